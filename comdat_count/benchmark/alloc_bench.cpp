@@ -0,0 +1,158 @@
+// Copyright (c) 2016 by SN Systems Ltd., Sony Interactive Entertainment Inc.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+// A benchmark counting the heap allocations made by the scan path. The input files are read into
+// memory and then scanned twice by the same comdat_scanner using each ELF backend. The first pass
+// adds every group signature to the results map; the second finds them all already present, so
+// its allocations are those of the steady-state scan itself.
+//
+// Only allocations made through operator new are counted. libelf's own (malloc()-based)
+// allocations are not.
+
+// Standard library includes
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <new>
+#include <string>
+#include <vector>
+
+// 3rd party includes
+#include <boost/filesystem.hpp>
+#include <libelf.h>
+
+// scanlib includes
+#include "comdat_scanner.hpp"
+#include "elf_enumerator.hpp"
+
+
+namespace {
+
+    std::atomic<std::uint64_t> allocations{0};
+
+} // end anonymous namespace
+
+void * operator new (std::size_t size) {
+    ++allocations;
+    if (void * const p = std::malloc (size == 0U ? 1U : size)) {
+        return p;
+    }
+    throw std::bad_alloc ();
+}
+void operator delete (void * p) noexcept {
+    std::free (p);
+}
+void operator delete (void * p, std::size_t) noexcept {
+    std::free (p);
+}
+
+
+namespace {
+
+    struct input {
+        boost::filesystem::path name;
+        std::vector<char> contents;
+    };
+
+    std::vector<input> load (std::vector<std::string> const & paths) {
+        std::vector<input> result;
+        for (auto const & path : paths) {
+            std::ifstream file (path, std::ios::binary);
+            if (!file) {
+                throw std::runtime_error ("Could not open \"" + path + '"');
+            }
+            result.push_back ({path, std::vector<char>{std::istreambuf_iterator<char> (file),
+                                                       std::istreambuf_iterator<char> ()}});
+        }
+        return result;
+    }
+
+    /// Scans each input using libelf. The inputs must be ELF object files (not archives).
+    void scan_libelf (std::vector<input> & inputs, comdat_scanner & scanner) {
+        for (auto & in : inputs) {
+            Elf * const elf = ::elf_memory (in.contents.data (), in.contents.size ());
+            if (elf == nullptr) {
+                throw std::runtime_error ("elf_memory() failed for " + in.name.string ());
+            }
+            scanner.scan (in.name, elf);
+            ::elf_end (elf);
+        }
+    }
+
+    /// Scans each input using the native reader.
+    void scan_native (std::vector<input> & inputs, comdat_scanner & scanner) {
+        for (auto & in : inputs) {
+            enumerate (elf_view::span{reinterpret_cast<std::uint8_t const *> (in.contents.data ()),
+                                      in.contents.size ()},
+                       in.name, &scanner, nullptr);
+        }
+    }
+
+    template <typename Function>
+    void measure (char const * name, std::vector<input> & inputs, Function scan) {
+        comdat_scanner scanner (output_flags{}, 1U, false /*record inputs*/);
+
+        std::uint64_t const start = allocations.load ();
+        scan (inputs, scanner);
+        std::uint64_t const first = allocations.load () - start;
+        scan (inputs, scanner);
+        std::uint64_t const second = allocations.load () - start - first;
+
+        std::uint64_t groups = 0;
+        for (auto const & kvp : scanner.comdats ()) {
+            groups += kvp.second.instances;
+        }
+        groups /= 2U;
+
+        auto const per = [](std::uint64_t n, std::uint64_t d) {
+            return d == 0U ? 0.0 : static_cast<double> (n) / static_cast<double> (d);
+        };
+        std::cout << std::left << std::setw (8) << name << std::right << std::fixed
+                  << std::setprecision (2) << "first pass: " << std::setw (8) << first << " ("
+                  << per (first, inputs.size ()) << "/input), second pass: " << std::setw (8)
+                  << second << " (" << per (second, inputs.size ()) << "/input, "
+                  << per (second, groups) << "/group)\n";
+    }
+
+} // end anonymous namespace
+
+
+int main (int argc, char * argv[]) {
+    if (argc < 2) {
+        std::cout << "Usage: " << argv[0] << " object-file...\n";
+        return EXIT_FAILURE;
+    }
+    try {
+        ::elf_version (EV_CURRENT);
+        std::vector<input> inputs = load (std::vector<std::string> (argv + 1, argv + argc));
+        std::cout << inputs.size () << " inputs\n";
+        measure ("libelf", inputs, scan_libelf);
+        measure ("native", inputs, scan_native);
+    } catch (std::exception const & ex) {
+        std::cerr << "Error: " << ex.what () << '\n';
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+// eof benchmark/alloc_bench.cpp
@@ -0,0 +1,203 @@
+// Copyright (c) 2016 by SN Systems Ltd., Sony Interactive Entertainment Inc.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+// A benchmark comparing the throughput of the scanner with and without NUMA-aware thread
+// placement. The input files are read into memory once and then scanned repeatedly in each
+// configuration so that only the scan and the aggregation of its results are measured.
+//
+// On a machine with a single NUMA node, use --nodes to divide the CPUs into simulated nodes.
+// This exercises the pinning and per-node shards (and shows the effect of splitting the results
+// map) although there is, of course, no remote memory to avoid.
+
+// Standard library includes
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+// 3rd party includes
+#include <boost/filesystem.hpp>
+#include <boost/program_options.hpp>
+
+// scanlib includes
+#include "comdat_scanner.hpp"
+#include "elf_enumerator.hpp"
+#include "numa.hpp"
+
+
+namespace {
+
+    struct input {
+        std::string name;
+        std::vector<std::uint8_t> contents;
+    };
+
+    std::vector<input> load (std::vector<std::string> const & paths, unsigned copies) {
+        std::vector<input> result;
+        for (auto const & path : paths) {
+            std::ifstream file (path, std::ios::binary);
+            if (!file) {
+                throw std::runtime_error ("Could not open \"" + path + '"');
+            }
+            std::vector<std::uint8_t> contents{std::istreambuf_iterator<char> (file),
+                                               std::istreambuf_iterator<char> ()};
+            for (auto ctr = 0U; ctr < copies; ++ctr) {
+                result.push_back ({path + '#' + std::to_string (ctr), contents});
+            }
+        }
+        return result;
+    }
+
+    struct timing {
+        double seconds;
+        std::size_t comdats;
+    };
+
+    /// Scans all of 'inputs' using 'num_threads' threads. If 'placement' is not null, the
+    /// threads are bound to its nodes and record their results per node.
+    timing run (std::vector<input> const & inputs, unsigned num_threads,
+                numa::placement const * const placement) {
+        output_flags const ofl;
+        comdat_scanner scanner (
+            ofl, placement != nullptr ? static_cast<unsigned> (placement->nodes ()) : 1U);
+        std::atomic<std::size_t> next{0};
+
+        auto const start = std::chrono::steady_clock::now ();
+        std::vector<std::thread> threads;
+        for (auto worker = 0U; worker < num_threads; ++worker) {
+            threads.emplace_back ([&, worker]() {
+                if (placement != nullptr) {
+                    comdat_scanner::set_thread_shard (placement->bind (worker));
+                }
+                for (std::size_t index; (index = next++) < inputs.size ();) {
+                    input const & in = inputs[index];
+                    enumerate (elf_view::span{in.contents.data (), in.contents.size ()},
+                               in.name, &scanner, nullptr);
+                }
+            });
+        }
+        for (auto & t : threads) {
+            t.join ();
+        }
+        scanner.merge_shards ();
+        std::chrono::duration<double> const elapsed = std::chrono::steady_clock::now () - start;
+        return {elapsed.count (), scanner.comdats ().size ()};
+    }
+
+    /// Runs the benchmark 'repeat' times and returns the fastest.
+    timing best_of (unsigned repeat, std::vector<input> const & inputs, unsigned num_threads,
+                    numa::placement const * const placement) {
+        timing best = run (inputs, num_threads, placement);
+        for (auto ctr = 1U; ctr < repeat; ++ctr) {
+            timing const t = run (inputs, num_threads, placement);
+            if (t.seconds < best.seconds) {
+                best = t;
+            }
+        }
+        return best;
+    }
+
+    void report (char const * name, timing const & t, std::uint64_t bytes, std::size_t files) {
+        double const mib = static_cast<double> (bytes) / (1024.0 * 1024.0);
+        std::cout << std::left << std::setw (10) << name << std::right << std::fixed
+                  << std::setprecision (3) << std::setw (10) << t.seconds << " s"
+                  << std::setprecision (1) << std::setw (12) << mib / t.seconds << " MiB/s"
+                  << std::setw (12) << static_cast<double> (files) / t.seconds << " files/s\n";
+    }
+}
+
+
+int main (int argc, char * argv[]) {
+    namespace po = boost::program_options;
+
+    try {
+        po::options_description options ("Options");
+        options.add_options () ("help", "produce help message") (
+            "threads,t",
+            po::value<unsigned> ()->default_value (
+                std::max (std::thread::hardware_concurrency (), 1U)),
+            "the number of scanning threads") (
+            "nodes", po::value<unsigned> ()->default_value (0U),
+            "the number of simulated NUMA nodes (0 uses the host's topology)") (
+            "repeat", po::value<unsigned> ()->default_value (5U),
+            "the number of runs of each configuration (the fastest is reported)") (
+            "copies", po::value<unsigned> ()->default_value (1U),
+            "the number of times that each input is scanned in a run");
+        po::options_description hidden;
+        hidden.add_options () ("input-file", po::value<std::vector<std::string>> (),
+                               "input file");
+        po::options_description all;
+        all.add (options).add (hidden);
+        po::positional_options_description positional;
+        positional.add ("input-file", -1);
+
+        po::variables_map vm;
+        store (po::command_line_parser (argc, argv).options (all).positional (positional).run (),
+               vm);
+        notify (vm);
+        if (vm.count ("help") || !vm.count ("input-file")) {
+            std::cout << "Usage: " << argv[0] << " [options] file...\n" << options << '\n';
+            return vm.count ("help") ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+
+        unsigned const num_threads = std::max (vm["threads"].as<unsigned> (), 1U);
+        unsigned const repeat = std::max (vm["repeat"].as<unsigned> (), 1U);
+        unsigned const nodes = vm["nodes"].as<unsigned> ();
+
+        std::vector<input> const inputs = load (vm["input-file"].as<std::vector<std::string>> (),
+                                                std::max (vm["copies"].as<unsigned> (), 1U));
+        std::uint64_t bytes = 0;
+        for (auto const & in : inputs) {
+            bytes += in.contents.size ();
+        }
+
+        numa::placement const placement (
+            nodes == 0U ? numa::topology::detect () : numa::topology::simulate (nodes), true);
+        std::cout << inputs.size () << " inputs, " << num_threads << " threads, "
+                  << placement.nodes () << (nodes == 0U ? "" : " simulated") << " node(s)\n";
+
+        timing const unpinned = best_of (repeat, inputs, num_threads, nullptr);
+        timing const pinned = best_of (repeat, inputs, num_threads, &placement);
+        if (unpinned.comdats != pinned.comdats) {
+            std::cerr << "Results differ: " << unpinned.comdats << " and " << pinned.comdats
+                      << " groups\n";
+            return EXIT_FAILURE;
+        }
+
+        report ("unpinned", unpinned, bytes, inputs.size ());
+        report ("pinned", pinned, bytes, inputs.size ());
+        std::cout << "speedup   " << std::setprecision (3) << unpinned.seconds / pinned.seconds
+                  << "x\n";
+    } catch (std::exception const & ex) {
+        std::cerr << "Error: " << ex.what () << '\n';
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+// eof benchmark/numa_bench.cpp
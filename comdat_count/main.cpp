@@ -20,12 +20,19 @@
 
 // Standard library includes
 #include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
 #include <exception>
 #include <fstream>
+#include <functional>
+#include <iostream>
 #include <memory>
 #include <sstream>
 #include <string>
 #include <thread>
+#include <utility>
+#include <vector>
 
 // 3rd party includes
 #include <boost/filesystem.hpp>
@@ -33,14 +40,23 @@
 #include <boost/thread/thread.hpp>
 
 // scanlib includes
+#include "checkpoint.hpp"
 #include "comdat_scanner.hpp"
 #include "consumer.hpp"
 #include "elf_helpers.hpp"
+#include "index_diff.hpp"
+#include "index_file.hpp"
+#include "input_set.hpp"
+#include "numa.hpp"
 #include "options.hpp"
+#include "prefetch.hpp"
 #include "producer.hpp"
 #include "progress.hpp"
-#include "temp_files.hpp"
-#include "zipper.hpp"
+#include "query.hpp"
+#include "results.hpp"
+#include "sampling.hpp"
+#include "unpack_pipeline.hpp"
+#include "watch.hpp"
 
 
 
@@ -51,11 +67,12 @@ namespace boost {
 }
 
 namespace {
-    std::unique_ptr <std::ofstream> output_file (std::string const & output) {
+    std::unique_ptr <std::ofstream> output_file (std::string const & output,
+                                                 std::ios::openmode mode = std::ios::out) {
         std::unique_ptr <std::ofstream> output_file_ptr;
         if (output != "-") {
             boost::filesystem::path path = output;
-            output_file_ptr.reset (new std::ofstream (path.native ()));
+            output_file_ptr.reset (new std::ofstream (path.native (), mode));
             if (!output_file_ptr->is_open ()) {
                 std::ostringstream str;
                 str << "Could not open " << path;
@@ -64,6 +81,110 @@ namespace {
         }
         return output_file_ptr;
     }
+
+    // The 'query' subcommand: answers questions from an index file written by an earlier scan.
+    int query_main (int argc, char * argv []) {
+        boost::program_options::variables_map vm = get_query_options (argc, argv);
+
+        index_file::reader const index (vm ["index"].as <std::string> ());
+
+        auto output_file_ptr = output_file (vm ["output"].as <std::string> ());
+        std::ostream & os = output_file_ptr.get () == nullptr ? std::cout : *output_file_ptr;
+
+        int exit_code = EXIT_SUCCESS;
+        bool any = false;
+        if (vm.count ("top")) {
+            query::top (index, vm ["top"].as <std::size_t> (), os);
+            any = true;
+        }
+        if (vm.count ("defines")) {
+            auto const & signature = vm ["defines"].as <std::string> ();
+            if (!query::defines (index, signature, os)) {
+                std::cerr << "Signature \"" << signature << "\" was not found\n";
+                exit_code = EXIT_FAILURE;
+            }
+            any = true;
+        }
+        if (vm.count ("prefix")) {
+            query::prefix (index, vm ["prefix"].as <std::string> (),
+                           vm ["limit"].as <std::size_t> (), os);
+            any = true;
+        }
+        if (!any) {
+            query::summary (index, os);
+        }
+        return exit_code;
+    }
+
+    // The --watch mode: scans the inputs once and then rescans the files which change, rewriting
+    // the output (and index) after each batch of changes. Runs until the process is killed.
+    int watch_main (boost::program_options::variables_map const & vm,
+                    std::vector <std::string> const & file_paths, unsigned num_threads,
+                    results::format format, bool unfiltered, output_flags const & ofl,
+                    scan_flags const & sfl) {
+        // Start watching before the initial scan so that no change is missed.
+        watch::watcher watcher (file_paths, ofl);
+        watch::live_results live;
+
+        auto all_files = [&file_paths, &ofl] () {
+            std::vector <std::string> result;
+            for_each_input_file (file_paths, ofl, [&result] (boost::filesystem::path const & p) {
+                result.push_back (p.string ());
+            });
+            return result;
+        };
+
+        auto write_results = [&] () {
+            auto output_file_ptr = output_file (vm ["output"].as <std::string> (),
+                                                format == results::format::binary
+                                                    ? std::ios::out | std::ios::binary
+                                                    : std::ios::out);
+            std::ostream & os = output_file_ptr.get () == nullptr ? std::cout : *output_file_ptr;
+            md5::digest const digest = live.digest ();
+            results::write (comdat_scanner::make_report (live.comdats (), digest, unfiltered),
+                            format, os);
+            os.flush ();
+
+            if (vm.count ("index")) {
+                comdat_scanner::comdat_map cm;
+                std::vector <std::string> inputs;
+                live.snapshot (cm, inputs);
+                index_file::write (vm ["index"].as <std::string> (), cm, inputs, digest);
+            }
+        };
+
+        watch::refresh (live, all_files (), num_threads, ofl, sfl);
+        std::chrono::milliseconds const debounce {vm ["debounce"].as <unsigned> ()};
+        for (;;) {
+            write_results ();
+            if (!ofl.quiet) {
+                std::cerr << "Watching " << live.files () << " files\n";
+            }
+
+            watch::watcher::changes const changes = watcher.wait (debounce);
+            std::vector <std::string> modified;
+            if (changes.overflow) {
+                // Some events were lost so everything must be checked.
+                for (std::string const & path : live.paths ()) {
+                    if (!boost::filesystem::exists (path)) {
+                        live.remove (path);
+                    }
+                }
+                modified = all_files ();
+            } else {
+                for (std::string const & path : changes.removed) {
+                    live.remove (path);
+                }
+                modified.assign (std::begin (changes.modified), std::end (changes.modified));
+            }
+
+            if (!ofl.quiet) {
+                std::cerr << "Rescanning " << modified.size () << " files ("
+                          << changes.removed.size () << " removed)\n";
+            }
+            watch::refresh (live, modified, num_threads, ofl, sfl);
+        }
+    }
 }
 
 
@@ -77,6 +198,10 @@ int main (int argc, char *argv []) {
     }
 
     try {
+        if (argc > 1 && std::strcmp (argv [1], "query") == 0) {
+            return query_main (argc - 1, argv + 1);
+        }
+
         boost::program_options::variables_map vm =
             get_program_options (argc, argv);
 
@@ -86,11 +211,30 @@ int main (int argc, char *argv []) {
             return EXIT_SUCCESS;
         }
 
+        if (vm.count ("diff")) {
+            auto const & paths = vm ["diff"].as <std::vector <std::string>> ();
+            if (paths.size () != 2) {
+                throw std::runtime_error ("--diff requires two index files (old and new)");
+            }
+            index_file::reader const old_index (paths [0]);
+            index_file::reader const new_index (paths [1]);
+
+            auto output_file_ptr = output_file (vm ["output"].as <std::string> ());
+            std::ostream & os = output_file_ptr.get () == nullptr ? std::cout : *output_file_ptr;
+            index_diff::diff (old_index, new_index, os);
+            return EXIT_SUCCESS;
+        }
+
         assert (vm.count ("threads") == 1);
         unsigned num_threads = vm ["threads"].as <unsigned> ();
         assert (num_threads > 0);
 
         assert (vm.count ("output") == 1);
+        results::format const format = results::parse_format (vm ["format"].as <std::string> ());
+        bool const unfiltered = vm ["unfiltered"].as <bool> ();
+        if (unfiltered && format == results::format::text) {
+            throw std::runtime_error ("--unfiltered requires --format=json, csv or binary");
+        }
 
         auto const & input_files = vm ["input-file"];
         if (!input_files.empty ()) {
@@ -98,15 +242,93 @@ int main (int argc, char *argv []) {
             ofl.verbose = vm ["verbose"].as <bool> ();
             ofl.quiet   = vm ["quiet"  ].as <bool> ();
 
+            scan_flags sfl;
+            sfl.backend = vm ["backend"].as <std::string> () == "libelf" ? elf_backend::libelf
+                                                                      : elf_backend::native;
+
+            if (vm ["watch"].as <bool> ()) {
+                if (vm.count ("sample") || vm.count ("checkpoint") || vm ["resume"].as <bool> ()) {
+                    throw std::runtime_error (
+                        "--watch cannot be used with --sample, --checkpoint or --resume");
+                }
+                return watch_main (vm, input_files.as <std::vector <std::string>> (), num_threads,
+                                   format, unfiltered, ofl, sfl);
+            }
+
             state_flags state;
             state.error = false;
 
-            comdat_scanner scanner (ofl);
+            // Optionally pin the consumers to the CPUs of a NUMA node and have the threads on
+            // each node record their results separately.
+            std::unique_ptr <numa::placement> placement;
+            if (vm ["pin-threads"].as <bool> ()) {
+                unsigned const nodes = vm ["numa-nodes"].as <unsigned> ();
+                placement.reset (new numa::placement (nodes == 0U ? numa::topology::detect ()
+                                                                  : numa::topology::simulate (nodes),
+                                                      true /*pin*/));
+                if (ofl.verbose) {
+                    std::cout << "Pinning threads to " << placement->nodes () << " node(s)\n";
+                }
+            }
+
+            // The per-group lists of inputs are only needed by the index and the sampling
+            // estimate. A checkpoint keeps them in case the resumed scan writes an index.
+            bool const record_inputs =
+                vm.count ("index") || vm.count ("sample") || vm.count ("checkpoint");
+            comdat_scanner scanner (ofl,
+                                    placement ? static_cast <unsigned> (placement->nodes ()) : 1U,
+                                    record_inputs);
+
+            // If resuming, load the results of the earlier run. The inputs that it completed are
+            // not scanned again.
+            boost::filesystem::path checkpoint_path;
+            checkpoint::completed_set completed;
+            if (vm.count ("checkpoint")) {
+                checkpoint_path = vm ["checkpoint"].as <std::string> ();
+                if (vm ["resume"].as <bool> () && boost::filesystem::exists (checkpoint_path)) {
+                    completed = checkpoint::load (checkpoint_path, scanner);
+                    if (!ofl.quiet) {
+                        std::cerr << "Resuming: " << completed.size ()
+                                  << " inputs already scanned\n";
+                    }
+                }
+            } else if (vm ["resume"].as <bool> ()) {
+                throw std::runtime_error ("--resume requires --checkpoint");
+            }
             auto file_paths = input_files.as <std::vector <std::string>> ();
 
-            // Create the lock-free queue onto which we will push jobs.
-            queue_type queue {file_paths.size ()};
-            std::size_t const num_queued = queue_input_files (queue, file_paths, ofl);
+            // If a sample was requested, choose the files to be scanned.
+            std::unique_ptr <sampling::sample> sample;
+            if (vm.count ("sample")) {
+                std::vector <boost::filesystem::path> all_files;
+                auto collect = [&all_files] (boost::filesystem::path const & p) {
+                    all_files.push_back (p);
+                };
+                for_each_input_file (file_paths, ofl, collect);
+                sample.reset (new sampling::sample (all_files, vm ["sample"].as <double> (),
+                                                    vm ["seed"].as <std::uint64_t> ()));
+                file_paths = sample->files ();
+                if (!ofl.quiet) {
+                    std::cerr << "Sampled " << file_paths.size () << " of " << all_files.size ()
+                              << " input files\n";
+                }
+            }
+
+            // Create the work queue onto which we will push jobs.
+            queue_type queue {num_threads};
+            input_set inputs;
+            std::vector <unpack_pipeline::job> jobs;
+            std::size_t const num_queued = queue_input_files (
+                queue, file_paths, inputs, jobs, ofl, completed.empty () ? nullptr : &completed);
+
+            // Start the I/O threads which pull the input files into the OS cache ahead of the
+            // consumers.
+            std::unique_ptr <prefetcher> prefetch;
+            unsigned const io_threads = vm ["io-threads"].as <unsigned> ();
+            if (io_threads > 0) {
+                unsigned const depth = vm ["prefetch-depth"].as <unsigned> ();
+                prefetch.reset (new prefetcher (queue, io_threads, depth));
+            }
 
             // Start the consumer threads. They'll immediately start pulling work from the
             // queue and then exit when it is exhausted.
@@ -116,17 +338,59 @@ int main (int argc, char *argv []) {
                     progress.run ();
                 }
 
+                // Start unpacking any zip members and tar files. Tar entries are added to the
+                // progress total as they are found.
+                std::unique_ptr <unpack_pipeline> unpack;
+                if (!jobs.empty ()) {
+                    unsigned const unpack_threads = vm ["unpack-threads"].as <unsigned> ();
+                    std::size_t const budget =
+                        std::size_t{vm ["unpack-memory"].as <unsigned> ()} * 1024U * 1024U;
+                    // Consumers waiting for the work queue must also wake for unpacked entries.
+                    unpack.reset (new unpack_pipeline (std::move (jobs), unpack_threads, budget,
+                                                       &progress,
+                                                       completed.empty () ? nullptr : &completed,
+                                                       [&queue] () { queue.wake (); }));
+                }
+
+                // Start recording checkpoints.
+                std::unique_ptr <checkpoint::tracker> tracker;
+                if (!checkpoint_path.empty ()) {
+                    std::chrono::milliseconds const interval =
+                        std::chrono::seconds {vm ["checkpoint-interval"].as <unsigned> ()};
+                    tracker.reset (new checkpoint::tracker (checkpoint_path, interval, scanner,
+                                                            completed, num_threads));
+                }
+
                 boost::thread_group threads;
-                while (num_threads-- > 0) {
-                    threads.create_thread (boost::bind (consumer,
-                                                        std::ref (queue), // the queue from which the consumer will read
-                                                        &scanner,
-                                                        std::cref (ofl), // output flags
-                                                        &state,
-                                                        std::ref (progress)));
+                for (unsigned worker = 0; worker < num_threads; ++worker) {
+                    auto entry_point = std::bind (consumer,
+                                                  std::ref (queue), // the queue from which the consumer will read
+                                                  worker,
+                                                  prefetch.get (),
+                                                  unpack.get (),
+                                                  &scanner,
+                                                  tracker.get (),
+                                                  std::cref (ofl), // output flags
+                                                  std::cref (sfl), // scan flags
+                                                  &state,
+                                                  std::ref (progress));
+                    numa::placement const * const p = placement.get ();
+                    threads.create_thread ([p, worker, entry_point] () {
+                        if (p != nullptr) {
+                            comdat_scanner::set_thread_shard (p->bind (worker));
+                        }
+                        entry_point ();
+                    });
                 }
                 // Wait for the worker threads to finish.
                 threads.join_all ();
+                if (tracker) {
+                    tracker->stop ();
+                }
+                scanner.merge_shards ();
+                if (prefetch) {
+                    prefetch->stop ();
+                }
             }
 
             if (!state.error) {
@@ -134,12 +398,37 @@ int main (int argc, char *argv []) {
                     std::cout << "Dumping results\n";
                 }
 
-                auto output_file_ptr = output_file (vm ["output"].as <std::string> ());
+                auto output_file_ptr = output_file (vm ["output"].as <std::string> (),
+                                                    format == results::format::binary
+                                                        ? std::ios::out | std::ios::binary
+                                                        : std::ios::out);
                 std::ostream & output_file = output_file_ptr.get () == nullptr
                                            ? std::cout
                                            : *output_file_ptr;
 
-                output_file << scanner;
+                if (sample) {
+                    sampling::estimate const estimate =
+                        sample->extrapolate (scanner.comdats (), scanner.inputs ());
+                    results::write (scanner.make_report (unfiltered), format, output_file,
+                                    &estimate);
+                } else {
+                    results::write (scanner.make_report (unfiltered), format, output_file);
+                }
+
+                if (vm.count ("index")) {
+                    if (ofl.verbose) {
+                        std::cout << "Writing index\n";
+                    }
+                    // Record the other names by which each input was reached.
+                    index_file::write (vm ["index"].as <std::string> (), scanner.comdats (),
+                                       inputs.annotate (scanner.inputs ()), scanner.digest ());
+                }
+
+                // The scan is complete so its checkpoint is no longer needed.
+                if (!checkpoint_path.empty ()) {
+                    boost::system::error_code ec;
+                    boost::filesystem::remove (checkpoint_path, ec);
+                }
             }
             if (state.error) {
                 exit_code = EXIT_FAILURE;
@@ -0,0 +1,107 @@
+// Copyright (c) 2016 by SN Systems Ltd., Sony Interactive Entertainment Inc.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef SCANLIB_APPEND_ARENA_HPP
+#define SCANLIB_APPEND_ARENA_HPP
+
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+
+/// An append-only container whose elements never move once they have been added. Any number of
+/// threads may append concurrently without taking a lock: each append claims a slot with a single
+/// atomic increment. Storage is allocated in chunks of ChunkSize elements; the first thread to
+/// need a new chunk publishes it with a compare-exchange.
+///
+/// Chunks are made up of default-constructed elements to which appended values are
+/// move-assigned. T must therefore be default constructible and its default constructor should
+/// be cheap.
+template <typename T, std::size_t ChunkSize = 4096, std::size_t MaxChunks = 16384>
+class append_arena {
+public:
+    append_arena ()
+            : size_ (0) {
+        for (auto & c : chunks_) {
+            c.store (nullptr, std::memory_order_relaxed);
+        }
+    }
+    ~append_arena () {
+        for (auto & c : chunks_) {
+            delete[] c.load (std::memory_order_relaxed);
+        }
+    }
+
+    // No copying or assignment.
+    append_arena (append_arena const &) = delete;
+    append_arena & operator= (append_arena const &) = delete;
+
+    /// Adds a value to the arena and returns a pointer to it. The pointer remains valid for the
+    /// lifetime of the arena.
+    T * append (T && value) {
+        std::size_t const index = size_.fetch_add (1U, std::memory_order_relaxed);
+        std::size_t const chunk_index = index / ChunkSize;
+        if (chunk_index >= MaxChunks) {
+            throw std::length_error ("append_arena capacity exceeded");
+        }
+        T * const slot = this->chunk (chunk_index) + index % ChunkSize;
+        *slot = std::move (value);
+        return slot;
+    }
+
+    /// Returns the element with the given index. Elements are numbered in the order in which
+    /// they were appended. The element must have been added by a call to append() which has
+    /// returned.
+    T const & operator[] (std::size_t index) const {
+        assert (index < this->size ());
+        T const * const c = chunks_[index / ChunkSize].load (std::memory_order_acquire);
+        assert (c != nullptr);
+        return c[index % ChunkSize];
+    }
+
+    /// The number of elements that have been added.
+    std::size_t size () const {
+        return size_.load (std::memory_order_relaxed);
+    }
+
+private:
+    T * chunk (std::size_t chunk_index) {
+        std::atomic<T *> & c = chunks_[chunk_index];
+        T * result = c.load (std::memory_order_acquire);
+        if (result == nullptr) {
+            std::unique_ptr<T[]> fresh (new T[ChunkSize]);
+            if (c.compare_exchange_strong (result, fresh.get (), std::memory_order_acq_rel)) {
+                result = fresh.release ();
+            }
+            // Otherwise another thread won the race: 'result' now holds its chunk and ours is
+            // discarded.
+        }
+        return result;
+    }
+
+    std::atomic<std::size_t> size_;
+    std::array<std::atomic<T *>, MaxChunks> chunks_;
+};
+
+#endif // SCANLIB_APPEND_ARENA_HPP
+// eof scanlib/append_arena.hpp
@@ -0,0 +1,139 @@
+// Copyright (c) 2016 by SN Systems Ltd., Sony Interactive Entertainment Inc.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef SCANLIB_ARENA_HPP
+#define SCANLIB_ARENA_HPP
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <memory>
+#include <utility>
+#include <vector>
+
+/// A monotonic allocator: memory is carved sequentially from large blocks and is never freed
+/// individually. Instead, reset() makes all of the memory available again at once while keeping
+/// the blocks for reuse. After the first few uses, an arena that is reset between units of work
+/// of similar size performs no heap allocation at all.
+///
+/// An arena is not thread-safe: each thread should use its own.
+class monotonic_arena {
+public:
+    explicit monotonic_arena (std::size_t block_size = 16 * 1024)
+            : block_size_ (block_size) {}
+
+    // No copying or assignment.
+    monotonic_arena (monotonic_arena const &) = delete;
+    monotonic_arena & operator= (monotonic_arena const &) = delete;
+
+    void * allocate (std::size_t size, std::size_t align) {
+        assert (align > 0U && (align & (align - 1U)) == 0U);
+        for (;;) {
+            if (current_ < blocks_.size ()) {
+                block & b = blocks_[current_];
+                std::size_t const aligned = (used_ + align - 1U) & ~(align - 1U);
+                if (aligned <= b.size && size <= b.size - aligned) {
+                    used_ = aligned + size;
+                    return b.data.get () + aligned;
+                }
+                // Move to the next block (if there is one) and try again.
+                if (current_ + 1U < blocks_.size () &&
+                    blocks_[current_ + 1U].size >= size + align) {
+                    ++current_;
+                    used_ = 0U;
+                    continue;
+                }
+            }
+            this->new_block (size + align);
+        }
+    }
+
+    /// Makes all of the arena's memory available for reuse. Any memory previously allocated
+    /// must no longer be in use.
+    void reset () {
+        current_ = 0U;
+        used_ = 0U;
+    }
+
+    /// The number of blocks allocated from the heap by this arena.
+    std::size_t blocks () const {
+        return blocks_.size ();
+    }
+
+private:
+    struct block {
+        std::unique_ptr<char[]> data;
+        std::size_t size;
+    };
+
+    void new_block (std::size_t min_size) {
+        std::size_t const size = std::max (block_size_, min_size);
+        block b{std::unique_ptr<char[]> (new char[size]), size};
+        // Insert the new block after the current one so that any blocks still waiting to be
+        // reused remain available.
+        auto const pos = current_ < blocks_.size () ? current_ + 1U : blocks_.size ();
+        blocks_.insert (blocks_.begin () + static_cast<std::ptrdiff_t> (pos), std::move (b));
+        current_ = pos;
+        used_ = 0U;
+    }
+
+    std::size_t const block_size_;
+    std::vector<block> blocks_;
+    std::size_t current_ = 0U;
+    std::size_t used_ = 0U;
+};
+
+
+/// A standard library allocator which obtains its memory from a monotonic_arena.
+template <typename T>
+class arena_allocator {
+public:
+    using value_type = T;
+
+    explicit arena_allocator (monotonic_arena * const arena) noexcept
+            : arena_ (arena) {}
+    template <typename Other>
+    arena_allocator (arena_allocator<Other> const & other) noexcept
+            : arena_ (other.arena ()) {}
+
+    T * allocate (std::size_t n) {
+        return static_cast<T *> (arena_->allocate (n * sizeof (T), alignof (T)));
+    }
+    void deallocate (T *, std::size_t) noexcept {}
+
+    monotonic_arena * arena () const noexcept {
+        return arena_;
+    }
+
+private:
+    monotonic_arena * arena_;
+};
+
+template <typename T, typename U>
+bool operator== (arena_allocator<T> const & lhs, arena_allocator<U> const & rhs) noexcept {
+    return lhs.arena () == rhs.arena ();
+}
+template <typename T, typename U>
+bool operator!= (arena_allocator<T> const & lhs, arena_allocator<U> const & rhs) noexcept {
+    return !(lhs == rhs);
+}
+
+#endif // SCANLIB_ARENA_HPP
+// eof scanlib/arena.hpp
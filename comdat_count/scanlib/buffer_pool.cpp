@@ -0,0 +1,142 @@
+// Copyright (c) 2016 by SN Systems Ltd., Sony Interactive Entertainment Inc.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "buffer_pool.hpp"
+
+#include <algorithm>
+#include <climits>
+
+constexpr unsigned buffer_pool::min_class;
+
+// (ctor)
+// ~~~~~~
+buffer_pool::buffer_pool (std::size_t budget)
+        : budget_ (budget)
+        , free_ (sizeof (std::size_t) * CHAR_BIT) {}
+
+// size class [static]
+// ~~~~~~~~~~
+unsigned buffer_pool::size_class (std::size_t size) {
+    unsigned result = min_class;
+    while (class_size (result) < size) {
+        ++result;
+    }
+    return result;
+}
+
+// acquire
+// ~~~~~~~
+auto buffer_pool::acquire (std::size_t size) -> buffer {
+    unsigned const c = size_class (size);
+    std::size_t const capacity = class_size (c);
+
+    std::unique_lock<std::mutex> lock (mut_);
+    cv_.wait (lock, [this, capacity]() {
+        return cancel_ || outstanding_ == 0U || outstanding_ + capacity <= budget_;
+    });
+    if (cancel_) {
+        return {};
+    }
+
+    outstanding_ += capacity;
+    auto & free = free_[c];
+    if (!free.empty ()) {
+        std::unique_ptr<std::uint8_t[]> data = std::move (free.back ());
+        free.pop_back ();
+        cached_ -= capacity;
+        return {std::move (data), c};
+    }
+
+    // A new buffer is needed. Drop cached buffers of other sizes so that the total memory held
+    // by the pool stays within the budget.
+    if (outstanding_ + cached_ > budget_) {
+        this->trim (outstanding_ + cached_ - budget_);
+    }
+    lock.unlock ();
+
+    try {
+        return {std::unique_ptr<std::uint8_t[]> (new std::uint8_t[capacity]), c};
+    } catch (...) {
+        lock.lock ();
+        outstanding_ -= capacity;
+        lock.unlock ();
+        cv_.notify_all ();
+        throw;
+    }
+}
+
+// release
+// ~~~~~~~
+void buffer_pool::release (buffer && b) {
+    if (!b) {
+        return;
+    }
+    std::size_t const capacity = b.capacity ();
+    {
+        std::lock_guard<std::mutex> lock (mut_);
+        outstanding_ -= capacity;
+        if (outstanding_ + cached_ + capacity <= budget_) {
+            free_[b.size_class_].push_back (std::move (b.data_));
+            cached_ += capacity;
+        }
+    }
+    b.data_.reset ();
+    cv_.notify_all ();
+}
+
+// cancel
+// ~~~~~~
+void buffer_pool::cancel () {
+    {
+        std::lock_guard<std::mutex> lock (mut_);
+        cancel_ = true;
+    }
+    cv_.notify_all ();
+}
+
+// outstanding
+// ~~~~~~~~~~~
+std::size_t buffer_pool::outstanding () const {
+    std::lock_guard<std::mutex> lock (mut_);
+    return outstanding_;
+}
+
+// cached
+// ~~~~~~
+std::size_t buffer_pool::cached () const {
+    std::lock_guard<std::mutex> lock (mut_);
+    return cached_;
+}
+
+// trim
+// ~~~~
+void buffer_pool::trim (std::size_t bytes) {
+    std::size_t freed = 0;
+    for (auto c = free_.size (); c > 0U && freed < bytes; --c) {
+        auto & free = free_[c - 1U];
+        while (!free.empty () && freed < bytes) {
+            free.pop_back ();
+            freed += class_size (static_cast<unsigned> (c - 1U));
+        }
+    }
+    cached_ -= std::min (cached_, freed);
+}
+
+// eof scanlib/buffer_pool.cpp
@@ -0,0 +1,116 @@
+// Copyright (c) 2016 by SN Systems Ltd., Sony Interactive Entertainment Inc.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef SCANLIB_BUFFER_POOL_HPP
+#define SCANLIB_BUFFER_POOL_HPP
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+/// A pool of recycled memory buffers. Buffer sizes are rounded up to a power of two (the "size
+/// class") so that a buffer released after holding one member can be reused for another of a
+/// similar size without going back to the heap.
+///
+/// The pool also caps the memory in use: acquire() waits while the buffers that have been
+/// acquired but not yet released would exceed the budget. This provides the back-pressure
+/// which stops decompression threads running too far ahead of the consumers.
+class buffer_pool {
+public:
+    class buffer {
+    public:
+        buffer () = default;
+
+        std::uint8_t * data () const {
+            return data_.get ();
+        }
+        std::size_t capacity () const {
+            return data_ ? class_size (size_class_) : 0U;
+        }
+        explicit operator bool () const {
+            return data_ != nullptr;
+        }
+
+    private:
+        friend class buffer_pool;
+        buffer (std::unique_ptr<std::uint8_t[]> && data, unsigned size_class)
+                : data_ (std::move (data))
+                , size_class_ (size_class) {}
+
+        std::unique_ptr<std::uint8_t[]> data_;
+        unsigned size_class_ = 0;
+    };
+
+    /// The smallest size class: 4KiB.
+    static constexpr unsigned min_class = 12;
+
+    explicit buffer_pool (std::size_t budget);
+
+    // No copying or assignment.
+    buffer_pool (buffer_pool const &) = delete;
+    buffer_pool & operator= (buffer_pool const &) = delete;
+
+    /// Returns a buffer of at least 'size' bytes. Waits while the buffers outstanding would
+    /// exceed the budget; a request larger than the budget is satisfied only once no other
+    /// buffers are outstanding.
+    /// \returns An empty buffer if the pool was cancelled.
+    buffer acquire (std::size_t size);
+
+    /// Returns a buffer to the pool so that it can be reused.
+    void release (buffer && b);
+
+    /// Wakes any threads waiting in acquire(). acquire() returns an empty buffer from this
+    /// point on.
+    void cancel ();
+
+    /// The number of bytes in buffers that have been acquired and not released.
+    std::size_t outstanding () const;
+    /// The number of bytes in buffers held for reuse.
+    std::size_t cached () const;
+
+    /// Returns the size class for a buffer of 'size' bytes.
+    static unsigned size_class (std::size_t size);
+    /// Returns the capacity of buffers in the given size class.
+    static std::size_t class_size (unsigned c) {
+        return std::size_t{1} << c;
+    }
+
+private:
+    /// Frees cached buffers, largest first, until at least 'bytes' have been released. Called
+    /// with mut_ held.
+    void trim (std::size_t bytes);
+
+    std::size_t const budget_;
+
+    mutable std::mutex mut_;
+    std::condition_variable cv_;
+    /// Free buffers indexed by size class.
+    std::vector<std::vector<std::unique_ptr<std::uint8_t[]>>> free_;
+    std::size_t outstanding_ = 0;
+    std::size_t cached_ = 0;
+    bool cancel_ = false;
+};
+
+#endif // SCANLIB_BUFFER_POOL_HPP
+// eof scanlib/buffer_pool.hpp
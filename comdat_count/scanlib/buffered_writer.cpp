@@ -0,0 +1,114 @@
+// Copyright (c) 2016 by SN Systems Ltd., Sony Interactive Entertainment Inc.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "buffered_writer.hpp"
+
+#include <algorithm>
+#include <ostream>
+
+namespace {
+    /// The two digit decimal representation of each of the values 0 to 99.
+    char const digit_pairs[] = "00010203040506070809"
+                               "10111213141516171819"
+                               "20212223242526272829"
+                               "30313233343536373839"
+                               "40414243444546474849"
+                               "50515253545556575859"
+                               "60616263646566676869"
+                               "70717273747576777879"
+                               "80818283848586878889"
+                               "90919293949596979899";
+}
+
+constexpr std::size_t buffered_writer::default_capacity;
+constexpr std::size_t buffered_writer::max_uint_chars;
+
+// (ctor)
+// ~~~~~~
+buffered_writer::buffered_writer (std::ostream & os, std::size_t capacity)
+        : os_ (os)
+        , capacity_ (std::max (capacity, max_uint_chars))
+        , buffer_ (new char[capacity_]) {}
+
+// (dtor)
+// ~~~~~~
+buffered_writer::~buffered_writer () {
+    this->flush ();
+}
+
+// flush
+// ~~~~~
+void buffered_writer::flush () {
+    if (pos_ > 0U) {
+        os_.write (buffer_.get (), static_cast<std::streamsize> (pos_));
+        pos_ = 0;
+    }
+}
+
+// write
+// ~~~~~
+buffered_writer & buffered_writer::write (char const * s, std::size_t size) {
+    if (size > capacity_ - pos_) {
+        this->flush ();
+        if (size > capacity_) {
+            // Too big to be worth copying.
+            os_.write (s, static_cast<std::streamsize> (size));
+            return *this;
+        }
+    }
+    std::memcpy (buffer_.get () + pos_, s, size);
+    pos_ += size;
+    return *this;
+}
+
+// write uint
+// ~~~~~~~~~~
+buffered_writer & buffered_writer::write_uint (std::uint64_t v) {
+    if (capacity_ - pos_ < max_uint_chars) {
+        this->flush ();
+    }
+    pos_ = static_cast<std::size_t> (to_chars (buffer_.get () + pos_, v) - buffer_.get ());
+    return *this;
+}
+
+// to chars [static]
+// ~~~~~~~~
+char * buffered_writer::to_chars (char * out, std::uint64_t v) {
+    // Produce the digits from the right, two at a time, then copy them to 'out'.
+    char digits[max_uint_chars];
+    char * p = digits + max_uint_chars;
+    while (v >= 100U) {
+        auto const pair = static_cast<unsigned> (v % 100U) * 2U;
+        v /= 100U;
+        *--p = digit_pairs[pair + 1U];
+        *--p = digit_pairs[pair];
+    }
+    if (v >= 10U) {
+        auto const pair = static_cast<unsigned> (v) * 2U;
+        *--p = digit_pairs[pair + 1U];
+        *--p = digit_pairs[pair];
+    } else {
+        *--p = static_cast<char> ('0' + v);
+    }
+    auto const length = static_cast<std::size_t> (digits + max_uint_chars - p);
+    std::memcpy (out, p, length);
+    return out + length;
+}
+// eof scanlib/buffered_writer.cpp
@@ -0,0 +1,82 @@
+// Copyright (c) 2016 by SN Systems Ltd., Sony Interactive Entertainment Inc.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef SCANLIB_BUFFERED_WRITER_HPP
+#define SCANLIB_BUFFERED_WRITER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iosfwd>
+#include <memory>
+#include <string>
+
+/// Collects output in a large buffer which is passed to the underlying stream in a single call
+/// when it fills. Integers are converted to text directly into the buffer. This avoids the cost
+/// of formatted stream insertion (locale, sentry and width handling) for every value when
+/// writing large results.
+class buffered_writer {
+public:
+    static constexpr std::size_t default_capacity = 256 * 1024;
+
+    explicit buffered_writer (std::ostream & os, std::size_t capacity = default_capacity);
+    /// Flushes any remaining output.
+    ~buffered_writer ();
+
+    // No copying or assignment.
+    buffered_writer (buffered_writer const &) = delete;
+    buffered_writer & operator= (buffered_writer const &) = delete;
+
+    buffered_writer & put (char c) {
+        if (pos_ == capacity_) {
+            this->flush ();
+        }
+        buffer_[pos_++] = c;
+        return *this;
+    }
+    buffered_writer & write (char const * s, std::size_t size);
+    buffered_writer & write (char const * s) {
+        return this->write (s, std::strlen (s));
+    }
+    buffered_writer & write (std::string const & s) {
+        return this->write (s.data (), s.size ());
+    }
+    /// Writes the decimal representation of 'v'.
+    buffered_writer & write_uint (std::uint64_t v);
+
+    /// Passes the buffered output to the stream.
+    void flush ();
+
+    /// The maximum number of characters produced by write_uint().
+    static constexpr std::size_t max_uint_chars = 20;
+    /// Writes the decimal representation of 'v' to 'out', which must have room for at least
+    /// max_uint_chars characters.
+    /// \returns A pointer to the character following the last one written.
+    static char * to_chars (char * out, std::uint64_t v);
+
+private:
+    std::ostream & os_;
+    std::size_t const capacity_;
+    std::unique_ptr<char[]> buffer_;
+    std::size_t pos_ = 0;
+};
+
+#endif // SCANLIB_BUFFERED_WRITER_HPP
+// eof scanlib/buffered_writer.hpp
@@ -0,0 +1,442 @@
+// Copyright (c) 2016 by SN Systems Ltd., Sony Interactive Entertainment Inc.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "checkpoint.hpp"
+
+// Standard library includes
+#include <cassert>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <utility>
+#include <vector>
+
+// 3rd party includes
+#include <boost/filesystem/operations.hpp>
+
+// Local includes
+#include "comdat_scanner.hpp"
+#include "print.hpp"
+
+namespace {
+
+    // image writer
+    // ~~~~~~~~~~~~
+    class image_writer {
+    public:
+        template <typename T>
+        void put (T const & t) {
+            image_.append (reinterpret_cast<char const *> (&t), sizeof (T));
+        }
+        void put_string (std::string const & str) {
+            this->put (static_cast<std::uint32_t> (str.length ()));
+            image_.append (str);
+        }
+        std::string & image () {
+            return image_;
+        }
+
+    private:
+        std::string image_;
+    };
+
+
+    // image reader
+    // ~~~~~~~~~~~~
+    class image_reader {
+    public:
+        image_reader (std::string const & image, boost::filesystem::path const & path)
+                : first_ (image.data ())
+                , last_ (image.data () + image.size ())
+                , path_ (path) {}
+
+        template <typename T>
+        T get () {
+            T result;
+            std::memcpy (&result, this->consume (sizeof (T)), sizeof (T));
+            return result;
+        }
+        std::string get_string () {
+            auto const length = this->get<std::uint32_t> ();
+            char const * const str = this->consume (length);
+            return {str, length};
+        }
+        /// Checks that 'count' items of at least 'size' bytes each could fit in the remainder of
+        /// the image so that a corrupt count doesn't cause an enormous allocation.
+        std::size_t check_count (std::uint64_t count, std::size_t size) const {
+            if (count > static_cast<std::uint64_t> (last_ - first_) / size) {
+                this->fail ();
+            }
+            return static_cast<std::size_t> (count);
+        }
+        bool at_end () const {
+            return first_ == last_;
+        }
+        [[noreturn]] void fail () const {
+            std::ostringstream str;
+            str << "The checkpoint file " << path_ << " is corrupt";
+            throw checkpoint::exception (str.str ());
+        }
+
+    private:
+        char const * consume (std::size_t size) {
+            if (size > static_cast<std::size_t> (last_ - first_)) {
+                this->fail ();
+            }
+            char const * const result = first_;
+            first_ += size;
+            return result;
+        }
+
+        char const * first_;
+        char const * const last_;
+        boost::filesystem::path const & path_;
+    };
+
+
+    // make image
+    // ~~~~~~~~~~
+    /// The comdats and inputs of a shard.
+    using shard_ref =
+        std::pair<comdat_scanner::comdat_map const *, std::vector<std::string> const *>;
+
+    /// Returns the checkpoint image for the given digests, completed inputs and shards.
+    std::string make_image (std::vector<md5::digest> const & digests,
+                            checkpoint::completed_set const & completed,
+                            std::vector<shard_ref> const & shards) {
+
+        checkpoint::header h;
+        std::memset (&h, 0, sizeof (h));
+        std::memcpy (h.magic, checkpoint::magic, sizeof (h.magic));
+        h.version = checkpoint::version;
+        h.byte_order = checkpoint::byte_order_marker;
+        h.digest_count = digests.size ();
+        h.completed_count = completed.size ();
+        h.shard_count = shards.size ();
+
+        image_writer w;
+        w.put (h);
+        for (auto const & d : digests) {
+            w.put (d);
+        }
+        for (auto const & name : completed) {
+            w.put_string (name);
+        }
+        for (shard_ref const & sh : shards) {
+            comdat_scanner::comdat_map const & comdats = *sh.first;
+            std::vector<std::string> const & inputs = *sh.second;
+            w.put (static_cast<std::uint64_t> (inputs.size ()));
+            for (auto const & name : inputs) {
+                w.put_string (name);
+            }
+            w.put (static_cast<std::uint64_t> (comdats.size ()));
+            for (auto const & kvp : comdats) {
+                comdat_scanner::value const & v = kvp.second;
+                w.put_string (kvp.first);
+                w.put (v.total_size);
+                w.put (v.largest);
+                w.put (static_cast<std::uint32_t> (v.instances));
+                w.put (static_cast<std::uint32_t> (v.inputs.size ()));
+                for (std::uint32_t const index : v.inputs) {
+                    w.put (index);
+                }
+            }
+        }
+        return std::move (w.image ());
+    }
+
+} // end anonymous namespace
+
+
+namespace checkpoint {
+
+    char const magic[8] = {'C', 'M', 'D', 'T', 'C', 'K', 'P', '\0'};
+
+    // image
+    // ~~~~~
+    std::string image (comdat_scanner const & scanner, completed_set const & completed) {
+        std::vector<shard_ref> shards;
+        scanner.for_each_shard ([&shards](comdat_scanner::comdat_map const & comdats,
+                                          std::vector<std::string> const & inputs) {
+            shards.emplace_back (&comdats, &inputs);
+        });
+        return make_image (scanner.input_digests (), completed, shards);
+    }
+
+    // write
+    // ~~~~~
+    void write (boost::filesystem::path const & path, std::string const & image) {
+        boost::filesystem::path temp = path;
+        temp += ".tmp";
+        {
+            std::ofstream os (temp.native (), std::ios::out | std::ios::binary | std::ios::trunc);
+            if (!os.is_open ()) {
+                std::ostringstream str;
+                str << "Could not open " << temp;
+                throw exception (str.str ());
+            }
+            os.write (image.data (), static_cast<std::streamsize> (image.size ()));
+            os.close ();
+            if (!os) {
+                std::ostringstream str;
+                str << "Could not write " << temp;
+                throw exception (str.str ());
+            }
+        }
+        boost::system::error_code ec;
+        boost::filesystem::rename (temp, path, ec);
+        if (ec) {
+            std::ostringstream str;
+            str << "Could not replace " << path << " (" << ec.message () << ')';
+            throw exception (str.str ());
+        }
+    }
+
+    // load
+    // ~~~~
+    completed_set load (boost::filesystem::path const & path, comdat_scanner & scanner) {
+        std::string contents;
+        {
+            std::ifstream is (path.native (), std::ios::in | std::ios::binary);
+            if (!is.is_open ()) {
+                std::ostringstream str;
+                str << "Could not open " << path;
+                throw exception (str.str ());
+            }
+            contents.assign (std::istreambuf_iterator<char> (is), std::istreambuf_iterator<char> ());
+        }
+
+        image_reader r (contents, path);
+        auto const h = r.get<header> ();
+        if (std::memcmp (h.magic, magic, sizeof (h.magic)) != 0 || h.version != version ||
+            h.byte_order != byte_order_marker) {
+            std::ostringstream str;
+            str << path << " is not a checkpoint file written by this version";
+            throw exception (str.str ());
+        }
+
+        std::vector<md5::digest> digests (r.check_count (h.digest_count, sizeof (md5::digest)));
+        for (auto & d : digests) {
+            d = r.get<md5::digest> ();
+        }
+
+        completed_set completed;
+        for (auto ctr = r.check_count (h.completed_count, sizeof (std::uint32_t)); ctr > 0U;
+             --ctr) {
+            completed.insert (r.get_string ());
+        }
+
+        for (auto shard = r.check_count (h.shard_count, sizeof (std::uint64_t) * 2U); shard > 0U;
+             --shard) {
+            std::vector<std::string> inputs (
+                r.check_count (r.get<std::uint64_t> (), sizeof (std::uint32_t)));
+            for (auto & name : inputs) {
+                name = r.get_string ();
+            }
+
+            comdat_scanner::comdat_map comdats;
+            auto const groups = r.check_count (r.get<std::uint64_t> (), sizeof (std::uint32_t));
+            comdats.reserve (groups);
+            for (auto ctr = std::size_t{0}; ctr < groups; ++ctr) {
+                std::string signature = r.get_string ();
+                comdat_scanner::value v;
+                v.total_size = r.get<std::uint64_t> ();
+                v.largest = r.get<std::uint64_t> ();
+                v.instances = r.get<std::uint32_t> ();
+                v.inputs.resize (r.check_count (r.get<std::uint32_t> (), sizeof (std::uint32_t)));
+                for (auto & index : v.inputs) {
+                    index = r.get<std::uint32_t> ();
+                    if (index >= inputs.size ()) {
+                        r.fail ();
+                    }
+                }
+                comdats.emplace (std::move (signature), std::move (v));
+            }
+            scanner.restore (std::move (comdats), std::move (inputs));
+        }
+        if (!r.at_end ()) {
+            r.fail ();
+        }
+
+        scanner.restore_digests (digests);
+        return completed;
+    }
+
+
+    // ***********
+    // * tracker *
+    // ***********
+    // (ctor)
+    // ~~~~~~
+    tracker::tracker (boost::filesystem::path path, std::chrono::milliseconds interval,
+                      comdat_scanner & scanner, completed_set completed,
+                      unsigned consumers)
+            : path_ (std::move (path))
+            , interval_ (interval)
+            , scanner_ (scanner)
+            , completed_ (std::move (completed))
+            , active_ (consumers) {
+        if (interval_.count () > 0) {
+            thread_ = std::thread (&tracker::run, this);
+        }
+    }
+
+    // (dtor)
+    // ~~~~~~
+    tracker::~tracker () {
+        this->stop ();
+    }
+
+    // idle
+    // ~~~~
+    void tracker::idle () {
+        {
+            std::lock_guard<std::mutex> lock (mut_);
+            ++parked_;
+        }
+        cv_.notify_all ();
+    }
+
+    // busy
+    // ~~~~
+    void tracker::busy () {
+        std::unique_lock<std::mutex> lock (mut_);
+        cv_.wait (lock, [this]() { return !pause_; });
+        assert (parked_ > 0U);
+        --parked_;
+    }
+
+    // completed
+    // ~~~~~~~~~
+    void tracker::completed (std::string const & name) {
+        std::lock_guard<std::mutex> lock (mut_);
+        recent_.push_back (name);
+    }
+
+    // retire
+    // ~~~~~~
+    void tracker::retire () {
+        {
+            std::lock_guard<std::mutex> lock (mut_);
+            assert (active_ > 0U);
+            --active_;
+        }
+        cv_.notify_all ();
+    }
+
+    // abandon
+    // ~~~~~~~
+    void tracker::abandon () {
+        {
+            std::lock_guard<std::mutex> lock (mut_);
+            abandoned_ = true;
+        }
+        cv_.notify_all ();
+    }
+
+    // take
+    // ~~~~
+    bool tracker::take () {
+        std::lock_guard<std::mutex> const take_lock (take_mut_);
+        comdat_scanner::partial_results results;
+        std::vector<std::string> names;
+        bool ok = false;
+        {
+            std::unique_lock<std::mutex> lock (mut_);
+            pause_ = true;
+            cv_.wait (lock, [this]() { return parked_ == active_ || abandoned_; });
+            ok = !abandoned_;
+            if (ok) {
+                results = scanner_.take_results ();
+                names.swap (recent_);
+            }
+            pause_ = false;
+        }
+        cv_.notify_all ();
+
+        if (!ok) {
+            return false;
+        }
+        // The consumers are running again. Add the new results to those taken by earlier
+        // checkpoints and write the image of the whole.
+        for (auto & sh : results.shards) {
+            comdat_scanner::append_results (comdats_, inputs_, std::move (sh.first),
+                                            std::move (sh.second));
+        }
+        digests_.insert (digests_.end (), results.digests.begin (), results.digests.end ());
+        for (auto & name : names) {
+            completed_.insert (std::move (name));
+        }
+        write (path_, make_image (digests_, completed_, {shard_ref{&comdats_, &inputs_}}));
+
+        std::lock_guard<std::mutex> lock (mut_);
+        ++written_;
+        return true;
+    }
+
+    // stop
+    // ~~~~
+    void tracker::stop () {
+        {
+            std::lock_guard<std::mutex> lock (mut_);
+            stop_ = true;
+        }
+        cv_.notify_all ();
+        if (thread_.joinable ()) {
+            thread_.join ();
+        }
+
+        std::lock_guard<std::mutex> const take_lock (take_mut_);
+        if (!comdats_.empty () || !inputs_.empty ()) {
+            scanner_.restore (std::move (comdats_), std::move (inputs_));
+            comdats_.clear ();
+            inputs_.clear ();
+        }
+        scanner_.restore_digests (digests_);
+        digests_.clear ();
+    }
+
+    // written
+    // ~~~~~~~
+    unsigned tracker::written () const {
+        std::lock_guard<std::mutex> lock (mut_);
+        return written_;
+    }
+
+    // run
+    // ~~~
+    void tracker::run () {
+        std::unique_lock<std::mutex> lock (mut_);
+        while (!cv_.wait_for (lock, interval_, [this]() { return stop_; })) {
+            lock.unlock ();
+            try {
+                this->take ();
+            } catch (std::exception const & ex) {
+                // A failure to write a checkpoint isn't fatal to the scan.
+                print_cerr ("Warning: ", ex.what ());
+            }
+            lock.lock ();
+        }
+    }
+
+} // end namespace checkpoint
+
+// eof scanlib/checkpoint.cpp
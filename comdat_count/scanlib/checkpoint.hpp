@@ -0,0 +1,190 @@
+// Copyright (c) 2016 by SN Systems Ltd., Sony Interactive Entertainment Inc.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef SCANLIB_CHECKPOINT_HPP
+#define SCANLIB_CHECKPOINT_HPP
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#include <boost/filesystem/path.hpp>
+
+#include "comdat_scanner.hpp"
+
+/// A checkpoint records the state of a scan which is in progress so that, should the process
+/// die, a later run can pick up where it left off (see the --checkpoint and --resume options).
+/// It holds the scanner's aggregated results, the digests of the inputs scanned and the names
+/// of the inputs which are complete. The layout is:
+///
+///     header
+///     std::uint8_t[16][digest_count]    (the digests of the scanned inputs)
+///     string[completed_count]           (the names of the completed inputs)
+///     shard[shard_count]
+///
+/// where a string is a std::uint32_t length followed by its characters and a shard is:
+///
+///     std::uint64_t input_count
+///     string[input_count]               (the input names)
+///     std::uint64_t group_count
+///     group[group_count]
+///
+/// and a group is its signature (a string), the total size and size of the largest instance
+/// (std::uint64_t), the number of instances (std::uint32_t) and the number of inputs
+/// (std::uint32_t) followed by that many input indices (std::uint32_t).
+///
+/// Values are stored in host byte order; the header records the byte order so that a file
+/// produced on a host of different endianness is rejected.
+namespace checkpoint {
+
+    class exception : public std::runtime_error {
+    public:
+        using std::runtime_error::runtime_error;
+    };
+
+    struct header {
+        char magic[8];
+        std::uint32_t version;
+        std::uint32_t byte_order;
+        std::uint64_t digest_count;
+        std::uint64_t completed_count;
+        std::uint64_t shard_count;
+    };
+
+    extern char const magic[8];
+    constexpr std::uint32_t version = 1;
+    constexpr std::uint32_t byte_order_marker = 0x01020304;
+
+    /// The names of the inputs which have been completely scanned.
+    using completed_set = std::unordered_set<std::string>;
+
+    /// Returns the checkpoint image for the current state of 'scanner'. No thread may be
+    /// recording results in the scanner when this function is called.
+    std::string image (comdat_scanner const & scanner, completed_set const & completed);
+
+    /// Writes a checkpoint image to 'path'. The image is written to a temporary file which then
+    /// replaces 'path' so that an existing checkpoint is not lost if the process dies while
+    /// writing.
+    void write (boost::filesystem::path const & path, std::string const & image);
+
+    /// Reads the checkpoint at 'path' adding its results to 'scanner' which must not yet have
+    /// scanned anything.
+    /// \returns The names of the inputs which were completely scanned.
+    completed_set load (boost::filesystem::path const & path, comdat_scanner & scanner);
+
+
+    // ***********
+    // * tracker *
+    // ***********
+    /// Records the inputs completed by the consumer threads and periodically writes a checkpoint
+    /// from a thread of its own.
+    ///
+    /// A checkpoint must not include an input which is only partly recorded (some members of an
+    /// archive, say). Each consumer calls idle() when it finishes an input and busy() once it
+    /// has found the next one. A checkpoint is taken when every consumer is between those calls:
+    /// this includes a consumer blocked waiting for work, which may in turn be waiting for
+    /// another consumer. A consumer which finds an input while a checkpoint is being taken waits
+    /// in busy().
+    ///
+    /// So that the consumers are paused only briefly however large the results grow, the
+    /// tracker moves the results recorded since the previous checkpoint out of the scanner
+    /// (see comdat_scanner::take_results()) rather than serializing them in place. Once the
+    /// consumers have been released, it adds them to the results that it already holds and
+    /// writes the image of the whole. stop() hands the results back to the scanner.
+    class tracker {
+    public:
+        /// \param path  The checkpoint file.
+        /// \param interval  The time between checkpoints.
+        /// \param scanner  The scanner whose state is recorded.
+        /// \param completed  The inputs completed by an earlier run.
+        /// \param consumers  The number of consumer threads.
+        tracker (boost::filesystem::path path, std::chrono::milliseconds interval,
+                 comdat_scanner & scanner, completed_set completed, unsigned consumers);
+        ~tracker ();
+
+        // No copying or assignment.
+        tracker (tracker const &) = delete;
+        tracker & operator= (tracker const &) = delete;
+
+        /// Called by a consumer before it looks for its next input. Never blocks.
+        void idle ();
+        /// Called by a consumer after idle() once it has an input to scan or is about to exit.
+        /// Waits if a checkpoint is being taken.
+        void busy ();
+        /// Called by a consumer when it has finished scanning the input named 'name'.
+        void completed (std::string const & name);
+        /// Called by a consumer as it exits.
+        void retire ();
+        /// Called if a consumer fails part way through an input. No further checkpoints are
+        /// written since the scanner may hold part of that input's results.
+        void abandon ();
+
+        /// Takes a checkpoint now.
+        /// \returns False if no checkpoint was written because the tracker was abandoned.
+        bool take ();
+        /// Stops the checkpoint thread and returns the results taken from the scanner. Must not
+        /// be called until the consumers have retired and must be called before the scanner's
+        /// results are used.
+        void stop ();
+
+        /// The number of checkpoints written.
+        unsigned written () const;
+
+    private:
+        void run ();
+
+        boost::filesystem::path const path_;
+        std::chrono::milliseconds const interval_;
+        comdat_scanner & scanner_;
+
+        /// Held by take() and stop(). Guards the results taken from the scanner.
+        std::mutex take_mut_;
+        comdat_scanner::comdat_map comdats_;
+        std::vector<std::string> inputs_;
+        std::vector<md5::digest> digests_;
+        completed_set completed_;
+
+        mutable std::mutex mut_;
+        std::condition_variable cv_;
+        /// The inputs completed since the last checkpoint.
+        std::vector<std::string> recent_;
+        /// The number of consumers that haven't retired.
+        unsigned active_;
+        /// The number of consumers between calls to idle() and busy().
+        unsigned parked_ = 0;
+        bool pause_ = false;
+        bool abandoned_ = false;
+        bool stop_ = false;
+        unsigned written_ = 0;
+
+        std::thread thread_;
+    };
+
+} // end namespace checkpoint
+
+#endif // SCANLIB_CHECKPOINT_HPP
+// eof scanlib/checkpoint.hpp
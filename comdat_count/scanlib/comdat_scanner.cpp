@@ -27,19 +27,22 @@
 #include <cmath>
 #include <functional>
 #include <future>
+#include <iterator>
 #include <numeric>
 #include <ostream>
-#include <sstream>
 #include <string>
 #include <thread>
 #include <tuple>
+#include <utility>
 #include <vector>
 
 // Local includes
+#include "arena.hpp"
 #include "consumer.hpp"
 #include "elf_helpers.hpp"
 #include "elf_scanner.hpp"
 #include "print.hpp"
+#include "results.hpp"
 
 // -------------------------------
 // comdat scanner base
@@ -97,30 +100,184 @@ std::ostream & operator<< (std::ostream & os, comdat_scanner::sizes const & d) {
 
 // (ctor)
 // ~~~~~~
-comdat_scanner::comdat_scanner (output_flags const & ofl)
+comdat_scanner::comdat_scanner (output_flags const & ofl, unsigned shards, bool record_inputs)
         : ofl_ (ofl)
+        , record_inputs_ (record_inputs)
         , digests_ ()
-        , comdat_lock_ ()
-        , comdat_count_ () {}
+        , shards_ () {
+    // Only the shard objects themselves are allocated here. Their maps allocate on first use
+    // so that, with the default first-touch policy, the memory comes from the node on which the
+    // shard's threads are running.
+    shards_.reserve (std::max (shards, 1U));
+    for (auto ctr = 0U; ctr < std::max (shards, 1U); ++ctr) {
+        shards_.emplace_back (new shard);
+    }
+}
+
+namespace {
+
+    // Per-thread buffers used by the scan path. These are reused for each member so that, once
+    // they have grown to a suitable size, scanning allocates no further memory other than when
+    // a new group signature is added to the map.
+    struct scan_buffers {
+        /// Transient storage for the groups found in the current member.
+        monotonic_arena arena;
+        /// Used to look up an identifier in the COMDAT map.
+        std::string key;
+        /// The shard in which this thread records its results.
+        unsigned shard = 0U;
+    };
+    thread_local scan_buffers buffers;
+
+} // end anonymous namespace
 
 // scan
 // ~~~~
 void comdat_scanner::scan (boost::filesystem::path const & user_file_path, Elf * const elf) {
     assert (elf != nullptr);
+    // Building the name costs an elf_getarhdr() call and an allocation: skip it if the name
+    // won't be used.
+    std::string name;
+    if (record_inputs_ || ofl_.verbose) {
+        name = this->get_name (user_file_path, elf);
+    }
     if (ofl_.verbose) {
-        print_cout ("Scan: ", this->get_name (user_file_path, elf));
+        print_cout ("Scan: ", name);
     }
 
     digests_.add_elf (elf);
 
     elf_scanner esc (elf);
-    esc.scan ([this](std::string const & identifier, std::uint64_t size) {
-        std::lock_guard<std::mutex> guard (comdat_lock_);
-        value & val = comdat_count_[identifier];
-        val.total_size += size;
-        val.largest = std::max (val.largest, size);
-        ++val.instances;
+    this->record (std::move (name), esc);
+}
+
+void comdat_scanner::scan (boost::filesystem::path const & user_file_path,
+                           elf_view::string_ref member_name, elf_view::file const & elf) {
+    std::string name;
+    if (record_inputs_ || ofl_.verbose) {
+        name = this->get_name (user_file_path, member_name);
+    }
+    if (ofl_.verbose) {
+        print_cout ("Scan: ", name);
+    }
+
+    elf_view::span const contents = elf.contents ();
+    digests_.add (contents.data, contents.size);
+
+    view_scanner vsc (elf);
+    this->record (std::move (name), vsc);
+}
+
+// record
+// ~~~~~~
+template <typename Scanner>
+void comdat_scanner::record (std::string && name, Scanner & scanner) {
+    // Gather the groups from this member before touching the shared map so that the lock is
+    // taken once per member rather than once per group.
+    buffers.arena.reset ();
+    using group = std::pair<elf_scanner::identifier, std::uint64_t>;
+    using allocator = arena_allocator<group>;
+    std::vector<group, allocator> groups{allocator (&buffers.arena)};
+    groups.reserve (64);
+
+    scanner.scan ([&groups](elf_scanner::identifier const & identifier, std::uint64_t size) {
+        groups.emplace_back (identifier, size);
     });
+
+    std::string & key = buffers.key;
+    shard & sh = *shards_[buffers.shard % shards_.size ()];
+    std::lock_guard<std::mutex> guard (sh.lock);
+    auto const input_index = static_cast<std::uint32_t> (sh.inputs.size ());
+    if (record_inputs_) {
+        sh.inputs.push_back (std::move (name));
+    }
+
+    for (auto const & g : groups) {
+        key.assign (g.first.data, g.first.length);
+        value & val = sh.comdats[key];
+        val.total_size += g.second;
+        val.largest = std::max (val.largest, g.second);
+        ++val.instances;
+        // An input may contain more than one instance of a group. Record it just once.
+        if (record_inputs_ && (val.inputs.empty () || val.inputs.back () != input_index)) {
+            val.inputs.push_back (input_index);
+        }
+    }
+}
+
+// set thread shard [static]
+// ~~~~~~~~~~~~~~~~
+void comdat_scanner::set_thread_shard (unsigned shard) {
+    buffers.shard = shard;
+}
+
+// append results [static]
+// ~~~~~~~~~~~~~~
+void comdat_scanner::append_results (comdat_map & comdats, std::vector<std::string> & inputs,
+                                     comdat_map && other_comdats,
+                                     std::vector<std::string> && other_inputs) {
+    // The input indices follow those already in the result. Since each shard's indices are
+    // increasing, appending the adjusted values keeps every 'inputs' vector sorted.
+    auto const base = static_cast<std::uint32_t> (inputs.size ());
+    std::move (std::begin (other_inputs), std::end (other_inputs),
+               std::back_inserter (inputs));
+
+    for (auto & kvp : other_comdats) {
+        value & val = comdats[kvp.first];
+        value const & other = kvp.second;
+        val.total_size += other.total_size;
+        val.largest = std::max (val.largest, other.largest);
+        val.instances += other.instances;
+        val.inputs.reserve (val.inputs.size () + other.inputs.size ());
+        for (std::uint32_t const index : other.inputs) {
+            val.inputs.push_back (base + index);
+        }
+    }
+}
+
+// merge shards
+// ~~~~~~~~~~~~
+void comdat_scanner::merge_shards () {
+    shard & result = *shards_.front ();
+    for (auto it = std::next (std::begin (shards_)), end = std::end (shards_); it != end; ++it) {
+        append_results (result.comdats, result.inputs, std::move ((*it)->comdats),
+                        std::move ((*it)->inputs));
+    }
+    shards_.resize (1U);
+}
+
+// restore
+// ~~~~~~~
+void comdat_scanner::restore (comdat_map && comdats, std::vector<std::string> && inputs) {
+    shard & result = *shards_.front ();
+    std::lock_guard<std::mutex> guard (result.lock);
+    if (result.comdats.empty () && result.inputs.empty ()) {
+        result.comdats = std::move (comdats);
+        result.inputs = std::move (inputs);
+    } else {
+        append_results (result.comdats, result.inputs, std::move (comdats), std::move (inputs));
+    }
+}
+
+// take results
+// ~~~~~~~~~~~~
+auto comdat_scanner::take_results () -> partial_results {
+    partial_results result;
+    result.shards.reserve (shards_.size ());
+    for (auto & sh : shards_) {
+        std::lock_guard<std::mutex> guard (sh->lock);
+        result.shards.emplace_back ();
+        result.shards.back ().first.swap (sh->comdats);
+        result.shards.back ().second.swap (sh->inputs);
+    }
+    result.digests = digests_.take ();
+    return result;
+}
+
+void comdat_scanner::restore_digests (std::vector<md5::digest> const & input_digests) {
+    for (auto const & d : input_digests) {
+        digests_.add (d);
+    }
 }
 
 // skip
@@ -140,11 +297,24 @@ std::string comdat_scanner::get_name (boost::filesystem::path const & path, Elf
     Elf_Arhdr const * const arh = ::elf_getarhdr (elf);
     if (arh == nullptr || ::elf_errno () != 0) {
         return path.string ();
-    } else {
-        std::ostringstream str;
-        str << path << " (" << arh->ar_name << ")";
-        return str.str ();
     }
+
+    std::string result = path.string ();
+    result += " (";
+    result += arh->ar_name;
+    result += ')';
+    return result;
+}
+
+std::string comdat_scanner::get_name (boost::filesystem::path const & path,
+                                      elf_view::string_ref member_name) {
+    std::string result = path.string ();
+    if (member_name.second > 0U) {
+        result += " (";
+        result.append (member_name.first, member_name.second);
+        result += ')';
+    }
+    return result;
 }
 
 // build_output_vector [static]
@@ -222,42 +392,51 @@ auto comdat_scanner::total_comdat_size (comdat_map const & cm) -> sizes {
     return std::accumulate (std::begin (cm), std::end (cm), sizes{0, 0}, acc_fn);
 }
 
-// dump
-// ~~~~
-std::ostream & comdat_scanner::dump (std::ostream & os) const {
+// make report
+// ~~~~~~~~~~~
+auto comdat_scanner::make_report (bool unfiltered) const -> report {
 
     // When this function is called, we shouldn't still be building the COMDAT records.
     // Nevertheless, I take the lock just in case.
-    std::lock_guard<std::mutex> comdat_lock (comdat_lock_);
-
-    std::future<output_vector> counts_future =
-        std::async (build_output_vector, std::cref (comdat_count_));
-    std::future<sizes> total_size_future =
-        std::async (total_comdat_size, std::cref (comdat_count_));
+    assert (shards_.size () == 1U);
+    shard & sh = *shards_.front ();
+    std::lock_guard<std::mutex> comdat_lock (sh.lock);
 
-    // This step removes all of the duplicate graph points, returning a collection with only the
-    // largest 'wasted'
-    // value for each deleted point. The argument collection is reordered.
+    // The digest is computed alongside the rest of the report.
     std::future<md5::digest> digest_future = std::async ([this]() { return digests_.final (); });
+    report r = make_report (sh.comdats, md5::digest{}, unfiltered);
+    r.digest = digest_future.get ();
+    return r;
+}
 
-    auto counts = counts_future.get ();
-    std::future<output_vector> counts2_future = std::async (filter, std::ref (counts));
+auto comdat_scanner::make_report (comdat_map const & cm, md5::digest const & digest,
+                                  bool unfiltered) -> report {
+    std::future<output_vector> counts_future = std::async (build_output_vector, std::cref (cm));
+    std::future<sizes> total_size_future = std::async (total_comdat_size, std::cref (cm));
 
-    os << "# MD5: " << md5::context::digest_hex (digest_future.get ()) << '\n';
-    os << "# Filtered " << comdat_count_.size () - counts.size () << " COMDATs with 1 instance\n";
+    report r;
+    r.comdats = cm.size ();
 
-    auto const & counts2 = counts2_future.get ();
-    os << "# Then trimmed " << counts.size () - counts2.size () << " similar points\n";
-    os << "# Result has " << counts2.size () << " points\n";
+    auto counts = counts_future.get ();
+    r.multiple = counts.size ();
+    r.has_unfiltered = unfiltered;
+    if (unfiltered) {
+        // filter() reorders its argument so keep a copy in the original order.
+        r.unfiltered = counts;
+    }
+    // This step removes all of the duplicate graph points, returning a collection with only the
+    // largest 'wasted' value for each deleted point.
+    r.points = filter (counts);
 
-    auto const & total_size = total_size_future.get ();
-    os << "#> Total:" << total_size.actual << '\n' << "#> Wasted:" << total_size.waste << '\n';
+    r.totals = total_size_future.get ();
+    r.digest = digest;
+    return r;
+}
 
-    os << "Size Instances Total\n";
-    for (auto const & v : counts2) {
-        assert (v.instances > 1);
-        os << v.largest << ' ' << v.instances << ' ' << v.wasted << '\n';
-    }
+// dump
+// ~~~~
+std::ostream & comdat_scanner::dump (std::ostream & os) const {
+    results::write (this->make_report (false), results::format::text, os);
     return os;
 }
 
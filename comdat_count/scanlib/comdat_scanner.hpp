@@ -21,16 +21,21 @@
 #ifndef COMDAT_SCANNER_H
 #define COMDAT_SCANNER_H
 
+#include <cassert>
 #include <cstdint>
 #include <iosfwd>
+#include <memory>
 #include <mutex>
+#include <set>
 #include <string>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include <boost/filesystem/path.hpp>
 
 #include "digests.hpp"
+#include "elf_view.hpp"
 #include "flags.hpp"
 
 struct Elf;
@@ -40,14 +45,29 @@ public:
     virtual ~comdat_scanner_base ();
     virtual void scan (boost::filesystem::path const & user_file_path, struct Elf * const elf) = 0;
     virtual void skip (boost::filesystem::path const & user_file_path, struct Elf * const elf) = 0;
+
+    /// Scans an ELF file read by the native reader. 'member_name' is the name of the archive
+    /// member containing the file or is empty if the file is not part of an archive.
+    virtual void scan (boost::filesystem::path const & user_file_path,
+                       elf_view::string_ref member_name, elf_view::file const & elf) = 0;
 };
 
 class comdat_scanner final : public comdat_scanner_base {
 public:
-    explicit comdat_scanner (output_flags const & ofl);
+    /// \param ofl  Output flags.
+    /// \param shards  The number of partial result sets. Each worker thread records its results
+    ///   in the shard chosen by set_thread_shard(); merge_shards() combines them once the scan is
+    ///   complete.
+    /// \param record_inputs  If true, the scanner records the name of each input and, for each
+    ///   group, the inputs which contain it (see value::inputs). Only the index, sampling and
+    ///   checkpoint outputs need these so a plain scan can skip the work.
+    explicit comdat_scanner (output_flags const & ofl, unsigned shards = 1U,
+                             bool record_inputs = true);
 
     void scan (boost::filesystem::path const & user_file_path, struct Elf * const elf) override;
     void skip (boost::filesystem::path const & user_file_path, struct Elf * const elf) override;
+    void scan (boost::filesystem::path const & user_file_path, elf_view::string_ref member_name,
+               elf_view::file const & elf) override;
 
     std::ostream & dump (std::ostream & os) const;
 
@@ -69,6 +89,9 @@ public:
         std::uint64_t largest;
         /// The number of instances encountered.
         unsigned instances;
+        /// The indices (into the scanner's input list) of the inputs containing an instance.
+        /// Empty unless the scanner is recording inputs.
+        std::vector<std::uint32_t> inputs;
     };
     typedef std::unordered_map<std::string, value> comdat_map;
 
@@ -81,14 +104,113 @@ public:
     };
     static sizes total_comdat_size (comdat_map const & cm);
 
+    /// The results of a scan in the form in which they are reported.
+    struct report {
+        md5::digest digest;
+        /// The number of distinct COMDAT groups.
+        std::size_t comdats;
+        /// The number of groups with more than one instance.
+        std::size_t multiple;
+        /// True if the report includes the unfiltered points.
+        bool has_unfiltered;
+        /// The groups with more than one instance (see build_output_vector()). Only populated
+        /// if has_unfiltered is true.
+        output_vector unfiltered;
+        /// The groups with more than one instance once similar points are merged (see filter()).
+        output_vector points;
+        sizes totals;
+    };
+    /// Produces the report of the scan's results. 'unfiltered' indicates whether the report's
+    /// 'unfiltered' member is populated.
+    report make_report (bool unfiltered) const;
+    /// Produces the report for the results 'cm' whose inputs have the combined digest 'digest'.
+    static report make_report (comdat_map const & cm, md5::digest const & digest,
+                               bool unfiltered);
+
+    /// Selects the shard in which the calling thread records its results. Threads running on
+    /// the same NUMA node should share a shard so that its map is allocated (and then updated)
+    /// node-locally.
+    static void set_thread_shard (unsigned shard);
+
+    /// Combines the per-shard results. Must be called once the consumer threads have finished
+    /// and before the results are examined.
+    void merge_shards ();
+
+    /// Calls 'fn (comdats, inputs)' for each shard. Must not be called while a thread may be
+    /// recording results.
+    template <typename Function>
+    void for_each_shard (Function fn) const {
+        for (auto const & sh : shards_) {
+            fn (sh->comdats, sh->inputs);
+        }
+    }
+    /// Returns the digests of the inputs scanned so far (see digests::final()).
+    std::vector<md5::digest> input_digests () const {
+        return digests_.list ();
+    }
+
+    /// Adds the results of an earlier scan (for example, one read from a checkpoint) as if the
+    /// inputs had been scanned again. Must not be called while a thread may be recording
+    /// results.
+    void restore (comdat_map && comdats, std::vector<std::string> && inputs);
+    void restore_digests (std::vector<md5::digest> const & input_digests);
+
+    /// The results removed from a scanner by take_results().
+    struct partial_results {
+        /// The comdats and inputs of each shard.
+        std::vector<std::pair<comdat_map, std::vector<std::string>>> shards;
+        std::multiset<md5::digest> digests;
+    };
+    /// Removes the results recorded so far and returns them, leaving the scanner as if nothing
+    /// had been scanned; restore() and restore_digests() give them back. The containers are
+    /// moved rather than copied so this is cheap however many results there are. Must not be
+    /// called while a thread may be recording results.
+    partial_results take_results ();
+
+    /// Adds 'other_comdats' and 'other_inputs' (the results of another shard or an earlier
+    /// scan) to 'comdats' and 'inputs'.
+    static void append_results (comdat_map & comdats, std::vector<std::string> & inputs,
+                                comdat_map && other_comdats,
+                                std::vector<std::string> && other_inputs);
+
+    /// Accessors for the results of the scan. These must not be called until the consumer threads
+    /// have finished and the shards have been merged.
+    comdat_map const & comdats () const {
+        assert (shards_.size () == 1U);
+        return shards_.front ()->comdats;
+    }
+    std::vector<std::string> const & inputs () const {
+        assert (shards_.size () == 1U);
+        return shards_.front ()->inputs;
+    }
+    md5::digest digest () const {
+        return digests_.final ();
+    }
+
 private:
     // Returns a user string for the given path/elf combination.
     static std::string get_name (boost::filesystem::path const & path, Elf * const elf);
+    static std::string get_name (boost::filesystem::path const & path,
+                                 elf_view::string_ref member_name);
+
+    /// Records the groups found by 'scanner' (an elf_scanner or view_scanner) in the input
+    /// named 'name'.
+    template <typename Scanner>
+    void record (std::string && name, Scanner & scanner);
+
+    /// A partial set of results gathered by the threads assigned to it.
+    struct shard {
+        std::mutex lock;
+        comdat_map comdats;
+        /// The names of the inputs that were scanned. A value's 'inputs' member holds indices
+        /// into this container.
+        std::vector<std::string> inputs;
+    };
 
     output_flags const ofl_;
+    bool const record_inputs_;
     mutable digests digests_;
-    mutable std::mutex comdat_lock_;
-    comdat_map comdat_count_;
+    std::vector<std::unique_ptr<shard>> shards_;
 };
 
 bool operator== (comdat_scanner::output const & lhs, comdat_scanner::output const & rhs);
@@ -22,89 +22,176 @@
 
 // Standard library includes
 #include <iostream>
+#include <memory>
 #include <mutex>
-#include <sstream>
-
-// 3rd party includes
-#include <boost/iostreams/device/mapped_file.hpp>
 
 // Local includes
+#include "checkpoint.hpp"
 #include "comdat_scanner.hpp"
 #include "elf_enumerator.hpp"
 #include "elf_helpers.hpp"
 #include "flags.hpp"
+#include "prefetch.hpp"
 #include "print.hpp"
 #include "progress.hpp"
-#include "temp_files.hpp"
-#include "zipper.hpp"
+#include "unpack_pipeline.hpp"
+
+
+namespace {
+
+    // scan file
+    // ~~~~~~~~~
+    /// Scans the file described by 'qmem'.
+    void scan_file (queue_member const & qmem, comdat_scanner * const scanner,
+                    output_flags const & ofl, scan_flags const & sfl, updater & progress) {
+        auto const & file_path = qmem.real_path;
+        auto const & user_file_path = qmem.user_path;
+
+        if (ofl.verbose) {
+            print_cout ("Processing: ", user_file_path);
+        }
+
+        if (file_size (file_path) == 0) {
+            // Skip zero size files.
+            if (!ofl.quiet) {
+                print_cout ("Skipping: ", user_file_path);
+            }
+            return;
+        }
+
+        if (sfl.backend == elf_backend::native) {
+            enumerate_native (file_path, user_file_path, scanner, &progress);
+        } else {
+            enumerate (file_path, user_file_path, scanner, &progress);
+        }
+    }
+
+    // scan entry
+    // ~~~~~~~~~~
+    /// Scans an entry from the unpack pipeline. The entry is already in memory so is always read
+    /// using the native ELF reader.
+    void scan_entry (unpack_pipeline::entry const & entry, comdat_scanner * const scanner,
+                     output_flags const & ofl, updater & progress) {
+        if (ofl.verbose) {
+            print_cout ("Processing: ", entry.user_path);
+        }
+        enumerate (entry.contents (), entry.user_path, scanner, &progress);
+    }
+
+    // next input
+    // ~~~~~~~~~~
+    /// Waits for the next input from either the work queue or the unpack pipeline.
+    bool next_input (queue_type & queue, unsigned worker, unpack_pipeline * const unpack,
+                     std::unique_ptr<unpack_pipeline::entry> & entry,
+                     queue_member const *& qmem) {
+        if (unpack == nullptr) {
+            return queue.pop (worker, qmem);
+        }
+        // Entries from the unpack pipeline are already holding memory so take them in
+        // preference to the work queue. A consumer waiting for the queue also wakes when the
+        // pipeline adds an entry: otherwise the entries would wait until the queue was drained.
+        // Once the queue is exhausted, wait for whatever remains of the pipeline.
+        for (;;) {
+            if (unpack->try_pop (entry) ||
+                queue.pop (worker, qmem, [unpack]() { return unpack->ready (); })) {
+                return true;
+            }
+            if (queue.finished ()) {
+                return unpack->pop (entry);
+            }
+        }
+    }
+
+} // end anonymous namespace
 
 
 // consumer
 // ~~~~~~~~
 // Thread entry-point.
-void consumer (queue_type & queue, comdat_scanner * const scanner, output_flags const & ofl,
-               state_flags * const state, updater & progress) {
+void consumer (queue_type & queue, unsigned worker, prefetcher * const prefetch,
+               unpack_pipeline * const unpack, comdat_scanner * const scanner,
+               checkpoint::tracker * const checkpoint, output_flags const & ofl,
+               scan_flags const & sfl, state_flags * const state, updater & progress) {
 
     assert (scanner != nullptr);
     assert (state != nullptr);
 
-    queue_member * qmem = nullptr;
-    while (queue.pop (qmem)) {
-        // If an error has been raised, then we need to end this thread.
-        if (state->error) {
-            break;
+    auto cancel = [&queue, unpack, checkpoint]() {
+        queue.cancel ();
+        if (unpack != nullptr) {
+            unpack->cancel ();
+        }
+        if (checkpoint != nullptr) {
+            // The scanner may now hold part of an input's results.
+            checkpoint->abandon ();
         }
+    };
 
+    for (;;) {
         try {
-            if (qmem == nullptr) {
-                throw std::runtime_error ("Cannot process an empty path.");
+            // Between inputs is the only safe place for the scanner's state to be recorded. That
+            // includes the time spent waiting for the next input: other consumers may be
+            // waiting for this one.
+            if (checkpoint != nullptr) {
+                checkpoint->idle ();
             }
 
-            auto const & file_path = qmem->real_path;
-            auto const & zip_member_name = qmem->member_name;
-            auto const & user_file_path = qmem->user_path;
-
-            path_cleanup pathc (file_path, false);
-
-            if (zip_member_name.length () > 0) {
-                boost::filesystem::path const & zip_path = pathc.path ();
-                zipper::zip_ptr uf (::unzOpen64 (zip_path.string ().c_str ()), &::unzClose);
-                if (uf.get () == nullptr) {
-                    std::ostringstream str;
-                    str << "Unable to open zip file " << pathc.path ();
-                    throw std::runtime_error (str.str ());
-                }
-                // copy the zip member into a temporary file and set path to its locations
-                pathc = path_cleanup (temporary_file_path (), true);
-                zipper::extract (uf.get (), zip_member_name.c_str (), pathc.path (),
-                                 user_file_path);
+            std::unique_ptr<unpack_pipeline::entry> entry;
+            queue_member const * qmem = nullptr;
+            bool const found = next_input (queue, worker, unpack, entry, qmem);
+            if (checkpoint != nullptr) {
+                checkpoint->busy ();
+            }
+            if (!found) {
+                break;
             }
 
-
-            if (ofl.verbose) {
-                print_cout ("Processing: ", user_file_path);
+            // If an error has been raised, then we need to end this thread.
+            if (state->error) {
+                cancel ();
+                break;
             }
 
-            if (file_size (pathc.path ()) == 0) {
-                // Skip zero size files.
-                if (!ofl.quiet) {
-                    print_cout ("Skipping: ", user_file_path);
+            if (entry) {
+                scan_entry (*entry, scanner, ofl, progress);
+                if (checkpoint != nullptr) {
+                    checkpoint->completed (entry->user_path.string ());
                 }
+                unpack->release (std::move (entry));
                 continue;
             }
 
-            enumerate (pathc.path (), user_file_path, scanner, &progress);
+            if (prefetch != nullptr) {
+                prefetch->started (worker);
+            }
+            if (qmem == nullptr) {
+                throw std::runtime_error ("Cannot process an empty path.");
+            }
+            scan_file (*qmem, scanner, ofl, sfl, progress);
+            if (checkpoint != nullptr) {
+                checkpoint->completed (qmem->user_path.string ());
+            }
+            // This thread may take its next input from the unpack pipeline rather than the
+            // queue. Finish with the queue item now so that threads waiting in queue.pop() for
+            // the queue to drain can move on to the pipeline.
+            queue.release (worker);
         } catch (std::exception const & ex) {
             // Tell the other threads that we've encountered an error and bail.
             state->error = true;
+            cancel ();
             print_cerr ("An error occurred: ", ex.what ());
             break;
         } catch (...) {
             // Tell the other threads that we've encountered an error and bail.
             state->error = true;
+            cancel ();
             print_cerr ("Oh dear. An unknown exception occurred.");
             break;
         }
     }
+
+    if (checkpoint != nullptr) {
+        checkpoint->retire ();
+    }
 }
 // eof scanlib/consumer.cpp
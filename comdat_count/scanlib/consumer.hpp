@@ -26,24 +26,36 @@
 
 // 3rd party includes
 #include <boost/filesystem.hpp>
-#include <boost/lockfree/queue.hpp>
+
+// Local includes
+#include "work_queue.hpp"
 
 
 // The job queue
 struct queue_member {
     boost::filesystem::path real_path;
-    std::string member_name;
     boost::filesystem::path user_path;
 };
-using queue_type = boost::lockfree::queue<queue_member const *>;
+using queue_type = work_queue<queue_member>;
 
 
+namespace checkpoint {
+    class tracker;
+}
 class comdat_scanner;
 struct output_flags;
+class prefetcher;
 struct state_flags;
+class unpack_pipeline;
 class updater;
-void consumer (queue_type & queue, comdat_scanner * const scanner, output_flags const & ofl,
-               state_flags * const state, updater & progress);
+struct scan_flags;
+/// Scans the files from 'queue' and, if 'unpack' is not null, the entries from the unpack
+/// pipeline until both are exhausted. If 'checkpoint' is not null, each completed input is
+/// recorded there.
+void consumer (queue_type & queue, unsigned worker, prefetcher * const prefetch,
+               unpack_pipeline * const unpack, comdat_scanner * const scanner,
+               checkpoint::tracker * const checkpoint, output_flags const & ofl,
+               scan_flags const & sfl, state_flags * const state, updater & progress);
 
 #endif // SCANLIB_CONSUMER_HPP
 // eof scanlib/consumer.hpp
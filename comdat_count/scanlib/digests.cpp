@@ -27,19 +27,64 @@
 void digests::add_elf (Elf * const elf) {
     auto const digest = this->md5 (elf);
     std::lock_guard<std::mutex> guard (hashes_lock_);
-    hashes_.push_back (digest);
+    hashes_.insert (digest);
 }
 
 void digests::add_elf (elf::elf_ptr const & elf) {
     return add_elf (elf.get ());
 }
 
+// add
+// ~~~
+void digests::add (void const * contents, std::size_t size) {
+    auto const digest = this->md5 (contents, size);
+    std::lock_guard<std::mutex> guard (hashes_lock_);
+    hashes_.insert (digest);
+}
+
+void digests::add (md5::digest const & digest) {
+    std::lock_guard<std::mutex> guard (hashes_lock_);
+    hashes_.insert (digest);
+}
+
+// remove
+// ~~~~~~
+bool digests::remove (md5::digest const & digest) {
+    std::lock_guard<std::mutex> guard (hashes_lock_);
+    auto const pos = hashes_.find (digest);
+    if (pos == std::end (hashes_)) {
+        return false;
+    }
+    hashes_.erase (pos);
+    return true;
+}
+
+// list
+// ~~~~
+std::vector<md5::digest> digests::list () const {
+    std::lock_guard<std::mutex> guard (hashes_lock_);
+    return {std::begin (hashes_), std::end (hashes_)};
+}
+
+// take
+// ~~~~
+std::multiset<md5::digest> digests::take () {
+    std::multiset<md5::digest> result;
+    std::lock_guard<std::mutex> guard (hashes_lock_);
+    result.swap (hashes_);
+    return result;
+}
+
 
 // md5 [static]
 // ~~~
 auto digests::md5 (Elf * const elf) -> md5::digest {
     auto size = std::size_t{0};
     void const * contents = elf_rawfile (elf, &size);
+    return md5 (contents, size);
+}
+
+auto digests::md5 (void const * contents, std::size_t size) -> md5::digest {
     assert (size > 0 && contents != nullptr);
 
     static char const begin[] = "Bgn";
@@ -59,18 +104,8 @@ auto digests::md5 (elf::elf_ptr const & elf) -> md5::digest {
 
 // final
 // ~~~~~
-auto digests::final () -> md5::digest {
+auto digests::final () const -> md5::digest {
     std::lock_guard<std::mutex> guard (hashes_lock_);
-    hashes_.sort ([](md5::digest const & a, md5::digest const & b) {
-        assert (a.size () == b.size ());
-        auto const size = a.size ();
-        for (auto idx = 0U; idx < size; ++idx) {
-            if (a[idx] != b[idx]) {
-                return a[idx] < b[idx];
-            }
-        }
-        return false;
-    });
     md5::context context;
     for (auto const & d : hashes_) {
         context.update (d.data (), d.size ());
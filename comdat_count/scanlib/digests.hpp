@@ -23,24 +23,39 @@
 
 #include "elf_helpers.hpp"
 #include "md5_context.h"
-#include <list>
 #include <mutex>
+#include <set>
+#include <vector>
 
 class digests {
 public:
     void add_elf (Elf * const elf);
     void add_elf (elf::elf_ptr const & elf);
+    /// Adds the digest of an ELF file held in memory.
+    void add (void const * contents, std::size_t size);
+    /// Adds a digest previously returned by list().
+    void add (md5::digest const & digest);
+    /// Removes one instance of 'digest'. Returns false if it was not present.
+    bool remove (md5::digest const & digest);
+
+    /// Returns the digests of the individual inputs in ascending order.
+    std::vector<md5::digest> list () const;
+    /// Removes all of the digests and returns them. This doesn't copy them.
+    std::multiset<md5::digest> take ();
 
     /// Returns the final MD5 digest for all of the inputs. This is produced by taking the (sorted)
     /// collections of MD5s from the individual inputs and hashing them together.
-    auto final () -> md5::digest;
+    auto final () const -> md5::digest;
 
     static auto md5 (Elf * const elf) -> md5::digest;
     static auto md5 (elf::elf_ptr const & elf) -> md5::digest;
+    static auto md5 (void const * contents, std::size_t size) -> md5::digest;
 
 private:
-    std::mutex hashes_lock_;
-    std::list<md5::digest> hashes_;
+    mutable std::mutex hashes_lock_;
+    /// Kept sorted so that adding or removing an input doesn't require the collection to be
+    /// sorted again before the final digest is computed.
+    std::multiset<md5::digest> hashes_;
 };
 
 #endif // SCANLIB_DIGEST_HPP
@@ -21,10 +21,16 @@
 #include "elf_enumerator.hpp"
 
 #include <cassert>
+#include <cstdint>
 #include <cstdio>
+#include <cstring>
 #include <exception>
+#include <limits>
 #include <memory>
 #include <sstream>
+#include <string>
+
+#include <boost/iostreams/device/mapped_file.hpp>
 
 #include "comdat_scanner.hpp"
 #include "consumer.hpp"
@@ -45,6 +51,20 @@ namespace {
         return ::elf_errno () == 0;
     }
 
+    // is special member
+    // ~~~~~~~~~~~~~~~~~
+    /// Returns true if 'member' (a member of an archive) is one of the archive's own tables
+    /// rather than a file. Some libelf implementations return the symbol table ("/" or
+    /// "/SYM64/") and the long name table ("//") as members. The native reader skips them.
+    bool is_special_member (Elf * const member) {
+        Elf_Arhdr const * const arh = ::elf_getarhdr (member);
+        if (arh == nullptr || arh->ar_name == nullptr) {
+            return false;
+        }
+        return std::strcmp (arh->ar_name, "/") == 0 || std::strcmp (arh->ar_name, "//") == 0 ||
+               std::strcmp (arh->ar_name, "/SYM64/") == 0;
+    }
+
 
     // open file
     // ~~~~~~~~~~
@@ -80,7 +100,9 @@ unsigned members (int fd, boost::filesystem::path const & user_file_path) {
         if (elfp == nullptr) {
             break;
         }
-        ++members;
+        if (::elf_kind (archive.get ()) != ELF_K_AR || !is_special_member (elfp)) {
+            ++members;
+        }
         cmd = elf_next (elfp);
     }
     return members;
@@ -94,6 +116,72 @@ unsigned members (boost::filesystem::path const & path,
 }
 
 
+namespace {
+
+    // enumerate members
+    // ~~~~~~~~~~~~~~~~~
+    /// Scans the members of 'archive' or, if it isn't an archive, the file itself. Archives
+    /// nested within an archive are enumerated recursively (as they are by the native reader):
+    /// their members are named "archive (nested) (member)". 'nested' is true if 'archive' is
+    /// itself an archive member.
+    void enumerate_members (int fd, Elf * const archive,
+                            boost::filesystem::path const & user_file_path,
+                            comdat_scanner_base * const scanner, updater * const progress,
+                            bool nested) {
+        // Some libelf implementations don't stop at the end of a nested archive but carry on
+        // through the members of the outer archive which follow it. Its members are bounded by
+        // the extent of the archive in the file.
+        std::int64_t end = std::numeric_limits<std::int64_t>::max ();
+        if (nested) {
+            Elf_Arhdr const * const arh = ::elf_getarhdr (archive);
+            if (arh != nullptr) {
+                end = ::elf_getbase (archive) + static_cast<std::int64_t> (arh->ar_size);
+            }
+        }
+
+        auto count = 0U;
+        for (Elf_Cmd cmd = ELF_C_READ; cmd != ELF_C_NULL;) {
+            elf::elf_ptr elf = elf::begin (fd, cmd, archive);
+            Elf * const elfp = elf.get ();
+            if (elfp == nullptr || ::elf_getbase (elfp) >= end) {
+                break;
+            }
+            if (::elf_kind (archive) == ELF_K_AR && is_special_member (elfp)) {
+                cmd = elf_next (elfp);
+                continue;
+            }
+            // The outer archive's member count included a nested archive as a single item: add
+            // the rest of its members to the progress total as they are found.
+            if (nested && progress != nullptr && count++ > 0U) {
+                progress->total_incr (1U);
+            }
+            if (::elf_kind (elfp) == ELF_K_AR) {
+                Elf_Arhdr const * const arh = ::elf_getarhdr (elfp);
+                std::string name = user_file_path.string ();
+                name += " (";
+                name += arh != nullptr ? arh->ar_name : "";
+                name += ')';
+                enumerate_members (fd, elfp, boost::filesystem::path (name), scanner, progress,
+                                   true /*nested*/);
+            } else {
+                if (is_elf (elfp)) {
+                    // It's an ELF file, so scan it...
+                    scanner->scan (user_file_path, elfp);
+                } else {
+                    scanner->skip (user_file_path, elfp);
+                }
+                if (progress != nullptr) {
+                    progress->completed_incr ();
+                }
+            }
+
+            // If we're processing an archive, move to the next file.
+            cmd = elf_next (elfp);
+        }
+    }
+
+} // end anonymous namespace
+
 void enumerate (int fd, boost::filesystem::path const & user_file_path,
                 comdat_scanner_base * const scanner, updater * const progress) {
     assert (scanner != nullptr);
@@ -101,11 +189,10 @@ void enumerate (int fd, boost::filesystem::path const & user_file_path,
     // FIXME: factor out the duplicated enumeration code.
     // If we're processing an archive, then we need to loop through
     // the files that it contains.
-    Elf_Cmd cmd = ELF_C_READ;
     elf::elf_ptr archive (nullptr, &::elf_end);
     bool skip = false;
     try {
-        archive = elf::begin (fd, cmd, nullptr);
+        archive = elf::begin (fd, ELF_C_READ, nullptr);
     } catch (elf::exception const &) {
         skip = true;
     }
@@ -119,29 +206,7 @@ void enumerate (int fd, boost::filesystem::path const & user_file_path,
         assert (m >= 1);
         progress->total_incr (m - 1);
     }
-
-    for (;;) {
-        if (cmd == ELF_C_NULL) {
-            // The last archive member (or the sole object file) has
-            // been processed.
-            break;
-        }
-        elf::elf_ptr elf = elf::begin (fd, cmd, archive.get ());
-        Elf * const elfp = elf.get ();
-        if (is_elf (elfp)) {
-            // It's an ELF file, so scan it...
-            scanner->scan (user_file_path, elfp);
-        } else {
-            scanner->skip (user_file_path, elfp);
-        }
-
-        if (progress != nullptr) {
-            progress->completed_incr ();
-        }
-
-        // If we're processing an archive, move to the next file.
-        cmd = elf_next (elfp);
-    }
+    enumerate_members (fd, archive.get (), user_file_path, scanner, progress, false /*nested*/);
 }
 
 void enumerate (boost::filesystem::path const & path,
@@ -153,4 +218,69 @@ void enumerate (boost::filesystem::path const & path,
     enumerate (fileno (file.get ()), user_file_path, scanner, progress);
 }
 
+
+void enumerate (elf_view::span contents, boost::filesystem::path const & user_file_path,
+                comdat_scanner_base * const scanner, updater * const progress) {
+    assert (scanner != nullptr);
+    if (elf_view::archive::is_archive (contents)) {
+        elf_view::archive const archive (contents);
+        if (archive.thin ()) {
+            // The producer expands thin archives given as inputs. One found here (for example,
+            // in a zip file) can't be resolved.
+            scanner->skip (user_file_path, nullptr);
+            if (progress != nullptr) {
+                progress->completed_incr ();
+            }
+            return;
+        }
+        if (progress != nullptr) {
+            // The archive itself was counted as one item.
+            std::size_t const m = archive.count ();
+            if (m == 0) {
+                progress->completed_incr ();
+            } else {
+                progress->total_incr (static_cast<unsigned> (m - 1));
+            }
+        }
+        archive.for_each ([&](elf_view::archive::member const & member) {
+            if (elf_view::archive::is_regular (member.data)) {
+                // A nested archive: its members are named "archive (nested) (member)". The
+                // recursive call accounts for the progress of this member.
+                std::string nested = user_file_path.string ();
+                nested += " (";
+                nested.append (member.name.first, member.name.second);
+                nested += ')';
+                enumerate (member.data, boost::filesystem::path (nested), scanner, progress);
+                return;
+            }
+            // Archive members which aren't ELF files are silently ignored.
+            if (elf_view::file::is_elf (member.data)) {
+                scanner->scan (user_file_path, member.name, elf_view::file (member.data));
+            }
+            if (progress != nullptr) {
+                progress->completed_incr ();
+            }
+        });
+        return;
+    }
+
+    if (elf_view::file::is_elf (contents)) {
+        scanner->scan (user_file_path, elf_view::string_ref{nullptr, 0U},
+                       elf_view::file (contents));
+    } else {
+        scanner->skip (user_file_path, nullptr);
+    }
+    if (progress != nullptr) {
+        progress->completed_incr ();
+    }
+}
+
+void enumerate_native (boost::filesystem::path const & path,
+                       boost::filesystem::path const & user_file_path,
+                       comdat_scanner_base * const scanner, updater * const progress) {
+    boost::iostreams::mapped_file_source file (path.string ());
+    enumerate (elf_view::span{reinterpret_cast<std::uint8_t const *> (file.data ()), file.size ()},
+               user_file_path, scanner, progress);
+}
+
 // eof elf_numerator.cpp
@@ -23,9 +23,14 @@
 
 #include <boost/filesystem.hpp>
 
+#include "elf_view.hpp"
+
 class comdat_scanner_base;
 class updater;
 
+/// Enumerates the ELF files in the file 'fd' using libelf. The file may be an ELF file or an
+/// archive. As with the native reader, archives nested within an archive are enumerated
+/// recursively and the archive's symbol and long name tables are ignored.
 void enumerate (int fd, boost::filesystem::path const & user_file_path,
                 comdat_scanner_base * const scanner, updater * const progress);
 
@@ -33,6 +38,15 @@ void enumerate (boost::filesystem::path const & path,
                 boost::filesystem::path const & user_file_path, comdat_scanner_base * const scanner,
                 updater * const progress);
 
+/// Enumerates the ELF files in a file held in memory using the native ELF reader. 'contents' may
+/// be an ELF file or an archive. Archives nested within an archive are enumerated recursively.
+void enumerate (elf_view::span contents, boost::filesystem::path const & user_file_path,
+                comdat_scanner_base * const scanner, updater * const progress);
+/// Maps the file at 'path' and enumerates its contents using the native ELF reader.
+void enumerate_native (boost::filesystem::path const & path,
+                       boost::filesystem::path const & user_file_path,
+                       comdat_scanner_base * const scanner, updater * const progress);
+
 
 /// Returns the number of members in the ELF container
 unsigned members (int fd, boost::filesystem::path const & user_file_path);
@@ -21,70 +21,291 @@
 #ifndef ELF_SCANNER_H
 #define ELF_SCANNER_H (1)
 
+#include <array>
+#include <cassert>
+#include <cstddef>
 #include <cstdint>
-#include <functional>
+#include <iterator>
+#include <stdexcept>
 #include <string>
+#include <utility>
 
 #include <gelf.h>
 
-class elf_intf {
-public:
-    virtual ~elf_intf () {}
-    virtual bool elf_is_le (Elf * const elf) = 0;
+#include "elf_helpers.hpp"
+#include "elf_view.hpp"
 
-    virtual Elf_Data * get_data (Elf_Scn * scn, Elf_Data * data) = 0;
-    virtual Elf_Scn * elf_getscn (Elf * elf, std::size_t index) = 0;
-    virtual Elf_Scn * elf_nextscn (Elf * elf, Elf_Scn * scn) = 0;
-    virtual char const * strptr (Elf * const elf, std::size_t section, std::size_t offset) = 0;
+/// The signature of a group. This refers to the string table of the ELF file being scanned and
+/// is valid only for as long as that file is open.
+struct group_signature {
+    char const * data;
+    std::size_t length;
 
-    virtual GElf_Shdr getshdr (Elf_Scn * const section) = 0;
-    virtual GElf_Sym getsym (Elf_Data * const data, unsigned section_index) = 0;
+    operator std::string () const {
+        return {data, length};
+    }
 };
 
 
-class libelf_intf final : public elf_intf {
+/// The ELF interfaces give basic_elf_scanner<> access to the sections of a file. An interface
+/// provides:
+///
+/// - 'section': the type describing a section and the static members type(), size(), link() and
+///   info() which return the corresponding fields of its header.
+/// - for_each_section(f): calls f(section) for each section other than the null section.
+/// - for_each_word(s, f): calls f(w) for each 32-bit word w (in host byte order) of section 's'
+///   until f returns false.
+/// - section_size(index): the size of the section with the given index.
+/// - 'symbol_table': the type describing a symbol table and its string table, and
+///   get_symbol_table(index) which returns that of the section with the given index.
+/// - symbol_name(t, index): the name of the symbol with the given index in symbol table 't'.
+
+/// An ELF interface which reads the file with libelf.
+class libelf_intf {
 public:
-    bool elf_is_le (Elf * const elf) override;
-    Elf_Data * get_data (Elf_Scn * scn, Elf_Data * data) override;
+    struct section {
+        Elf_Scn * scn;
+        GElf_Shdr shdr;
+    };
+    struct symbol_table {
+        Elf_Data * symbols = nullptr;
+        std::size_t strtab_index = 0;
+        Elf_Data * strings = nullptr;
+    };
 
-    Elf_Scn * elf_getscn (Elf * elf, size_t index) override;
-    Elf_Scn * elf_nextscn (Elf * elf, Elf_Scn * scn) override;
-    char const * strptr (Elf * const elf, std::size_t section, std::size_t offset) override;
+    explicit libelf_intf (Elf * const elf);
 
-    GElf_Shdr getshdr (Elf_Scn * const section) override;
-    GElf_Sym getsym (Elf_Data * const data, unsigned section_index) override;
-};
+    static std::uint32_t type (section const & s) {
+        return s.shdr.sh_type;
+    }
+    static std::uint64_t size (section const & s) {
+        return s.shdr.sh_size;
+    }
+    static std::uint32_t link (section const & s) {
+        return s.shdr.sh_link;
+    }
+    static std::uint32_t info (section const & s) {
+        return static_cast<std::uint32_t> (s.shdr.sh_info);
+    }
+
+    template <typename Function>
+    void for_each_section (Function f) const;
+    template <typename Function>
+    void for_each_word (section const & s, Function f) const;
+    std::uint64_t section_size (std::uint32_t index) const;
 
+    symbol_table get_symbol_table (std::uint32_t index) const;
+    group_signature symbol_name (symbol_table const & t, std::uint32_t index) const;
+
+private:
+    static std::uint32_t get_le (std::uint8_t const * v);
+    static std::uint32_t get_be (std::uint8_t const * v);
+    static bool elf_is_le (Elf * const elf);
 
+    Elf * const elf_;
+    bool const is_le_;
+};
 
-class elf_scanner {
+/// An ELF interface which reads the file with the in-tree zero-copy reader.
+class view_intf {
 public:
-    using callback = std::function<void(std::string const &, std::uint64_t)>;
+    using section = elf_view::section_header;
+    struct symbol_table {
+        elf_view::section_header symbols{};
+        elf_view::section_header strings{};
+    };
+
+    explicit view_intf (elf_view::file const & file)
+            : file_ (file) {}
+
+    static std::uint32_t type (section const & s) {
+        return s.type;
+    }
+    static std::uint64_t size (section const & s) {
+        return s.size;
+    }
+    static std::uint32_t link (section const & s) {
+        return s.link;
+    }
+    static std::uint32_t info (section const & s) {
+        return s.info;
+    }
 
-    explicit elf_scanner (Elf * const elf);
-    void scan (callback const & cb); // virtual to allow mocking
+    template <typename Function>
+    void for_each_section (Function f) const;
+    template <typename Function>
+    void for_each_word (section const & s, Function f) const;
+    std::uint64_t section_size (std::uint32_t index) const {
+        return file_.section (index).size;
+    }
+
+    symbol_table get_symbol_table (std::uint32_t index) const;
+    group_signature symbol_name (symbol_table const & t, std::uint32_t index) const;
 
 private:
-    Elf * const elf_;
-    bool const is_le_;
+    elf_view::file const & file_;
+};
+
 
-    void scan_group_section (Elf_Scn * section, GElf_Shdr const & shdr, callback const & cb);
-    std::string group_identifier (GElf_Shdr const & group_shdr);
+/// Finds the COMDAT groups in an ELF file read through the ELF interface 'ElfIntf'.
+template <typename ElfIntf>
+class basic_elf_scanner {
+public:
+    using identifier = group_signature;
 
+    /// \param source  The file to be scanned: passed to the constructor of ElfIntf.
+    template <typename Source>
+    explicit basic_elf_scanner (Source && source)
+            : elf_ (std::forward<Source> (source)) {}
 
-    struct state {
-        explicit state (GElf_Shdr const & shdr_)
-                : shdr (shdr_) {}
-        decltype (GElf_Shdr::sh_size) n{0};
-        unsigned member_count{0};
-        std::uint64_t total_size{0};
-        GElf_Shdr const shdr;
-    };
-    void record_member (state * const st, std::uint32_t v);
+    /// Calls 'callback' with (identifier, size) for each COMDAT group in the file.
+    template <typename Function>
+    void scan (Function callback);
 
-    static std::uint32_t get_le (std::uint8_t const * v);
-    static std::uint32_t get_be (std::uint8_t const * v);
-    static bool elf_is_le (Elf * const elf);
+private:
+    using section = typename ElfIntf::section;
+
+    /// Returns the total size of the sections in a COMDAT group or 0 if the group isn't a COMDAT.
+    std::uint64_t scan_group_section (section const & group) const;
+    identifier group_identifier (section const & group);
+
+    ElfIntf elf_;
+
+    /// The section index of the symbol table most recently used to identify a group (or 0) and
+    /// the data of that table. All of the groups in a file normally refer to the same symbol
+    /// table so it is looked up just once.
+    std::uint32_t symtab_index_ = 0;
+    typename ElfIntf::symbol_table symtab_{};
 };
+
+/// Scans an ELF file using libelf.
+using elf_scanner = basic_elf_scanner<libelf_intf>;
+/// Scans an ELF file using the in-tree ELF reader. The results are identical to those produced by
+/// elf_scanner.
+using view_scanner = basic_elf_scanner<view_intf>;
+
+
+// scan
+// ~~~~
+template <typename ElfIntf>
+template <typename Function>
+void basic_elf_scanner<ElfIntf>::scan (Function callback) {
+    elf_.for_each_section ([this, &callback](section const & s) {
+        if (ElfIntf::type (s) == elf_view::sht_group) {
+            std::uint64_t const size = this->scan_group_section (s);
+            if (size > 0) {
+                callback (this->group_identifier (s), size);
+            }
+        }
+    });
+}
+
+// scan_group_section
+// ~~~~~~~~~~~~~~~~~~
+template <typename ElfIntf>
+std::uint64_t basic_elf_scanner<ElfIntf>::scan_group_section (section const & group) const {
+    assert (ElfIntf::type (group) == elf_view::sht_group);
+    if (ElfIntf::size (group) % sizeof (std::uint32_t) != 0) {
+        throw std::runtime_error ("SHT_GROUP sections must be a multiple of 4 bytes");
+    }
+
+    // The first word in a group section is the flag word: if it's not GRP_COMDAT then skip its
+    // contents. The remaining words are the section indices of its members.
+    bool first = true;
+    bool is_comdat = false;
+    std::uint64_t total_size = 0;
+    elf_.for_each_word (group, [&](std::uint32_t word) {
+        if (first) {
+            first = false;
+            is_comdat = word == elf_view::grp_comdat;
+            return is_comdat;
+        }
+        total_size += elf_.section_size (word);
+        return true;
+    });
+    return is_comdat ? total_size : 0U;
+}
+
+// group_identifier
+// ~~~~~~~~~~~~~~~~
+template <typename ElfIntf>
+auto basic_elf_scanner<ElfIntf>::group_identifier (section const & group) -> identifier {
+    std::uint32_t const link = ElfIntf::link (group);
+    if (symtab_index_ == 0 || symtab_index_ != link) {
+        symtab_ = elf_.get_symbol_table (link);
+        symtab_index_ = link;
+    }
+    return elf_.symbol_name (symtab_, ElfIntf::info (group));
+}
+
+
+// ***************
+// * libelf_intf *
+// ***************
+// for_each_section
+// ~~~~~~~~~~~~~~~~
+template <typename Function>
+void libelf_intf::for_each_section (Function f) const {
+    Elf_Scn * scn = nullptr;
+    while ((scn = ::elf_nextscn (elf_, scn)) != nullptr) {
+        f (section{scn, gelf::getshdr (scn)});
+    }
+}
+
+// for_each_word
+// ~~~~~~~~~~~~~
+template <typename Function>
+void libelf_intf::for_each_word (section const & s, Function f) const {
+    // Some versions of libelf understand that an SHT_GROUP section contains an array of
+    // ELF_T_WORD, and some do not. To minimize the dependency on a particular version or
+    // implementation, I'm requesting the raw section data (i.e. not translated by the
+    // library) and doing the byte swapping myself. The data may arrive in more than one block
+    // so a word can be split between two of them.
+    std::array<std::uint8_t, 4> bytes;
+    auto v_it = std::begin (bytes);
+    auto const size = s.shdr.sh_size;
+    decltype (s.shdr.sh_size) n = 0;
+    Elf_Data * data = nullptr;
+    while (n < size && (data = ::elf_rawdata (s.scn, data)) != nullptr) {
+        for (auto p = static_cast<std::uint8_t const *> (data->d_buf), end = p + data->d_size;
+             p < end && n < size; ++p, ++n) {
+            *(v_it++) = *p;
+            if (v_it == std::end (bytes)) {
+                // We've read 4 bytes. Turn that into a section index.
+                if (!f (is_le_ ? get_le (bytes.data ()) : get_be (bytes.data ()))) {
+                    return;
+                }
+                v_it = std::begin (bytes);
+            }
+        }
+    }
+}
+
+
+// *************
+// * view_intf *
+// *************
+// for_each_section
+// ~~~~~~~~~~~~~~~~
+template <typename Function>
+void view_intf::for_each_section (Function f) const {
+    for (std::size_t index = 1, count = file_.section_count (); index < count; ++index) {
+        f (file_.section (index));
+    }
+}
+
+// for_each_word
+// ~~~~~~~~~~~~~
+template <typename Function>
+void view_intf::for_each_word (section const & s, Function f) const {
+    elf_view::span const data = file_.data (s);
+    for (std::uint8_t const * p = data.data, *end = p + data.size; p < end;
+         p += sizeof (std::uint32_t)) {
+        if (!f (file_.read32 (p))) {
+            return;
+        }
+    }
+}
+
 #endif // ELF_SCANNER_H
 // eof elf_scanner.h
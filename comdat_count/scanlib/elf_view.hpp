@@ -0,0 +1,437 @@
+// Copyright (c) 2016 by SN Systems Ltd., Sony Interactive Entertainment Inc.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef SCANLIB_ELF_VIEW_HPP
+#define SCANLIB_ELF_VIEW_HPP
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+/// A minimal, read-only view of ELF files and ar archives held in memory (typically a mapped
+/// file). Nothing is decoded until it is asked for and nothing is copied: section contents and
+/// strings are returned as pointers into the original bytes. The view understands both 32- and
+/// 64-bit ELF files of either byte order.
+namespace elf_view {
+
+    class exception : public std::runtime_error {
+    public:
+        using std::runtime_error::runtime_error;
+    };
+
+    // span
+    // ~~~~
+    /// A contiguous range of bytes.
+    struct span {
+        std::uint8_t const * data;
+        std::size_t size;
+
+        /// Returns the part of this span starting at 'offset' and of 'length' bytes. Throws if
+        /// the result would not lie entirely within the span.
+        span subspan (std::uint64_t offset, std::uint64_t length) const {
+            if (offset > size || length > size - offset) {
+                throw exception ("ELF data lies outside the file");
+            }
+            return {data + offset, static_cast<std::size_t> (length)};
+        }
+    };
+
+    /// A string: a pointer to its first character and its length.
+    using string_ref = std::pair<char const *, std::size_t>;
+
+    namespace details {
+        inline std::uint16_t read16 (std::uint8_t const * p, bool le) {
+            return le ? static_cast<std::uint16_t> (p[0] | (p[1] << 8))
+                      : static_cast<std::uint16_t> ((p[0] << 8) | p[1]);
+        }
+        inline std::uint32_t read32 (std::uint8_t const * p, bool le) {
+            return le ? (static_cast<std::uint32_t> (p[3]) << 24) |
+                            (static_cast<std::uint32_t> (p[2]) << 16) |
+                            (static_cast<std::uint32_t> (p[1]) << 8) | p[0]
+                      : (static_cast<std::uint32_t> (p[0]) << 24) |
+                            (static_cast<std::uint32_t> (p[1]) << 16) |
+                            (static_cast<std::uint32_t> (p[2]) << 8) | p[3];
+        }
+        inline std::uint64_t read64 (std::uint8_t const * p, bool le) {
+            std::uint64_t const a = read32 (p, le);
+            std::uint64_t const b = read32 (p + 4, le);
+            return le ? (b << 32) | a : (a << 32) | b;
+        }
+    } // namespace details
+
+
+    // Just enough of the ELF constants for our purposes. These have the same values as their
+    // <elf.h> counterparts.
+    constexpr std::uint32_t sht_nobits = 8;
+    constexpr std::uint32_t sht_group = 17;
+    constexpr std::uint32_t sht_strtab = 3;
+    constexpr std::uint32_t grp_comdat = 1;
+
+
+    struct section_header {
+        std::uint32_t name;
+        std::uint32_t type;
+        std::uint64_t flags;
+        std::uint64_t offset;
+        std::uint64_t size;
+        std::uint32_t link;
+        std::uint32_t info;
+        std::uint64_t entsize;
+    };
+
+    struct symbol {
+        std::uint32_t name;
+        std::uint8_t info;
+        std::uint8_t other;
+        std::uint16_t shndx;
+        std::uint64_t value;
+        std::uint64_t size;
+    };
+
+
+    // ********
+    // * file *
+    // ********
+    class file {
+    public:
+        /// Returns true if the span looks like an ELF file that this view can read.
+        static bool is_elf (span s) {
+            static std::uint8_t const magic[] = {0x7f, 'E', 'L', 'F'};
+            if (s.size < 16U || std::memcmp (s.data, magic, sizeof (magic)) != 0) {
+                return false;
+            }
+            std::uint8_t const cls = s.data[ei_class];
+            std::uint8_t const data = s.data[ei_data];
+            if ((cls != elfclass32 && cls != elfclass64) ||
+                (data != elfdata2lsb && data != elfdata2msb)) {
+                return false;
+            }
+            return s.size >= (cls == elfclass64 ? 64U : 52U);
+        }
+
+        explicit file (span s)
+                : s_ (s) {
+            if (!is_elf (s)) {
+                throw exception ("Not an ELF file");
+            }
+            is64_ = s.data[ei_class] == elfclass64;
+            le_ = s.data[ei_data] == elfdata2lsb;
+
+            std::uint8_t const * const p = s.data;
+            shoff_ = is64_ ? this->read64 (p + 40) : this->read32 (p + 32);
+            shentsize_ = this->read16 (p + (is64_ ? 58 : 46));
+            shnum_ = this->read16 (p + (is64_ ? 60 : 48));
+            if (shoff_ == 0U) {
+                shnum_ = 0U;
+                return;
+            }
+            if (shentsize_ < (is64_ ? 64U : 40U)) {
+                throw exception ("Bad ELF section header size");
+            }
+            if (shnum_ == 0U) {
+                // Extended section numbering: the real count is held in section 0's size.
+                shnum_ = static_cast<std::size_t> (this->section_at (0U).size);
+            }
+            // Check that the section header table lies within the file.
+            s_.subspan (shoff_, static_cast<std::uint64_t> (shnum_) * shentsize_);
+        }
+
+        bool is_64 () const {
+            return is64_;
+        }
+        bool is_le () const {
+            return le_;
+        }
+        span contents () const {
+            return s_;
+        }
+
+        /// The number of entries in the section header table (including the null entry).
+        std::size_t section_count () const {
+            return shnum_;
+        }
+
+        section_header section (std::size_t index) const {
+            if (index >= shnum_) {
+                throw exception ("ELF section index is out of range");
+            }
+            return this->section_at (index);
+        }
+
+        /// Returns the contents of a section. There is no copy: the result points into the file.
+        span data (section_header const & shdr) const {
+            if (shdr.type == sht_nobits) {
+                return {s_.data, 0U};
+            }
+            return s_.subspan (shdr.offset, shdr.size);
+        }
+
+        /// Returns entry 'index' of a symbol table.
+        symbol get_symbol (section_header const & symtab, std::size_t index) const {
+            std::size_t const entsize = is64_ ? 24U : 16U;
+            span const d = this->data (symtab);
+            if (index >= d.size / entsize) {
+                throw exception ("ELF symbol index is out of range");
+            }
+            std::uint8_t const * const p = d.data + index * entsize;
+            symbol result;
+            result.name = this->read32 (p);
+            if (is64_) {
+                result.info = p[4];
+                result.other = p[5];
+                result.shndx = this->read16 (p + 6);
+                result.value = this->read64 (p + 8);
+                result.size = this->read64 (p + 16);
+            } else {
+                result.value = this->read32 (p + 4);
+                result.size = this->read32 (p + 8);
+                result.info = p[12];
+                result.other = p[13];
+                result.shndx = this->read16 (p + 14);
+            }
+            return result;
+        }
+
+        /// Returns the NUL-terminated string at 'offset' in a string table section.
+        string_ref string (section_header const & strtab, std::size_t offset) const {
+            if (strtab.type != sht_strtab) {
+                throw exception ("ELF section is not a string table");
+            }
+            span const d = this->data (strtab);
+            if (offset >= d.size) {
+                throw exception ("ELF string offset is out of range");
+            }
+            auto const * const first = reinterpret_cast<char const *> (d.data + offset);
+            auto const * const nul =
+                static_cast<char const *> (std::memchr (first, '\0', d.size - offset));
+            if (nul == nullptr) {
+                throw exception ("ELF string is not terminated");
+            }
+            return {first, static_cast<std::size_t> (nul - first)};
+        }
+
+        std::uint16_t read16 (std::uint8_t const * p) const {
+            return details::read16 (p, le_);
+        }
+        std::uint32_t read32 (std::uint8_t const * p) const {
+            return details::read32 (p, le_);
+        }
+        std::uint64_t read64 (std::uint8_t const * p) const {
+            return details::read64 (p, le_);
+        }
+
+    private:
+        static constexpr std::size_t ei_class = 4;
+        static constexpr std::size_t ei_data = 5;
+        static constexpr std::uint8_t elfclass32 = 1;
+        static constexpr std::uint8_t elfclass64 = 2;
+        static constexpr std::uint8_t elfdata2lsb = 1;
+        static constexpr std::uint8_t elfdata2msb = 2;
+
+        section_header section_at (std::size_t index) const {
+            std::uint8_t const * const p =
+                s_.subspan (shoff_ + static_cast<std::uint64_t> (index) * shentsize_, shentsize_)
+                    .data;
+            section_header result;
+            result.name = this->read32 (p);
+            result.type = this->read32 (p + 4);
+            if (is64_) {
+                result.flags = this->read64 (p + 8);
+                result.offset = this->read64 (p + 24);
+                result.size = this->read64 (p + 32);
+                result.link = this->read32 (p + 40);
+                result.info = this->read32 (p + 44);
+                result.entsize = this->read64 (p + 56);
+            } else {
+                result.flags = this->read32 (p + 8);
+                result.offset = this->read32 (p + 16);
+                result.size = this->read32 (p + 20);
+                result.link = this->read32 (p + 24);
+                result.info = this->read32 (p + 28);
+                result.entsize = this->read32 (p + 36);
+            }
+            return result;
+        }
+
+        span s_;
+        bool is64_ = false;
+        bool le_ = false;
+        std::uint64_t shoff_ = 0U;
+        std::size_t shentsize_ = 0U;
+        std::size_t shnum_ = 0U;
+    };
+
+
+    // ***********
+    // * archive *
+    // ***********
+    /// Iterates over the members of an ar archive. Both regular and GNU thin archives are
+    /// understood.
+    class archive {
+    public:
+        struct member {
+            string_ref name;
+            /// The member's contents. A thin archive does not hold its members' contents: 'data'
+            /// is empty and 'name' is the path of the member file relative to the directory
+            /// containing the archive.
+            span data;
+        };
+
+        /// Returns true if 's' is a regular or thin archive.
+        static bool is_archive (span s) {
+            return is_regular (s) || is_thin (s);
+        }
+        static bool is_regular (span s) {
+            return s.size >= magic_size && std::memcmp (s.data, "!<arch>\n", magic_size) == 0;
+        }
+        static bool is_thin (span s) {
+            return s.size >= magic_size && std::memcmp (s.data, "!<thin>\n", magic_size) == 0;
+        }
+
+        explicit archive (span s)
+                : s_ (s)
+                , thin_ (is_thin (s)) {
+            if (!thin_ && !is_regular (s)) {
+                throw exception ("Not an archive");
+            }
+        }
+
+        /// True if this is a thin archive.
+        bool thin () const {
+            return thin_;
+        }
+
+        /// Calls 'function' for each ordinary member of the archive. The archive symbol tables
+        /// and the long name table are not reported.
+        template <typename Function>
+        void for_each (Function function) const;
+
+        /// Returns the number of ordinary members in the archive.
+        std::size_t count () const {
+            std::size_t result = 0;
+            this->for_each ([&result](member const &) { ++result; });
+            return result;
+        }
+
+    private:
+        static constexpr std::size_t magic_size = 8;
+        static constexpr std::size_t header_size = 60;
+
+        static std::uint64_t decimal (std::uint8_t const * p, std::size_t length) {
+            std::uint64_t result = 0;
+            for (auto const * end = p + length; p != end && *p >= '0' && *p <= '9'; ++p) {
+                result = result * 10U + static_cast<unsigned> (*p - '0');
+            }
+            return result;
+        }
+
+        /// Removes trailing characters 'c' from a string.
+        static string_ref trim (string_ref str, char c) {
+            while (str.second > 0U && str.first[str.second - 1U] == c) {
+                --str.second;
+            }
+            return str;
+        }
+
+        span s_;
+        bool thin_;
+    };
+
+    // for each
+    // ~~~~~~~~
+    template <typename Function>
+    void archive::for_each (Function function) const {
+        span long_names{nullptr, 0U};
+        std::uint64_t pos = magic_size;
+        while (pos + header_size <= s_.size) {
+            std::uint8_t const * const header = s_.data + pos;
+            if (header[58] != '`' || header[59] != '\n') {
+                throw exception ("Bad archive member header");
+            }
+            std::uint64_t const size = decimal (header + 48, 10);
+            auto const * const raw_name = reinterpret_cast<char const *> (header);
+            string_ref name = trim (string_ref{raw_name, 16U}, ' ');
+            bool const is_table =
+                name.second > 0U && name.first[0] == '/' &&
+                (name.second == 1U || (name.second == 2U && name.first[1] == '/') ||
+                 (name.second == 7U && std::memcmp (name.first, "/SYM64/", 7) == 0));
+
+            // The symbol and long name tables are always stored in the archive, but the header
+            // of a thin archive member is not followed by its contents.
+            span data{nullptr, 0U};
+            if (thin_ && !is_table) {
+                pos += header_size;
+            } else {
+                data = s_.subspan (pos + header_size, size);
+                // Members are aligned on 2 byte boundaries.
+                pos += header_size + size + (size & 1U);
+            }
+
+            if (name.second > 0U && name.first[0] == '/') {
+                if (is_table) {
+                    if (name.second == 2U) {
+                        long_names = data; // The GNU long name table.
+                    }
+                    continue; // The archive symbol table.
+                }
+                // A GNU long name: "/offset" into the long name table. Each name in the table
+                // is terminated by "/\n".
+                std::uint64_t const offset = decimal (header + 1, 15);
+                if (offset >= long_names.size) {
+                    throw exception ("Bad archive long name offset");
+                }
+                auto const * const first =
+                    reinterpret_cast<char const *> (long_names.data + offset);
+                auto const * const nl = static_cast<char const *> (
+                    std::memchr (first, '\n', static_cast<std::size_t> (long_names.size - offset)));
+                std::size_t const length = nl == nullptr
+                                               ? static_cast<std::size_t> (long_names.size - offset)
+                                               : static_cast<std::size_t> (nl - first);
+                name = trim (string_ref{first, length}, '/');
+            } else if (!thin_ && name.second > 3U && std::memcmp (name.first, "#1/", 3) == 0) {
+                // A BSD long name: the name occupies the first bytes of the member data.
+                std::uint64_t const length = decimal (header + 3, 13);
+                span const n = data.subspan (0U, length);
+                data = data.subspan (length, data.size - length);
+                auto const * const first = reinterpret_cast<char const *> (n.data);
+                auto const * const nul =
+                    static_cast<char const *> (std::memchr (first, '\0', n.size));
+                name = string_ref{first, nul == nullptr ? n.size
+                                                        : static_cast<std::size_t> (nul - first)};
+            } else {
+                // A GNU short name is terminated by '/'.
+                auto const * const slash =
+                    static_cast<char const *> (std::memchr (name.first, '/', name.second));
+                if (slash != nullptr) {
+                    name.second = static_cast<std::size_t> (slash - name.first);
+                }
+            }
+            function (member{name, data});
+        }
+    }
+
+} // namespace elf_view
+
+#endif // SCANLIB_ELF_VIEW_HPP
+// eof scanlib/elf_view.hpp
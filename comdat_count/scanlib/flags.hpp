@@ -28,6 +28,16 @@ struct output_flags {
     bool verbose = false;
 };
 
+/// The library used to read ELF files and archives.
+enum class elf_backend {
+    native, ///< The in-tree reader (elf_view.hpp) over a mapped file.
+    libelf, ///< libelf.
+};
+
+struct scan_flags {
+    elf_backend backend = elf_backend::native;
+};
+
 struct state_flags {
     /// True if one of the consumer threads encounters an error. The other threads
     /// exit ASAP if this is set.
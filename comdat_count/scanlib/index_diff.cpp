@@ -0,0 +1,118 @@
+// Copyright (c) 2016 by SN Systems Ltd., Sony Interactive Entertainment Inc.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "index_diff.hpp"
+
+// Standard Library
+#include <cassert>
+#include <ostream>
+
+namespace {
+
+    void write_signature (index_file::reader const & index, index_file::entry const & e,
+                          std::ostream & os) {
+        os << ' ' << index.demangled (e) << '\n';
+    }
+
+} // end anonymous namespace
+
+namespace index_diff {
+
+    // classify
+    // ~~~~~~~~
+    change classify (index_file::entry const * old_entry, index_file::entry const * new_entry) {
+        assert (old_entry != nullptr || new_entry != nullptr);
+        if (old_entry == nullptr) {
+            return change::added;
+        }
+        if (new_entry == nullptr) {
+            return change::vanished;
+        }
+        auto const old_waste = old_entry->wasted ();
+        auto const new_waste = new_entry->wasted ();
+        if (new_waste > old_waste) {
+            return change::grown;
+        }
+        if (new_waste < old_waste) {
+            return change::shrunk;
+        }
+        return change::unchanged;
+    }
+
+    // diff
+    // ~~~~
+    totals diff (index_file::reader const & old_index, index_file::reader const & new_index,
+                 std::ostream & os) {
+        totals t{};
+        t.old_total = old_index.get_header ().total_size;
+        t.new_total = new_index.get_header ().total_size;
+        t.old_waste = old_index.get_header ().total_waste;
+        t.new_waste = new_index.get_header ().total_waste;
+
+        os << "Change Old-Wasted New-Wasted Old-Instances New-Instances Signature\n";
+        merge_join (old_index, new_index, [&](index_file::entry const * old_entry,
+                                              index_file::entry const * new_entry) {
+            char marker = ' ';
+            switch (classify (old_entry, new_entry)) {
+            case change::added:
+                ++t.added;
+                marker = '+';
+                break;
+            case change::vanished:
+                ++t.vanished;
+                marker = '-';
+                break;
+            case change::grown:
+                ++t.grown;
+                marker = '>';
+                break;
+            case change::shrunk:
+                ++t.shrunk;
+                marker = '<';
+                break;
+            case change::unchanged:
+                ++t.unchanged;
+                return;
+            }
+
+            os << marker << ' ' << (old_entry ? old_entry->wasted () : 0U) << ' '
+               << (new_entry ? new_entry->wasted () : 0U) << ' '
+               << (old_entry ? old_entry->instances : 0U) << ' '
+               << (new_entry ? new_entry->instances : 0U);
+            if (new_entry != nullptr) {
+                write_signature (new_index, *new_entry, os);
+            } else {
+                write_signature (old_index, *old_entry, os);
+            }
+        });
+
+        os << "#> Added:" << t.added << '\n'
+           << "#> Vanished:" << t.vanished << '\n'
+           << "#> Grown:" << t.grown << '\n'
+           << "#> Shrunk:" << t.shrunk << '\n'
+           << "#> Unchanged:" << t.unchanged << '\n'
+           << "#> Total:" << t.old_total << " -> " << t.new_total << '\n'
+           << "#> Wasted:" << t.old_waste << " -> " << t.new_waste << '\n';
+        return t;
+    }
+
+} // namespace index_diff
+
+// eof index_diff.cpp
@@ -0,0 +1,113 @@
+// Copyright (c) 2016 by SN Systems Ltd., Sony Interactive Entertainment Inc.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef SCANLIB_INDEX_DIFF_HPP
+#define SCANLIB_INDEX_DIFF_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+
+#include "index_file.hpp"
+
+/// Compares the results of two scans which were written as index files.
+namespace index_diff {
+
+    enum class change { added, vanished, grown, shrunk, unchanged };
+
+    struct totals {
+        std::uint64_t added;
+        std::uint64_t vanished;
+        std::uint64_t grown;
+        std::uint64_t shrunk;
+        std::uint64_t unchanged;
+        /// The total and wasted sizes of the old and new results.
+        std::uint64_t old_total;
+        std::uint64_t new_total;
+        std::uint64_t old_waste;
+        std::uint64_t new_waste;
+    };
+
+    /// Compares the names of two entries which may belong to different index files using the
+    /// order in which they are stored in the index.
+    inline int compare_names (index_file::reader const & lhs_index, index_file::entry const & lhs,
+                              index_file::reader const & rhs_index, index_file::entry const & rhs) {
+        auto const l = lhs_index.name_view (lhs);
+        auto const r = rhs_index.name_view (rhs);
+        int const result = std::char_traits<char>::compare (l.first, r.first,
+                                                            std::min (l.second, r.second));
+        if (result != 0) {
+            return result;
+        }
+        return l.second < r.second ? -1 : (l.second > r.second ? 1 : 0);
+    }
+
+    /// Walks the entries of two indices in step. Since both are sorted by (hash, name) this is a
+    /// simple merge-join which needs no memory beyond the mapped files themselves. 'function' is
+    /// called for every signature with pointers to the old and new entries; one of these will be
+    /// nullptr if the signature appears in only one of the indices.
+    template <typename Function>
+    void merge_join (index_file::reader const & old_index, index_file::reader const & new_index,
+                     Function function) {
+        auto old_it = old_index.begin ();
+        auto const old_end = old_index.end ();
+        auto new_it = new_index.begin ();
+        auto const new_end = new_index.end ();
+
+        while (old_it != old_end && new_it != new_end) {
+            int order = 0;
+            if (old_it->hash < new_it->hash) {
+                order = -1;
+            } else if (old_it->hash > new_it->hash) {
+                order = 1;
+            } else {
+                order = compare_names (old_index, *old_it, new_index, *new_it);
+            }
+
+            if (order < 0) {
+                function (old_it++, nullptr);
+            } else if (order > 0) {
+                function (nullptr, new_it++);
+            } else {
+                function (old_it++, new_it++);
+            }
+        }
+        for (; old_it != old_end; ++old_it) {
+            function (old_it, nullptr);
+        }
+        for (; new_it != new_end; ++new_it) {
+            function (nullptr, new_it);
+        }
+    }
+
+    /// Classifies the change between two entries either of which may be nullptr. Groups are
+    /// compared by the space that they waste.
+    change classify (index_file::entry const * old_entry, index_file::entry const * new_entry);
+
+    /// Writes a line for each signature which was added, vanished, or whose waste changed
+    /// followed by a summary. Returns the totals.
+    totals diff (index_file::reader const & old_index, index_file::reader const & new_index,
+                 std::ostream & os);
+
+} // namespace index_diff
+
+#endif // SCANLIB_INDEX_DIFF_HPP
+// eof index_diff.hpp
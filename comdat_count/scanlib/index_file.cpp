@@ -0,0 +1,410 @@
+// Copyright (c) 2016 by SN Systems Ltd., Sony Interactive Entertainment Inc.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "index_file.hpp"
+
+// Standard Library
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <tuple>
+
+#if defined(__GNUC__) || defined(__clang__)
+#include <cxxabi.h>
+#endif
+
+// 3rd party
+#include <boost/filesystem.hpp>
+
+namespace {
+
+    char const index_magic[8] = {'C', 'M', 'D', 'T', 'I', 'D', 'X', '\0'};
+    std::uint32_t const index_version = 1;
+    std::uint32_t const byte_order_marker = 0x01020304;
+
+    std::uint64_t aligned (std::uint64_t v) {
+        return (v + 7U) & ~std::uint64_t{7};
+    }
+
+    /// Compares a string in the index with a std::string using the same ordering as
+    /// std::string::compare().
+    int compare (char const * str, std::size_t length, std::string const & rhs) {
+        auto const rlen = rhs.length ();
+        int const r = std::char_traits<char>::compare (str, rhs.data (), std::min (length, rlen));
+        if (r != 0) {
+            return r;
+        }
+        return length < rlen ? -1 : (length > rlen ? 1 : 0);
+    }
+
+    /// Returns the demangled form of a symbol name or the name itself if it could not be
+    /// demangled.
+    std::string demangle (std::string const & name) {
+#if defined(__GNUC__) || defined(__clang__)
+        int status = 0;
+        std::unique_ptr<char, decltype (&std::free)> demangled (
+            abi::__cxa_demangle (name.c_str (), nullptr, nullptr, &status), &std::free);
+        if (status == 0 && demangled.get () != nullptr) {
+            return demangled.get ();
+        }
+#endif
+        return name;
+    }
+
+
+    // string table
+    // ~~~~~~~~~~~~
+    class string_table {
+    public:
+        index_file::string_ref add (std::string const & str) {
+            index_file::string_ref const result{data_.length (),
+                                                static_cast<std::uint32_t> (str.length ()), 0};
+            data_.append (str);
+            return result;
+        }
+        std::string const & data () const {
+            return data_;
+        }
+
+    private:
+        std::string data_;
+    };
+
+
+    // writer
+    // ~~~~~~
+    class writer {
+    public:
+        explicit writer (boost::filesystem::path const & path)
+                : os_ (path.native (), std::ios::out | std::ios::binary | std::ios::trunc) {
+            if (!os_.is_open ()) {
+                std::ostringstream str;
+                str << "Could not open " << path;
+                throw index_file::exception (str.str ());
+            }
+            os_.exceptions (std::ios::badbit | std::ios::failbit);
+        }
+
+        /// Writes 'count' instances of T starting at 'offset' in the file. The gap between the
+        /// previous section and 'offset' is filled with zeros.
+        template <typename T>
+        void section (std::uint64_t offset, T const * data, std::size_t count) {
+            assert (offset >= pos_);
+            static char const zeros[8] = {0};
+            assert (offset - pos_ <= sizeof (zeros));
+            os_.write (zeros, static_cast<std::streamsize> (offset - pos_));
+            std::size_t const size = sizeof (T) * count;
+            os_.write (reinterpret_cast<char const *> (data), static_cast<std::streamsize> (size));
+            pos_ = offset + size;
+        }
+
+    private:
+        std::ofstream os_;
+        std::uint64_t pos_ = 0;
+    };
+
+} // end anonymous namespace
+
+
+namespace index_file {
+
+    // hash
+    // ~~~~
+    /// 64-bit FNV-1a.
+    std::uint64_t hash (char const * str, std::size_t length) {
+        std::uint64_t result = 0xcbf29ce484222325ULL;
+        for (auto const * end = str + length; str != end; ++str) {
+            result ^= static_cast<unsigned char> (*str);
+            result *= 0x100000001b3ULL;
+        }
+        return result;
+    }
+
+
+    // write
+    // ~~~~~
+    void write (boost::filesystem::path const & path, comdat_scanner::comdat_map const & cm,
+                std::vector<std::string> const & inputs, md5::digest const & digest) {
+        using comdat_iterator = comdat_scanner::comdat_map::const_iterator;
+
+        // Order the signatures by hash (and then by name to break any ties) so that a reader
+        // can find a signature with a binary search.
+        std::vector<std::tuple<std::uint64_t, comdat_iterator>> order;
+        order.reserve (cm.size ());
+        for (auto it = std::begin (cm), end = std::end (cm); it != end; ++it) {
+            order.emplace_back (hash (it->first), it);
+        }
+        std::sort (std::begin (order), std::end (order),
+                   [](std::tuple<std::uint64_t, comdat_iterator> const & lhs,
+                      std::tuple<std::uint64_t, comdat_iterator> const & rhs) {
+                       return std::tie (std::get<0> (lhs), std::get<1> (lhs)->first) <
+                              std::tie (std::get<0> (rhs), std::get<1> (rhs)->first);
+                   });
+
+        string_table strings;
+        std::vector<entry> entries;
+        std::vector<std::string> demangled_names;
+        std::vector<std::uint32_t> postings;
+        entries.reserve (order.size ());
+        demangled_names.reserve (order.size ());
+
+        header h;
+        std::memset (&h, 0, sizeof (h));
+        for (auto const & o : order) {
+            std::string const & name = std::get<1> (o)->first;
+            comdat_scanner::value const & value = std::get<1> (o)->second;
+
+            entry e;
+            std::memset (&e, 0, sizeof (e));
+            e.hash = std::get<0> (o);
+            e.total_size = value.total_size;
+            e.largest = value.largest;
+            e.instances = value.instances;
+
+            e.name = strings.add (name);
+            demangled_names.push_back (demangle (name));
+            e.demangled =
+                demangled_names.back () == name ? e.name : strings.add (demangled_names.back ());
+
+            // The scanner records the inputs in the order that the consumer threads encounter
+            // them. Sort them so that the postings are deterministic.
+            std::vector<std::uint32_t> in = value.inputs;
+            std::sort (std::begin (in), std::end (in));
+            in.erase (std::unique (std::begin (in), std::end (in)), std::end (in));
+            e.postings_offset = postings.size ();
+            e.postings_count = static_cast<std::uint32_t> (in.size ());
+            postings.insert (std::end (postings), std::begin (in), std::end (in));
+
+            h.total_size += value.total_size;
+            h.total_waste += value.total_size - value.largest;
+            entries.push_back (e);
+        }
+
+        auto const count = static_cast<std::uint32_t> (entries.size ());
+        std::vector<std::uint32_t> by_waste (count);
+        std::vector<std::uint32_t> by_name (count);
+        for (std::uint32_t index = 0; index < count; ++index) {
+            by_waste[index] = by_name[index] = index;
+        }
+        std::stable_sort (std::begin (by_waste), std::end (by_waste),
+                          [&entries](std::uint32_t lhs, std::uint32_t rhs) {
+                              return entries[lhs].wasted () > entries[rhs].wasted ();
+                          });
+        std::stable_sort (std::begin (by_name), std::end (by_name),
+                          [&demangled_names](std::uint32_t lhs, std::uint32_t rhs) {
+                              return demangled_names[lhs] < demangled_names[rhs];
+                          });
+
+        std::vector<string_ref> input_refs;
+        input_refs.reserve (inputs.size ());
+        for (auto const & in : inputs) {
+            input_refs.push_back (strings.add (in));
+        }
+
+        std::memcpy (h.magic, index_magic, sizeof (h.magic));
+        h.version = index_version;
+        h.byte_order = byte_order_marker;
+        h.signature_count = count;
+        h.posting_count = postings.size ();
+        h.input_count = input_refs.size ();
+        h.entries_offset = aligned (sizeof (header));
+        h.by_waste_offset = aligned (h.entries_offset + sizeof (entry) * entries.size ());
+        h.by_name_offset = aligned (h.by_waste_offset + sizeof (std::uint32_t) * by_waste.size ());
+        h.postings_offset = aligned (h.by_name_offset + sizeof (std::uint32_t) * by_name.size ());
+        h.inputs_offset = aligned (h.postings_offset + sizeof (std::uint32_t) * postings.size ());
+        h.strings_offset = aligned (h.inputs_offset + sizeof (string_ref) * input_refs.size ());
+        h.strings_size = strings.data ().length ();
+        std::copy (std::begin (digest), std::end (digest), h.digest);
+
+        writer w (path);
+        w.section (0, &h, 1);
+        w.section (h.entries_offset, entries.data (), entries.size ());
+        w.section (h.by_waste_offset, by_waste.data (), by_waste.size ());
+        w.section (h.by_name_offset, by_name.data (), by_name.size ());
+        w.section (h.postings_offset, postings.data (), postings.size ());
+        w.section (h.inputs_offset, input_refs.data (), input_refs.size ());
+        w.section (h.strings_offset, strings.data ().data (), strings.data ().length ());
+    }
+
+    void write (boost::filesystem::path const & path, comdat_scanner const & scanner) {
+        write (path, scanner.comdats (), scanner.inputs (), scanner.digest ());
+    }
+
+
+    // **********
+    // * reader *
+    // **********
+    // (ctor)
+    // ~~~~~~
+    reader::reader (boost::filesystem::path const & path)
+            : file_ ()
+            , header_ (nullptr)
+            , entries_ (nullptr)
+            , by_waste_ (nullptr)
+            , by_name_ (nullptr)
+            , postings_ (nullptr)
+            , inputs_ (nullptr)
+            , strings_ (nullptr) {
+
+        if (boost::filesystem::file_size (path) < sizeof (header)) {
+            std::ostringstream str;
+            str << path << " is not a COMDAT index file";
+            throw exception (str.str ());
+        }
+        file_.open (path.string ());
+        header_ = reinterpret_cast<header const *> (file_.data ());
+        if (std::memcmp (header_->magic, index_magic, sizeof (index_magic)) != 0) {
+            std::ostringstream str;
+            str << path << " is not a COMDAT index file";
+            throw exception (str.str ());
+        }
+        if (header_->byte_order != byte_order_marker) {
+            std::ostringstream str;
+            str << path << " was written by a host of different byte order";
+            throw exception (str.str ());
+        }
+        if (header_->version != index_version) {
+            std::ostringstream str;
+            str << path << " has unsupported version " << header_->version;
+            throw exception (str.str ());
+        }
+
+        entries_ = this->section<entry> (header_->entries_offset, header_->signature_count);
+        by_waste_ =
+            this->section<std::uint32_t> (header_->by_waste_offset, header_->signature_count);
+        by_name_ = this->section<std::uint32_t> (header_->by_name_offset, header_->signature_count);
+        postings_ = this->section<std::uint32_t> (header_->postings_offset, header_->posting_count);
+        inputs_ = this->section<string_ref> (header_->inputs_offset, header_->input_count);
+        strings_ = this->section<char> (header_->strings_offset, header_->strings_size);
+    }
+
+    // section
+    // ~~~~~~~
+    template <typename T>
+    T const * reader::section (std::uint64_t offset, std::uint64_t count) const {
+        std::uint64_t const size = file_.size ();
+        if (offset % alignof (T) != 0 || offset > size || count > (size - offset) / sizeof (T)) {
+            throw exception ("Index file is corrupt");
+        }
+        return reinterpret_cast<T const *> (file_.data () + offset);
+    }
+
+    // view
+    // ~~~~
+    std::pair<char const *, std::size_t> reader::view (string_ref const & ref) const {
+        if (ref.offset > header_->strings_size || ref.length > header_->strings_size - ref.offset) {
+            throw exception ("Index file is corrupt");
+        }
+        return {strings_ + ref.offset, ref.length};
+    }
+
+    // input
+    // ~~~~~
+    std::string reader::input (std::uint32_t index) const {
+        if (index >= header_->input_count) {
+            throw exception ("Index file is corrupt");
+        }
+        return this->str (inputs_[index]);
+    }
+
+    // inputs
+    // ~~~~~~
+    std::vector<std::string> reader::inputs (entry const & e) const {
+        if (e.postings_offset > header_->posting_count ||
+            e.postings_count > header_->posting_count - e.postings_offset) {
+            throw exception ("Index file is corrupt");
+        }
+        std::vector<std::string> result;
+        result.reserve (e.postings_count);
+        auto const * first = postings_ + e.postings_offset;
+        std::for_each (first, first + e.postings_count, [this, &result](std::uint32_t index) {
+            result.push_back (this->input (index));
+        });
+        return result;
+    }
+
+    // find
+    // ~~~~
+    entry const * reader::find (std::string const & signature) const {
+        std::uint64_t const h = hash (signature);
+        auto it = std::lower_bound (this->begin (), this->end (), h,
+                                    [](entry const & e, std::uint64_t v) { return e.hash < v; });
+        for (; it != this->end () && it->hash == h; ++it) {
+            auto const v = this->view (it->name);
+            if (compare (v.first, v.second, signature) == 0) {
+                return it;
+            }
+        }
+        return nullptr;
+    }
+
+    // top by waste
+    // ~~~~~~~~~~~~
+    std::vector<entry const *> reader::top_by_waste (std::size_t n) const {
+        n = std::min (n, this->size ());
+        std::vector<entry const *> result;
+        result.reserve (n);
+        for (auto const * it = by_waste_, *end = by_waste_ + n; it != end; ++it) {
+            result.push_back (this->at (*it));
+        }
+        return result;
+    }
+
+    // prefix
+    // ~~~~~~
+    std::vector<entry const *> reader::prefix (std::string const & prefix,
+                                               std::size_t limit) const {
+        auto const * first = by_name_;
+        auto const * last = by_name_ + this->size ();
+        auto it = std::lower_bound (first, last, prefix, [this](std::uint32_t index,
+                                                               std::string const & p) {
+            auto const v = this->view (this->at (index)->demangled);
+            return compare (v.first, v.second, p) < 0;
+        });
+
+        std::vector<entry const *> result;
+        for (; it != last && (limit == 0 || result.size () < limit); ++it) {
+            entry const * const e = this->at (*it);
+            auto const v = this->view (e->demangled);
+            if (v.second < prefix.length () ||
+                std::char_traits<char>::compare (v.first, prefix.data (), prefix.length ()) != 0) {
+                break;
+            }
+            result.push_back (e);
+        }
+        return result;
+    }
+
+    // at
+    // ~~
+    entry const * reader::at (std::uint32_t index) const {
+        if (index >= header_->signature_count) {
+            throw exception ("Index file is corrupt");
+        }
+        return entries_ + index;
+    }
+
+} // namespace index_file
+
+// eof index_file.cpp
@@ -0,0 +1,188 @@
+// Copyright (c) 2016 by SN Systems Ltd., Sony Interactive Entertainment Inc.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef SCANLIB_INDEX_FILE_HPP
+#define SCANLIB_INDEX_FILE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <boost/filesystem/path.hpp>
+#include <boost/iostreams/device/mapped_file.hpp>
+
+#include "comdat_scanner.hpp"
+#include "md5_context.h"
+
+/// The index file is a persistent, memory-mappable record of the complete COMDAT table produced
+/// by a scan. The layout is:
+///
+///     header
+///     entry[signature_count]            (sorted by signature hash, then by name)
+///     std::uint32_t[signature_count]    (entry indices ordered by descending waste)
+///     std::uint32_t[signature_count]    (entry indices ordered by demangled name)
+///     std::uint32_t[posting_count]      (input indices for each entry)
+///     string_ref[input_count]           (the names of the contributing inputs)
+///     char[strings_size]                (string storage)
+///
+/// Each section starts on an 8 byte boundary. Values are stored in host byte order; the header
+/// records the byte order so that a file produced on a host of different endianness is rejected.
+namespace index_file {
+
+    class exception : public std::runtime_error {
+    public:
+        using std::runtime_error::runtime_error;
+    };
+
+    struct string_ref {
+        std::uint64_t offset;
+        std::uint32_t length;
+        std::uint32_t padding;
+    };
+
+    struct entry {
+        /// The hash of the group signature.
+        std::uint64_t hash;
+        /// The total size of all instances encountered.
+        std::uint64_t total_size;
+        /// The size of the largest instances encountered.
+        std::uint64_t largest;
+        /// The group signature (the name of the identifying symbol).
+        string_ref name;
+        /// The demangled group signature.
+        string_ref demangled;
+        /// The index of the first of the entry's postings.
+        std::uint64_t postings_offset;
+        /// The number of instances encountered.
+        std::uint32_t instances;
+        /// The number of postings belonging to this entry.
+        std::uint32_t postings_count;
+
+        std::uint64_t wasted () const {
+            return total_size - largest;
+        }
+    };
+
+    struct header {
+        char magic[8];
+        std::uint32_t version;
+        std::uint32_t byte_order;
+        std::uint64_t signature_count;
+        std::uint64_t posting_count;
+        std::uint64_t input_count;
+        std::uint64_t entries_offset;
+        std::uint64_t by_waste_offset;
+        std::uint64_t by_name_offset;
+        std::uint64_t postings_offset;
+        std::uint64_t inputs_offset;
+        std::uint64_t strings_offset;
+        std::uint64_t strings_size;
+        std::uint64_t total_size;
+        std::uint64_t total_waste;
+        std::uint8_t digest[16];
+    };
+
+    /// Returns the hash of a group signature. Entries in the index are sorted by this value.
+    std::uint64_t hash (char const * str, std::size_t length);
+    inline std::uint64_t hash (std::string const & str) {
+        return hash (str.data (), str.length ());
+    }
+
+    /// Writes the contents of a COMDAT table to an index file.
+    void write (boost::filesystem::path const & path, comdat_scanner::comdat_map const & cm,
+                std::vector<std::string> const & inputs, md5::digest const & digest);
+    void write (boost::filesystem::path const & path, comdat_scanner const & scanner);
+
+
+    // **********
+    // * reader *
+    // **********
+    class reader {
+    public:
+        explicit reader (boost::filesystem::path const & path);
+
+        // No copying or assignment.
+        reader (reader const &) = delete;
+        reader & operator= (reader const &) = delete;
+
+        header const & get_header () const {
+            return *header_;
+        }
+
+        using const_iterator = entry const *;
+        const_iterator begin () const {
+            return entries_;
+        }
+        const_iterator end () const {
+            return entries_ + header_->signature_count;
+        }
+        std::size_t size () const {
+            return static_cast<std::size_t> (header_->signature_count);
+        }
+
+        std::string name (entry const & e) const {
+            return this->str (e.name);
+        }
+        std::string demangled (entry const & e) const {
+            return this->str (e.demangled);
+        }
+        /// Returns the name of an entry without copying it out of the file.
+        std::pair<char const *, std::size_t> name_view (entry const & e) const {
+            return this->view (e.name);
+        }
+        std::string input (std::uint32_t index) const;
+        std::vector<std::string> inputs (entry const & e) const;
+
+        /// Returns the entry whose signature is 'signature' or nullptr if there is no such entry.
+        entry const * find (std::string const & signature) const;
+
+        /// Returns the (up to) 'n' entries with the greatest waste, the largest first.
+        std::vector<entry const *> top_by_waste (std::size_t n) const;
+
+        /// Returns the entries whose demangled signature starts with 'prefix' in name order.
+        std::vector<entry const *> prefix (std::string const & prefix, std::size_t limit) const;
+
+    private:
+        std::string str (string_ref const & ref) const {
+            auto const v = this->view (ref);
+            return {v.first, v.second};
+        }
+        std::pair<char const *, std::size_t> view (string_ref const & ref) const;
+        entry const * at (std::uint32_t index) const;
+        template <typename T>
+        T const * section (std::uint64_t offset, std::uint64_t count) const;
+
+        boost::iostreams::mapped_file_source file_;
+        header const * header_;
+        entry const * entries_;
+        std::uint32_t const * by_waste_;
+        std::uint32_t const * by_name_;
+        std::uint32_t const * postings_;
+        string_ref const * inputs_;
+        char const * strings_;
+    };
+
+} // namespace index_file
+
+#endif // SCANLIB_INDEX_FILE_HPP
+// eof index_file.hpp
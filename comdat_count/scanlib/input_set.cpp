@@ -0,0 +1,109 @@
+// Copyright (c) 2016 by SN Systems Ltd., Sony Interactive Entertainment Inc.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "input_set.hpp"
+
+// Standard library includes
+#include <cerrno>
+#include <cstdint>
+#include <sstream>
+#include <system_error>
+
+// 3rd party includes
+#include <boost/filesystem/operations.hpp>
+
+// OS includes
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/stat.h>
+#endif
+
+// file key [static]
+// ~~~~~~~~
+std::string input_set::file_key (boost::filesystem::path const & path) {
+#if defined(__unix__) || defined(__APPLE__)
+    struct stat st;
+    if (::stat (path.string ().c_str (), &st) != 0) {
+        std::ostringstream str;
+        str << "Could not stat " << path;
+        throw std::system_error (errno, std::generic_category (), str.str ());
+    }
+    std::uint64_t const id[2] = {static_cast<std::uint64_t> (st.st_dev),
+                                 static_cast<std::uint64_t> (st.st_ino)};
+    return std::string (reinterpret_cast<char const *> (id), sizeof (id));
+#else
+    // There's no inode number to be had so fall back to the canonical path. This won't spot
+    // hard links.
+    return boost::filesystem::canonical (path).string ();
+#endif
+}
+
+// insert
+// ~~~~~~
+bool input_set::insert (boost::filesystem::path const & path, std::string const & name) {
+    auto const inserted = files_.emplace (file_key (path), records_.size ());
+    if (!inserted.second) {
+        records_[inserted.first->second].aliases.push_back (name);
+        return false;
+    }
+    records_.push_back (record{name, {}});
+    names_.emplace (name, inserted.first->second);
+    return true;
+}
+
+// aliases
+// ~~~~~~~
+std::vector<std::string> const * input_set::aliases (std::string const & name) const {
+    auto const it = names_.find (name);
+    if (it == names_.end ()) {
+        return nullptr;
+    }
+    auto const & result = records_[it->second].aliases;
+    return result.empty () ? nullptr : &result;
+}
+
+// annotate
+// ~~~~~~~~
+std::vector<std::string> input_set::annotate (std::vector<std::string> const & names) const {
+    std::vector<std::string> result;
+    result.reserve (names.size ());
+    for (auto const & name : names) {
+        result.push_back (name);
+
+        // Look for the whole name and then for each of the containing archives.
+        std::vector<std::string> const * a = this->aliases (name);
+        for (auto pos = name.rfind (" ("); a == nullptr && pos != std::string::npos && pos > 0;
+             pos = name.rfind (" (", pos - 1)) {
+            a = this->aliases (name.substr (0, pos));
+        }
+        if (a != nullptr) {
+            std::string & n = result.back ();
+            char const * separator = " [also: ";
+            for (auto const & alias : *a) {
+                n += separator;
+                n += alias;
+                separator = ", ";
+            }
+            n += ']';
+        }
+    }
+    return result;
+}
+
+// eof scanlib/input_set.cpp
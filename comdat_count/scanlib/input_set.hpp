@@ -0,0 +1,67 @@
+// Copyright (c) 2016 by SN Systems Ltd., Sony Interactive Entertainment Inc.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef SCANLIB_INPUT_SET_HPP
+#define SCANLIB_INPUT_SET_HPP
+
+#include <cstddef>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <boost/filesystem/path.hpp>
+
+/// Records the physical files that have been queued for scanning. A file is identified by its
+/// device and inode so that an object reached by more than one route (for example, given on the
+/// command line and also referenced by a thin archive) is parsed only once. The other names by
+/// which the file was reached are remembered so that they can be reported.
+class input_set {
+public:
+    /// Records that the file at 'path' is to be scanned under the name 'name'.
+    /// \returns True if this is the first time that the file has been seen. False if it was
+    /// already recorded, in which case 'name' is remembered as an alias.
+    bool insert (boost::filesystem::path const & path, std::string const & name);
+
+    /// Returns the aliases of the file first recorded as 'name' or nullptr if it has none.
+    std::vector<std::string> const * aliases (std::string const & name) const;
+
+    /// Returns a copy of the input names reported by a scanner with any aliases appended to
+    /// each. A scanner names an archive member "archive (member)"; the aliases of the archive
+    /// are appended to the names of each of its members.
+    std::vector<std::string> annotate (std::vector<std::string> const & names) const;
+
+private:
+    struct record {
+        std::string name;
+        std::vector<std::string> aliases;
+    };
+
+    /// Returns a key which uniquely identifies the physical file at 'path'.
+    static std::string file_key (boost::filesystem::path const & path);
+
+    /// Maps a file key to an index in records_.
+    std::unordered_map<std::string, std::size_t> files_;
+    /// Maps the name under which a file was first recorded to an index in records_.
+    std::unordered_map<std::string, std::size_t> names_;
+    std::vector<record> records_;
+};
+
+#endif // SCANLIB_INPUT_SET_HPP
+// eof scanlib/input_set.hpp
@@ -21,6 +21,7 @@
 #include "options.hpp"
 
 #include <algorithm>
+#include <cstdint>
 #include <fstream>
 #include <iostream>
 #include <ostream>
@@ -31,6 +32,8 @@
 #include <boost/token_functions.hpp>
 #include <boost/tokenizer.hpp>
 
+#include "results.hpp"
+
 
 namespace {
 
@@ -51,6 +54,27 @@ namespace {
             throw std::runtime_error (str.str ());
         }
     }
+
+    void check_backend (std::string const & value) {
+        if (value != "native" && value != "libelf") {
+            std::ostringstream str;
+            str << "Unknown backend \"" << value << "\" (expected 'native' or 'libelf')";
+            throw std::runtime_error (str.str ());
+        }
+    }
+
+    void check_sample (double value) {
+        if (!(value > 0.0 && value <= 1.0)) {
+            std::ostringstream str;
+            str << "The sample fraction must be greater than 0 and at most 1 (got " << value << ')';
+            throw std::runtime_error (str.str ());
+        }
+    }
+
+    void check_format (std::string const & value) {
+        // Throws if the name isn't recognized.
+        (void) results::parse_format (value);
+    }
 }
 
 
@@ -65,11 +89,50 @@ boost::program_options::variables_map get_program_options (int argc, char * argv
         "quiet,q", po::bool_switch ()->default_value (false), "quiet output") (
         "threads,t",
         po::value<unsigned> ()->default_value (default_threads)->notifier (&check_threads),
-        "the number of threads to use") ("verbose,v", po::bool_switch ()->default_value (false),
-                                         "produce verbose output") (
+        "the number of threads to use") (
+        "backend", po::value<std::string> ()->default_value ("native")->notifier (&check_backend),
+        "the ELF reader to use: 'native' or 'libelf'") (
+        "io-threads", po::value<unsigned> ()->default_value (2U),
+        "the number of threads prefetching input files (0 to disable)") (
+        "prefetch-depth", po::value<unsigned> ()->default_value (64U),
+        "the number of files by which prefetching may run ahead of the scan") (
+        "unpack-threads", po::value<unsigned> ()->default_value (2U)->notifier (&check_threads),
+        "the number of threads decompressing zip members and tar files") (
+        "unpack-memory", po::value<unsigned> ()->default_value (512U),
+        "the memory (in MiB) which may be used for unpacked files waiting to be scanned") (
+        "pin-threads", po::bool_switch ()->default_value (false),
+        "pin the scanning threads to the CPUs of each NUMA node and gather results per node") (
+        "numa-nodes", po::value<unsigned> ()->default_value (0U),
+        "with --pin-threads, divide the CPUs into the given number of simulated nodes (0 uses "
+        "the host's topology)") (
+        "verbose,v", po::bool_switch ()->default_value (false), "produce verbose output") (
         "response-file", po::value<std::string> (), "can be specified with '@name', too") (
         "output,o", po::value<std::string> ()->composing ()->default_value ("-"),
-        "the file to which output will be written ('-' indicates stdout");
+        "the file to which output will be written ('-' indicates stdout") (
+        "format", po::value<std::string> ()->default_value ("text")->notifier (&check_format),
+        "the output format: 'text', 'json', 'csv' or 'binary'") (
+        "unfiltered", po::bool_switch ()->default_value (false),
+        "also write every group with more than one instance, before similar points are merged "
+        "(not with --format=text)") (
+        "sample", po::value<double> ()->notifier (&check_sample),
+        "scan only the given fraction of the input files and estimate the totals from them") (
+        "seed", po::value<std::uint64_t> ()->default_value (0U),
+        "the seed used to choose the files scanned by --sample") (
+        "checkpoint", po::value<std::string> (),
+        "periodically record the progress of the scan in the given file") (
+        "checkpoint-interval", po::value<unsigned> ()->default_value (300U),
+        "the number of seconds between checkpoints") (
+        "resume", po::bool_switch ()->default_value (false),
+        "continue the scan recorded by --checkpoint, skipping the inputs that it completed") (
+        "watch", po::bool_switch ()->default_value (false),
+        "keep running, rescanning files as they change and rewriting the output after each "
+        "batch of changes") (
+        "debounce", po::value<unsigned> ()->default_value (500U),
+        "with --watch, the number of milliseconds without a change which ends a batch") (
+        "index,i", po::value<std::string> (),
+        "write an index of the results to the given file (see 'query')") (
+        "diff", po::value<std::vector<std::string>> ()->multitoken (),
+        "compare two index files (old and new) written by --index");
 
     // Declare a group of options that will be
     // allowed both on command line and in
@@ -134,4 +197,47 @@ boost::program_options::variables_map get_program_options (int argc, char * argv
     return vm;
 }
 
+
+boost::program_options::variables_map get_query_options (int argc, char * argv[]) {
+    namespace po = boost::program_options;
+
+    po::options_description generic ("Query options");
+    generic.add_options () ("help", "produce help message") (
+        "top", po::value<std::size_t> (), "list the given number of signatures with most waste") (
+        "defines", po::value<std::string> (), "list the inputs which define the given signature") (
+        "prefix", po::value<std::string> (),
+        "list the signatures whose demangled name starts with the given string") (
+        "limit", po::value<std::size_t> ()->default_value (100),
+        "the maximum number of prefix matches to list (0 for no limit)") (
+        "output,o", po::value<std::string> ()->default_value ("-"),
+        "the file to which output will be written ('-' indicates stdout");
+
+    po::options_description hidden ("Hidden options");
+    hidden.add_options () ("index", po::value<std::string> (), "index file");
+
+    po::options_description cmdline_options;
+    cmdline_options.add (generic).add (hidden);
+
+    po::positional_options_description positional;
+    positional.add ("index", 1);
+
+    po::variables_map vm;
+    store (po::command_line_parser (argc, argv)
+               .options (cmdline_options)
+               .positional (positional)
+               .run (),
+           vm);
+
+    if (vm.count ("help")) {
+        std::cout << "Usage: " << argv[0] << " index-file [options]\n" << generic << "\n";
+        std::exit (EXIT_SUCCESS);
+    }
+    if (!vm.count ("index")) {
+        throw std::runtime_error ("An index file must be specified");
+    }
+
+    notify (vm);
+    return vm;
+}
+
 // eof options.cpp
@@ -25,5 +25,8 @@
 
 boost::program_options::variables_map get_program_options (int argc, char * argv[]);
 
+/// Parses the command line of the 'query' subcommand. argv[0] is the subcommand name.
+boost::program_options::variables_map get_query_options (int argc, char * argv[]);
+
 #endif // OPTIONS_H
 // eof options.h
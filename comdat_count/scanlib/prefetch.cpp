@@ -0,0 +1,157 @@
+// Copyright (c) 2016 by SN Systems Ltd., Sony Interactive Entertainment Inc.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "prefetch.hpp"
+
+// Standard library includes
+#include <cassert>
+#include <cstddef>
+#include <fstream>
+#include <utility>
+#include <vector>
+
+// OS includes
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// (ctor)
+// ~~~~~~
+prefetcher::prefetcher (queue_type const & queue, unsigned io_threads, std::size_t depth,
+                        fetch_function fetch)
+        : queue_ (queue)
+        , depth_ (depth)
+        , fetch_ (std::move (fetch))
+        , mut_ ()
+        , cv_ ()
+        , cursors_ (queue.workers ())
+        , fetched_ (0U)
+        , started_ (0U)
+        , stop_ (false)
+        , threads_ () {
+
+    unsigned const workers = queue.workers ();
+    for (std::size_t index = 0, size = queue.stored (); index < size; ++index) {
+        cursors_[queue_type::dealt_to (index, workers)].items.push_back (index);
+    }
+
+    threads_.reserve (io_threads);
+    while (io_threads-- > 0U) {
+        threads_.emplace_back (&prefetcher::worker, this);
+    }
+}
+
+// (dtor)
+// ~~~~~~
+prefetcher::~prefetcher () {
+    this->stop ();
+}
+
+// stop
+// ~~~~
+void prefetcher::stop () {
+    {
+        std::lock_guard<std::mutex> lock (mut_);
+        stop_ = true;
+    }
+    cv_.notify_all ();
+    for (auto & t : threads_) {
+        if (t.joinable ()) {
+            t.join ();
+        }
+    }
+}
+
+// started
+// ~~~~~~~
+void prefetcher::started (unsigned worker) {
+    {
+        std::lock_guard<std::mutex> lock (mut_);
+        assert (worker < cursors_.size ());
+        ++cursors_[worker].started;
+        ++started_;
+    }
+    cv_.notify_one ();
+}
+
+// choose
+// ~~~~~~
+auto prefetcher::choose () -> cursor * {
+    // Advance the cursor which is least far ahead of its consumer. Its lead may be negative if
+    // the consumer has been processing items stolen from the others.
+    cursor * result = nullptr;
+    auto lead = [](cursor const & c) {
+        return static_cast<std::ptrdiff_t> (c.next) - static_cast<std::ptrdiff_t> (c.started);
+    };
+    for (cursor & c : cursors_) {
+        if (c.next < c.items.size () && (result == nullptr || lead (c) < lead (*result))) {
+            result = &c;
+        }
+    }
+    return result;
+}
+
+// worker
+// ~~~~~~
+void prefetcher::worker () {
+    for (;;) {
+        std::size_t index;
+        {
+            std::unique_lock<std::mutex> lock (mut_);
+            cv_.wait (lock, [this]() { return stop_ || fetched_ < started_ + depth_; });
+            cursor * const c = stop_ ? nullptr : this->choose ();
+            if (c == nullptr) {
+                return;
+            }
+
+            index = c->items[c->next++];
+            ++fetched_;
+        }
+
+        try {
+            fetch_ (queue_.stored (index).real_path);
+        } catch (...) {
+            // Prefetching is purely advisory. Any problem with the file will be reported
+            // when the consumer gets to it.
+        }
+    }
+}
+
+// readahead [static]
+// ~~~~~~~~~
+void prefetcher::readahead (boost::filesystem::path const & path) {
+#if defined(POSIX_FADV_WILLNEED)
+    int const fd = ::open (path.c_str (), O_RDONLY);
+    if (fd != -1) {
+        // Start asynchronous readahead of the whole file.
+        ::posix_fadvise (fd, 0, 0, POSIX_FADV_WILLNEED);
+        ::close (fd);
+    }
+#else
+    // No readahead hint is available so simply read the file and throw the data away.
+    std::ifstream file (path.native (), std::ios::binary);
+    std::vector<char> buffer (65536);
+    while (file.read (buffer.data (), static_cast<std::streamsize> (buffer.size ()))) {
+    }
+#endif
+}
+
+// eof scanlib/prefetch.cpp
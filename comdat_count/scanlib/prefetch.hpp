@@ -0,0 +1,106 @@
+// Copyright (c) 2016 by SN Systems Ltd., Sony Interactive Entertainment Inc.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef SCANLIB_PREFETCH_HPP
+#define SCANLIB_PREFETCH_HPP
+
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <boost/filesystem/path.hpp>
+
+#include "consumer.hpp"
+
+/// An I/O stage which runs ahead of the consumer threads asking the operating system to read the
+/// input files into its cache. By the time that a consumer opens a file its contents should
+/// already be in memory so that the CPU-bound threads do not stall waiting for the disk (or the
+/// network).
+///
+/// The queue deals its items out to the consumers in batches so each consumer works through its
+/// own share of the files. The prefetcher keeps a cursor for each consumer that follows that
+/// share in order and always advances the one which is least far ahead, so the files fetched
+/// are those that the consumers will open next. (An item stolen by one consumer from another is
+/// still fetched in its original owner's order.) The prefetcher is kept no more than 'depth'
+/// files ahead of the consumers as a whole so that it does not evict data from the cache before
+/// it is used.
+class prefetcher {
+public:
+    using fetch_function = std::function<void(boost::filesystem::path const &)>;
+
+    /// \param queue  The queue whose items are to be prefetched. All of the initial work must
+    ///               have been queued by a single producer starting with worker 0.
+    /// \param io_threads  The number of I/O threads to use.
+    /// \param depth  The maximum number of files by which the prefetcher may lead the consumers.
+    /// \param fetch  The function used to prefetch a file.
+    prefetcher (queue_type const & queue, unsigned io_threads, std::size_t depth,
+                fetch_function fetch = &prefetcher::readahead);
+    ~prefetcher ();
+
+    // No copying or assignment.
+    prefetcher (prefetcher const &) = delete;
+    prefetcher & operator= (prefetcher const &) = delete;
+
+    /// Called by consumer number 'worker' as it starts to process each item. Each call allows
+    /// the prefetcher to move one file further ahead.
+    void started (unsigned worker);
+
+    /// Stops the I/O threads and waits for them to exit.
+    void stop ();
+
+    /// Asks the operating system to read the given file into its cache.
+    static void readahead (boost::filesystem::path const & path);
+
+private:
+    /// The items dealt to one consumer and the progress made through them.
+    struct cursor {
+        /// The indices of the queue items dealt to the consumer, in the order it takes them.
+        std::vector<std::size_t> items;
+        /// The number of these items that have been prefetched.
+        std::size_t next = 0U;
+        /// The number of items that the consumer has started to process.
+        std::size_t started = 0U;
+    };
+
+    void worker ();
+    /// Returns the cursor which should be advanced next or null if there is none. Must be called
+    /// with mut_ held.
+    cursor * choose ();
+
+    queue_type const & queue_;
+    std::size_t const depth_;
+    fetch_function const fetch_;
+
+    std::mutex mut_;
+    std::condition_variable cv_;
+    std::vector<cursor> cursors_;
+    /// The total number of items prefetched and the total that the consumers have started.
+    std::size_t fetched_;
+    std::size_t started_;
+    bool stop_;
+
+    std::vector<std::thread> threads_;
+};
+
+#endif // SCANLIB_PREFETCH_HPP
+// eof scanlib/prefetch.hpp
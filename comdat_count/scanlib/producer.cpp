@@ -20,24 +20,25 @@
 
 #include "producer.hpp"
 
+#include <fstream>
 #include <iostream>
-#include <list>
+#include <string>
+
+#include <boost/iostreams/device/mapped_file.hpp>
 
 #include "consumer.hpp"
+#include "elf_view.hpp"
 #include "flags.hpp"
+#include "input_set.hpp"
 #include "print.hpp"
+#include "tar_stream.hpp"
 #include "zipper.hpp"
 
-namespace {
-
-    std::mutex zip_members_lock;
-    std::list<queue_member> member_storage;
-}
-
+/// Adds a job to unpack each member of a zip file except for those in 'completed'.
 std::size_t push_zip_contents (unzFile uf, boost::filesystem::path const & zip_path,
-                               queue_type & queue) {
+                               std::vector<unpack_pipeline::job> & jobs,
+                               checkpoint::completed_set const * const completed) {
     std::size_t num_queued = 0;
-    std::lock_guard<std::mutex> guard (zip_members_lock);
     int err = UNZ_OK;
     for (err = unzGoToFirstFile (uf); err == UNZ_OK; err = unzGoToNextFile (uf)) {
 
@@ -51,11 +52,21 @@ std::size_t push_zip_contents (unzFile uf, boost::filesystem::path const & zip_p
         if (err != UNZ_OK) {
             zipper::throw_unzip_error (err, zip_path);
         }
-
         filename_inzip[buffer_elements - 1] = '\0';
-        member_storage.push_back (
-            {zip_path, std::string{filename_inzip}, zip_path / filename_inzip});
-        queue.push (&member_storage.back ());
+        if (completed != nullptr &&
+            completed->count ((zip_path / filename_inzip).string ()) > 0U) {
+            continue;
+        }
+
+        // Remember where the member's directory entry is so that a decompression thread can
+        // go straight to it.
+        unz64_file_pos pos;
+        err = unzGetFilePos64 (uf, &pos);
+        if (err != UNZ_OK) {
+            zipper::throw_unzip_error (err, zip_path);
+        }
+        jobs.push_back (unpack_pipeline::job::zip_member (
+            zip_path, std::string{filename_inzip}, pos, file_info.uncompressed_size));
         ++num_queued;
     }
     if (err != UNZ_END_OF_LIST_OF_FILE) {
@@ -66,16 +77,113 @@ std::size_t push_zip_contents (unzFile uf, boost::filesystem::path const & zip_p
 
 
 namespace {
-    std::size_t path_processor (queue_type & queue, boost::filesystem::path const & p) {
+    // is thin archive
+    // ~~~~~~~~~~~~~~~
+    bool is_thin_archive (boost::filesystem::path const & p) {
+        std::uint8_t magic[8];
+        std::ifstream file (p.string (), std::ios::binary);
+        return file.read (reinterpret_cast<char *> (magic), sizeof (magic)) &&
+               elf_view::archive::is_thin (elf_view::span{magic, sizeof (magic)});
+    }
+
+    // push file
+    // ~~~~~~~~~
+    /// Queues the physical file at 'p' unless it has already been queued or was completed by
+    /// an earlier run. 'name' is the name under which the file is reported.
+    std::size_t push_file (queue_type & queue, queue_type::producer & producer, input_set & inputs,
+                           boost::filesystem::path const & p, std::string const & name,
+                           checkpoint::completed_set const * const completed,
+                           output_flags const & ofl) {
+        if (!inputs.insert (p, name)) {
+            if (ofl.verbose) {
+                print_cout ("Already queued: ", name);
+            }
+            return 0;
+        }
+        // A completed file is still recorded in 'inputs' so that its aliases are reported.
+        if (completed != nullptr && completed->count (name) > 0U) {
+            if (ofl.verbose) {
+                print_cout ("Already scanned: ", name);
+            }
+            return 0;
+        }
+        producer.push (queue.store ({p, boost::filesystem::path (name)}));
+        return 1;
+    }
+
+    // push thin archive contents
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~
+    /// A thin archive holds only the paths of its members. Each member is queued as a separate
+    /// input (unless the same file has already been queued) so that it is scanned by the
+    /// ordinary path and named "archive (member)". Members which are themselves thin archives
+    /// are expanded in turn.
+    std::size_t push_thin_archive_contents (queue_type & queue, queue_type::producer & producer,
+                                            input_set & inputs, boost::filesystem::path const & p,
+                                            std::string const & name,
+                                            checkpoint::completed_set const * const completed,
+                                            output_flags const & ofl) {
+        // Recording the archive itself means that an archive given twice (or one which
+        // includes itself) is expanded only once.
+        if (!inputs.insert (p, name)) {
+            if (ofl.verbose) {
+                print_cout ("Already queued: ", name);
+            }
+            return 0;
+        }
+        boost::iostreams::mapped_file_source file (p.string ());
+        elf_view::archive const archive (elf_view::span{
+            reinterpret_cast<std::uint8_t const *> (file.data ()), file.size ()});
+
+        std::size_t num_queued = 0;
+        boost::filesystem::path const base = p.parent_path ();
+        archive.for_each ([&](elf_view::archive::member const & member) {
+            boost::filesystem::path member_path (
+                std::string (member.name.first, member.name.second));
+            if (member_path.is_relative ()) {
+                member_path = base / member_path;
+            }
+            std::string member_name = name;
+            member_name += " (";
+            member_name.append (member.name.first, member.name.second);
+            member_name += ')';
+
+            if (is_thin_archive (member_path)) {
+                num_queued += push_thin_archive_contents (queue, producer, inputs, member_path,
+                                                          member_name, completed, ofl);
+            } else {
+                num_queued += push_file (queue, producer, inputs, member_path, member_name,
+                                         completed, ofl);
+            }
+        });
+        return num_queued;
+    }
+
+    std::size_t path_processor (queue_type & queue, queue_type::producer & producer,
+                                input_set & inputs, std::vector<unpack_pipeline::job> & jobs,
+                                boost::filesystem::path const & p,
+                                checkpoint::completed_set const * const completed,
+                                output_flags const & ofl) {
         std::size_t num_queued = 0;
         zipper::zip_ptr uf = zipper::open (p, std::nothrow);
         if (uf) {
-            num_queued += push_zip_contents (uf.get (), p, queue);
+            if (inputs.insert (p, p.string ())) {
+                num_queued += push_zip_contents (uf.get (), p, jobs, completed);
+            } else if (ofl.verbose) {
+                print_cout ("Already queued: ", p);
+            }
+        } else if (is_thin_archive (p)) {
+            num_queued +=
+                push_thin_archive_contents (queue, producer, inputs, p, p.string (), completed, ofl);
+        } else if (tar::is_tar (p)) {
+            // The number of entries in a tar file isn't known until it is read so it doesn't
+            // contribute to the count of files queued.
+            if (inputs.insert (p, p.string ())) {
+                jobs.push_back (unpack_pipeline::job::tar (p));
+            } else if (ofl.verbose) {
+                print_cout ("Already queued: ", p);
+            }
         } else {
-            std::lock_guard<std::mutex> guard (zip_members_lock);
-            member_storage.push_back ({p, std::string (), p});
-            queue.push (&member_storage.back ());
-            ++num_queued;
+            num_queued += push_file (queue, producer, inputs, p, p.string (), completed, ofl);
         }
         return num_queued;
     }
@@ -89,15 +197,13 @@ namespace {
 }
 
 
-std::size_t queue_input_files (queue_type & queue, std::vector<std::string> const & file_paths,
-                               output_flags const & ofl) {
-
-    std::size_t num_queued = 0;
-
-    // Push the input files into the queue.
+// for each input file
+// ~~~~~~~~~~~~~~~~~~~
+void for_each_input_file (std::vector<std::string> const & file_paths, output_flags const & ofl,
+                          std::function<void (boost::filesystem::path const &)> const & fn) {
     for (boost::filesystem::path const & path : file_paths) {
         if (!boost::filesystem::is_directory (path)) {
-            num_queued += path_processor (queue, path);
+            fn (path);
         } else {
             if (ofl.verbose) {
                 print_cout ("Scanning: ", path);
@@ -119,12 +225,30 @@ std::size_t queue_input_files (queue_type & queue, std::vector<std::string> cons
                     }
                 } else {
                     if (!is_hidden) {
-                        num_queued += path_processor (queue, p);
+                        fn (p);
                     }
                 }
             }
         }
     }
+}
+
+// queue input files
+// ~~~~~~~~~~~~~~~~~
+std::size_t queue_input_files (queue_type & queue, std::vector<std::string> const & file_paths,
+                               input_set & inputs, std::vector<unpack_pipeline::job> & jobs,
+                               output_flags const & ofl,
+                               checkpoint::completed_set const * const completed) {
+
+    std::size_t num_queued = 0;
+    queue_type::producer producer (queue);
+
+    // Push the input files into the queue.
+    for_each_input_file (file_paths, ofl, [&](boost::filesystem::path const & p) {
+        num_queued += path_processor (queue, producer, inputs, jobs, p, completed, ofl);
+    });
+    producer.flush ();
+    queue.close ();
     return num_queued;
 }
 // eof scanlib/producer.cpp
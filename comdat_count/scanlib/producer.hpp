@@ -21,14 +21,32 @@
 #ifndef SCANLIB_PRODUCER_HPP
 #define SCANLIB_PRODUCER_HPP
 
+#include "checkpoint.hpp"
 #include "consumer.hpp"
+#include "unpack_pipeline.hpp"
+#include <functional>
 #include <string>
 #include <vector>
 
+class input_set;
 struct output_flags;
-/// \returns The number of files queued.
+/// Calls 'fn' for each of the input files: each of 'file_paths' which is not a directory and the
+/// files found by recursively searching those which are. Hidden files and directories are
+/// skipped.
+void for_each_input_file (std::vector<std::string> const & file_paths, output_flags const & ofl,
+                          std::function<void (boost::filesystem::path const &)> const & fn);
+
+/// Pushes the input files onto the queue and then closes it. The members of thin archives are
+/// queued individually. Tar files and the members of zip files are not queued but are added to
+/// 'jobs' for the unpack pipeline. A file is queued only once however many times it is reached:
+/// 'inputs' records the files that were queued and the other names by which they were found.
+/// Files and zip members named in 'completed' (if it is not null) were scanned by an earlier
+/// run and are not queued.
+/// \returns The number of files queued (including zip members).
 std::size_t queue_input_files (queue_type & queue, std::vector<std::string> const & file_paths,
-                               output_flags const & ofl);
+                               input_set & inputs, std::vector<unpack_pipeline::job> & jobs,
+                               output_flags const & ofl,
+                               checkpoint::completed_set const * const completed = nullptr);
 
 #endif // SCANLIB_PRODUCER_HPP
 // eof scanlib/producer.hpp
@@ -0,0 +1,103 @@
+// Copyright (c) 2016 by SN Systems Ltd., Sony Interactive Entertainment Inc.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "query.hpp"
+
+// Standard Library
+#include <algorithm>
+#include <ostream>
+#include <vector>
+
+namespace {
+
+    void write_entry (index_file::reader const & index, index_file::entry const & e,
+                      std::ostream & os) {
+        os << e.wasted () << ' ' << e.largest << ' ' << e.instances << ' ' << index.demangled (e)
+           << '\n';
+    }
+
+    void write_entries (index_file::reader const & index,
+                        std::vector<index_file::entry const *> const & entries, std::ostream & os) {
+        os << "Wasted Size Instances Signature\n";
+        for (auto const * e : entries) {
+            write_entry (index, *e, os);
+        }
+    }
+
+} // end anonymous namespace
+
+namespace query {
+
+    // summary
+    // ~~~~~~~
+    void summary (index_file::reader const & index, std::ostream & os) {
+        index_file::header const & h = index.get_header ();
+        md5::digest digest;
+        std::copy (std::begin (h.digest), std::end (h.digest), std::begin (digest));
+
+        os << "# MD5: " << md5::context::digest_hex (digest) << '\n';
+        os << "# Signatures: " << h.signature_count << '\n';
+        os << "# Inputs: " << h.input_count << '\n';
+        os << "#> Total:" << h.total_size << '\n' << "#> Wasted:" << h.total_waste << '\n';
+    }
+
+    // top
+    // ~~~
+    void top (index_file::reader const & index, std::size_t n, std::ostream & os) {
+        write_entries (index, index.top_by_waste (n), os);
+    }
+
+    // defines
+    // ~~~~~~~
+    bool defines (index_file::reader const & index, std::string const & signature,
+                  std::ostream & os) {
+        std::vector<index_file::entry const *> entries;
+        if (index_file::entry const * const e = index.find (signature)) {
+            entries.push_back (e);
+        } else {
+            // Not a mangled name: look for an exact match amongst the demangled names.
+            for (auto const * e : index.prefix (signature, 0)) {
+                if (index.demangled (*e) == signature) {
+                    entries.push_back (e);
+                }
+            }
+        }
+
+        for (auto const * e : entries) {
+            os << index.name (*e) << '\n';
+            os << "#> Size:" << e->largest << " Instances:" << e->instances
+               << " Wasted:" << e->wasted () << '\n';
+            for (auto const & input : index.inputs (*e)) {
+                os << input << '\n';
+            }
+        }
+        return !entries.empty ();
+    }
+
+    // prefix
+    // ~~~~~~
+    void prefix (index_file::reader const & index, std::string const & prefix, std::size_t limit,
+                 std::ostream & os) {
+        write_entries (index, index.prefix (prefix, limit), os);
+    }
+
+} // namespace query
+
+// eof query.cpp
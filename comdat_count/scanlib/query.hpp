@@ -0,0 +1,52 @@
+// Copyright (c) 2016 by SN Systems Ltd., Sony Interactive Entertainment Inc.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef SCANLIB_QUERY_HPP
+#define SCANLIB_QUERY_HPP
+
+#include <cstddef>
+#include <iosfwd>
+#include <string>
+
+#include "index_file.hpp"
+
+/// Answers questions about the contents of an index file written by a previous scan.
+namespace query {
+
+    /// Writes the (up to) 'n' signatures responsible for the greatest waste.
+    void top (index_file::reader const & index, std::size_t n, std::ostream & os);
+
+    /// Writes the inputs containing an instance of 'signature'. The signature may be given either
+    /// in its mangled or demangled form. Returns false if the signature was not found.
+    bool defines (index_file::reader const & index, std::string const & signature,
+                  std::ostream & os);
+
+    /// Writes the signatures whose demangled name starts with 'prefix'. A limit of 0 means that
+    /// all matching signatures are written.
+    void prefix (index_file::reader const & index, std::string const & prefix, std::size_t limit,
+                 std::ostream & os);
+
+    /// Writes a summary of the index.
+    void summary (index_file::reader const & index, std::ostream & os);
+
+} // namespace query
+
+#endif // SCANLIB_QUERY_HPP
+// eof query.hpp
@@ -0,0 +1,225 @@
+// Copyright (c) 2016 by SN Systems Ltd., Sony Interactive Entertainment Inc.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "results.hpp"
+
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <ostream>
+
+#include "buffered_writer.hpp"
+
+namespace {
+
+    std::uint64_t round (double v) {
+        return v <= 0.0 ? 0U : static_cast<std::uint64_t> (std::llround (v));
+    }
+
+    // write text
+    // ~~~~~~~~~~
+    void write_text (comdat_scanner::report const & r, sampling::estimate const * sample,
+                     buffered_writer & w) {
+        w.write ("# MD5: ").write (md5::context::digest_hex (r.digest)).put ('\n');
+        w.write ("# Filtered ").write_uint (r.comdats - r.multiple);
+        w.write (" COMDATs with 1 instance\n");
+        w.write ("# Then trimmed ").write_uint (r.multiple - r.points.size ());
+        w.write (" similar points\n");
+        w.write ("# Result has ").write_uint (r.points.size ()).write (" points\n");
+        w.write ("#> Total:").write_uint (r.totals.actual).put ('\n');
+        w.write ("#> Wasted:").write_uint (r.totals.waste).put ('\n');
+        if (sample != nullptr) {
+            w.write ("# Sampled ").write_uint (sample->sampled).write (" of ");
+            w.write_uint (sample->population).write (" input files\n");
+            w.write ("#> Estimated total:").write_uint (round (sample->total.value)).put ('\n');
+            w.write ("#> Estimated total CI95:").write_uint (round (sample->total.half_width));
+            w.put ('\n');
+            w.write ("#> Estimated wasted:").write_uint (round (sample->wasted.value)).put ('\n');
+            w.write ("#> Estimated wasted CI95:").write_uint (round (sample->wasted.half_width));
+            w.put ('\n');
+        }
+
+        w.write ("Size Instances Total\n");
+        for (auto const & v : r.points) {
+            assert (v.instances > 1);
+            w.write_uint (v.largest).put (' ').write_uint (v.instances).put (' ');
+            w.write_uint (v.wasted).put ('\n');
+        }
+    }
+
+
+    // write json points
+    // ~~~~~~~~~~~~~~~~~
+    void write_json_points (char const * name, comdat_scanner::output_vector const & points,
+                            buffered_writer & w) {
+        w.write (",\n  \"").write (name).write ("\": [");
+        char const * separator = "\n    ";
+        for (auto const & v : points) {
+            w.write (separator).put ('[').write_uint (v.largest).put (',');
+            w.write_uint (v.instances).put (',').write_uint (v.wasted).put (']');
+            separator = ",\n    ";
+        }
+        w.write (points.empty () ? "]" : "\n  ]");
+    }
+
+    // write json
+    // ~~~~~~~~~~
+    void write_json (comdat_scanner::report const & r, sampling::estimate const * sample,
+                     buffered_writer & w) {
+        w.write ("{\n  \"md5\": \"").write (md5::context::digest_hex (r.digest)).put ('"');
+        w.write (",\n  \"comdats\": ").write_uint (r.comdats);
+        w.write (",\n  \"filtered\": ").write_uint (r.comdats - r.multiple);
+        w.write (",\n  \"trimmed\": ").write_uint (r.multiple - r.points.size ());
+        w.write (",\n  \"total\": ").write_uint (r.totals.actual);
+        w.write (",\n  \"wasted\": ").write_uint (r.totals.waste);
+        if (sample != nullptr) {
+            w.write (",\n  \"sample\": {\"sampled\": ").write_uint (sample->sampled);
+            w.write (", \"population\": ").write_uint (sample->population);
+            w.write (", \"total\": ").write_uint (round (sample->total.value));
+            w.write (", \"total_ci95\": ").write_uint (round (sample->total.half_width));
+            w.write (", \"wasted\": ").write_uint (round (sample->wasted.value));
+            w.write (", \"wasted_ci95\": ").write_uint (round (sample->wasted.half_width));
+            w.put ('}');
+        }
+        write_json_points ("points", r.points, w);
+        if (r.has_unfiltered) {
+            write_json_points ("unfiltered", r.unfiltered, w);
+        }
+        w.write ("\n}\n");
+    }
+
+
+    // write csv points
+    // ~~~~~~~~~~~~~~~~
+    void write_csv_points (comdat_scanner::output_vector const & points, buffered_writer & w) {
+        w.write ("\nsize,instances,wasted\n");
+        for (auto const & v : points) {
+            w.write_uint (v.largest).put (',').write_uint (v.instances).put (',');
+            w.write_uint (v.wasted).put ('\n');
+        }
+    }
+
+    // write csv
+    // ~~~~~~~~~
+    void write_csv (comdat_scanner::report const & r, sampling::estimate const * sample,
+                    buffered_writer & w) {
+        w.write ("md5,comdats,filtered,trimmed,total,wasted\n");
+        w.write (md5::context::digest_hex (r.digest)).put (',').write_uint (r.comdats).put (',');
+        w.write_uint (r.comdats - r.multiple).put (',');
+        w.write_uint (r.multiple - r.points.size ()).put (',');
+        w.write_uint (r.totals.actual).put (',').write_uint (r.totals.waste).put ('\n');
+        if (sample != nullptr) {
+            w.write ("\nsampled,population,total,total_ci95,wasted,wasted_ci95\n");
+            w.write_uint (sample->sampled).put (',').write_uint (sample->population).put (',');
+            w.write_uint (round (sample->total.value)).put (',');
+            w.write_uint (round (sample->total.half_width)).put (',');
+            w.write_uint (round (sample->wasted.value)).put (',');
+            w.write_uint (round (sample->wasted.half_width)).put ('\n');
+        }
+        write_csv_points (r.points, w);
+        if (r.has_unfiltered) {
+            write_csv_points (r.unfiltered, w);
+        }
+    }
+
+
+    // write binary points
+    // ~~~~~~~~~~~~~~~~~~~
+    void write_binary_points (comdat_scanner::output_vector const & points,
+                              buffered_writer & w) {
+        for (auto const & v : points) {
+            results::point const p{v.largest, v.wasted, v.instances, 0U};
+            w.write (reinterpret_cast<char const *> (&p), sizeof (p));
+        }
+    }
+
+    // write binary
+    // ~~~~~~~~~~~~
+    void write_binary (comdat_scanner::report const & r, sampling::estimate const * sample,
+                       buffered_writer & w) {
+        results::header h;
+        std::memset (&h, 0, sizeof (h));
+        std::memcpy (h.magic, results::binary_magic, sizeof (h.magic));
+        h.version = results::binary_version;
+        h.byte_order = results::byte_order_marker;
+        h.comdats = r.comdats;
+        h.filtered = r.comdats - r.multiple;
+        h.trimmed = r.multiple - r.points.size ();
+        h.total_size = r.totals.actual;
+        h.total_waste = r.totals.waste;
+        h.point_count = r.points.size ();
+        h.unfiltered_count = r.unfiltered.size ();
+        static_assert (sizeof (h.digest) == sizeof (md5::digest), "digest size mismatch");
+        std::memcpy (h.digest, r.digest.data (), sizeof (h.digest));
+        if (sample != nullptr) {
+            h.sampled = sample->sampled;
+            h.population = sample->population;
+            h.total_estimate = round (sample->total.value);
+            h.total_ci95 = round (sample->total.half_width);
+            h.waste_estimate = round (sample->wasted.value);
+            h.waste_ci95 = round (sample->wasted.half_width);
+        }
+
+        w.write (reinterpret_cast<char const *> (&h), sizeof (h));
+        write_binary_points (r.points, w);
+        write_binary_points (r.unfiltered, w);
+    }
+
+} // end anonymous namespace
+
+
+namespace results {
+
+    char const binary_magic[8] = {'C', 'M', 'D', 'T', 'R', 'E', 'S', '\0'};
+
+    // parse format
+    // ~~~~~~~~~~~~
+    format parse_format (std::string const & name) {
+        if (name == "text") {
+            return format::text;
+        }
+        if (name == "json") {
+            return format::json;
+        }
+        if (name == "csv") {
+            return format::csv;
+        }
+        if (name == "binary") {
+            return format::binary;
+        }
+        throw exception ("Unknown output format \"" + name +
+                         "\" (expected 'text', 'json', 'csv' or 'binary')");
+    }
+
+    // write
+    // ~~~~~
+    void write (comdat_scanner::report const & r, format f, std::ostream & os,
+                sampling::estimate const * sample) {
+        buffered_writer w (os);
+        switch (f) {
+        case format::text: write_text (r, sample, w); break;
+        case format::json: write_json (r, sample, w); break;
+        case format::csv: write_csv (r, sample, w); break;
+        case format::binary: write_binary (r, sample, w); break;
+        }
+    }
+
+} // namespace results
+// eof scanlib/results.cpp
@@ -0,0 +1,111 @@
+// Copyright (c) 2016 by SN Systems Ltd., Sony Interactive Entertainment Inc.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef SCANLIB_RESULTS_HPP
+#define SCANLIB_RESULTS_HPP
+
+#include <cstdint>
+#include <iosfwd>
+#include <stdexcept>
+#include <string>
+
+#include "comdat_scanner.hpp"
+#include "sampling.hpp"
+
+/// Writers for the results of a scan (a comdat_scanner::report). As well as the original text
+/// table, the results can be written in formats intended to be read by other tools:
+///
+/// json    A single object:
+///             { "md5": "<hex>", "comdats": N, "filtered": N, "trimmed": N, "total": N,
+///               "wasted": N, "points": [[size, instances, wasted], ...],
+///               "unfiltered": [[size, instances, wasted], ...] }
+///         "filtered" is the number of groups with a single instance and "trimmed" the number of
+///         similar points that were merged. "unfiltered" is present only if the report includes
+///         the unfiltered points. If only a sample of the inputs was scanned, the object also
+///         has a "sample" member:
+///             { "sampled": N, "population": N, "total": N, "total_ci95": N, "wasted": N,
+///               "wasted_ci95": N }
+///
+/// csv     A summary table followed by the points table. If the report includes the unfiltered
+///         points, they follow as a third table. A sample's estimates are in a table following
+///         the summary with the same columns as the json "sample" member. Tables are separated
+///         by an empty line:
+///             md5,comdats,filtered,trimmed,total,wasted
+///             <hex>,N,N,N,N,N
+///
+///             size,instances,wasted
+///             ...
+///
+/// binary  A header followed by header::point_count points then header::unfiltered_count
+///         points. Values are stored in host byte order; the header records the byte order.
+namespace results {
+
+    class exception : public std::runtime_error {
+    public:
+        using std::runtime_error::runtime_error;
+    };
+
+    enum class format { text, json, csv, binary };
+
+    /// Returns the format with the given name ("text", "json", "csv" or "binary").
+    format parse_format (std::string const & name);
+
+    /// Writes 'r' to 'os' in format 'f'. If the scan was of a sample of the inputs, 'sample' is
+    /// the estimate of the totals for the whole set of inputs.
+    void write (comdat_scanner::report const & r, format f, std::ostream & os,
+                sampling::estimate const * sample = nullptr);
+
+    // The layout of the binary format.
+    struct header {
+        char magic[8];
+        std::uint32_t version;
+        std::uint32_t byte_order;
+        std::uint64_t comdats;
+        std::uint64_t filtered;
+        std::uint64_t trimmed;
+        std::uint64_t total_size;
+        std::uint64_t total_waste;
+        std::uint64_t point_count;
+        std::uint64_t unfiltered_count;
+        std::uint8_t digest[16];
+        /// The estimates from a sample (see sampling.hpp). If the scan wasn't of a sample, these
+        /// are all zero.
+        std::uint64_t sampled;
+        std::uint64_t population;
+        std::uint64_t total_estimate;
+        std::uint64_t total_ci95;
+        std::uint64_t waste_estimate;
+        std::uint64_t waste_ci95;
+    };
+    struct point {
+        std::uint64_t largest;
+        std::uint64_t wasted;
+        std::uint32_t instances;
+        std::uint32_t padding;
+    };
+
+    extern char const binary_magic[8];
+    constexpr std::uint32_t binary_version = 1;
+    constexpr std::uint32_t byte_order_marker = 0x01020304;
+
+} // namespace results
+
+#endif // SCANLIB_RESULTS_HPP
+// eof scanlib/results.hpp
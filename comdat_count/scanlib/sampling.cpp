@@ -0,0 +1,299 @@
+// Copyright (c) 2016 by SN Systems Ltd., Sony Interactive Entertainment Inc.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "sampling.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <tuple>
+#include <utility>
+
+#include <boost/filesystem/operations.hpp>
+
+namespace {
+    /// The z-score for a 95% confidence interval.
+    constexpr double z95 = 1.96;
+
+    /// The number of bootstrap replicates used to estimate the error of the waste.
+    constexpr unsigned bootstrap_replicates = 200;
+
+    /// Returns a hash of 'str' mixed with 'seed'. Used to order the files within a stratum: the
+    /// value must not depend on the platform or standard library so that a sample can be
+    /// repeated anywhere.
+    std::uint64_t key (std::string const & str, std::uint64_t seed) {
+        // FNV-1a followed by the splitmix64 finalizer.
+        std::uint64_t h = 14695981039346656037ULL ^ seed;
+        for (char c : str) {
+            h ^= static_cast<unsigned char> (c);
+            h *= 1099511628211ULL;
+        }
+        h ^= h >> 30;
+        h *= 0xBF58476D1CE4E5B9ULL;
+        h ^= h >> 27;
+        h *= 0x94D049BB133111EBULL;
+        h ^= h >> 31;
+        return h;
+    }
+
+    /// The inputs containing one group which were found in the sample. The group's bytes are
+    /// shared equally between all of the inputs containing it.
+    struct group_share {
+        /// The group's total size and the size of its largest instance.
+        std::uint64_t total_size;
+        std::uint64_t largest;
+        /// The number of inputs containing the group.
+        std::uint32_t inputs;
+        /// The sampled files containing the group and the number of its inputs from each.
+        std::vector<std::pair<std::uint32_t, std::uint32_t>> files;
+    };
+
+    /// Makes the group_share for the group 'v' whose sampled inputs came from 'files' (the
+    /// index of the sampled file for each input). 'files' is sorted.
+    group_share make_group (comdat_scanner::value const & v, std::vector<std::uint32_t> & files) {
+        std::sort (files.begin (), files.end ());
+        group_share result{v.total_size, v.largest, static_cast<std::uint32_t> (v.inputs.size ()),
+                           {}};
+        for (auto first = files.begin (), end = files.end (); first != end;) {
+            auto const last = std::upper_bound (first, end, *first);
+            result.files.emplace_back (*first, static_cast<std::uint32_t> (last - first));
+            first = last;
+        }
+        return result;
+    }
+
+    /// Returns the waste estimated from 'groups' when each sampled file represents 'weights[f]'
+    /// files of the population.
+    double estimated_waste (std::vector<group_share> const & groups,
+                            std::vector<double> const & weights) {
+        double result = 0.0;
+        for (group_share const & g : groups) {
+            double inputs = 0.0;
+            for (auto const & f : g.files) {
+                inputs += weights[f.first] * f.second;
+            }
+            // Multiplying before dividing means that, when every weight is 1, the total is
+            // exactly that of the group and the waste matches that of a full scan.
+            double const total = inputs * static_cast<double> (g.total_size) / g.inputs;
+            result += std::max (0.0, total - static_cast<double> (g.largest));
+        }
+        return result;
+    }
+
+    /// Accumulates the values belonging to one stratum of the sample.
+    struct accumulator {
+        std::vector<double> values;
+
+        /// Adds this stratum's contribution to the estimated total and its variance.
+        void add_to (std::size_t population, sampling::interval & result) const {
+            auto const n = static_cast<double> (values.size ());
+            if (n == 0.0) {
+                return;
+            }
+            auto const big_n = static_cast<double> (population);
+            double sum = 0.0;
+            for (double v : values) {
+                sum += v;
+            }
+            double const mean = sum / n;
+            result.value += big_n * mean;
+            if (n > 1.0) {
+                double ss = 0.0;
+                for (double v : values) {
+                    ss += (v - mean) * (v - mean);
+                }
+                double const variance = ss / (n - 1.0);
+                // Accumulate the variance in half_width; the caller converts it.
+                result.half_width += big_n * big_n * (1.0 - n / big_n) * variance / n;
+            }
+        }
+    };
+}
+
+namespace sampling {
+
+    // stratum
+    // ~~~~~~~
+    unsigned stratum (std::uint64_t size) {
+        unsigned result = 0;
+        while (size != 0U) {
+            ++result;
+            size >>= 1;
+        }
+        return result;
+    }
+
+
+    // (ctor)
+    // ~~~~~~
+    sample::sample (std::vector<boost::filesystem::path> const & files, double fraction,
+                    std::uint64_t seed)
+            : population_ (files.size ())
+            , seed_ (seed) {
+
+        // Find the stratum of each file and its position within the stratum.
+        using candidate = std::tuple<unsigned, std::uint64_t, std::string>;
+        std::vector<candidate> candidates;
+        candidates.reserve (files.size ());
+        for (auto const & f : files) {
+            boost::system::error_code ec;
+            std::uint64_t const size = boost::filesystem::file_size (f, ec);
+            std::string name = f.string ();
+            std::uint64_t const k = key (name, seed);
+            candidates.emplace_back (stratum (ec ? 0U : size), k, std::move (name));
+        }
+        std::sort (candidates.begin (), candidates.end ());
+
+        for (auto first = candidates.begin (), end = candidates.end (); first != end;) {
+            unsigned const s = std::get<0> (*first);
+            auto const last = std::find_if (first, end, [s](candidate const & c) {
+                return std::get<0> (c) != s;
+            });
+            auto const size = static_cast<std::size_t> (last - first);
+            if (strata_.size () <= s) {
+                strata_.resize (s + 1U, 0U);
+            }
+            strata_[s] = size;
+
+            auto const wanted = static_cast<std::size_t> (std::ceil (fraction * size));
+            auto const chosen = std::min (size, std::max (wanted, std::size_t{2}));
+            for (auto it = first; it != first + static_cast<std::ptrdiff_t> (chosen); ++it) {
+                index_[std::get<2> (*it)] = files_.size ();
+                files_.push_back (std::move (std::get<2> (*it)));
+                file_strata_.push_back (s);
+            }
+            first = last;
+        }
+    }
+
+    // file index
+    // ~~~~~~~~~~
+    std::ptrdiff_t sample::file_index (std::string const & name) const {
+        // Try the whole name then successively shorter prefixes which end before an archive or
+        // zip member name.
+        std::string prefix = name;
+        for (;;) {
+            auto const it = index_.find (prefix);
+            if (it != index_.end ()) {
+                return static_cast<std::ptrdiff_t> (it->second);
+            }
+            auto const pos = prefix.find_last_of ("(/\\");
+            if (pos == std::string::npos || pos == 0U) {
+                return -1;
+            }
+            prefix.resize (prefix[pos] == '(' && prefix[pos - 1U] == ' ' ? pos - 1U : pos);
+        }
+    }
+
+    // extrapolate
+    // ~~~~~~~~~~~
+    estimate sample::extrapolate (comdat_scanner::comdat_map const & cm,
+                                  std::vector<std::string> const & inputs) const {
+        std::vector<std::ptrdiff_t> input_files;
+        input_files.reserve (inputs.size ());
+        for (auto const & in : inputs) {
+            input_files.push_back (this->file_index (in));
+        }
+
+        // Share each group's bytes equally between the inputs that contain it, then credit the
+        // input's share to the file from which the input came. Files which contributed nothing
+        // are still part of the sample, with a value of zero. For the waste, record the number
+        // of each group's inputs found in each sampled file.
+        std::vector<double> totals (files_.size (), 0.0);
+        std::vector<group_share> groups;
+        groups.reserve (cm.size ());
+        std::vector<std::uint32_t> group_files;
+        for (auto const & kvp : cm) {
+            comdat_scanner::value const & v = kvp.second;
+            if (v.inputs.empty ()) {
+                continue;
+            }
+            auto const n = static_cast<double> (v.inputs.size ());
+            double const total_share = static_cast<double> (v.total_size) / n;
+            group_files.clear ();
+            for (std::uint32_t in : v.inputs) {
+                std::ptrdiff_t const f = in < input_files.size () ? input_files[in] : -1;
+                if (f >= 0) {
+                    totals[static_cast<std::size_t> (f)] += total_share;
+                    group_files.push_back (static_cast<std::uint32_t> (f));
+                }
+            }
+            if (!group_files.empty ()) {
+                groups.push_back (make_group (v, group_files));
+            }
+        }
+
+        std::vector<accumulator> total_acc (strata_.size ());
+        std::vector<std::vector<std::uint32_t>> members (strata_.size ());
+        for (std::size_t f = 0; f < files_.size (); ++f) {
+            total_acc[file_strata_[f]].values.push_back (totals[f]);
+            members[file_strata_[f]].push_back (static_cast<std::uint32_t> (f));
+        }
+
+        estimate result{files_.size (), population_, {0.0, 0.0}, {0.0, 0.0}};
+        for (std::size_t s = 0; s < strata_.size (); ++s) {
+            total_acc[s].add_to (strata_[s], result.total);
+        }
+        result.total.half_width = z95 * std::sqrt (result.total.half_width);
+
+        // The number of files in the population represented by each sampled file.
+        std::vector<double> weights (files_.size (), 0.0);
+        for (std::size_t f = 0; f < files_.size (); ++f) {
+            unsigned const s = file_strata_[f];
+            weights[f] =
+                static_cast<double> (strata_[s]) / static_cast<double> (members[s].size ());
+        }
+        result.wasted.value = estimated_waste (groups, weights);
+
+        // The bootstrap. A stratum which was sampled in its entirety contributes no error so its
+        // files keep their weights.
+        std::mt19937_64 rng (seed_);
+        std::vector<double> replicate (files_.size ());
+        double sum = 0.0;
+        double sum_squares = 0.0;
+        for (unsigned b = 0; b < bootstrap_replicates; ++b) {
+            std::fill (replicate.begin (), replicate.end (), 0.0);
+            for (std::size_t s = 0; s < strata_.size (); ++s) {
+                std::vector<std::uint32_t> const & m = members[s];
+                if (m.size () == strata_[s]) {
+                    for (std::uint32_t f : m) {
+                        replicate[f] = weights[f];
+                    }
+                    continue;
+                }
+                for (std::size_t ctr = 0; ctr < m.size (); ++ctr) {
+                    std::uint32_t const f = m[static_cast<std::size_t> (rng () % m.size ())];
+                    replicate[f] += weights[f];
+                }
+            }
+            double const w = estimated_waste (groups, replicate);
+            sum += w;
+            sum_squares += w * w;
+        }
+        double const mean = sum / bootstrap_replicates;
+        double const variance =
+            std::max (0.0, (sum_squares - bootstrap_replicates * mean * mean) /
+                               (bootstrap_replicates - 1U));
+        result.wasted.half_width = z95 * std::sqrt (variance);
+        return result;
+    }
+
+} // namespace sampling
+// eof scanlib/sampling.cpp
@@ -0,0 +1,115 @@
+// Copyright (c) 2016 by SN Systems Ltd., Sony Interactive Entertainment Inc.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef SCANLIB_SAMPLING_HPP
+#define SCANLIB_SAMPLING_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <boost/filesystem/path.hpp>
+
+#include "comdat_scanner.hpp"
+
+/// Support for estimating the results of a scan from a sample of its inputs.
+///
+/// The input files are divided into strata by size (one per power of two) and the same fraction
+/// of each stratum is chosen. Files are chosen by a hash of their path and a seed, so the sample
+/// is repeatable. After the scan, each scanned input's share of the COMDAT bytes is attributed
+/// to the sampled file from which it came and the stratified estimator gives the corpus total,
+/// with a 95% confidence interval.
+///
+/// The waste is a property of each group rather than of the files: as for a full scan, a group
+/// wastes its total size less the size of its largest instance. Each sampled file stands for
+/// N/n files of its stratum (N being the size of the stratum and n the number sampled from it),
+/// so weighting each sampled file's share of a group's bytes in that way estimates the group's
+/// total size in the whole population. Groups which weren't seen at all are
+/// missed, so the estimate is still low for groups which occur in only a few files. Its
+/// confidence interval comes from a bootstrap: the sampled files of each stratum are resampled
+/// with replacement and the waste recomputed.
+namespace sampling {
+
+    struct interval {
+        double value;
+        /// The half-width of the 95% confidence interval.
+        double half_width;
+    };
+
+    struct estimate {
+        /// The number of files scanned.
+        std::size_t sampled;
+        /// The number of files from which the sample was drawn.
+        std::size_t population;
+        interval total;
+        interval wasted;
+    };
+
+    /// Returns the stratum of a file of 'size' bytes.
+    unsigned stratum (std::uint64_t size);
+
+
+    // **********
+    // * sample *
+    // **********
+    class sample {
+    public:
+        /// Chooses the sample. 'files' are the candidate files, 'fraction' the proportion of each
+        /// stratum to be chosen (at least two files are chosen from each stratum, if possible,
+        /// so that its variance can be estimated).
+        sample (std::vector<boost::filesystem::path> const & files, double fraction,
+                std::uint64_t seed);
+
+        /// The chosen files.
+        std::vector<std::string> const & files () const {
+            return files_;
+        }
+        std::size_t population () const {
+            return population_;
+        }
+
+        /// Extrapolates the results of scanning the sample. 'inputs' are the names of the
+        /// inputs that were scanned (which are indexed by the map's values).
+        estimate extrapolate (comdat_scanner::comdat_map const & cm,
+                              std::vector<std::string> const & inputs) const;
+
+    private:
+        /// Returns the index of the chosen file which produced the input named 'name' or -1 if
+        /// there isn't one. An input is named after the file followed by the path of an archive
+        /// member (" (member)") or zip member ("/member").
+        std::ptrdiff_t file_index (std::string const & name) const;
+
+        std::size_t population_;
+        std::uint64_t seed_;
+        /// The number of files in each stratum.
+        std::vector<std::size_t> strata_;
+        /// The chosen files and the stratum of each.
+        std::vector<std::string> files_;
+        std::vector<unsigned> file_strata_;
+        /// Maps the name of a chosen file to its index in files_.
+        std::unordered_map<std::string, std::size_t> index_;
+    };
+
+} // namespace sampling
+
+#endif // SCANLIB_SAMPLING_HPP
+// eof scanlib/sampling.hpp
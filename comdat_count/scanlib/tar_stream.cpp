@@ -0,0 +1,510 @@
+// Copyright (c) 2016 by SN Systems Ltd., Sony Interactive Entertainment Inc.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "tar_stream.hpp"
+
+// Standard library includes
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+#include <system_error>
+#include <vector>
+
+// 3rd party includes
+#include <boost/filesystem/operations.hpp>
+#include <zlib.h>
+#if defined(HAVE_ZSTD)
+#include <zstd.h>
+#endif
+
+namespace {
+
+    constexpr std::size_t input_buffer_size = 128 * 1024;
+
+    // ***************
+    // * file source *
+    // ***************
+    class file_source final : public tar::source {
+    public:
+        explicit file_source (boost::filesystem::path const & path);
+        std::size_t read (void * buffer, std::size_t size) override;
+        void skip (std::uint64_t size) override;
+
+    private:
+        std::unique_ptr<FILE, decltype (&std::fclose)> file_;
+        std::uint64_t const size_;
+        std::uint64_t pos_ = 0;
+    };
+
+    file_source::file_source (boost::filesystem::path const & path)
+            : file_ (std::fopen (path.string ().c_str (), "rb"), &std::fclose)
+            , size_ (file_.get () == nullptr ? 0U : boost::filesystem::file_size (path)) {
+        if (file_.get () == nullptr) {
+            std::ostringstream str;
+            str << "Could not open " << path;
+            throw std::system_error (errno, std::generic_category (), str.str ());
+        }
+    }
+
+    std::size_t file_source::read (void * buffer, std::size_t size) {
+        std::size_t const result = std::fread (buffer, 1U, size, file_.get ());
+        if (result < size && std::ferror (file_.get ())) {
+            throw std::system_error (errno, std::generic_category (), "Read error");
+        }
+        pos_ += result;
+        return result;
+    }
+
+    void file_source::skip (std::uint64_t size) {
+        // A plain file can simply seek over the data. fseek() is happy to move beyond the end of
+        // the file so check for truncation here.
+        if (size > size_ - pos_) {
+            throw tar::exception ("Unexpected end of tar data");
+        }
+        pos_ += size;
+        while (size > 0U) {
+            auto const step = std::min (size, std::uint64_t{1} << 30);
+            if (std::fseek (file_.get (), static_cast<long> (step), SEEK_CUR) != 0) {
+                throw std::system_error (errno, std::generic_category (), "Seek error");
+            }
+            size -= step;
+        }
+    }
+
+
+    // ***************
+    // * gzip source *
+    // ***************
+    /// Decompresses a gzip stream. A file made up of several concatenated gzip members (as
+    /// produced by parallel compressors such as pigz) is read as a single stream.
+    class gzip_source final : public tar::source {
+    public:
+        explicit gzip_source (std::unique_ptr<tar::source> && inner);
+        ~gzip_source () override;
+        std::size_t read (void * buffer, std::size_t size) override;
+
+    private:
+        std::unique_ptr<tar::source> inner_;
+        std::vector<std::uint8_t> in_;
+        z_stream zs_;
+        bool end_ = false;
+    };
+
+    gzip_source::gzip_source (std::unique_ptr<tar::source> && inner)
+            : inner_ (std::move (inner))
+            , in_ (input_buffer_size) {
+        std::memset (&zs_, 0, sizeof (zs_));
+        // 15 window bits plus 16 to select the gzip format.
+        if (::inflateInit2 (&zs_, 15 + 16) != Z_OK) {
+            throw tar::exception ("Could not initialize the gzip decompressor");
+        }
+    }
+
+    gzip_source::~gzip_source () {
+        ::inflateEnd (&zs_);
+    }
+
+    std::size_t gzip_source::read (void * buffer, std::size_t size) {
+        zs_.next_out = static_cast<Bytef *> (buffer);
+        zs_.avail_out = static_cast<uInt> (std::min (size, std::size_t{1} << 30));
+        while (!end_ && zs_.avail_out > 0U) {
+            if (zs_.avail_in == 0U) {
+                zs_.next_in = in_.data ();
+                zs_.avail_in = static_cast<uInt> (inner_->read (in_.data (), in_.size ()));
+                if (zs_.avail_in == 0U) {
+                    throw tar::exception ("Unexpected end of gzip data");
+                }
+            }
+            int const err = ::inflate (&zs_, Z_NO_FLUSH);
+            if (err == Z_STREAM_END) {
+                // Look for another gzip member.
+                if (zs_.avail_in == 0U) {
+                    zs_.next_in = in_.data ();
+                    zs_.avail_in = static_cast<uInt> (inner_->read (in_.data (), in_.size ()));
+                }
+                if (zs_.avail_in == 0U) {
+                    end_ = true;
+                } else {
+                    ::inflateReset (&zs_);
+                }
+            } else if (err != Z_OK && err != Z_BUF_ERROR) {
+                std::ostringstream str;
+                str << "gzip decompression failed (" << (zs_.msg != nullptr ? zs_.msg : "?")
+                    << ')';
+                throw tar::exception (str.str ());
+            }
+        }
+        return static_cast<std::size_t> (zs_.next_out - static_cast<Bytef *> (buffer));
+    }
+
+
+#if defined(HAVE_ZSTD)
+    // ***************
+    // * zstd source *
+    // ***************
+    class zstd_source final : public tar::source {
+    public:
+        explicit zstd_source (std::unique_ptr<tar::source> && inner);
+        ~zstd_source () override;
+        std::size_t read (void * buffer, std::size_t size) override;
+
+    private:
+        std::unique_ptr<tar::source> inner_;
+        std::vector<std::uint8_t> in_;
+        ZSTD_DStream * const zds_;
+        ZSTD_inBuffer input_;
+        /// The value returned by the last call to ZSTD_decompressStream(): 0 when a frame has
+        /// been completely decoded.
+        std::size_t hint_ = 0;
+    };
+
+    zstd_source::zstd_source (std::unique_ptr<tar::source> && inner)
+            : inner_ (std::move (inner))
+            , in_ (::ZSTD_DStreamInSize ())
+            , zds_ (::ZSTD_createDStream ())
+            , input_{in_.data (), 0U, 0U} {
+        if (zds_ == nullptr || ::ZSTD_isError (::ZSTD_initDStream (zds_))) {
+            ::ZSTD_freeDStream (zds_);
+            throw tar::exception ("Could not initialize the zstd decompressor");
+        }
+    }
+
+    zstd_source::~zstd_source () {
+        ::ZSTD_freeDStream (zds_);
+    }
+
+    std::size_t zstd_source::read (void * buffer, std::size_t size) {
+        ZSTD_outBuffer output{buffer, size, 0U};
+        while (output.pos < output.size) {
+            if (input_.pos == input_.size) {
+                input_.size = inner_->read (in_.data (), in_.size ());
+                input_.pos = 0U;
+                if (input_.size == 0U) {
+                    if (hint_ != 0U) {
+                        throw tar::exception ("Unexpected end of zstd data");
+                    }
+                    break;
+                }
+            }
+            hint_ = ::ZSTD_decompressStream (zds_, &output, &input_);
+            if (::ZSTD_isError (hint_)) {
+                std::ostringstream str;
+                str << "zstd decompression failed (" << ::ZSTD_getErrorName (hint_) << ')';
+                throw tar::exception (str.str ());
+            }
+        }
+        return output.pos;
+    }
+#endif // HAVE_ZSTD
+
+
+    // pad
+    // ~~~
+    /// Returns the number of bytes which follow 'size' bytes of data to fill the last block.
+    std::size_t pad (std::uint64_t size) {
+        constexpr std::uint64_t block_size = tar::reader::block_size;
+        return static_cast<std::size_t> ((block_size - size % block_size) % block_size);
+    }
+
+    bool is_zero (std::uint8_t const * block) {
+        return std::all_of (block, block + tar::reader::block_size,
+                            [](std::uint8_t b) { return b == 0U; });
+    }
+
+    /// Returns the length of a string in a fixed-size field which is NUL terminated only if
+    /// shorter than the field.
+    std::size_t field_length (std::uint8_t const * field, std::size_t size) {
+        auto const * const nul =
+            static_cast<std::uint8_t const *> (std::memchr (field, '\0', size));
+        return nul == nullptr ? size : static_cast<std::size_t> (nul - field);
+    }
+
+} // end anonymous namespace
+
+
+namespace tar {
+
+    // **********
+    // * source *
+    // **********
+    source::~source () {}
+
+    void source::skip (std::uint64_t size) {
+        std::array<std::uint8_t, 64 * 1024> buffer;
+        while (size > 0U) {
+            std::size_t const n =
+                this->read (buffer.data (), static_cast<std::size_t> (std::min (
+                                                size, std::uint64_t{buffer.size ()})));
+            if (n == 0U) {
+                throw exception ("Unexpected end of tar data");
+            }
+            size -= n;
+        }
+    }
+
+    // open
+    // ~~~~
+    std::unique_ptr<source> open (boost::filesystem::path const & path) {
+        std::uint8_t magic[4] = {0};
+        {
+            file_source f (path);
+            f.read (magic, sizeof (magic));
+        }
+
+        std::unique_ptr<source> result (new file_source (path));
+        if (magic[0] == 0x1F && magic[1] == 0x8B) {
+            result.reset (new gzip_source (std::move (result)));
+        } else if (magic[0] == 0x28 && magic[1] == 0xB5 && magic[2] == 0x2F && magic[3] == 0xFD) {
+#if defined(HAVE_ZSTD)
+            result.reset (new zstd_source (std::move (result)));
+#else
+            throw exception ("zstd-compressed input is not supported by this build");
+#endif
+        }
+        return result;
+    }
+
+    // is tar
+    // ~~~~~~
+    bool is_tar (boost::filesystem::path const & path) {
+        try {
+            std::unique_ptr<source> src = open (path);
+            std::array<std::uint8_t, reader::block_size> block;
+            std::size_t size = 0;
+            while (size < block.size ()) {
+                std::size_t const n = src->read (block.data () + size, block.size () - size);
+                if (n == 0U) {
+                    return false;
+                }
+                size += n;
+            }
+            return reader::is_header (block.data ());
+        } catch (std::exception const &) {
+            // Anything that we can't read isn't treated as a tar file. The consumer will report
+            // the problem if the file can't be scanned either.
+            return false;
+        }
+    }
+
+
+    // **********
+    // * reader *
+    // **********
+    // (ctor)
+    // ~~~~~~
+    reader::reader (source & src)
+            : src_ (src) {}
+
+    // number [static]
+    // ~~~~~~
+    std::uint64_t reader::number (std::uint8_t const * field, std::size_t length) {
+        std::uint64_t result = 0;
+        if (field[0] & 0x80U) {
+            // GNU base-256 encoding for values too large for the octal field.
+            for (std::size_t index = 1; index < length; ++index) {
+                result = (result << 8) | field[index];
+            }
+            return result;
+        }
+        std::size_t index = 0;
+        while (index < length && field[index] == ' ') {
+            ++index;
+        }
+        for (; index < length && field[index] >= '0' && field[index] <= '7'; ++index) {
+            result = (result << 3) | static_cast<unsigned> (field[index] - '0');
+        }
+        return result;
+    }
+
+    // is header [static]
+    // ~~~~~~~~~
+    bool reader::is_header (std::uint8_t const * block) {
+        if (is_zero (block)) {
+            return false;
+        }
+        // The checksum is the sum of the header's bytes with the checksum field itself taken
+        // to be spaces. Some early implementations summed signed chars so accept that, too.
+        static constexpr std::size_t checksum_offset = 148;
+        static constexpr std::size_t checksum_size = 8;
+        std::uint64_t const expected = number (block + checksum_offset, checksum_size);
+        std::uint64_t unsigned_sum = 0;
+        std::int64_t signed_sum = 0;
+        for (std::size_t index = 0; index < block_size; ++index) {
+            bool const in_checksum =
+                index >= checksum_offset && index < checksum_offset + checksum_size;
+            std::uint8_t const b = in_checksum ? std::uint8_t{' '} : block[index];
+            unsigned_sum += b;
+            signed_sum += static_cast<signed char> (b);
+        }
+        return expected == unsigned_sum || static_cast<std::int64_t> (expected) == signed_sum;
+    }
+
+    // read exact
+    // ~~~~~~~~~~
+    void reader::read_exact (void * buffer, std::size_t size) {
+        auto * p = static_cast<std::uint8_t *> (buffer);
+        while (size > 0U) {
+            std::size_t const n = src_.read (p, size);
+            if (n == 0U) {
+                throw exception ("Unexpected end of tar data");
+            }
+            p += n;
+            size -= n;
+        }
+    }
+
+    // read extended
+    // ~~~~~~~~~~~~~
+    std::string reader::read_extended (std::uint64_t size) {
+        static constexpr std::uint64_t max_extended = 1024 * 1024;
+        if (size > max_extended) {
+            throw exception ("Tar extended header is too large");
+        }
+        std::string result (static_cast<std::size_t> (size), '\0');
+        this->read_exact (&result[0], result.size ());
+        src_.skip (pad (size));
+        return result;
+    }
+
+    // next
+    // ~~~~
+    bool reader::next () {
+        src_.skip (remaining_ + padding_);
+        remaining_ = 0;
+        padding_ = 0;
+
+        std::string long_name;
+        std::string pax_path;
+        bool have_pax_size = false;
+        std::uint64_t pax_size = 0;
+
+        while (!end_) {
+            std::array<std::uint8_t, block_size> block;
+            // The end of the stream at a block boundary is taken as the end of the archive
+            // even if the two zero blocks which should mark it are missing.
+            std::size_t const n = src_.read (block.data (), block.size ());
+            if (n == 0U) {
+                end_ = true;
+                break;
+            }
+            this->read_exact (block.data () + n, block.size () - n);
+            if (is_zero (block.data ())) {
+                end_ = true;
+                break;
+            }
+            if (!is_header (block.data ())) {
+                throw exception ("Bad tar header");
+            }
+
+            std::uint64_t size = number (block.data () + 124, 12);
+            char const type = static_cast<char> (block[156]);
+            switch (type) {
+            case 'L': // GNU long name for the next entry.
+                long_name = this->read_extended (size);
+                long_name.resize (field_length (reinterpret_cast<std::uint8_t const *> (
+                                                    long_name.data ()),
+                                                long_name.size ()));
+                continue;
+            case 'x': { // pax extended header for the next entry.
+                // Each record is "length key=value\n" where length counts the whole record.
+                std::string const records = this->read_extended (size);
+                std::size_t pos = 0;
+                while (pos < records.size ()) {
+                    std::size_t const space = records.find (' ', pos);
+                    if (space == std::string::npos) {
+                        break;
+                    }
+                    std::size_t const length = std::strtoul (records.c_str () + pos, nullptr, 10);
+                    if (length <= space - pos || pos + length > records.size ()) {
+                        throw exception ("Bad pax header record");
+                    }
+                    std::string const record =
+                        records.substr (space + 1, pos + length - space - 2); // Drop the '\n'.
+                    std::size_t const eq = record.find ('=');
+                    if (eq != std::string::npos) {
+                        std::string const key = record.substr (0, eq);
+                        if (key == "path") {
+                            pax_path = record.substr (eq + 1);
+                        } else if (key == "size") {
+                            pax_size = std::strtoull (record.c_str () + eq + 1, nullptr, 10);
+                            have_pax_size = true;
+                        }
+                    }
+                    pos += length;
+                }
+                continue;
+            }
+            default: break;
+            }
+
+            if (have_pax_size) {
+                size = pax_size;
+            }
+            if (type != '0' && type != '\0' && type != '7') {
+                // Not a regular file: directories, links, devices, global pax headers and so
+                // on. Skip any contents.
+                src_.skip (size + pad (size));
+                long_name.clear ();
+                pax_path.clear ();
+                have_pax_size = false;
+                continue;
+            }
+
+            if (!long_name.empty ()) {
+                name_ = std::move (long_name);
+            } else if (!pax_path.empty ()) {
+                name_ = std::move (pax_path);
+            } else {
+                name_.clear ();
+                // A ustar header may split a long path between the prefix and name fields.
+                if (std::memcmp (block.data () + 257, "ustar", 5) == 0 && block[345] != 0U) {
+                    name_.assign (reinterpret_cast<char const *> (block.data () + 345),
+                                  field_length (block.data () + 345, 155));
+                    name_ += '/';
+                }
+                name_.append (reinterpret_cast<char const *> (block.data ()),
+                              field_length (block.data (), 100));
+            }
+            size_ = size;
+            remaining_ = size;
+            padding_ = pad (size);
+            return true;
+        }
+        return false;
+    }
+
+    // read
+    // ~~~~
+    std::size_t reader::read (void * buffer, std::size_t size) {
+        std::size_t const n = static_cast<std::size_t> (std::min (std::uint64_t{size}, remaining_));
+        if (n == 0U) {
+            return 0U;
+        }
+        this->read_exact (buffer, n);
+        remaining_ -= n;
+        return n;
+    }
+
+} // namespace tar
+
+// eof scanlib/tar_stream.cpp
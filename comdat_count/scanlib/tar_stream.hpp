@@ -0,0 +1,115 @@
+// Copyright (c) 2016 by SN Systems Ltd., Sony Interactive Entertainment Inc.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef SCANLIB_TAR_STREAM_HPP
+#define SCANLIB_TAR_STREAM_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+#include <boost/filesystem/path.hpp>
+
+/// Sequential reading of tar files, optionally gzip or zstd compressed, without unpacking them
+/// to disk. zstd support is available only if the library was built with HAVE_ZSTD defined.
+namespace tar {
+
+    class exception : public std::runtime_error {
+    public:
+        using std::runtime_error::runtime_error;
+    };
+
+    // **********
+    // * source *
+    // **********
+    /// A sequential source of bytes.
+    class source {
+    public:
+        virtual ~source ();
+        /// Reads up to 'size' bytes into 'buffer'.
+        /// \returns The number of bytes read: 0 at the end of the stream.
+        virtual std::size_t read (void * buffer, std::size_t size) = 0;
+        /// Discards the next 'size' bytes. Throws if the stream ends first.
+        virtual void skip (std::uint64_t size);
+    };
+
+    /// Opens the file at 'path' for sequential reading. If the file is gzip or zstd compressed
+    /// then the returned source decompresses it on the fly.
+    std::unique_ptr<source> open (boost::filesystem::path const & path);
+
+    /// Returns true if the file at 'path' is a (possibly compressed) tar file which can be read.
+    bool is_tar (boost::filesystem::path const & path);
+
+
+    // **********
+    // * reader *
+    // **********
+    /// Iterates over the regular files in a tar stream. ustar, GNU (long names and base-256
+    /// sizes) and pax (path and size records) headers are understood.
+    class reader {
+    public:
+        static constexpr std::size_t block_size = 512;
+
+        explicit reader (source & src);
+
+        /// Advances to the next regular file, skipping any unread contents of the current one.
+        /// \returns False at the end of the archive.
+        bool next ();
+
+        /// The path of the current file.
+        std::string const & name () const {
+            return name_;
+        }
+        /// The size of the current file.
+        std::uint64_t size () const {
+            return size_;
+        }
+
+        /// Reads up to 'size' bytes of the current file's contents.
+        /// \returns The number of bytes read: 0 once the contents have been consumed.
+        std::size_t read (void * buffer, std::size_t size);
+
+        /// Returns true if 'block' is a valid tar header.
+        static bool is_header (std::uint8_t const * block);
+
+    private:
+        /// Reads exactly 'size' bytes. Throws if the stream ends first.
+        void read_exact (void * buffer, std::size_t size);
+        /// Reads the contents of an extended header entry of 'size' bytes.
+        std::string read_extended (std::uint64_t size);
+
+        static std::uint64_t number (std::uint8_t const * field, std::size_t length);
+
+        source & src_;
+        std::string name_;
+        std::uint64_t size_ = 0;
+        /// The number of bytes of the current file that are yet to be read.
+        std::uint64_t remaining_ = 0;
+        /// The number of padding bytes which follow the current file.
+        std::size_t padding_ = 0;
+        bool end_ = false;
+    };
+
+} // namespace tar
+
+#endif // SCANLIB_TAR_STREAM_HPP
+// eof scanlib/tar_stream.hpp
@@ -20,10 +20,6 @@
 
 #include "temp_files.hpp"
 
-#include <memory>
-#include <mutex>
-#include <sstream>
-
 boost::filesystem::path temp_directory_creator::unique_temp_dir () {
     // Find the nominated temporary directory, then create a (likely) unique
     // name inside it.
@@ -35,56 +31,3 @@ boost::filesystem::path temp_directory_creator::unique_temp_dir () {
     boost::filesystem::create_directories (resl);
     return resl;
 }
-
-
-boost::filesystem::path temporary_file_path () {
-    static std::mutex temp_dir_lock;
-    static std::unique_ptr<temp_directory_creator> temp_dir;
-    static auto uniquifier = 0U;
-
-    std::lock_guard<std::mutex> guard (temp_dir_lock);
-    if (!temp_dir) {
-        temp_dir.reset (new temp_directory_creator ());
-    }
-
-    std::ostringstream temp_file_name;
-    temp_file_name << "t" << uniquifier++;
-
-    boost::filesystem::path temp_file = temp_dir->path ();
-    temp_file /= temp_file_name.str ();
-
-    return temp_file;
-}
-
-
-
-path_cleanup::path_cleanup (boost::filesystem::path const & path, bool is_temp)
-        : path_ (path)
-        , is_temp_ (is_temp) {}
-
-path_cleanup::path_cleanup (path_cleanup && other)
-        : path_ (other.path_)
-        , is_temp_ (other.is_temp_) {
-
-    other.is_temp_ = false;
-}
-
-path_cleanup & path_cleanup::operator= (path_cleanup && other) {
-    if (this != &other) {
-        this->cleanup ();
-        path_ = other.path_;
-        is_temp_ = other.is_temp_;
-        other.is_temp_ = false;
-    }
-    return *this;
-}
-
-path_cleanup::~path_cleanup () {
-    this->cleanup ();
-}
-void path_cleanup::cleanup () {
-    if (is_temp_) {
-        boost::filesystem::remove (path_);
-        is_temp_ = false;
-    }
-}
@@ -45,27 +45,5 @@ private:
 };
 
 
-class path_cleanup {
-public:
-    path_cleanup (boost::filesystem::path const & path, bool is_temp);
-    path_cleanup (path_cleanup const &) = delete;
-    path_cleanup (path_cleanup && other);
-    ~path_cleanup ();
-
-    path_cleanup & operator= (path_cleanup && other);
-    path_cleanup & operator= (path_cleanup const &) = delete;
-
-    boost::filesystem::path path () const {
-        return path_;
-    }
-
-private:
-    void cleanup ();
-    boost::filesystem::path path_;
-    bool is_temp_;
-};
-
-boost::filesystem::path temporary_file_path ();
-
 #endif // TEMP_FILES_H
 // eof temp_files.h
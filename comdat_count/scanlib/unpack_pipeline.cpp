@@ -0,0 +1,305 @@
+// Copyright (c) 2016 by SN Systems Ltd., Sony Interactive Entertainment Inc.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "unpack_pipeline.hpp"
+
+// Standard library includes
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+// Local includes
+#include "progress.hpp"
+#include "tar_stream.hpp"
+
+namespace {
+    /// Returns true if 'first' (the first bytes of a file) could be the start of an ELF file or
+    /// an ar archive.
+    bool is_scannable (std::uint8_t const * first, std::size_t size) {
+        static char const elf_magic[] = {'\x7F', 'E', 'L', 'F'};
+        return (size >= sizeof (elf_magic) &&
+                std::memcmp (first, elf_magic, sizeof (elf_magic)) == 0) ||
+               elf_view::archive::is_archive (elf_view::span{first, size});
+    }
+
+    /// The number of bytes examined by is_scannable().
+    constexpr std::size_t magic_size = 8;
+
+    /// Calls 'read' until 'size' bytes have been read or it returns 0.
+    /// \returns The number of bytes read.
+    template <typename ReadFunction>
+    std::size_t read_fully (ReadFunction read, std::uint8_t * buffer, std::size_t size) {
+        std::size_t total = 0;
+        while (total < size) {
+            std::size_t const n = read (buffer + total, size - total);
+            if (n == 0U) {
+                break;
+            }
+            total += n;
+        }
+        return total;
+    }
+}
+
+// (ctor)
+// ~~~~~~
+unpack_pipeline::unpack_pipeline (std::vector<job> jobs, unsigned threads, std::size_t budget,
+                                  updater * const progress,
+                                  checkpoint::completed_set const * const completed,
+                                  std::function<void ()> notify)
+        : jobs_ (std::move (jobs))
+        , progress_ (progress)
+        , completed_ (completed)
+        , notify_ (std::move (notify))
+        , pool_ (budget)
+        , running_ (std::max (threads, 1U)) {
+
+    // Note that running_ may be decremented by a worker as soon as it starts so isn't used to
+    // control the loop.
+    unsigned const num_threads = running_;
+    threads_.reserve (num_threads);
+    for (unsigned ctr = 0; ctr < num_threads; ++ctr) {
+        threads_.emplace_back (&unpack_pipeline::worker, this);
+    }
+}
+
+// (dtor)
+// ~~~~~~
+unpack_pipeline::~unpack_pipeline () {
+    this->cancel ();
+    for (auto & t : threads_) {
+        if (t.joinable ()) {
+            t.join ();
+        }
+    }
+}
+
+// cancel
+// ~~~~~~
+void unpack_pipeline::cancel () {
+    {
+        std::lock_guard<std::mutex> lock (mut_);
+        cancel_ = true;
+        entries_.clear ();
+    }
+    pool_.cancel ();
+    ready_cv_.notify_all ();
+}
+
+// check error
+// ~~~~~~~~~~~
+void unpack_pipeline::check_error () const {
+    if (error_) {
+        std::rethrow_exception (error_);
+    }
+}
+
+// ready
+// ~~~~~
+bool unpack_pipeline::ready () {
+    std::lock_guard<std::mutex> lock (mut_);
+    return !entries_.empty () || error_;
+}
+
+// try pop
+// ~~~~~~~
+bool unpack_pipeline::try_pop (std::unique_ptr<entry> & e) {
+    std::lock_guard<std::mutex> lock (mut_);
+    this->check_error ();
+    if (entries_.empty ()) {
+        return false;
+    }
+    e = std::move (entries_.front ());
+    entries_.pop_front ();
+    return true;
+}
+
+// pop
+// ~~~
+bool unpack_pipeline::pop (std::unique_ptr<entry> & e) {
+    std::unique_lock<std::mutex> lock (mut_);
+    ready_cv_.wait (lock, [this]() {
+        return !entries_.empty () || running_ == 0U || cancel_ || error_;
+    });
+    this->check_error ();
+    if (entries_.empty ()) {
+        return false;
+    }
+    e = std::move (entries_.front ());
+    entries_.pop_front ();
+    return true;
+}
+
+// release
+// ~~~~~~~
+void unpack_pipeline::release (std::unique_ptr<entry> && e) {
+    if (e) {
+        pool_.release (std::move (e->buffer));
+        e.reset ();
+    }
+}
+
+// push
+// ~~~~
+void unpack_pipeline::push (std::unique_ptr<entry> && e) {
+    {
+        std::lock_guard<std::mutex> lock (mut_);
+        entries_.push_back (std::move (e));
+    }
+    ready_cv_.notify_one ();
+    if (notify_) {
+        notify_ ();
+    }
+}
+
+// worker
+// ~~~~~~
+void unpack_pipeline::worker () {
+    // The zip file most recently opened by this thread. Consecutive members of the same file
+    // don't need to open it again.
+    zipper::zip_ptr uf{nullptr, &::unzClose};
+    boost::filesystem::path uf_path;
+
+    for (;;) {
+        std::size_t index;
+        {
+            std::lock_guard<std::mutex> lock (mut_);
+            if (cancel_ || next_ >= jobs_.size ()) {
+                break;
+            }
+            index = next_++;
+        }
+
+        try {
+            job const & j = jobs_[index];
+            switch (j.k) {
+            case job::kind::tar: this->read_tar (j.path); break;
+            case job::kind::zip_member: this->read_zip_member (j, uf, uf_path); break;
+            }
+        } catch (...) {
+            // Record the error for a consumer to report and stop the other decompression
+            // threads.
+            {
+                std::lock_guard<std::mutex> lock (mut_);
+                if (!error_) {
+                    error_ = std::current_exception ();
+                }
+                cancel_ = true;
+            }
+            pool_.cancel ();
+            if (notify_) {
+                notify_ ();
+            }
+            break;
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock (mut_);
+        --running_;
+    }
+    ready_cv_.notify_all ();
+}
+
+// read tar
+// ~~~~~~~~
+void unpack_pipeline::read_tar (boost::filesystem::path const & path) {
+    std::unique_ptr<tar::source> src = tar::open (path);
+    tar::reader reader (*src);
+    auto read = [&reader](std::uint8_t * buffer, std::size_t size) {
+        return reader.read (buffer, size);
+    };
+
+    while (reader.next ()) {
+        std::string user_path = path.string () + " (" + reader.name () + ')';
+        if (completed_ != nullptr && completed_->count (user_path) > 0U) {
+            continue;
+        }
+
+        // Look at the first few bytes of the entry. We don't want to hold anything that we
+        // can't scan in memory.
+        std::uint8_t first[magic_size];
+        std::size_t const first_size = read_fully (read, first, sizeof (first));
+        if (!is_scannable (first, first_size)) {
+            continue;
+        }
+
+        auto const size = static_cast<std::size_t> (reader.size ());
+        std::unique_ptr<entry> e (
+            new entry{boost::filesystem::path (), pool_.acquire (size), size});
+        if (!e->buffer) {
+            return; // Cancelled.
+        }
+        e->user_path = std::move (user_path);
+        std::memcpy (e->buffer.data (), first, first_size);
+        read_fully (read, e->buffer.data () + first_size, size - first_size);
+
+        if (progress_ != nullptr) {
+            progress_->total_incr ();
+        }
+        this->push (std::move (e));
+    }
+}
+
+// read zip member
+// ~~~~~~~~~~~~~~~
+void unpack_pipeline::read_zip_member (job const & j, zipper::zip_ptr & uf,
+                                       boost::filesystem::path & uf_path) {
+    if (!uf || uf_path != j.path) {
+        uf = zipper::open (j.path);
+        uf_path = j.path;
+    }
+    unz64_file_pos pos = j.pos;
+    zipper::throw_unzip_error (unzGoToFilePos64 (uf.get (), &pos), j.path);
+
+    zipper::current_file member (uf.get (), j.path);
+    auto read = [&member](std::uint8_t * buffer, std::size_t size) {
+        return member.read (buffer, size);
+    };
+
+    std::uint8_t first[magic_size];
+    std::size_t const first_size = read_fully (read, first, sizeof (first));
+    if (!is_scannable (first, first_size)) {
+        // The member was counted when it was queued.
+        if (progress_ != nullptr) {
+            progress_->completed_incr ();
+        }
+        return;
+    }
+
+    auto const size = static_cast<std::size_t> (j.size);
+    if (first_size > size) {
+        zipper::throw_unzip_error ("Member size does not match its directory entry in", j.path);
+    }
+    std::unique_ptr<entry> e (new entry{j.path / j.member, pool_.acquire (size), size});
+    if (!e->buffer) {
+        return; // Cancelled.
+    }
+    // Inflate straight into the pooled buffer.
+    std::memcpy (e->buffer.data (), first, first_size);
+    std::size_t const actual =
+        first_size + read_fully (read, e->buffer.data () + first_size, size - first_size);
+    if (actual != size) {
+        zipper::throw_unzip_error ("Member size does not match its directory entry in", j.path);
+    }
+    this->push (std::move (e));
+}
+
+// eof scanlib/unpack_pipeline.cpp
@@ -0,0 +1,157 @@
+// Copyright (c) 2016 by SN Systems Ltd., Sony Interactive Entertainment Inc.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef SCANLIB_UNPACK_PIPELINE_HPP
+#define SCANLIB_UNPACK_PIPELINE_HPP
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <boost/filesystem/path.hpp>
+
+#include "buffer_pool.hpp"
+#include "checkpoint.hpp"
+#include "elf_view.hpp"
+#include "zipper.hpp"
+
+class updater;
+
+/// A pipeline stage which unpacks the contents of container files -- tar files (see
+/// tar_stream.hpp) and zip files -- into memory ready for the consumer threads to scan.
+/// Decompression runs on the pipeline's own threads so that it overlaps with scanning. Each zip
+/// member is a separate job so the members of a single zip file are inflated in parallel.
+///
+/// Only entries which start like an ELF file or an ar archive are buffered; anything else is
+/// skipped without being held in memory. Entries are read into buffers from a buffer_pool whose
+/// budget limits the memory held by entries waiting to be scanned: once it is reached,
+/// decompression pauses until the consumers have released enough entries.
+class unpack_pipeline {
+public:
+    /// A unit of work for the pipeline: a tar file or a single member of a zip file.
+    struct job {
+        enum class kind { tar, zip_member };
+
+        static job tar (boost::filesystem::path const & path) {
+            return {kind::tar, path, std::string (), unz64_file_pos{0, 0}, 0U};
+        }
+        static job zip_member (boost::filesystem::path const & path, std::string const & member,
+                               unz64_file_pos const & pos, std::uint64_t size) {
+            return {kind::zip_member, path, member, pos, size};
+        }
+
+        kind k;
+        boost::filesystem::path path;
+        /// The name of a zip member.
+        std::string member;
+        /// The location of a zip member's directory entry.
+        unz64_file_pos pos;
+        /// The uncompressed size of a zip member.
+        std::uint64_t size;
+    };
+
+    struct entry {
+        /// The name used to report the entry: "file.tar (path/in/tar)" or "file.zip/member".
+        boost::filesystem::path user_path;
+        buffer_pool::buffer buffer;
+        std::size_t size;
+
+        elf_view::span contents () const {
+            return {buffer.data (), size};
+        }
+    };
+
+    /// \param jobs  The work to be done.
+    /// \param threads  The number of decompression threads.
+    /// \param budget  The maximum number of bytes held in buffered entries. A single entry larger
+    ///                than this is still buffered but only when nothing else is.
+    /// \param progress  If not null, the progress total is increased for each tar entry found
+    ///                  and each zip member which is skipped is counted as completed. (Zip
+    ///                  members are included in the total when they are queued.)
+    /// \param completed  If not null, the names of tar entries completed by an earlier run.
+    ///                   These are skipped.
+    /// \param notify  If not empty, called (without any of the pipeline's locks held) after an
+    ///                entry is added or an error is recorded. A consumer that waits for some other
+    ///                source of work while testing ready() must be woken by this function.
+    unpack_pipeline (std::vector<job> jobs, unsigned threads, std::size_t budget,
+                     updater * const progress,
+                     checkpoint::completed_set const * const completed = nullptr,
+                     std::function<void ()> notify = std::function<void ()> ());
+    ~unpack_pipeline ();
+
+    // No copying or assignment.
+    unpack_pipeline (unpack_pipeline const &) = delete;
+    unpack_pipeline & operator= (unpack_pipeline const &) = delete;
+
+    /// Returns true if try_pop() would return an entry or raise an error.
+    bool ready ();
+    /// Takes the next buffered entry without waiting.
+    /// \returns False if no entry is currently available.
+    bool try_pop (std::unique_ptr<entry> & e);
+    /// Takes the next buffered entry, waiting for one if necessary.
+    /// \returns False once every job is complete and all of the entries have been taken.
+    bool pop (std::unique_ptr<entry> & e);
+    /// Called once the consumer has finished with an entry to return its buffer to the pool.
+    void release (std::unique_ptr<entry> && e);
+
+    /// Stops the decompression threads. Any entries not yet taken are discarded.
+    void cancel ();
+
+private:
+    void worker ();
+    void read_tar (boost::filesystem::path const & path);
+    /// Reads a zip member. 'uf' is the zip file last opened by this thread (and 'uf_path' its
+    /// path): it is reused if the member is in the same file.
+    void read_zip_member (job const & j, zipper::zip_ptr & uf, boost::filesystem::path & uf_path);
+    /// Adds an entry to the queue of those waiting to be scanned.
+    void push (std::unique_ptr<entry> && e);
+    /// Rethrows the first error raised by a decompression thread. Called with mut_ held.
+    void check_error () const;
+
+    std::vector<job> const jobs_;
+    updater * const progress_;
+    checkpoint::completed_set const * const completed_;
+    std::function<void ()> const notify_;
+    buffer_pool pool_;
+
+    std::mutex mut_;
+    /// Signalled when an entry is added or the pipeline finishes.
+    std::condition_variable ready_cv_;
+    std::deque<std::unique_ptr<entry>> entries_;
+    /// The index of the next job to be started.
+    std::size_t next_ = 0;
+    /// The number of decompression threads that are still running.
+    unsigned running_;
+    bool cancel_ = false;
+    std::exception_ptr error_;
+
+    std::vector<std::thread> threads_;
+};
+
+#endif // SCANLIB_UNPACK_PIPELINE_HPP
+// eof scanlib/unpack_pipeline.hpp
@@ -0,0 +1,572 @@
+// Copyright (c) 2016 by SN Systems Ltd., Sony Interactive Entertainment Inc.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "watch.hpp"
+
+// Standard library includes
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+#include <iterator>
+#include <memory>
+#include <sstream>
+#include <system_error>
+#include <thread>
+#include <utility>
+
+// 3rd party includes
+#include <boost/filesystem/operations.hpp>
+
+// OS includes
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+// Local includes
+#include "consumer.hpp"
+#include "flags.hpp"
+#include "input_set.hpp"
+#include "print.hpp"
+#include "producer.hpp"
+#include "progress.hpp"
+#include "unpack_pipeline.hpp"
+
+namespace {
+
+    /// The memory which may be held by the members of a single zip or tar file waiting to be
+    /// scanned.
+    constexpr std::size_t unpack_budget = 64U * 1024U * 1024U;
+
+    /// Returns true if 'p' names a hidden file or directory (one whose name begins with '.').
+    bool is_hidden (boost::filesystem::path const & p) {
+        std::string const name = p.filename ().string ();
+        return !name.empty () && name[0] == '.' && name != "." && name != "..";
+    }
+
+} // end anonymous namespace
+
+
+namespace watch {
+
+    // scan
+    // ~~~~
+    contribution scan (boost::filesystem::path const & path, output_flags const & ofl,
+                       scan_flags const & sfl) {
+        // The file is queued just as it would be for a full scan so that archives, thin
+        // archives, zip and tar files are all handled. It is then scanned on the calling thread.
+        comdat_scanner scanner (ofl);
+        queue_type queue{1U};
+        input_set inputs;
+        std::vector<unpack_pipeline::job> jobs;
+        queue_input_files (queue, std::vector<std::string>{path.string ()}, inputs, jobs, ofl);
+
+        updater progress;
+        std::unique_ptr<unpack_pipeline> unpack;
+        if (!jobs.empty ()) {
+            unpack.reset (new unpack_pipeline (std::move (jobs), 1U, unpack_budget, nullptr));
+        }
+
+        state_flags state;
+        consumer (queue, 0U, nullptr, unpack.get (), &scanner, nullptr, ofl, sfl, &state,
+                  progress);
+        if (state.error) {
+            std::ostringstream str;
+            str << "Could not scan " << path;
+            throw exception (str.str ());
+        }
+
+        scanner.merge_shards ();
+        contribution c;
+        c.comdats = scanner.comdats ();
+        c.inputs = scanner.inputs ();
+        c.digests = scanner.input_digests ();
+        return c;
+    }
+
+
+    // refresh
+    // ~~~~~~~
+    void refresh (live_results & live, std::vector<std::string> const & paths, unsigned threads,
+                  output_flags const & ofl, scan_flags const & sfl) {
+        // Each thread takes the next file to be scanned. The results are recorded once all of
+        // the threads have finished since live_results is not thread-safe.
+        std::vector<std::unique_ptr<contribution>> results (paths.size ());
+        std::atomic<std::size_t> next{0U};
+        auto worker = [&]() {
+            for (std::size_t index; (index = next++) < paths.size ();) {
+                boost::filesystem::path const path = paths[index];
+                boost::system::error_code ec;
+                if (!boost::filesystem::is_regular_file (path, ec)) {
+                    continue;
+                }
+                try {
+                    results[index].reset (new contribution (scan (path, ofl, sfl)));
+                } catch (std::exception const & ex) {
+                    // The file may be only partly written. It will be scanned again when it is
+                    // next modified.
+                    print_cerr ("Warning: ", ex.what ());
+                }
+            }
+        };
+
+        threads = std::max (std::min (threads, static_cast<unsigned> (paths.size ())), 1U);
+        std::vector<std::thread> pool;
+        pool.reserve (threads - 1U);
+        for (auto ctr = 1U; ctr < threads; ++ctr) {
+            pool.emplace_back (worker);
+        }
+        worker ();
+        for (std::thread & t : pool) {
+            t.join ();
+        }
+
+        for (std::size_t index = 0; index < paths.size (); ++index) {
+            if (results[index]) {
+                live.update (paths[index], std::move (*results[index]));
+            } else {
+                live.remove (paths[index]);
+            }
+        }
+    }
+
+
+    // ****************
+    // * live results *
+    // ****************
+    // update
+    // ~~~~~~
+    void live_results::update (std::string const & path, contribution && c) {
+        auto pos = files_.find (path);
+        if (pos == std::end (files_)) {
+            pos = files_.emplace (path, file_record ()).first;
+        } else {
+            this->subtract (pos->second);
+        }
+        pos->second.c = std::move (c);
+        this->add (pos->second);
+    }
+
+    // remove
+    // ~~~~~~
+    std::size_t live_results::remove (std::string const & path) {
+        // Find the file itself and then any files beneath the directory of that name. Since
+        // the map is ordered, these are contiguous.
+        std::size_t removed = 0;
+        auto it = files_.find (path);
+        if (it != std::end (files_)) {
+            this->subtract (it->second);
+            files_.erase (it);
+            ++removed;
+        }
+
+        std::string prefix = path;
+        if (prefix.empty () || prefix.back () != boost::filesystem::path::preferred_separator) {
+            prefix += boost::filesystem::path::preferred_separator;
+        }
+        it = files_.lower_bound (prefix);
+        while (it != std::end (files_) && it->first.compare (0, prefix.length (), prefix) == 0) {
+            this->subtract (it->second);
+            it = files_.erase (it);
+            ++removed;
+        }
+        return removed;
+    }
+
+    // paths
+    // ~~~~~
+    std::vector<std::string> live_results::paths () const {
+        std::vector<std::string> result;
+        result.reserve (files_.size ());
+        for (auto const & kvp : files_) {
+            result.push_back (kvp.first);
+        }
+        return result;
+    }
+
+    // digest
+    // ~~~~~~
+    md5::digest live_results::digest () {
+        return digests_.final ();
+    }
+
+    // snapshot
+    // ~~~~~~~~
+    void live_results::snapshot (comdat_scanner::comdat_map & cm,
+                                 std::vector<std::string> & inputs) const {
+        // Number the occupied slots in order. The groups' 'inputs' vectors are kept unsorted
+        // so are sorted once they have been remapped.
+        std::vector<std::uint32_t> index (slot_names_.size ());
+        inputs.clear ();
+        for (std::size_t slot = 0; slot < slot_names_.size (); ++slot) {
+            if (slot_owners_[slot] != nullptr) {
+                index[slot] = static_cast<std::uint32_t> (inputs.size ());
+                inputs.push_back (slot_names_[slot]);
+            }
+        }
+
+        cm = comdats_;
+        for (auto & kvp : cm) {
+            std::vector<std::uint32_t> & v = kvp.second.inputs;
+            for (std::uint32_t & slot : v) {
+                slot = index[slot];
+            }
+            std::sort (std::begin (v), std::end (v));
+        }
+    }
+
+    // add
+    // ~~~
+    void live_results::add (file_record & rec) {
+        rec.slots.clear ();
+        rec.slots.reserve (rec.c.inputs.size ());
+        for (std::string const & name : rec.c.inputs) {
+            std::uint32_t slot;
+            if (free_slots_.empty ()) {
+                slot = static_cast<std::uint32_t> (slot_names_.size ());
+                slot_names_.push_back (name);
+                slot_owners_.push_back (&rec);
+            } else {
+                slot = free_slots_.back ();
+                free_slots_.pop_back ();
+                slot_names_[slot] = name;
+                slot_owners_[slot] = &rec;
+            }
+            rec.slots.push_back (slot);
+        }
+
+        rec.positions.clear ();
+        for (auto const & kvp : rec.c.comdats) {
+            comdat_scanner::value & val = comdats_[kvp.first];
+            group_state & group = groups_[kvp.first];
+            comdat_scanner::value const & other = kvp.second;
+            val.total_size += other.total_size;
+            val.instances += other.instances;
+            group.largest.insert (other.largest);
+            val.largest = *group.largest.rbegin ();
+            for (std::uint32_t const index : other.inputs) {
+                group.postings.push_back (
+                    posting{&rec, static_cast<std::uint32_t> (rec.positions.size ())});
+                rec.positions.push_back (static_cast<std::uint32_t> (val.inputs.size ()));
+                val.inputs.push_back (rec.slots[index]);
+            }
+        }
+
+        for (md5::digest const & d : rec.c.digests) {
+            digests_.add (d);
+        }
+    }
+
+    // subtract
+    // ~~~~~~~~
+    void live_results::subtract (file_record & rec) {
+        // The groups are visited in the same order as they were by add() so the positions are
+        // taken in turn.
+        auto position = std::begin (rec.positions);
+        for (auto const & kvp : rec.c.comdats) {
+            auto const pos = comdats_.find (kvp.first);
+            auto const group_pos = groups_.find (kvp.first);
+            assert (pos != std::end (comdats_) && group_pos != std::end (groups_));
+            comdat_scanner::value & val = pos->second;
+            group_state & group = group_pos->second;
+            comdat_scanner::value const & other = kvp.second;
+
+            assert (val.instances >= other.instances && val.total_size >= other.total_size);
+            val.instances -= other.instances;
+            val.total_size -= other.total_size;
+            for (auto ctr = other.inputs.size (); ctr > 0U; --ctr) {
+                assert (position != std::end (rec.positions));
+                erase_posting (val, group, *position++);
+            }
+
+            if (val.instances == 0U) {
+                comdats_.erase (pos);
+                groups_.erase (group_pos);
+            } else {
+                auto const largest = group.largest.find (other.largest);
+                assert (largest != std::end (group.largest));
+                group.largest.erase (largest);
+                val.largest = group.largest.empty () ? 0U : *group.largest.rbegin ();
+            }
+        }
+        assert (position == std::end (rec.positions));
+        rec.positions.clear ();
+
+        for (std::uint32_t const slot : rec.slots) {
+            slot_names_[slot].clear ();
+            slot_owners_[slot] = nullptr;
+            free_slots_.push_back (slot);
+        }
+        rec.slots.clear ();
+
+        for (md5::digest const & d : rec.c.digests) {
+            bool const removed = digests_.remove (d);
+            assert (removed);
+            (void) removed;
+        }
+    }
+
+
+    // erase posting
+    // ~~~~~~~~~~~~~
+    void live_results::erase_posting (comdat_scanner::value & val, group_state & group,
+                                      std::uint32_t position) {
+        assert (position < val.inputs.size () && val.inputs.size () == group.postings.size ());
+        auto const last = static_cast<std::uint32_t> (val.inputs.size () - 1U);
+        if (position != last) {
+            val.inputs[position] = val.inputs[last];
+            posting const & moved = group.postings[position] = group.postings[last];
+            moved.owner->positions[moved.index] = position;
+        }
+        val.inputs.pop_back ();
+        group.postings.pop_back ();
+    }
+
+
+    // ***********
+    // * watcher *
+    // ***********
+#ifdef __linux__
+    // (ctor)
+    // ~~~~~~
+    watcher::watcher (std::vector<std::string> const & paths, output_flags const & ofl)
+            : ofl_ (ofl) {
+        fd_ = ::inotify_init1 (IN_NONBLOCK | IN_CLOEXEC);
+        if (fd_ == -1) {
+            throw std::system_error (errno, std::generic_category (), "inotify_init1");
+        }
+
+        for (boost::filesystem::path const path : paths) {
+            if (boost::filesystem::is_directory (path)) {
+                this->add_tree (path, nullptr);
+            } else {
+                // Watch the file's directory but report changes only to this file.
+                boost::filesystem::path parent = path.parent_path ();
+                if (parent.empty ()) {
+                    parent = ".";
+                }
+                auto & files = file_parents_[parent];
+                if (files.empty ()) {
+                    this->add_directory (parent);
+                }
+                files.insert (path.filename ());
+            }
+        }
+    }
+
+    // (dtor)
+    // ~~~~~~
+    watcher::~watcher () {
+        if (fd_ != -1) {
+            ::close (fd_);
+        }
+    }
+
+    // add tree
+    // ~~~~~~~~
+    void watcher::add_tree (boost::filesystem::path const & dir, changes * const c) {
+        this->add_directory (dir);
+        boost::system::error_code ec;
+        for (auto it = boost::filesystem::recursive_directory_iterator (dir, ec),
+                  end = boost::filesystem::recursive_directory_iterator{};
+             !ec && it != end; it.increment (ec)) {
+            boost::filesystem::path const & p = *it;
+            if (boost::filesystem::is_directory (p)) {
+                if (boost::filesystem::is_symlink (p) || is_hidden (p)) {
+                    it.no_push ();
+                } else {
+                    this->add_directory (p);
+                }
+            } else if (c != nullptr && !is_hidden (p)) {
+                c->modified.insert (p.string ());
+            }
+        }
+    }
+
+    // add directory
+    // ~~~~~~~~~~~~~
+    void watcher::add_directory (boost::filesystem::path const & dir) {
+        std::uint32_t const mask = IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVED_FROM |
+                                   IN_MOVED_TO | IN_DELETE_SELF | IN_ONLYDIR;
+        int const wd = ::inotify_add_watch (fd_, dir.c_str (), mask);
+        if (wd == -1) {
+            // The directory may already have gone.
+            if (errno == ENOENT) {
+                return;
+            }
+            std::ostringstream str;
+            str << "Could not watch " << dir;
+            throw std::system_error (errno, std::generic_category (), str.str ());
+        }
+        if (ofl_.verbose) {
+            print_cout ("Watching: ", dir);
+        }
+        dirs_[wd] = dir;
+    }
+
+    // remove tree
+    // ~~~~~~~~~~~
+    void watcher::remove_tree (boost::filesystem::path const & dir) {
+        std::string const & name = dir.native ();
+        for (auto it = std::begin (dirs_); it != std::end (dirs_);) {
+            std::string const & watched = it->second.native ();
+            if (watched.compare (0, name.length (), name) == 0 &&
+                (watched.length () == name.length () ||
+                 watched[name.length ()] == boost::filesystem::path::preferred_separator)) {
+                // The kernel will follow with IN_IGNORED for this descriptor, which is dropped
+                // since it is no longer in 'dirs_'.
+                ::inotify_rm_watch (fd_, it->first);
+                it = dirs_.erase (it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    // read events
+    // ~~~~~~~~~~~
+    void watcher::read_events (changes & c) {
+        alignas (inotify_event) char buffer[16 * 1024];
+        for (;;) {
+            ssize_t const length = ::read (fd_, buffer, sizeof (buffer));
+            if (length == -1) {
+                if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                    return;
+                }
+                if (errno == EINTR) {
+                    continue;
+                }
+                throw std::system_error (errno, std::generic_category (), "read inotify");
+            }
+
+            for (char const * p = buffer; p < buffer + length;) {
+                auto const * const event = reinterpret_cast<inotify_event const *> (p);
+                p += sizeof (inotify_event) + event->len;
+
+                if ((event->mask & IN_Q_OVERFLOW) != 0U) {
+                    c.overflow = true;
+                    continue;
+                }
+                auto const pos = dirs_.find (event->wd);
+                if (pos == std::end (dirs_)) {
+                    continue;
+                }
+                if ((event->mask & IN_IGNORED) != 0U) {
+                    // The watch was removed because its directory was deleted.
+                    dirs_.erase (pos);
+                    continue;
+                }
+                if (event->len == 0U) {
+                    continue;
+                }
+
+                boost::filesystem::path const & dir = pos->second;
+                boost::filesystem::path const name (event->name);
+                boost::filesystem::path const path = dir / name;
+                if (is_hidden (name)) {
+                    continue;
+                }
+                auto const parent = file_parents_.find (dir);
+                if (parent != std::end (file_parents_) && parent->second.count (name) == 0U &&
+                    (event->mask & IN_ISDIR) == 0U) {
+                    continue;
+                }
+
+                bool const is_dir = (event->mask & IN_ISDIR) != 0U;
+                if ((event->mask & (IN_DELETE | IN_MOVED_FROM)) != 0U) {
+                    c.modified.erase (path.string ());
+                    c.removed.insert (path.string ());
+                    if (is_dir && (event->mask & IN_MOVED_FROM) != 0U) {
+                        // The watches follow the directory to its new location. Their events
+                        // would be reported against the old path so drop them. If it was moved
+                        // within the tree, IN_MOVED_TO adds it again under its new name.
+                        this->remove_tree (path);
+                    }
+                } else if (is_dir && (event->mask & (IN_CREATE | IN_MOVED_TO)) != 0U) {
+                    if (parent == std::end (file_parents_) &&
+                        !boost::filesystem::is_symlink (path)) {
+                        this->add_tree (path, &c);
+                    }
+                } else if ((event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) != 0U) {
+                    c.removed.erase (path.string ());
+                    c.modified.insert (path.string ());
+                }
+            }
+        }
+    }
+
+    // wait
+    // ~~~~
+    auto watcher::wait (std::chrono::milliseconds debounce, std::chrono::milliseconds timeout)
+        -> changes {
+        changes c;
+        auto poll_for = [this](std::chrono::milliseconds ms) {
+            pollfd pfd;
+            pfd.fd = fd_;
+            pfd.events = POLLIN;
+            pfd.revents = 0;
+            for (;;) {
+                int const r =
+                    ::poll (&pfd, 1, ms.count () < 0 ? -1 : static_cast<int> (ms.count ()));
+                if (r >= 0) {
+                    return r > 0;
+                }
+                if (errno != EINTR) {
+                    throw std::system_error (errno, std::generic_category (), "poll inotify");
+                }
+            }
+        };
+
+        // Wait for the first event. Some events (such as those for hidden files) are dropped so
+        // keep waiting until there's a change to report.
+        while (c.empty ()) {
+            if (!poll_for (timeout)) {
+                return c;
+            }
+            this->read_events (c);
+        }
+        // A build usually writes many files in quick succession. Keep collecting until things
+        // have been quiet for the debounce period.
+        while (poll_for (debounce)) {
+            this->read_events (c);
+        }
+        return c;
+    }
+#else
+    watcher::watcher (std::vector<std::string> const &, output_flags const & ofl)
+            : ofl_ (ofl) {
+        throw exception ("--watch is not supported on this platform");
+    }
+    watcher::~watcher () {}
+    void watcher::add_tree (boost::filesystem::path const &, changes * const) {}
+    void watcher::add_directory (boost::filesystem::path const &) {}
+    void watcher::remove_tree (boost::filesystem::path const &) {}
+    void watcher::read_events (changes &) {}
+    auto watcher::wait (std::chrono::milliseconds, std::chrono::milliseconds) -> changes {
+        return {};
+    }
+#endif // __linux__
+
+} // end namespace watch
+
+// eof scanlib/watch.cpp
@@ -0,0 +1,225 @@
+// Copyright (c) 2016 by SN Systems Ltd., Sony Interactive Entertainment Inc.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef SCANLIB_WATCH_HPP
+#define SCANLIB_WATCH_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "comdat_scanner.hpp"
+#include "digests.hpp"
+
+struct output_flags;
+struct scan_flags;
+
+/// Support for the --watch option: the inputs are scanned once and then the COMDAT results are
+/// kept up to date as files under the input directories change.
+///
+/// Each input file's contribution to the results is remembered so that, when the file changes
+/// or is removed, its old contribution can be subtracted from the totals before the new one
+/// is added. A refresh therefore costs time in proportion to the number of files that changed
+/// rather than to the size of the tree.
+namespace watch {
+
+    class exception : public std::runtime_error {
+    public:
+        using std::runtime_error::runtime_error;
+    };
+
+
+    /// The results of scanning a single input file (which may be an archive and so produce
+    /// more than one input).
+    struct contribution {
+        /// The file's groups. Each value's 'inputs' member holds indices into 'inputs'.
+        comdat_scanner::comdat_map comdats;
+        std::vector<std::string> inputs;
+        std::vector<md5::digest> digests;
+    };
+
+    /// Scans the file at 'path' and returns its contribution to the results.
+    /// \throws exception  If the file could not be scanned.
+    contribution scan (boost::filesystem::path const & path, output_flags const & ofl,
+                       scan_flags const & sfl);
+
+
+    class live_results;
+    /// Scans the files named by 'paths' on up to 'threads' threads and records their
+    /// contributions in 'live'. A file which no longer exists or can't be scanned is removed
+    /// from the results.
+    void refresh (live_results & live, std::vector<std::string> const & paths, unsigned threads,
+                  output_flags const & ofl, scan_flags const & sfl);
+
+
+    // ****************
+    // * live results *
+    // ****************
+    /// The combined results of the files being watched.
+    class live_results {
+    public:
+        live_results () = default;
+
+        // No copying or assignment.
+        live_results (live_results const &) = delete;
+        live_results & operator= (live_results const &) = delete;
+
+        /// Records the contribution of the file at 'path', replacing any earlier contribution
+        /// from the same file.
+        void update (std::string const & path, contribution && c);
+        /// Removes the contribution of the file at 'path' or, if 'path' names a directory, of
+        /// every file beneath it.
+        /// \returns The number of files removed.
+        std::size_t remove (std::string const & path);
+
+        /// The number of files contributing to the results.
+        std::size_t files () const {
+            return files_.size ();
+        }
+        /// The paths of the files contributing to the results.
+        std::vector<std::string> paths () const;
+
+        /// The combined groups. The values' 'inputs' members hold slot numbers, in no
+        /// particular order, rather than indices into a list of inputs (see snapshot()).
+        comdat_scanner::comdat_map const & comdats () const {
+            return comdats_;
+        }
+        /// Returns the combined digest of all of the inputs (see digests::final()).
+        md5::digest digest ();
+
+        /// Produces a copy of the results in the form in which comdat_scanner records them:
+        /// 'inputs' is filled with the names of the inputs and each value's 'inputs' member
+        /// holds sorted indices into it.
+        void snapshot (comdat_scanner::comdat_map & cm, std::vector<std::string> & inputs) const;
+
+    private:
+        struct file_record {
+            contribution c;
+            /// The slot assigned to each member of c.inputs.
+            std::vector<std::uint32_t> slots;
+            /// For each of the file's inputs of each of its groups (taken in the order in which
+            /// c.comdats is visited), the position of its slot in the group's combined 'inputs'.
+            std::vector<std::uint32_t> positions;
+        };
+        using file_map = std::map<std::string, file_record>;
+
+        /// Identifies the member of file_record::positions which refers to an entry in a
+        /// group's combined 'inputs'.
+        struct posting {
+            file_record * owner;
+            std::uint32_t index;
+        };
+        /// What is needed, besides its comdat_scanner::value, to update a group in time which
+        /// doesn't depend on the number of files containing it.
+        struct group_state {
+            /// The owner of each entry in the group's 'inputs'.
+            std::vector<posting> postings;
+            /// The size of the largest instance from each file which contains the group.
+            std::multiset<std::uint64_t> largest;
+        };
+
+        void add (file_record & rec);
+        void subtract (file_record & rec);
+        /// Removes the entry at 'position' from val.inputs by moving the last entry into its
+        /// place.
+        static void erase_posting (comdat_scanner::value & val, group_state & group,
+                                   std::uint32_t position);
+
+        /// The contribution of each file. This is ordered so that the files beneath a directory
+        /// can be found quickly.
+        file_map files_;
+        comdat_scanner::comdat_map comdats_;
+        std::unordered_map<std::string, group_state> groups_;
+
+        /// Inputs are given a slot number which doesn't change while the file is unmodified. A
+        /// free slot has an empty name and no owner.
+        std::vector<std::string> slot_names_;
+        std::vector<file_record const *> slot_owners_;
+        std::vector<std::uint32_t> free_slots_;
+
+        digests digests_;
+    };
+
+
+    // ***********
+    // * watcher *
+    // ***********
+    /// Watches the input paths for changes. Directories are watched recursively, skipping hidden
+    /// directories and symbolic links as for_each_input_file() does.
+    class watcher {
+    public:
+        /// \param paths  The paths given on the command line. A file is watched through its
+        ///   parent directory.
+        /// \param ofl  Output flags.
+        watcher (std::vector<std::string> const & paths, output_flags const & ofl);
+        ~watcher ();
+
+        // No copying or assignment.
+        watcher (watcher const &) = delete;
+        watcher & operator= (watcher const &) = delete;
+
+        struct changes {
+            /// Files which were written or added.
+            std::set<std::string> modified;
+            /// Files and directories which were removed.
+            std::set<std::string> removed;
+            /// True if the kernel's event queue overflowed so that changes may have been missed.
+            /// Everything should be rescanned.
+            bool overflow = false;
+
+            bool empty () const {
+                return modified.empty () && removed.empty () && !overflow;
+            }
+        };
+
+        /// Waits for something to change and then continues to collect changes until none have
+        /// arrived for 'debounce'. Returns no changes if nothing changed within 'timeout'
+        /// (a negative value waits indefinitely).
+        changes wait (std::chrono::milliseconds debounce,
+                      std::chrono::milliseconds timeout = std::chrono::milliseconds{-1});
+
+    private:
+        /// Watches the directory 'dir' and those beneath it. If 'c' is not null, the files found
+        /// are recorded as modified (they may have been written before the watch was added).
+        void add_tree (boost::filesystem::path const & dir, changes * const c);
+        void add_directory (boost::filesystem::path const & dir);
+        /// Stops watching the directory 'dir' and those beneath it.
+        void remove_tree (boost::filesystem::path const & dir);
+        /// Reads the events available and adds them to 'c'.
+        void read_events (changes & c);
+
+        output_flags const & ofl_;
+        int fd_ = -1;
+        /// Maps a watch descriptor to the directory it watches.
+        std::unordered_map<int, boost::filesystem::path> dirs_;
+        /// Directories watched only because files within them were named on the command line.
+        /// Other files in these directories are ignored.
+        std::map<boost::filesystem::path, std::set<boost::filesystem::path>> file_parents_;
+    };
+
+} // end namespace watch
+
+#endif // SCANLIB_WATCH_HPP
+// eof scanlib/watch.hpp
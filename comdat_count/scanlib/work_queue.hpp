@@ -0,0 +1,429 @@
+// Copyright (c) 2016 by SN Systems Ltd., Sony Interactive Entertainment Inc.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef SCANLIB_WORK_QUEUE_HPP
+#define SCANLIB_WORK_QUEUE_HPP
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <boost/lockfree/queue.hpp>
+
+#include "append_arena.hpp"
+
+/// A work-stealing scheduler. Work items are gathered into batches by a producer and each batch
+/// is handed to one of the workers. A worker takes items from its own batches and, when it has
+/// none left, steals a batch from one of the others. Compared with a single shared queue, this
+/// means that the shared state is touched once per batch rather than once per item.
+///
+/// A whole batch may be more work than should be given to one thread: when there are few inputs,
+/// they may all fit in a single batch. A worker that can find no batch to steal therefore takes
+/// the upper half of the items remaining in the batch that another worker is busy with.
+///
+/// The items themselves live in an append-only arena owned by the queue so that storing one
+/// requires no lock.
+template <typename T>
+class work_queue {
+public:
+    static constexpr std::size_t batch_size = 32;
+    struct batch {
+        /// The number of members filled in by the producer.
+        std::size_t size = 0;
+        /// The members still to be taken: [next, end) packed as next | end << 32. The owning
+        /// worker takes items from the front and a thief from the back.
+        std::atomic<std::uint64_t> range{0U};
+        std::array<T const *, batch_size> members;
+    };
+
+    explicit work_queue (unsigned workers);
+    ~work_queue ();
+
+    // No copying or assignment.
+    work_queue (work_queue const &) = delete;
+    work_queue & operator= (work_queue const &) = delete;
+
+    /// Moves a value into the queue's storage. The returned pointer is valid for the lifetime of
+    /// the queue.
+    T const * store (T && value) {
+        return storage_.append (std::move (value));
+    }
+
+    /// The number of items that have been stored and the item with the given index. Items are
+    /// numbered in the order in which they were stored.
+    std::size_t stored () const {
+        return storage_.size ();
+    }
+    T const & stored (std::size_t index) const {
+        return storage_[index];
+    }
+
+    unsigned workers () const {
+        return static_cast<unsigned> (workers_.size ());
+    }
+
+    /// The worker to which a producer starting with worker 0 deals the item with the given
+    /// index, assuming that it stored and pushed every item in the queue. Unless it is stolen,
+    /// the worker takes its items in index order.
+    static unsigned dealt_to (std::size_t index, unsigned workers) {
+        return static_cast<unsigned> ((index / batch_size) % workers);
+    }
+
+
+    // producer
+    // ~~~~~~~~
+    /// Gathers items into batches before handing them to the queue. Any thread may push work but
+    /// each must use its own producer. A worker which pushes work must flush its producer before
+    /// it next calls pop().
+    class producer {
+    public:
+        explicit producer (work_queue & queue, unsigned first_worker = 0U)
+                : queue_ (queue)
+                , next_ (first_worker) {}
+        ~producer () {
+            this->flush ();
+        }
+
+        // No copying or assignment.
+        producer (producer const &) = delete;
+        producer & operator= (producer const &) = delete;
+
+        void push (T const * member);
+        void flush ();
+
+    private:
+        work_queue & queue_;
+        std::unique_ptr<batch> batch_;
+        unsigned next_;
+    };
+
+
+    /// Indicates that no further work will be pushed other than by the workers themselves. Once
+    /// the queue is closed and every item has been processed, pop() will return false.
+    void close () {
+        closed_.store (true);
+        this->wake_all ();
+    }
+    /// Abandons any remaining work: pop() will return false in every worker.
+    void cancel () {
+        cancelled_.store (true);
+        this->wake_all ();
+    }
+
+    /// Called by worker number 'worker' to get its next item. Calling pop() also signals that
+    /// the worker has finished with the item previously returned. If no item is available, the
+    /// caller blocks until one is pushed or the queue is finished. Returns false when there is
+    /// no more work to be done.
+    bool pop (unsigned worker, T const *& member) {
+        return this->pop (worker, member, []() { return false; });
+    }
+
+    /// As pop() but a worker waiting for an item also stops waiting and returns false once
+    /// 'interrupt' returns true. This lets a worker wait for work from another source at the same
+    /// time: that source must call wake() whenever the result of 'interrupt' may have changed.
+    /// If pop() returns false, finished() distinguishes the two cases.
+    template <typename Predicate>
+    bool pop (unsigned worker, T const *& member, Predicate interrupt);
+
+    /// Wakes all of the workers waiting in pop() so that they test their 'interrupt' predicate.
+    void wake () {
+        this->wake_all ();
+    }
+
+    /// Returns true if pop() will return false: the queue was cancelled or is closed and all of
+    /// its work is done.
+    bool finished () const {
+        return cancelled_.load () || (closed_.load () && outstanding_.load () == 0U);
+    }
+
+    /// Signals that worker number 'worker' has finished with the item most recently returned by
+    /// pop(). pop() does this itself but a worker which goes on to do something else first must
+    /// call release() so that idle workers aren't kept waiting for the item.
+    void release (unsigned worker);
+
+private:
+    struct worker_state {
+        worker_state ()
+                : batches (64) {}
+        boost::lockfree::queue<batch *> batches;
+        /// The batch from which this worker is taking items. Only the owner changes it but it
+        /// must hold current_mut to do so since thieves split the batch under the same lock.
+        std::unique_ptr<batch> current;
+        std::mutex current_mut;
+        // Touched only by the owning worker.
+        bool in_flight = false;
+    };
+
+    static std::uint64_t pack_range (std::uint64_t next, std::uint64_t end) {
+        return next | (end << 32);
+    }
+    static bool take_item (batch & b, T const *& member);
+    static std::unique_ptr<batch> split_batch (batch & b);
+    static std::size_t remaining (batch const & b) {
+        auto const r = b.range.load ();
+        return static_cast<std::size_t> ((r >> 32) - (r & 0xFFFFFFFFU));
+    }
+
+    void push_batch (std::unique_ptr<batch> b, unsigned worker);
+    std::unique_ptr<batch> take_batch (unsigned worker);
+    std::unique_ptr<batch> steal_items (unsigned worker);
+
+    /// Wakes workers blocked in pop(). Taking the mutex (under which a worker checks for work
+    /// before waiting) ensures that a change made before the call can't be missed.
+    void wake_one () {
+        { std::lock_guard<std::mutex> const lock (mut_); }
+        cv_.notify_one ();
+    }
+    void wake_all () {
+        { std::lock_guard<std::mutex> const lock (mut_); }
+        cv_.notify_all ();
+    }
+
+    append_arena<T> storage_;
+    std::vector<std::unique_ptr<worker_state>> workers_;
+    /// The number of items that have been pushed but not yet finished.
+    std::atomic<std::size_t> outstanding_;
+    std::atomic<bool> closed_;
+    std::atomic<bool> cancelled_;
+    /// Used by idle workers to wait for work or for the queue to finish.
+    std::mutex mut_;
+    std::condition_variable cv_;
+};
+
+template <typename T>
+constexpr std::size_t work_queue<T>::batch_size;
+
+// (ctor)
+// ~~~~~~
+template <typename T>
+work_queue<T>::work_queue (unsigned workers)
+        : storage_ ()
+        , workers_ ()
+        , outstanding_ (0U)
+        , closed_ (false)
+        , cancelled_ (false)
+        , mut_ ()
+        , cv_ () {
+    assert (workers > 0U);
+    workers_.reserve (workers);
+    while (workers-- > 0U) {
+        workers_.emplace_back (new worker_state);
+    }
+}
+
+// (dtor)
+// ~~~~~~
+template <typename T>
+work_queue<T>::~work_queue () {
+    for (auto & w : workers_) {
+        w->batches.consume_all ([](batch * b) { delete b; });
+    }
+}
+
+// push_batch
+// ~~~~~~~~~~
+template <typename T>
+void work_queue<T>::push_batch (std::unique_ptr<batch> b, unsigned worker) {
+    assert (b && b->size > 0U);
+    b->range.store (pack_range (0U, b->size));
+    // Count the work before it becomes visible so that a worker can never see the count reach
+    // zero while these items are still to be done.
+    outstanding_.fetch_add (b->size);
+    workers_[worker % workers_.size ()]->batches.push (b.get ());
+    b.release ();
+    // Any idle worker can steal the batch so one is enough.
+    this->wake_one ();
+}
+
+// take_item
+// ~~~~~~~~~
+/// Takes the first remaining member of batch 'b'. Returns false if it is empty.
+template <typename T>
+bool work_queue<T>::take_item (batch & b, T const *& member) {
+    auto r = b.range.load ();
+    for (;;) {
+        auto const next = r & 0xFFFFFFFFU;
+        auto const end = r >> 32;
+        if (next >= end) {
+            return false;
+        }
+        if (b.range.compare_exchange_weak (r, pack_range (next + 1U, end))) {
+            member = b.members[next];
+            return true;
+        }
+    }
+}
+
+// split_batch
+// ~~~~~~~~~~~
+/// Removes the upper half of the members remaining in batch 'b' and returns them as a new batch.
+/// Returns null if 'b' is empty.
+template <typename T>
+auto work_queue<T>::split_batch (batch & b) -> std::unique_ptr<batch> {
+    auto r = b.range.load ();
+    for (;;) {
+        auto const next = r & 0xFFFFFFFFU;
+        auto const end = r >> 32;
+        if (next >= end) {
+            return nullptr;
+        }
+        // Round up so that a single remaining item can be taken by an idle worker while the
+        // owner is still busy with its predecessor.
+        auto const first = end - (end - next + 1U) / 2U;
+        if (b.range.compare_exchange_weak (r, pack_range (next, first))) {
+            std::unique_ptr<batch> result (new batch);
+            result->size = static_cast<std::size_t> (end - first);
+            std::copy (std::begin (b.members) + first, std::begin (b.members) + end,
+                       std::begin (result->members));
+            result->range.store (pack_range (0U, result->size));
+            return result;
+        }
+    }
+}
+
+// take_batch
+// ~~~~~~~~~~
+/// Takes a batch from this worker's own queue or, failing that, steals one from another. If
+/// there are no batches waiting, takes half of the items from one that another worker is
+/// processing.
+template <typename T>
+auto work_queue<T>::take_batch (unsigned worker) -> std::unique_ptr<batch> {
+    auto const num_workers = workers_.size ();
+    batch * b = nullptr;
+    for (std::size_t ctr = 0; ctr < num_workers; ++ctr) {
+        if (workers_[(worker + ctr) % num_workers]->batches.pop (b)) {
+            return std::unique_ptr<batch> (b);
+        }
+    }
+    return this->steal_items (worker);
+}
+
+// steal_items
+// ~~~~~~~~~~~
+template <typename T>
+auto work_queue<T>::steal_items (unsigned worker) -> std::unique_ptr<batch> {
+    auto const num_workers = workers_.size ();
+    for (std::size_t ctr = 1; ctr < num_workers; ++ctr) {
+        worker_state & victim = *workers_[(worker + ctr) % num_workers];
+        std::lock_guard<std::mutex> const lock (victim.current_mut);
+        if (victim.current) {
+            if (std::unique_ptr<batch> b = split_batch (*victim.current)) {
+                return b;
+            }
+        }
+    }
+    return nullptr;
+}
+
+// release
+// ~~~~~~~
+template <typename T>
+void work_queue<T>::release (unsigned worker) {
+    assert (worker < workers_.size ());
+    worker_state & ws = *workers_[worker];
+    if (ws.in_flight) {
+        ws.in_flight = false;
+        if (outstanding_.fetch_sub (1U) == 1U) {
+            // That was the last item: workers waiting for it to finish may be able to exit.
+            this->wake_all ();
+        }
+    }
+}
+
+// pop
+// ~~~
+template <typename T>
+template <typename Predicate>
+bool work_queue<T>::pop (unsigned worker, T const *& member, Predicate interrupt) {
+    assert (worker < workers_.size ());
+    worker_state & ws = *workers_[worker];
+    this->release (worker);
+
+    for (;;) {
+        if (cancelled_.load ()) {
+            return false;
+        }
+        if (ws.current && take_item (*ws.current, member)) {
+            ws.in_flight = true;
+            return true;
+        }
+
+        std::unique_ptr<batch> b = this->take_batch (worker);
+        if (!b) {
+            // There's nothing available but other workers may yet push more work. We're finished
+            // only when the queue is closed and nothing is outstanding. Until then, sleep. The
+            // checks are repeated under the lock so that a wake-up can't be lost.
+            std::unique_lock<std::mutex> lock (mut_);
+            while (!(b = this->take_batch (worker))) {
+                if (this->finished () || interrupt ()) {
+                    return false;
+                }
+                cv_.wait (lock);
+            }
+        }
+        bool const shareable = remaining (*b) > 1U;
+        {
+            std::lock_guard<std::mutex> const lock (ws.current_mut);
+            ws.current.swap (b);
+        }
+        // (The old batch, now in 'b', is destroyed outside the lock.)
+        if (shareable) {
+            // Some of these items can be taken by a worker that is waiting for work.
+            this->wake_one ();
+        }
+    }
+}
+
+
+// *******************
+// * queue::producer *
+// *******************
+// push
+// ~~~~
+template <typename T>
+void work_queue<T>::producer::push (T const * member) {
+    if (!batch_) {
+        batch_.reset (new batch);
+    }
+    batch_->members[batch_->size++] = member;
+    if (batch_->size == batch_size) {
+        this->flush ();
+    }
+}
+
+// flush
+// ~~~~~
+template <typename T>
+void work_queue<T>::producer::flush () {
+    if (batch_ && batch_->size > 0U) {
+        // Deal the batches out to the workers in turn.
+        queue_.push_batch (std::move (batch_), next_++);
+    }
+}
+
+#endif // SCANLIB_WORK_QUEUE_HPP
+// eof scanlib/work_queue.hpp
@@ -19,35 +19,11 @@
 // THE SOFTWARE.
 
 #include "zipper.hpp"
-#include <fstream>
+#include <algorithm>
+#include <cassert>
 #include <sstream>
 #include <system_error>
 
-namespace {
-    class file {
-    public:
-        explicit file (unzFile uf, boost::filesystem::path const & zip_path);
-        ~file ();
-
-    private:
-        unzFile uf_;
-    };
-
-    file::file (unzFile uf, boost::filesystem::path const & zip_path)
-            : uf_ (uf) {
-        assert (uf != nullptr);
-        int err = unzOpenCurrentFile (uf);
-        if (err != UNZ_OK) {
-            zipper::throw_unzip_error (err, zip_path);
-        }
-    }
-    file::~file () {
-        ::unzCloseCurrentFile (uf_);
-        // (discard any error)
-    }
-}
-
-
 namespace zipper {
     // -----------------
     // exception
@@ -118,41 +94,33 @@ namespace zipper {
     }
 
 
-    // -------
-    // extract
-    // -------
-    void extract (unzFile uf, char const * member_name, boost::filesystem::path const & dest,
-                  boost::filesystem::path const & zip_path) {
-
-        assert (member_name != nullptr);
-
-        std::ofstream out (dest.native (), std::ios::binary | std::ios::out | std::ios::trunc);
-        if (!out.is_open ()) {
-            std::ostringstream str;
-            str << "Could not open " << dest;
-            throw std::runtime_error (str.str ());
-        }
-        // The library will now throw if we can't write to the file.
-        out.exceptions (std::ofstream::failbit | std::ofstream::badbit);
-
-        int err = unzLocateFile (uf, member_name, 1 /* case sensitive compare */);
+    // ------------
+    // current file
+    // ------------
+    current_file::current_file (unzFile uf, boost::filesystem::path const & zip_path)
+            : uf_ (uf)
+            , zip_path_ (zip_path) {
+        assert (uf != nullptr);
+        int const err = unzOpenCurrentFile (uf);
         if (err != UNZ_OK) {
             throw_unzip_error (err, zip_path);
         }
+    }
 
-        static constexpr unsigned buffer_size = 65535;
-        std::vector<char> buf (buffer_size);
-        file current_file (uf, zip_path);
-        for (;;) {
-            int copied = unzReadCurrentFile (uf, buf.data (), buffer_size);
-            if (copied == 0) {
-                break;
-            } else if (copied < 0) {
-                throw_unzip_error (err, zip_path);
-            }
+    current_file::~current_file () {
+        ::unzCloseCurrentFile (uf_);
+        // (discard any error)
+    }
 
-            out.write (buf.data (), copied);
+    std::size_t current_file::read (void * buffer, std::size_t size) {
+        // unzReadCurrentFile() takes an unsigned count and returns an int.
+        static constexpr std::size_t max_read = 1U << 30;
+        int const copied =
+            unzReadCurrentFile (uf_, buffer, static_cast<unsigned> (std::min (size, max_read)));
+        if (copied < 0) {
+            throw_unzip_error (copied, zip_path_);
         }
+        return static_cast<std::size_t> (copied);
     }
 
 } // namespace zipper
@@ -52,8 +52,25 @@ namespace zipper {
     void throw_unzip_error (char const * msg, boost::filesystem::path const & zip_path);
     void throw_unzip_error (std::string const & msg, boost::filesystem::path const & zip_path);
 
-    void extract (unzFile uf, char const * member_name, boost::filesystem::path const & dest,
-                  boost::filesystem::path const & zip_path);
+    /// Opens the zip member at the current position in 'uf' and closes it again on
+    /// destruction.
+    class current_file {
+    public:
+        current_file (unzFile uf, boost::filesystem::path const & zip_path);
+        ~current_file ();
+
+        // No copying or assignment.
+        current_file (current_file const &) = delete;
+        current_file & operator= (current_file const &) = delete;
+
+        /// Reads up to 'size' bytes of the member's uncompressed contents.
+        /// \returns The number of bytes read: 0 at the end of the member.
+        std::size_t read (void * buffer, std::size_t size);
+
+    private:
+        unzFile uf_;
+        boost::filesystem::path const & zip_path_;
+    };
 
 } // namespace zipper
 
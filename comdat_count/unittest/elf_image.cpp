@@ -0,0 +1,156 @@
+// Copyright (c) 2016 by SN Systems Ltd., Sony Interactive Entertainment Inc.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "elf_image.hpp"
+
+#include <algorithm>
+#include <iterator>
+#include <string>
+
+// (ctor)
+// ~~~~~~
+image_builder::image_builder (bool is64, bool le)
+        : is64_ (is64)
+        , le_ (le) {
+    sections_.push_back ({0, 0, 0, {}}); // The null section.
+}
+
+// add
+// ~~~
+std::uint32_t image_builder::add (std::uint32_t type, std::vector<std::uint8_t> const & data,
+                                  std::uint32_t link, std::uint32_t info) {
+    sections_.push_back ({type, link, info, data});
+    return static_cast<std::uint32_t> (sections_.size () - 1U);
+}
+
+// words
+// ~~~~~
+std::vector<std::uint8_t> image_builder::words (std::vector<std::uint32_t> const & w) const {
+    std::vector<std::uint8_t> result;
+    for (auto v : w) {
+        this->put (result, v, 4);
+    }
+    return result;
+}
+
+// symbol
+// ~~~~~~
+std::vector<std::uint8_t> image_builder::symbol (std::uint32_t name) const {
+    std::vector<std::uint8_t> result;
+    this->put (result, name, 4);
+    if (is64_) {
+        result.resize (24U, 0U);
+    } else {
+        result.resize (16U, 0U);
+    }
+    return result;
+}
+
+// build
+// ~~~~~
+std::vector<std::uint8_t> image_builder::build () const {
+    std::size_t const ehsize = is64_ ? 64U : 52U;
+    std::size_t const shentsize = is64_ ? 64U : 40U;
+
+    std::vector<std::uint8_t> data;
+    std::vector<std::uint64_t> offsets;
+    data.resize (ehsize);
+    for (auto const & s : sections_) {
+        offsets.push_back (data.size ());
+        data.insert (data.end (), s.data.begin (), s.data.end ());
+    }
+    while (data.size () % 8U != 0U) {
+        data.push_back (0U);
+    }
+    std::uint64_t const shoff = data.size ();
+
+    for (std::size_t index = 0; index < sections_.size (); ++index) {
+        section const & s = sections_[index];
+        std::uint64_t const offset = index == 0 ? 0U : offsets[index];
+        this->put (data, 0U, 4);     // sh_name
+        this->put (data, s.type, 4); // sh_type
+        this->put (data, 0U, is64_ ? 8 : 4); // sh_flags
+        this->put (data, 0U, is64_ ? 8 : 4); // sh_addr
+        this->put (data, offset, is64_ ? 8 : 4);
+        this->put (data, s.data.size (), is64_ ? 8 : 4);
+        this->put (data, s.link, 4);
+        this->put (data, s.info, 4);
+        this->put (data, 1U, is64_ ? 8 : 4); // sh_addralign
+        this->put (data, 0U, is64_ ? 8 : 4); // sh_entsize
+    }
+
+    // Now the file header.
+    std::uint8_t const ident[] = {0x7f,
+                                  'E',
+                                  'L',
+                                  'F',
+                                  static_cast<std::uint8_t> (is64_ ? 2 : 1), // EI_CLASS
+                                  static_cast<std::uint8_t> (le_ ? 1 : 2),   // EI_DATA
+                                  1};                                        // EI_VERSION
+    std::vector<std::uint8_t> header (std::begin (ident), std::end (ident));
+    header.resize (16U, 0U);
+    this->put (header, 1U, 2); // e_type (ET_REL)
+    this->put (header, 62U, 2); // e_machine
+    this->put (header, 1U, 4); // e_version
+    this->put (header, 0U, is64_ ? 8 : 4); // e_entry
+    this->put (header, 0U, is64_ ? 8 : 4); // e_phoff
+    this->put (header, shoff, is64_ ? 8 : 4);
+    this->put (header, 0U, 4); // e_flags
+    this->put (header, ehsize, 2);
+    this->put (header, 0U, 2); // e_phentsize
+    this->put (header, 0U, 2); // e_phnum
+    this->put (header, shentsize, 2);
+    this->put (header, sections_.size (), 2);
+    this->put (header, 0U, 2); // e_shstrndx
+    std::copy (header.begin (), header.end (), data.begin ());
+    return data;
+}
+
+// put
+// ~~~
+void image_builder::put (std::vector<std::uint8_t> & out, std::uint64_t v, unsigned size) const {
+    for (unsigned ctr = 0; ctr < size; ++ctr) {
+        unsigned const shift = le_ ? ctr * 8U : (size - ctr - 1U) * 8U;
+        out.push_back (static_cast<std::uint8_t> (v >> shift));
+    }
+}
+
+// two_groups
+// ~~~~~~~~~~
+std::vector<std::uint8_t> two_groups (bool is64, bool le) {
+    image_builder b (is64, le);
+    std::string const strings ("\0foo\0bar\0", 9);
+    std::uint32_t const a = b.add (1, std::vector<std::uint8_t> (10U));
+    std::uint32_t const c = b.add (1, std::vector<std::uint8_t> (6U));
+    std::uint32_t const strtab = b.add (
+        elf_view::sht_strtab, std::vector<std::uint8_t> (strings.begin (), strings.end ()));
+
+    std::vector<std::uint8_t> symbols = b.symbol (0);
+    auto const foo = b.symbol (1);
+    auto const bar = b.symbol (5);
+    symbols.insert (symbols.end (), foo.begin (), foo.end ());
+    symbols.insert (symbols.end (), bar.begin (), bar.end ());
+    std::uint32_t const symtab = b.add (2, symbols, strtab);
+
+    b.add (elf_view::sht_group, b.words ({elf_view::grp_comdat, a, c}), symtab, 1);
+    b.add (elf_view::sht_group, b.words ({0, a}), symtab, 2);
+    return b.build ();
+}
+// eof unittest/elf_image.cpp
@@ -0,0 +1,72 @@
+// Copyright (c) 2016 by SN Systems Ltd., Sony Interactive Entertainment Inc.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef UNITTEST_ELF_IMAGE_HPP
+#define UNITTEST_ELF_IMAGE_HPP
+
+#include <cstdint>
+#include <vector>
+
+#include "elf_view.hpp"
+
+// *****************
+// * image_builder *
+// *****************
+/// Builds a minimal ELF relocatable file image in memory.
+class image_builder {
+public:
+    image_builder (bool is64, bool le);
+
+    /// Adds a section and returns its index.
+    std::uint32_t add (std::uint32_t type, std::vector<std::uint8_t> const & data,
+                       std::uint32_t link = 0, std::uint32_t info = 0);
+
+    std::vector<std::uint8_t> words (std::vector<std::uint32_t> const & w) const;
+
+    /// Returns a symbol table entry whose name is at offset 'name' in the string table.
+    std::vector<std::uint8_t> symbol (std::uint32_t name) const;
+
+    std::vector<std::uint8_t> build () const;
+
+private:
+    struct section {
+        std::uint32_t type;
+        std::uint32_t link;
+        std::uint32_t info;
+        std::vector<std::uint8_t> data;
+    };
+
+    void put (std::vector<std::uint8_t> & out, std::uint64_t v, unsigned size) const;
+
+    bool const is64_;
+    bool const le_;
+    std::vector<section> sections_;
+};
+
+inline elf_view::span as_span (std::vector<std::uint8_t> const & v) {
+    return {v.data (), v.size ()};
+}
+
+/// Builds a file containing a COMDAT group "foo" with members of 10 and 6 bytes and a
+/// non-COMDAT group "bar".
+std::vector<std::uint8_t> two_groups (bool is64, bool le);
+
+#endif // UNITTEST_ELF_IMAGE_HPP
+// eof unittest/elf_image.hpp
@@ -0,0 +1,86 @@
+// Copyright (c) 2016 by SN Systems Ltd., Sony Interactive Entertainment Inc.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "tar_builder.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#include <zlib.h>
+
+#include "tar_stream.hpp"
+
+// add
+// ~~~
+tar_builder & tar_builder::add (std::string const & name, std::string const & contents,
+                                char type, std::string const & prefix) {
+    std::string header (tar::reader::block_size, '\0');
+    header.replace (0, name.size (), name);
+    std::snprintf (&header[124], 12, "%011o", static_cast<unsigned> (contents.size ()));
+    header[156] = type;
+    header.replace (257, 6, std::string ("ustar\0", 6));
+    header.replace (263, 2, "00");
+    header.replace (345, prefix.size (), prefix);
+
+    // Compute the checksum with the field filled with spaces.
+    header.replace (148, 8, std::string (8, ' '));
+    unsigned sum = 0;
+    for (char c : header) {
+        sum += static_cast<unsigned char> (c);
+    }
+    std::snprintf (&header[148], 8, "%06o", sum);
+
+    tar_ += header + contents;
+    tar_.append ((tar::reader::block_size - contents.size () % tar::reader::block_size) %
+                     tar::reader::block_size,
+                 '\0');
+    return *this;
+}
+
+// build
+// ~~~~~
+std::string tar_builder::build () const {
+    return tar_ + std::string (2 * tar::reader::block_size, '\0');
+}
+
+// gzip
+// ~~~~
+std::string gzip (std::string const & in) {
+    z_stream zs;
+    std::memset (&zs, 0, sizeof (zs));
+    deflateInit2 (&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY);
+    std::string out (deflateBound (&zs, static_cast<uLong> (in.size ())), '\0');
+    zs.next_in = reinterpret_cast<Bytef *> (const_cast<char *> (in.data ()));
+    zs.avail_in = static_cast<uInt> (in.size ());
+    zs.next_out = reinterpret_cast<Bytef *> (&out[0]);
+    zs.avail_out = static_cast<uInt> (out.size ());
+    deflate (&zs, Z_FINISH);
+    out.resize (zs.total_out);
+    deflateEnd (&zs);
+    return out;
+}
+
+// write file
+// ~~~~~~~~~~
+void write_file (boost::filesystem::path const & path, std::string const & contents) {
+    std::ofstream (path.string (), std::ios::binary) << contents;
+}
+// eof unittest/tar_builder.cpp
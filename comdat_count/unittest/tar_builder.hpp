@@ -0,0 +1,46 @@
+// Copyright (c) 2016 by SN Systems Ltd., Sony Interactive Entertainment Inc.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef UNITTEST_TAR_BUILDER_HPP
+#define UNITTEST_TAR_BUILDER_HPP
+
+#include <string>
+
+#include <boost/filesystem/path.hpp>
+
+/// Builds tar files in memory.
+class tar_builder {
+public:
+    tar_builder & add (std::string const & name, std::string const & contents, char type = '0',
+                       std::string const & prefix = std::string ());
+    std::string build () const;
+
+private:
+    std::string tar_;
+};
+
+/// Compresses 'in' as a gzip member.
+std::string gzip (std::string const & in);
+
+/// Writes 'contents' to a new file at 'path'.
+void write_file (boost::filesystem::path const & path, std::string const & contents);
+
+#endif // UNITTEST_TAR_BUILDER_HPP
+// eof unittest/tar_builder.hpp
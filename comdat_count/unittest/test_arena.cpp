@@ -0,0 +1,71 @@
+// Copyright (c) 2016 by SN Systems Ltd., Sony Interactive Entertainment Inc.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "arena.hpp"
+
+#include <cstdint>
+#include <vector>
+
+#include <gmock/gmock.h>
+
+TEST (Arena, Alignment) {
+    monotonic_arena arena (64);
+    arena.allocate (1, 1);
+    void * const p = arena.allocate (8, 8);
+    EXPECT_EQ (0U, reinterpret_cast<std::uintptr_t> (p) % 8U);
+}
+
+TEST (Arena, LargeAllocation) {
+    monotonic_arena arena (64);
+    auto * const p = static_cast<char *> (arena.allocate (1000, 1));
+    p[999] = 'x';
+    EXPECT_EQ (1U, arena.blocks ());
+}
+
+TEST (Arena, ResetReusesBlocks) {
+    monotonic_arena arena (256);
+    for (int ctr = 0; ctr < 10; ++ctr) {
+        arena.allocate (100, 8);
+    }
+    auto const blocks = arena.blocks ();
+    EXPECT_GT (blocks, 1U);
+
+    // After a reset, the same pattern of allocations doesn't need any new blocks.
+    arena.reset ();
+    for (int ctr = 0; ctr < 10; ++ctr) {
+        arena.allocate (100, 8);
+    }
+    EXPECT_EQ (blocks, arena.blocks ());
+}
+
+TEST (Arena, Allocator) {
+    monotonic_arena arena;
+    using allocator = arena_allocator<int>;
+    std::vector<int, allocator> v{allocator (&arena)};
+    for (int ctr = 0; ctr < 1000; ++ctr) {
+        v.push_back (ctr);
+    }
+    for (int ctr = 0; ctr < 1000; ++ctr) {
+        EXPECT_EQ (ctr, v[ctr]);
+    }
+    EXPECT_EQ (allocator (&arena), arena_allocator<char> (&arena));
+}
+
+// eof test_arena.cpp
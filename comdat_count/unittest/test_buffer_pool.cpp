@@ -0,0 +1,105 @@
+// Copyright (c) 2016 by SN Systems Ltd., Sony Interactive Entertainment Inc.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "buffer_pool.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include <gmock/gmock.h>
+
+TEST (BufferPool, SizeClass) {
+    EXPECT_EQ (buffer_pool::min_class, buffer_pool::size_class (0U));
+    EXPECT_EQ (buffer_pool::min_class, buffer_pool::size_class (4096U));
+    EXPECT_EQ (buffer_pool::min_class + 1U, buffer_pool::size_class (4097U));
+    EXPECT_EQ (20U, buffer_pool::size_class (1024U * 1024U));
+}
+
+TEST (BufferPool, ReusesReleasedBuffers) {
+    buffer_pool pool (1024U * 1024U);
+    buffer_pool::buffer b1 = pool.acquire (5000U);
+    ASSERT_TRUE (static_cast<bool> (b1));
+    EXPECT_EQ (8192U, b1.capacity ());
+    EXPECT_EQ (8192U, pool.outstanding ());
+    std::uint8_t const * const data = b1.data ();
+    pool.release (std::move (b1));
+    EXPECT_EQ (0U, pool.outstanding ());
+    EXPECT_EQ (8192U, pool.cached ());
+
+    // A request in the same size class gets the same memory back.
+    buffer_pool::buffer b2 = pool.acquire (6000U);
+    EXPECT_EQ (data, b2.data ());
+    EXPECT_EQ (0U, pool.cached ());
+    pool.release (std::move (b2));
+}
+
+TEST (BufferPool, CacheStaysWithinBudget) {
+    buffer_pool pool (16384U);
+    buffer_pool::buffer b = pool.acquire (16384U);
+    pool.release (std::move (b));
+    EXPECT_EQ (16384U, pool.cached ());
+
+    // A buffer of a different class displaces the cached one.
+    b = pool.acquire (4096U);
+    EXPECT_EQ (0U, pool.cached ());
+    pool.release (std::move (b));
+}
+
+TEST (BufferPool, OversizeRequest) {
+    buffer_pool pool (4096U);
+    // Larger than the budget but nothing else is outstanding.
+    buffer_pool::buffer b = pool.acquire (100000U);
+    ASSERT_TRUE (static_cast<bool> (b));
+    EXPECT_GE (b.capacity (), 100000U);
+    pool.release (std::move (b));
+    // Not kept: it would exceed the budget.
+    EXPECT_EQ (0U, pool.cached ());
+}
+
+TEST (BufferPool, WaitsForRelease) {
+    buffer_pool pool (4096U);
+    buffer_pool::buffer b1 = pool.acquire (4096U);
+
+    std::atomic<bool> acquired{false};
+    std::thread t ([&pool, &acquired]() {
+        buffer_pool::buffer b2 = pool.acquire (4096U);
+        acquired = true;
+        pool.release (std::move (b2));
+    });
+    std::this_thread::sleep_for (std::chrono::milliseconds (20));
+    EXPECT_FALSE (acquired);
+    pool.release (std::move (b1));
+    t.join ();
+    EXPECT_TRUE (acquired);
+}
+
+TEST (BufferPool, CancelWakesWaiters) {
+    buffer_pool pool (4096U);
+    buffer_pool::buffer b1 = pool.acquire (4096U);
+
+    bool empty = false;
+    std::thread t ([&pool, &empty]() { empty = !pool.acquire (4096U); });
+    pool.cancel ();
+    t.join ();
+    EXPECT_TRUE (empty);
+    pool.release (std::move (b1));
+}
+// eof unittest/test_buffer_pool.cpp
@@ -0,0 +1,69 @@
+// Copyright (c) 2016 by SN Systems Ltd., Sony Interactive Entertainment Inc.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "buffered_writer.hpp"
+
+#include <limits>
+#include <sstream>
+#include <string>
+
+#include <gmock/gmock.h>
+
+namespace {
+    std::string to_string (std::uint64_t v) {
+        char buffer[buffered_writer::max_uint_chars];
+        return std::string (buffer, buffered_writer::to_chars (buffer, v));
+    }
+}
+
+TEST (BufferedWriter, ToChars) {
+    EXPECT_EQ ("0", to_string (0U));
+    EXPECT_EQ ("7", to_string (7U));
+    EXPECT_EQ ("10", to_string (10U));
+    EXPECT_EQ ("99", to_string (99U));
+    EXPECT_EQ ("100", to_string (100U));
+    EXPECT_EQ ("1000000007", to_string (1000000007U));
+    EXPECT_EQ ("18446744073709551615", to_string (std::numeric_limits<std::uint64_t>::max ()));
+    for (std::uint64_t v = 1; v < std::numeric_limits<std::uint64_t>::max () / 3U; v *= 3U) {
+        EXPECT_EQ (std::to_string (v), to_string (v));
+    }
+}
+
+TEST (BufferedWriter, FlushesWhenFull) {
+    std::ostringstream os;
+    {
+        // A tiny buffer so that every kind of write has to flush.
+        buffered_writer w (os, 1U);
+        w.write ("abc").put (' ').write_uint (1234567890U).put (' ');
+        w.write (std::string (100, 'x'));
+        w.put ('\n');
+    }
+    EXPECT_EQ ("abc 1234567890 " + std::string (100, 'x') + '\n', os.str ());
+}
+
+TEST (BufferedWriter, NothingWrittenUntilFlush) {
+    std::ostringstream os;
+    buffered_writer w (os);
+    w.write ("abc");
+    EXPECT_EQ ("", os.str ());
+    w.flush ();
+    EXPECT_EQ ("abc", os.str ());
+}
+// eof unittest/test_buffered_writer.cpp
@@ -0,0 +1,316 @@
+// Copyright (c) 2016 by SN Systems Ltd., Sony Interactive Entertainment Inc.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "checkpoint.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gmock/gmock.h>
+
+#include "comdat_scanner.hpp"
+#include "consumer.hpp"
+#include "elf_image.hpp"
+#include "elf_view.hpp"
+#include "flags.hpp"
+#include "input_set.hpp"
+#include "producer.hpp"
+#include "progress.hpp"
+#include "results.hpp"
+#include "tar_builder.hpp"
+#include "temp_files.hpp"
+
+namespace {
+    using comdat_map = comdat_scanner::comdat_map;
+
+    class Checkpoint : public ::testing::Test {
+    protected:
+        Checkpoint ()
+                : path_ (temp_dir_.path () / "checkpoint") {}
+
+        /// Gives 'scanner' the results of scanning two inputs in each of two shards.
+        static void populate (comdat_scanner & scanner) {
+            comdat_map first;
+            first["foo"] = comdat_scanner::value{30, 20, 2, {0, 1}};
+            first["bar"] = comdat_scanner::value{5, 5, 1, {1}};
+            scanner.restore (std::move (first), {"a.o", "b.o"});
+            comdat_map second;
+            second["foo"] = comdat_scanner::value{20, 20, 1, {0}};
+            scanner.restore (std::move (second), {"c.o"});
+
+            md5::digest d;
+            std::fill (std::begin (d), std::end (d), 0x5a);
+            scanner.restore_digests ({d, d, d});
+        }
+
+        /// Writes 'count' object files to the temporary directory and returns their paths.
+        /// Each has the COMDAT group "common" and one of three others.
+        std::vector<std::string> write_objects (unsigned count) const {
+            std::vector<std::string> paths;
+            for (unsigned ctr = 0; ctr < count; ++ctr) {
+                image_builder b (true, true);
+                std::string const strings ("\0common\0g0\0g1\0g2\0", 19);
+                std::uint32_t const a = b.add (1, std::vector<std::uint8_t> (8U + ctr));
+                std::uint32_t const strtab = b.add (
+                    elf_view::sht_strtab,
+                    std::vector<std::uint8_t> (strings.begin (), strings.end ()));
+                std::vector<std::uint8_t> symbols = b.symbol (0);
+                for (std::uint32_t name : {1U, 8U + (ctr % 3U) * 3U}) {
+                    auto const sym = b.symbol (name);
+                    symbols.insert (symbols.end (), sym.begin (), sym.end ());
+                }
+                std::uint32_t const symtab = b.add (2, symbols, strtab);
+                b.add (elf_view::sht_group, b.words ({elf_view::grp_comdat, a}), symtab, 1);
+                b.add (elf_view::sht_group, b.words ({elf_view::grp_comdat, a}), symtab, 2);
+                auto const image = b.build ();
+
+                boost::filesystem::path const path =
+                    temp_dir_.path () / ("f" + std::to_string (ctr) + ".o");
+                write_file (path, std::string (image.begin (), image.end ()));
+                paths.push_back (path.string ());
+            }
+            return paths;
+        }
+
+        /// Scans 'paths' (other than those in 'completed') into 'scanner' using one consumer.
+        void scan (std::vector<std::string> const & paths, comdat_scanner & scanner,
+                   checkpoint::tracker * const tracker,
+                   checkpoint::completed_set const * const completed = nullptr) const {
+            queue_type queue{1U};
+            input_set inputs;
+            std::vector<unpack_pipeline::job> jobs;
+            updater progress (nullptr,
+                              queue_input_files (queue, paths, inputs, jobs, ofl_, completed));
+            state_flags state;
+            consumer (queue, 0U, nullptr, nullptr, &scanner, tracker, ofl_, sfl_, &state,
+                      progress);
+            EXPECT_FALSE (state.error);
+        }
+
+        /// Returns the text report for the results held by 'scanner'.
+        static std::string report (comdat_scanner & scanner) {
+            scanner.merge_shards ();
+            std::ostringstream os;
+            results::write (scanner.make_report (true), results::format::text, os);
+            return os.str ();
+        }
+
+        void write_bytes (std::string const & bytes) {
+            std::ofstream os (path_.native (), std::ios::out | std::ios::binary);
+            os.write (bytes.data (), static_cast<std::streamsize> (bytes.size ()));
+        }
+
+        temp_directory_creator temp_dir_;
+        boost::filesystem::path path_;
+        output_flags const ofl_{};
+        scan_flags const sfl_{};
+    };
+}
+
+TEST_F (Checkpoint, RoundTrip) {
+    comdat_scanner original (ofl_);
+    populate (original);
+    checkpoint::write (path_, checkpoint::image (original, {"a.o", "b.o", "c.o"}));
+    EXPECT_FALSE (boost::filesystem::exists (path_.string () + ".tmp"));
+
+    comdat_scanner restored (ofl_, 2U);
+    checkpoint::completed_set const completed = checkpoint::load (path_, restored);
+    restored.merge_shards ();
+    EXPECT_THAT (completed, ::testing::UnorderedElementsAre ("a.o", "b.o", "c.o"));
+
+    EXPECT_EQ (original.inputs (), restored.inputs ());
+    EXPECT_EQ (original.digest (), restored.digest ());
+    ASSERT_EQ (2U, restored.comdats ().size ());
+    comdat_scanner::value const & foo = restored.comdats ().at ("foo");
+    EXPECT_EQ (50U, foo.total_size);
+    EXPECT_EQ (20U, foo.largest);
+    EXPECT_EQ (3U, foo.instances);
+    EXPECT_THAT (foo.inputs, ::testing::ElementsAre (0U, 1U, 2U));
+    EXPECT_EQ (original.make_report (false).totals, restored.make_report (false).totals);
+}
+
+TEST_F (Checkpoint, Corrupt) {
+    comdat_scanner original (ofl_);
+    populate (original);
+    std::string image = checkpoint::image (original, {"a.o"});
+
+    // A truncated file.
+    this->write_bytes (image.substr (0, image.size () - 1U));
+    {
+        comdat_scanner scanner (ofl_);
+        EXPECT_THROW (checkpoint::load (path_, scanner), checkpoint::exception);
+    }
+    // Not a checkpoint file.
+    image[0] = 'X';
+    this->write_bytes (image);
+    {
+        comdat_scanner scanner (ofl_);
+        EXPECT_THROW (checkpoint::load (path_, scanner), checkpoint::exception);
+    }
+}
+
+TEST_F (Checkpoint, TrackerWaitsForConsumers) {
+    comdat_scanner scanner (ofl_);
+    checkpoint::tracker tracker (path_, std::chrono::milliseconds{0}, scanner, {"old.o"}, 2U);
+
+    // One consumer runs between inputs until told to stop; the other has already finished.
+    std::atomic<bool> done{false};
+    std::thread consumer ([&tracker, &done]() {
+        unsigned count = 0;
+        while (!done) {
+            tracker.idle ();
+            tracker.busy ();
+            tracker.completed ("new" + std::to_string (count++) + ".o");
+        }
+        tracker.retire ();
+    });
+    tracker.retire ();
+
+    EXPECT_TRUE (tracker.take ());
+    EXPECT_EQ (1U, tracker.written ());
+    done = true;
+    consumer.join ();
+
+    comdat_scanner restored (ofl_);
+    checkpoint::completed_set const completed = checkpoint::load (path_, restored);
+    EXPECT_EQ (1U, completed.count ("old.o"));
+    EXPECT_GE (completed.size (), 1U);
+
+    // Once abandoned, no further checkpoints are written.
+    tracker.abandon ();
+    EXPECT_FALSE (tracker.take ());
+    EXPECT_EQ (1U, tracker.written ());
+}
+
+TEST_F (Checkpoint, ConsumersWaitingForWork) {
+    // While the queue is open but empty, the consumers wait for work. Checkpoints must still be
+    // taken.
+    std::vector<std::string> const paths = this->write_objects (8U);
+    comdat_scanner scanner (ofl_);
+    unsigned const num_consumers = 2U;
+    checkpoint::tracker tracker (path_, std::chrono::milliseconds{1}, scanner, {},
+                                 num_consumers);
+
+    queue_type queue{num_consumers};
+    updater progress (nullptr, static_cast<unsigned> (paths.size ()));
+    state_flags state;
+    std::vector<std::thread> consumers;
+    for (unsigned worker = 0; worker < num_consumers; ++worker) {
+        consumers.emplace_back ([&, worker]() {
+            consumer (queue, worker, nullptr, nullptr, &scanner, &tracker, ofl_, sfl_, &state,
+                      progress);
+        });
+    }
+
+    auto push = [&queue, &paths](std::size_t first, std::size_t last) {
+        queue_type::producer producer (queue);
+        for (auto index = first; index < last; ++index) {
+            producer.push (queue.store (queue_member{paths[index], paths[index]}));
+        }
+    };
+    push (0U, paths.size () / 2U);
+    auto const deadline = std::chrono::steady_clock::now () + std::chrono::seconds{10};
+    while (tracker.written () < 2U && std::chrono::steady_clock::now () < deadline) {
+        std::this_thread::sleep_for (std::chrono::milliseconds{1});
+    }
+    EXPECT_GE (tracker.written (), 2U);
+
+    push (paths.size () / 2U, paths.size ());
+    queue.close ();
+    for (auto & t : consumers) {
+        t.join ();
+    }
+    tracker.stop ();
+    EXPECT_FALSE (state.error);
+
+    scanner.merge_shards ();
+    EXPECT_EQ (paths.size (), scanner.inputs ().size ());
+    EXPECT_EQ (paths.size (), scanner.comdats ().at ("common").instances);
+}
+
+TEST_F (Checkpoint, ResumeMatchesUninterruptedRun) {
+    std::vector<std::string> const paths = this->write_objects (6U);
+
+    comdat_scanner uninterrupted (ofl_);
+    this->scan (paths, uninterrupted, nullptr);
+
+    // The first run is stopped after scanning some of the inputs.
+    {
+        comdat_scanner scanner (ofl_);
+        checkpoint::tracker tracker (path_, std::chrono::milliseconds{0}, scanner, {}, 1U);
+        this->scan (std::vector<std::string> (paths.begin (), paths.begin () + 4), scanner,
+                    &tracker);
+        EXPECT_TRUE (tracker.take ());
+    }
+
+    // The second loads the checkpoint and scans the rest.
+    comdat_scanner resumed (ofl_);
+    checkpoint::completed_set const completed = checkpoint::load (path_, resumed);
+    EXPECT_EQ (4U, completed.size ());
+    this->scan (paths, resumed, nullptr, &completed);
+
+    EXPECT_EQ (report (uninterrupted), report (resumed));
+    EXPECT_EQ (uninterrupted.digest (), resumed.digest ());
+    EXPECT_EQ (uninterrupted.comdats ().size (), resumed.comdats ().size ());
+}
+
+TEST_F (Checkpoint, SuccessiveCheckpointsAccumulate) {
+    // Each checkpoint moves the new results out of the scanner. The image must nevertheless
+    // hold everything scanned so far, and stopping the tracker must give the results back.
+    std::vector<std::string> const paths = this->write_objects (6U);
+
+    comdat_scanner uninterrupted (ofl_);
+    this->scan (paths, uninterrupted, nullptr);
+
+    // The inputs are scanned while no consumer is registered with the tracker so that the
+    // checkpoints need not wait.
+    comdat_scanner scanner (ofl_);
+    checkpoint::tracker tracker (path_, std::chrono::milliseconds{0}, scanner, {}, 0U);
+    auto scan_part = [&](std::size_t first, std::size_t last) {
+        std::vector<std::string> const part (paths.begin () + first, paths.begin () + last);
+        this->scan (part, scanner, nullptr);
+        for (auto const & path : part) {
+            tracker.completed (path);
+        }
+    };
+    scan_part (0U, 3U);
+    EXPECT_TRUE (tracker.take ());
+    scan_part (3U, paths.size ());
+    EXPECT_TRUE (tracker.take ());
+    EXPECT_EQ (2U, tracker.written ());
+
+    comdat_scanner loaded (ofl_);
+    checkpoint::completed_set const completed = checkpoint::load (path_, loaded);
+    EXPECT_EQ (paths.size (), completed.size ());
+    EXPECT_EQ (report (uninterrupted), report (loaded));
+    EXPECT_EQ (uninterrupted.digest (), loaded.digest ());
+
+    tracker.stop ();
+    EXPECT_EQ (report (uninterrupted), report (scanner));
+    EXPECT_EQ (uninterrupted.digest (), scanner.digest ());
+}
+
+// eof test_checkpoint.cpp
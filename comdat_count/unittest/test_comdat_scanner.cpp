@@ -22,6 +22,8 @@
 
 #include <gmock/gmock.h>
 
+#include "elf_image.hpp"
+
 using output_vector = comdat_scanner::output_vector;
 using comdat_map = comdat_scanner::comdat_map;
 using sizes = comdat_scanner::sizes;
@@ -85,6 +87,7 @@ TEST (ComdatScannerBuildOutputVector, TwoComdatsEachWithMultipleSameSizeInstance
                 2 * 3, // total size: two instances of 3 bytes each
                 3, // largest: the largest instance was 3 bytes.
                 2, // number of instances
+                {}, // inputs
             },
         },
         {
@@ -93,6 +96,7 @@ TEST (ComdatScannerBuildOutputVector, TwoComdatsEachWithMultipleSameSizeInstance
                 5 * 7, // total size
                 5, // largest
                 7, // number of instances
+                {}, // inputs
             },
         },
     };
@@ -115,6 +119,7 @@ TEST (ComdatScannerBuildOutputVector, TwoComdatsOneHasOneInstance) {
                 4, // total size: instances where 1 & 3 bytes.
                 3, // largest: the largest instance was 3 bytes.
                 2, // number of instances
+                {}, // inputs
             },
         },
         {
@@ -123,6 +128,7 @@ TEST (ComdatScannerBuildOutputVector, TwoComdatsOneHasOneInstance) {
                 5, // total size
                 5, // largest: the only instance was 5 bytes.
                 1, // number of instances
+                {}, // inputs
             },
         },
     };
@@ -145,6 +151,7 @@ TEST (ComdatScannerBuildOutputVector, TwoComdatsOfSameSize) {
                 5, // total size
                 3, // largest: the only instance was 5 bytes.
                 2, // number of instances
+                {}, // inputs
             },
         },
         {
@@ -153,6 +160,7 @@ TEST (ComdatScannerBuildOutputVector, TwoComdatsOfSameSize) {
                 4, // total size: instances where 1 & 3 bytes.
                 3, // largest: the largest instance was 3 bytes.
                 2, // number of instances
+                {}, // inputs
             },
         },
     };
@@ -183,6 +191,7 @@ TEST (ComdatScannerTotalComdatSize, TwoComdats) {
                 5, // total size
                 3, // largest: the only instance was 5 bytes.
                 2, // number of instances
+                {}, // inputs
             },
         },
         {
@@ -191,6 +200,7 @@ TEST (ComdatScannerTotalComdatSize, TwoComdats) {
                 4, // total size: instances where 1 & 3 bytes.
                 3, // largest: the largest instance was 3 bytes.
                 2, // number of instances
+                {}, // inputs
             },
         },
     };
@@ -242,4 +252,48 @@ TEST (ComdatScannerFilter, TwoEntriesInSamePosition) {
     EXPECT_THAT (actual, ContainerEq (expected));
 }
 
+TEST (ComdatScannerShards, Merge) {
+    auto const image = two_groups (true, true);
+    elf_view::file const file (as_span (image));
+    elf_view::string_ref const no_member{nullptr, 0U};
+
+    comdat_scanner scanner (output_flags{}, 2U);
+    comdat_scanner::set_thread_shard (1U);
+    scanner.scan ("a.o", no_member, file);
+    comdat_scanner::set_thread_shard (0U);
+    scanner.scan ("b.o", no_member, file);
+    comdat_scanner::set_thread_shard (1U);
+    scanner.scan ("c.o", no_member, file);
+    comdat_scanner::set_thread_shard (0U);
+    scanner.merge_shards ();
+
+    // Shard 0's inputs come first followed by those of shard 1.
+    EXPECT_THAT (scanner.inputs (), ::testing::ElementsAre ("b.o", "a.o", "c.o"));
+    ASSERT_EQ (1U, scanner.comdats ().size ());
+    comdat_scanner::value const & foo = scanner.comdats ().at ("foo");
+    EXPECT_EQ (3U, foo.instances);
+    EXPECT_EQ (48U, foo.total_size);
+    EXPECT_EQ (16U, foo.largest);
+    EXPECT_THAT (foo.inputs, ::testing::ElementsAre (0U, 1U, 2U));
+}
+
+TEST (ComdatScannerInputs, NotRecorded) {
+    auto const image = two_groups (true, true);
+    elf_view::file const file (as_span (image));
+    elf_view::string_ref const no_member{nullptr, 0U};
+
+    comdat_scanner scanner (output_flags{}, 1U, false /*record inputs*/);
+    scanner.scan ("a.o", no_member, file);
+    scanner.scan ("b.o", no_member, file);
+    scanner.merge_shards ();
+
+    // The totals are unaffected but neither the names of the inputs nor the postings are kept.
+    EXPECT_TRUE (scanner.inputs ().empty ());
+    ASSERT_EQ (1U, scanner.comdats ().size ());
+    comdat_scanner::value const & foo = scanner.comdats ().at ("foo");
+    EXPECT_EQ (2U, foo.instances);
+    EXPECT_EQ (32U, foo.total_size);
+    EXPECT_TRUE (foo.inputs.empty ());
+}
+
 // eof unittes/test_comdat_scanner.cpp
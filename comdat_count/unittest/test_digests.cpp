@@ -71,4 +71,26 @@ TEST (Digests, OrderIsNotSignificant) {
     EXPECT_THAT (d1.final (), ::testing::ContainerEq (d2.final ()));
 }
 
+TEST (Digests, Remove) {
+    auto const a = digests::md5 ("a", 1U);
+    auto const b = digests::md5 ("b", 1U);
+    auto const c = digests::md5 ("c", 1U);
+
+    digests d1;
+    d1.add (c);
+    d1.add (a);
+    d1.add (b);
+    d1.add (a);
+    EXPECT_TRUE (d1.remove (b));
+    EXPECT_FALSE (d1.remove (b));
+    EXPECT_TRUE (d1.remove (a));
+
+    // Only one of the two instances of 'a' was removed.
+    digests d2;
+    d2.add (a);
+    d2.add (c);
+    EXPECT_THAT (d1.final (), ::testing::ContainerEq (d2.final ()));
+    EXPECT_THAT (d1.list (), ::testing::ContainerEq (d2.list ()));
+}
+
 // eof unittest/test_digests.cpp
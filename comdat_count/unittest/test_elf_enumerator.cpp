@@ -52,6 +52,8 @@ namespace {
 
         MOCK_METHOD2 (scan, void(boost::filesystem::path const & user_file_path, Elf * const elf));
         MOCK_METHOD2 (skip, void(boost::filesystem::path const & user_file_path, Elf * const elf));
+        MOCK_METHOD3 (scan, void(boost::filesystem::path const & user_file_path,
+                                 elf_view::string_ref member_name, elf_view::file const & elf));
 
         void record_scan (boost::filesystem::path const & user_file_path, Elf * const elf) {
             digests_.push_back ({user_file_path, digests::md5 (elf)});
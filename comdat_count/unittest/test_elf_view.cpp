@@ -0,0 +1,334 @@
+// Copyright (c) 2016 by SN Systems Ltd., Sony Interactive Entertainment Inc.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "elf_view.hpp"
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include <gmock/gmock.h>
+
+#include "comdat_scanner.hpp"
+#include "elf_enumerator.hpp"
+#include "elf_image.hpp"
+#include "elf_helpers.hpp"
+#include "elf_scanner.hpp"
+#include "temporary_file.h"
+
+namespace {
+
+    std::vector<std::tuple<std::string, std::uint64_t>> scan (elf_view::span s) {
+        elf_view::file const file (s);
+        std::vector<std::tuple<std::string, std::uint64_t>> result;
+        view_scanner (file).scan (
+            [&result](elf_scanner::identifier const & id, std::uint64_t size) {
+                result.emplace_back (std::string (id), size);
+            });
+        return result;
+    }
+
+    /// Scans an image using libelf rather than the native reader.
+    std::vector<std::tuple<std::string, std::uint64_t>>
+    scan_libelf (std::vector<std::uint8_t> const & image) {
+        ::elf_version (EV_CURRENT);
+        std::vector<char> copy (image.begin (), image.end ());
+        elf::elf_ptr const elf (::elf_memory (copy.data (), copy.size ()), &::elf_end);
+        EXPECT_NE (nullptr, elf.get ());
+        std::vector<std::tuple<std::string, std::uint64_t>> result;
+        elf_scanner (elf.get ()).scan (
+            [&result](elf_scanner::identifier const & id, std::uint64_t size) {
+                result.emplace_back (std::string (id), size);
+            });
+        return result;
+    }
+
+    /// Builds an ar archive. The members of a thin archive always use long names and their
+    /// contents are not stored: only their sizes are recorded.
+    std::vector<std::uint8_t> archive_image (
+        std::vector<std::tuple<std::string, std::vector<std::uint8_t>>> const & members,
+        bool thin = false) {
+        std::string result = thin ? "!<thin>\n" : "!<arch>\n";
+        std::string long_names;
+        std::vector<std::string> names;
+        for (auto const & m : members) {
+            std::string const & name = std::get<0> (m);
+            if (!thin && name.length () < 16U) {
+                names.push_back (name + '/');
+            } else {
+                names.push_back ('/' + std::to_string (long_names.length ()));
+                long_names += name + "/\n";
+            }
+        }
+
+        auto header = [](std::string name, std::size_t size) {
+            name.resize (16U, ' ');
+            std::string size_str = std::to_string (size);
+            size_str.resize (10U, ' ');
+            return name + std::string (32U, ' ') + size_str + "`\n";
+        };
+        auto add = [&result, &header](std::string const & name, std::string const & data) {
+            result += header (name, data.size ()) + data;
+            if (data.size () % 2U != 0U) {
+                result += '\n';
+            }
+        };
+
+        add ("/", std::string (4U, '\0')); // An empty symbol table.
+        if (!long_names.empty ()) {
+            add ("//", long_names);
+        }
+        for (std::size_t index = 0; index < members.size (); ++index) {
+            auto const & data = std::get<1> (members[index]);
+            if (thin) {
+                result += header (names[index], data.size ());
+            } else {
+                add (names[index], std::string (data.begin (), data.end ()));
+            }
+        }
+        return std::vector<std::uint8_t> (result.begin (), result.end ());
+    }
+
+    /// Records the names of the ELF files found by enumerate().
+    class recorder final : public comdat_scanner_base {
+    public:
+        void scan (boost::filesystem::path const & user_file_path, Elf * const elf) override {
+            Elf_Arhdr const * const arh = ::elf_getarhdr (elf);
+            scanned.emplace_back (user_file_path.string (),
+                                  arh != nullptr ? std::string (arh->ar_name) : std::string ());
+        }
+        void skip (boost::filesystem::path const & user_file_path, Elf * const) override {
+            skipped.push_back (user_file_path.string ());
+        }
+        void scan (boost::filesystem::path const & user_file_path,
+                   elf_view::string_ref member_name, elf_view::file const &) override {
+            scanned.emplace_back (user_file_path.string (),
+                                  std::string (member_name.first, member_name.second));
+        }
+
+        std::vector<std::tuple<std::string, std::string>> scanned;
+        std::vector<std::string> skipped;
+    };
+}
+
+TEST (ElfView, NotElf) {
+    std::vector<std::uint8_t> const v (64U, 0U);
+    EXPECT_FALSE (elf_view::file::is_elf (as_span (v)));
+    EXPECT_THROW (elf_view::file{as_span (v)}, elf_view::exception);
+}
+
+TEST (ElfView, Le64Groups) {
+    auto const image = two_groups (true, true);
+    EXPECT_THAT (scan (as_span (image)), ::testing::ElementsAre (std::make_tuple ("foo", 16U)));
+}
+
+TEST (ElfView, Be32Groups) {
+    auto const image = two_groups (false, false);
+    elf_view::file const file (as_span (image));
+    EXPECT_FALSE (file.is_64 ());
+    EXPECT_FALSE (file.is_le ());
+    EXPECT_EQ (7U, file.section_count ());
+    EXPECT_THAT (scan (as_span (image)), ::testing::ElementsAre (std::make_tuple ("foo", 16U)));
+}
+
+TEST (ElfView, GroupsWithDifferentSymbolTables) {
+    // Groups normally share a symbol table but needn't: make sure that each is resolved using
+    // its own table.
+    image_builder b (true, true);
+    std::uint32_t const a = b.add (1, std::vector<std::uint8_t> (4U));
+    auto symbol_table = [&b](std::string const & strings) {
+        std::uint32_t const strtab = b.add (
+            elf_view::sht_strtab, std::vector<std::uint8_t> (strings.begin (), strings.end ()));
+        std::vector<std::uint8_t> symbols = b.symbol (0);
+        auto const sym = b.symbol (1);
+        symbols.insert (symbols.end (), sym.begin (), sym.end ());
+        return b.add (2, symbols, strtab);
+    };
+    std::uint32_t const symtab1 = symbol_table (std::string ("\0first\0", 7));
+    std::uint32_t const symtab2 = symbol_table (std::string ("\0second\0", 8));
+    b.add (elf_view::sht_group, b.words ({elf_view::grp_comdat, a}), symtab1, 1);
+    b.add (elf_view::sht_group, b.words ({elf_view::grp_comdat, a}), symtab2, 1);
+    b.add (elf_view::sht_group, b.words ({elf_view::grp_comdat, a}), symtab1, 1);
+
+    auto const image = b.build ();
+    EXPECT_THAT (scan (as_span (image)),
+                 ::testing::ElementsAre (std::make_tuple ("first", 4U),
+                                         std::make_tuple ("second", 4U),
+                                         std::make_tuple ("first", 4U)));
+}
+
+TEST (ElfView, MatchesLibelfAfterNonComdatGroup) {
+    // A group which isn't a COMDAT is ignored by both readers, including when a COMDAT group
+    // follows it.
+    for (bool const is64 : {false, true}) {
+        image_builder b (is64, true);
+        std::string const strings ("\0foo\0bar\0", 9);
+        std::uint32_t const a = b.add (1, std::vector<std::uint8_t> (10U));
+        std::uint32_t const c = b.add (1, std::vector<std::uint8_t> (6U));
+        std::uint32_t const strtab = b.add (
+            elf_view::sht_strtab, std::vector<std::uint8_t> (strings.begin (), strings.end ()));
+        std::vector<std::uint8_t> symbols = b.symbol (0);
+        auto const foo = b.symbol (1);
+        auto const bar = b.symbol (5);
+        symbols.insert (symbols.end (), foo.begin (), foo.end ());
+        symbols.insert (symbols.end (), bar.begin (), bar.end ());
+        std::uint32_t const symtab = b.add (2, symbols, strtab);
+        b.add (elf_view::sht_group, b.words ({0, a, c}), symtab, 2);
+        b.add (elf_view::sht_group, b.words ({elf_view::grp_comdat, a, c}), symtab, 1);
+        auto const image = b.build ();
+
+        auto const expected = ::testing::ElementsAre (std::make_tuple ("foo", 16U));
+        EXPECT_THAT (scan (as_span (image)), expected);
+        EXPECT_THAT (scan_libelf (image), expected);
+    }
+}
+
+TEST (ElfView, TruncatedFile) {
+    auto image = two_groups (true, true);
+    image.resize (image.size () - 10U);
+    EXPECT_THROW (elf_view::file{as_span (image)}, elf_view::exception);
+}
+
+TEST (ElfView, BadGroupMember) {
+    image_builder b (true, true);
+    std::string const strings ("\0foo\0", 5);
+    std::uint32_t const strtab =
+        b.add (elf_view::sht_strtab, std::vector<std::uint8_t> (strings.begin (), strings.end ()));
+    std::vector<std::uint8_t> symbols = b.symbol (0);
+    auto const foo = b.symbol (1);
+    symbols.insert (symbols.end (), foo.begin (), foo.end ());
+    std::uint32_t const symtab = b.add (2, symbols, strtab);
+    b.add (elf_view::sht_group, b.words ({elf_view::grp_comdat, 99}), symtab, 1);
+    auto const image = b.build ();
+    EXPECT_THROW (scan (as_span (image)), elf_view::exception);
+}
+
+TEST (ElfViewArchive, Members) {
+    auto const elf = two_groups (true, true);
+    std::vector<std::uint8_t> const text{'h', 'e', 'l', 'l', 'o'};
+    auto const image = archive_image ({
+        std::make_tuple ("short.o", elf),
+        std::make_tuple ("a_rather_long_member_name.o", text),
+        std::make_tuple ("another_long_member_name.o", elf),
+    });
+
+    elf_view::span const s = as_span (image);
+    ASSERT_TRUE (elf_view::archive::is_archive (s));
+    elf_view::archive const archive (s);
+    EXPECT_EQ (3U, archive.count ());
+
+    std::vector<std::tuple<std::string, std::size_t>> actual;
+    archive.for_each ([&actual](elf_view::archive::member const & m) {
+        actual.emplace_back (std::string (m.name.first, m.name.second), m.data.size);
+    });
+    EXPECT_THAT (actual, ::testing::ElementsAre (
+                             std::make_tuple ("short.o", elf.size ()),
+                             std::make_tuple ("a_rather_long_member_name.o", text.size ()),
+                             std::make_tuple ("another_long_member_name.o", elf.size ())));
+}
+
+TEST (ElfViewArchive, Thin) {
+    auto const elf = two_groups (true, true);
+    auto const image = archive_image (
+        {
+            std::make_tuple ("a.o", elf),
+            std::make_tuple ("sub/b.o", elf),
+        },
+        true);
+
+    elf_view::span const s = as_span (image);
+    EXPECT_TRUE (elf_view::archive::is_archive (s));
+    EXPECT_TRUE (elf_view::archive::is_thin (s));
+    EXPECT_FALSE (elf_view::archive::is_regular (s));
+    elf_view::archive const archive (s);
+    EXPECT_TRUE (archive.thin ());
+
+    // The members of a thin archive have names but no contents.
+    std::vector<std::tuple<std::string, std::size_t>> actual;
+    archive.for_each ([&actual](elf_view::archive::member const & m) {
+        actual.emplace_back (std::string (m.name.first, m.name.second), m.data.size);
+    });
+    EXPECT_THAT (actual, ::testing::ElementsAre (std::make_tuple ("a.o", 0U),
+                                                 std::make_tuple ("sub/b.o", 0U)));
+}
+
+TEST (ElfViewArchive, EnumerateNested) {
+    auto const elf = two_groups (true, true);
+    auto const inner = archive_image ({
+        std::make_tuple ("inner.o", elf),
+    });
+    auto const outer = archive_image ({
+        std::make_tuple ("first.o", elf),
+        std::make_tuple ("inner.a", inner),
+        std::make_tuple ("last.o", elf),
+    });
+
+    recorder r;
+    enumerate (as_span (outer), "outer.a", &r, nullptr);
+    EXPECT_THAT (r.scanned, ::testing::ElementsAre (
+                                std::make_tuple ("outer.a", "first.o"),
+                                std::make_tuple ("outer.a (inner.a)", "inner.o"),
+                                std::make_tuple ("outer.a", "last.o")));
+    EXPECT_TRUE (r.skipped.empty ());
+}
+
+TEST (ElfViewArchive, EnumerateNestedLibelf) {
+    // The libelf enumerator must also descend into nested archives and report their members in
+    // the same way as the native reader.
+    auto const elf = two_groups (true, true);
+    auto const inner = archive_image ({
+        std::make_tuple ("inner.o", elf),
+        std::make_tuple ("inner2.o", elf),
+    });
+    auto const outer = archive_image ({
+        std::make_tuple ("first.o", elf),
+        std::make_tuple ("inner.a", inner),
+        std::make_tuple ("last.o", elf),
+    });
+
+    file_ptr file = temporary_file ();
+    ASSERT_EQ (outer.size (), std::fwrite (outer.data (), 1U, outer.size (), file.get ()));
+    ASSERT_EQ (0, std::fflush (file.get ()));
+
+    recorder native;
+    enumerate (as_span (outer), "outer.a", &native, nullptr);
+    recorder libelf;
+    enumerate (fileno (file.get ()), "outer.a", &libelf, nullptr);
+
+    EXPECT_THAT (libelf.scanned, ::testing::ElementsAre (
+                                     std::make_tuple ("outer.a", "first.o"),
+                                     std::make_tuple ("outer.a (inner.a)", "inner.o"),
+                                     std::make_tuple ("outer.a (inner.a)", "inner2.o"),
+                                     std::make_tuple ("outer.a", "last.o")));
+    EXPECT_EQ (native.scanned, libelf.scanned);
+    EXPECT_TRUE (libelf.skipped.empty ());
+}
+
+TEST (ElfViewArchive, EnumerateThinIsSkipped) {
+    auto const image = archive_image ({std::make_tuple ("a.o", two_groups (true, true))}, true);
+    recorder r;
+    enumerate (as_span (image), "thin.a", &r, nullptr);
+    EXPECT_TRUE (r.scanned.empty ());
+    EXPECT_THAT (r.skipped, ::testing::ElementsAre ("thin.a"));
+}
+
+// eof test_elf_view.cpp
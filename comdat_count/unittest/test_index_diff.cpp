@@ -0,0 +1,113 @@
+// Copyright (c) 2016 by SN Systems Ltd., Sony Interactive Entertainment Inc.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "index_diff.hpp"
+
+#include <algorithm>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include <gmock/gmock.h>
+
+#include "temp_files.hpp"
+
+namespace {
+    using comdat_map = comdat_scanner::comdat_map;
+
+    class IndexDiff : public ::testing::Test {
+    protected:
+        IndexDiff ()
+                : old_path_ (temp_dir_.path () / "old")
+                , new_path_ (temp_dir_.path () / "new") {}
+
+        static void write (boost::filesystem::path const & path, comdat_map const & cm) {
+            index_file::write (path, cm, std::vector<std::string>{"a.o", "b.o", "c.o"},
+                               md5::digest{});
+        }
+
+        temp_directory_creator temp_dir_;
+        boost::filesystem::path old_path_;
+        boost::filesystem::path new_path_;
+    };
+}
+
+TEST_F (IndexDiff, MergeJoin) {
+    comdat_map old_cm;
+    old_cm["both"] = {2, 1, 2, {0, 1}};
+    old_cm["old"] = {2, 1, 2, {0, 1}};
+    comdat_map new_cm;
+    new_cm["both"] = {2, 1, 2, {0, 1}};
+    new_cm["new"] = {2, 1, 2, {0, 1}};
+    write (old_path_, old_cm);
+    write (new_path_, new_cm);
+
+    index_file::reader const old_index (old_path_);
+    index_file::reader const new_index (new_path_);
+
+    std::vector<std::tuple<std::string, std::string>> actual;
+    index_diff::merge_join (old_index, new_index, [&](index_file::entry const * o,
+                                                      index_file::entry const * n) {
+        actual.emplace_back (o ? old_index.name (*o) : "", n ? new_index.name (*n) : "");
+    });
+    std::sort (std::begin (actual), std::end (actual));
+    EXPECT_THAT (actual, ::testing::ElementsAre (std::make_tuple ("", "new"),
+                                                 std::make_tuple ("both", "both"),
+                                                 std::make_tuple ("old", "")));
+}
+
+TEST_F (IndexDiff, Totals) {
+    comdat_map old_cm;
+    old_cm["grown"] = {10, 5, 2, {0, 1}};
+    old_cm["shrunk"] = {30, 10, 3, {0, 1, 2}};
+    old_cm["same"] = {8, 4, 2, {0, 1}};
+    old_cm["vanished"] = {6, 3, 2, {1, 2}};
+    comdat_map new_cm;
+    new_cm["grown"] = {15, 5, 3, {0, 1, 2}};
+    new_cm["shrunk"] = {10, 10, 1, {0}};
+    new_cm["same"] = {8, 4, 2, {0, 2}};
+    new_cm["added"] = {4, 2, 2, {0, 1}};
+    write (old_path_, old_cm);
+    write (new_path_, new_cm);
+
+    index_file::reader const old_index (old_path_);
+    index_file::reader const new_index (new_path_);
+    std::ostringstream os;
+    index_diff::totals const t = index_diff::diff (old_index, new_index, os);
+    EXPECT_EQ (1U, t.added);
+    EXPECT_EQ (1U, t.vanished);
+    EXPECT_EQ (1U, t.grown);
+    EXPECT_EQ (1U, t.shrunk);
+    EXPECT_EQ (1U, t.unchanged);
+    EXPECT_EQ (54U, t.old_total);
+    EXPECT_EQ (37U, t.new_total);
+    EXPECT_EQ (32U, t.old_waste);
+    EXPECT_EQ (16U, t.new_waste);
+
+    std::string const out = os.str ();
+    EXPECT_NE (std::string::npos, out.find ("+ 0 2 0 2 added\n"));
+    EXPECT_NE (std::string::npos, out.find ("- 3 0 2 0 vanished\n"));
+    EXPECT_NE (std::string::npos, out.find ("> 5 10 2 3 grown\n"));
+    EXPECT_NE (std::string::npos, out.find ("< 20 0 3 1 shrunk\n"));
+    EXPECT_EQ (std::string::npos, out.find ("same\n"));
+}
+
+// eof test_index_diff.cpp
@@ -0,0 +1,144 @@
+// Copyright (c) 2016 by SN Systems Ltd., Sony Interactive Entertainment Inc.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "index_file.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <gmock/gmock.h>
+
+#include "temp_files.hpp"
+
+namespace {
+    using comdat_map = comdat_scanner::comdat_map;
+
+    class IndexFile : public ::testing::Test {
+    protected:
+        IndexFile ()
+                : path_ (temp_dir_.path () / "index") {}
+
+        void write (comdat_map const & cm) {
+            md5::digest digest;
+            std::fill (std::begin (digest), std::end (digest), 0x5a);
+            index_file::write (path_, cm, inputs_, digest);
+        }
+
+        temp_directory_creator temp_dir_;
+        boost::filesystem::path path_;
+        std::vector<std::string> const inputs_{"a.o", "b.o", "c.o"};
+    };
+
+    std::vector<std::string> names (index_file::reader const & index,
+                                    std::vector<index_file::entry const *> const & entries) {
+        std::vector<std::string> result;
+        for (auto const * e : entries) {
+            result.push_back (index.name (*e));
+        }
+        return result;
+    }
+}
+
+TEST_F (IndexFile, Empty) {
+    this->write (comdat_map{});
+    index_file::reader const index (path_);
+    EXPECT_EQ (0U, index.size ());
+    EXPECT_EQ (3U, index.get_header ().input_count);
+    EXPECT_EQ (nullptr, index.find ("foo"));
+    EXPECT_TRUE (index.top_by_waste (10).empty ());
+    EXPECT_TRUE (index.prefix ("", 0).empty ());
+}
+
+TEST_F (IndexFile, Find) {
+    comdat_map cm;
+    cm["_Z3foov"] = {30, 10, 3, {2, 0, 1}};
+    cm["_Z3barv"] = {4, 4, 1, {1}};
+    this->write (cm);
+
+    index_file::reader const index (path_);
+    EXPECT_EQ (2U, index.size ());
+    EXPECT_EQ (34U, index.get_header ().total_size);
+    EXPECT_EQ (20U, index.get_header ().total_waste);
+
+    index_file::entry const * const foo = index.find ("_Z3foov");
+    ASSERT_NE (nullptr, foo);
+    EXPECT_EQ (30U, foo->total_size);
+    EXPECT_EQ (10U, foo->largest);
+    EXPECT_EQ (3U, foo->instances);
+    EXPECT_EQ ("foo()", index.demangled (*foo));
+    // Postings are sorted in input order.
+    EXPECT_THAT (index.inputs (*foo), ::testing::ElementsAre ("a.o", "b.o", "c.o"));
+
+    index_file::entry const * const bar = index.find ("_Z3barv");
+    ASSERT_NE (nullptr, bar);
+    EXPECT_THAT (index.inputs (*bar), ::testing::ElementsAre ("b.o"));
+
+    EXPECT_EQ (nullptr, index.find ("_Z3bazv"));
+}
+
+TEST_F (IndexFile, TopByWaste) {
+    comdat_map cm;
+    cm["a"] = {10, 5, 2, {0, 1}};   // waste 5
+    cm["b"] = {90, 30, 3, {0, 1, 2}}; // waste 60
+    cm["c"] = {7, 7, 1, {2}};       // waste 0
+    cm["d"] = {40, 20, 2, {1, 2}};  // waste 20
+    this->write (cm);
+
+    index_file::reader const index (path_);
+    EXPECT_THAT (names (index, index.top_by_waste (2)), ::testing::ElementsAre ("b", "d"));
+    EXPECT_THAT (names (index, index.top_by_waste (10)),
+                 ::testing::ElementsAre ("b", "d", "a", "c"));
+}
+
+TEST_F (IndexFile, Prefix) {
+    comdat_map cm;
+    cm["_ZN2ns3fooEv"] = {2, 1, 2, {0, 1}};
+    cm["_ZN2ns3barEv"] = {2, 1, 2, {0, 1}};
+    cm["_ZN5other3fooEv"] = {2, 1, 2, {0, 1}};
+    cm["plain"] = {2, 1, 2, {0, 1}};
+    this->write (cm);
+
+    index_file::reader const index (path_);
+    EXPECT_THAT (names (index, index.prefix ("ns::", 0)),
+                 ::testing::ElementsAre ("_ZN2ns3barEv", "_ZN2ns3fooEv"));
+    EXPECT_THAT (names (index, index.prefix ("ns::", 1)), ::testing::ElementsAre ("_ZN2ns3barEv"));
+    EXPECT_THAT (names (index, index.prefix ("pl", 0)), ::testing::ElementsAre ("plain"));
+    EXPECT_TRUE (index.prefix ("zzz", 0).empty ());
+}
+
+TEST_F (IndexFile, BadMagic) {
+    {
+        std::ofstream os (path_.native (), std::ios::binary);
+        os << std::string (sizeof (index_file::header), 'x');
+    }
+    EXPECT_THROW (index_file::reader{path_}, index_file::exception);
+}
+
+TEST_F (IndexFile, Truncated) {
+    {
+        std::ofstream os (path_.native (), std::ios::binary);
+        os << "CMDTIDX";
+    }
+    EXPECT_THROW (index_file::reader{path_}, index_file::exception);
+}
+
+// eof test_index_file.cpp
@@ -0,0 +1,90 @@
+// Copyright (c) 2016 by SN Systems Ltd., Sony Interactive Entertainment Inc.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "input_set.hpp"
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+#include <gmock/gmock.h>
+
+#include "temp_files.hpp"
+
+namespace {
+    class InputSet : public ::testing::Test {
+    protected:
+        boost::filesystem::path create (char const * name) {
+            boost::filesystem::path const p = dir_.path () / name;
+            std::ofstream (p.string ()) << name;
+            return p;
+        }
+
+        temp_directory_creator dir_;
+        input_set inputs_;
+    };
+}
+
+TEST_F (InputSet, DistinctFiles) {
+    EXPECT_TRUE (inputs_.insert (this->create ("a.o"), "a.o"));
+    EXPECT_TRUE (inputs_.insert (this->create ("b.o"), "b.o"));
+    EXPECT_EQ (nullptr, inputs_.aliases ("a.o"));
+    EXPECT_EQ (nullptr, inputs_.aliases ("b.o"));
+}
+
+TEST_F (InputSet, SameFileByDifferentPaths) {
+    boost::filesystem::path const a = this->create ("a.o");
+    EXPECT_TRUE (inputs_.insert (a, "a.o"));
+    EXPECT_FALSE (inputs_.insert (dir_.path () / "." / "a.o", "lib.a (a.o)"));
+
+    std::vector<std::string> const * const aliases = inputs_.aliases ("a.o");
+    ASSERT_NE (nullptr, aliases);
+    EXPECT_THAT (*aliases, ::testing::ElementsAre ("lib.a (a.o)"));
+}
+
+TEST_F (InputSet, HardLink) {
+    boost::filesystem::path const a = this->create ("a.o");
+    boost::filesystem::path const b = dir_.path () / "b.o";
+    boost::system::error_code ec;
+    boost::filesystem::create_hard_link (a, b, ec);
+    if (ec) {
+        return; // The file system doesn't support hard links.
+    }
+    EXPECT_TRUE (inputs_.insert (a, "a.o"));
+    EXPECT_FALSE (inputs_.insert (b, "b.o"));
+}
+
+TEST_F (InputSet, Annotate) {
+    boost::filesystem::path const a = this->create ("a.o");
+    boost::filesystem::path const ar = this->create ("lib.a");
+    inputs_.insert (a, "thin.a (a.o)");
+    inputs_.insert (a, "a.o");
+    inputs_.insert (a, "other.a (a.o)");
+    inputs_.insert (ar, "lib.a");
+    inputs_.insert (ar, "copy.a");
+
+    std::vector<std::string> const names{"thin.a (a.o)", "lib.a (x.o)", "b.o"};
+    EXPECT_THAT (inputs_.annotate (names),
+                 ::testing::ElementsAre ("thin.a (a.o) [also: a.o, other.a (a.o)]",
+                                         "lib.a (x.o) [also: copy.a]", "b.o"));
+}
+
+// eof unittest/test_input_set.cpp
@@ -0,0 +1,135 @@
+// Copyright (c) 2016 by SN Systems Ltd., Sony Interactive Entertainment Inc.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "prefetch.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gmock/gmock.h>
+
+namespace {
+    class Prefetch : public ::testing::Test {
+    protected:
+        Prefetch ()
+                : queue_ (1U) {}
+
+        void push (std::string const & path) {
+            queue_type::producer producer (queue_);
+            producer.push (queue_.store ({path, path}));
+        }
+
+        /// Waits (for a while) until 'count' files have been fetched.
+        bool wait_for (std::size_t count) {
+            for (auto ctr = 0U; ctr < 1000U; ++ctr) {
+                {
+                    std::lock_guard<std::mutex> lock (mut_);
+                    if (fetched_.size () >= count) {
+                        return true;
+                    }
+                }
+                std::this_thread::sleep_for (std::chrono::milliseconds (1));
+            }
+            return false;
+        }
+
+        prefetcher::fetch_function recorder () {
+            return [this](boost::filesystem::path const & p) {
+                std::lock_guard<std::mutex> lock (mut_);
+                fetched_.push_back (p.string ());
+            };
+        }
+
+        queue_type queue_;
+        std::mutex mut_;
+        std::vector<std::string> fetched_;
+    };
+}
+
+TEST_F (Prefetch, FetchesInQueueOrder) {
+    this->push ("a");
+    this->push ("b");
+    this->push ("c");
+    {
+        prefetcher p (queue_, 1U, 8U, this->recorder ());
+        ASSERT_TRUE (this->wait_for (3U));
+    }
+    EXPECT_THAT (fetched_, ::testing::ElementsAre ("a", "b", "c"));
+}
+
+TEST (PrefetchOrder, FollowsEachConsumersShare) {
+    // The first batch of files is dealt to consumer 0 and the second to consumer 1. Both
+    // consumers start at the beginning of their batch so the prefetcher must alternate between
+    // them rather than fetch the files in queue order.
+    queue_type queue (2U);
+    {
+        queue_type::producer producer (queue);
+        for (std::size_t ctr = 0; ctr < 2U * queue_type::batch_size; ++ctr) {
+            auto const path = std::to_string (ctr);
+            producer.push (queue.store ({path, path}));
+        }
+    }
+
+    std::mutex mut;
+    std::vector<std::string> fetched;
+    prefetcher p (queue, 1U, 4U, [&mut, &fetched](boost::filesystem::path const & path) {
+        std::lock_guard<std::mutex> lock (mut);
+        fetched.push_back (path.string ());
+    });
+    auto const first = std::to_string (queue_type::batch_size);
+    auto const second = std::to_string (queue_type::batch_size + 1U);
+    for (auto ctr = 0U; ctr < 1000U; ++ctr) {
+        {
+            std::lock_guard<std::mutex> lock (mut);
+            if (fetched.size () >= 4U) {
+                break;
+            }
+        }
+        std::this_thread::sleep_for (std::chrono::milliseconds (1));
+    }
+    p.stop ();
+    EXPECT_THAT (fetched, ::testing::ElementsAre ("0", first, "1", second));
+}
+
+TEST_F (Prefetch, StaysWithinDepth) {
+    for (auto ctr = 0; ctr < 10; ++ctr) {
+        this->push (std::to_string (ctr));
+    }
+    prefetcher p (queue_, 2U, 3U, this->recorder ());
+    ASSERT_TRUE (this->wait_for (3U));
+    std::this_thread::sleep_for (std::chrono::milliseconds (20));
+    {
+        std::lock_guard<std::mutex> lock (mut_);
+        EXPECT_EQ (3U, fetched_.size ());
+    }
+
+    // The consumers start two items so the prefetcher can move two further ahead.
+    p.started (0U);
+    p.started (0U);
+    ASSERT_TRUE (this->wait_for (5U));
+    p.stop ();
+    EXPECT_EQ (5U, fetched_.size ());
+}
+
+// eof test_prefetch.cpp
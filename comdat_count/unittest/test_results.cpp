@@ -0,0 +1,165 @@
+// Copyright (c) 2016 by SN Systems Ltd., Sony Interactive Entertainment Inc.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "results.hpp"
+
+#include <cstring>
+#include <sstream>
+#include <string>
+
+#include <gmock/gmock.h>
+
+namespace {
+    comdat_scanner::report make_report (bool unfiltered) {
+        comdat_scanner::report r;
+        r.digest.fill (0xAB);
+        r.comdats = 5;
+        r.multiple = 3;
+        r.has_unfiltered = unfiltered;
+        if (unfiltered) {
+            r.unfiltered = {{10, 2, 10}, {11, 2, 11}, {300, 4, 900}};
+        }
+        r.points = {{11, 2, 11}, {300, 4, 900}};
+        r.totals = {1234, 921};
+        return r;
+    }
+
+    std::string write (comdat_scanner::report const & r, results::format f,
+                       sampling::estimate const * sample = nullptr) {
+        std::ostringstream os;
+        results::write (r, f, os, sample);
+        return os.str ();
+    }
+
+    std::string const digest_hex = []() {
+        std::string result;
+        for (auto ctr = 0; ctr < 16; ++ctr) {
+            result += "ab";
+        }
+        return result;
+    }();
+}
+
+TEST (Results, ParseFormat) {
+    EXPECT_EQ (results::format::text, results::parse_format ("text"));
+    EXPECT_EQ (results::format::json, results::parse_format ("json"));
+    EXPECT_EQ (results::format::csv, results::parse_format ("csv"));
+    EXPECT_EQ (results::format::binary, results::parse_format ("binary"));
+    EXPECT_THROW (results::parse_format ("xml"), results::exception);
+}
+
+TEST (Results, Text) {
+    EXPECT_EQ ("# MD5: " + digest_hex + "\n"
+               "# Filtered 2 COMDATs with 1 instance\n"
+               "# Then trimmed 1 similar points\n"
+               "# Result has 2 points\n"
+               "#> Total:1234\n"
+               "#> Wasted:921\n"
+               "Size Instances Total\n"
+               "11 2 11\n"
+               "300 4 900\n",
+               write (make_report (false), results::format::text));
+}
+
+TEST (Results, Json) {
+    EXPECT_EQ ("{\n"
+               "  \"md5\": \"" + digest_hex + "\",\n"
+               "  \"comdats\": 5,\n"
+               "  \"filtered\": 2,\n"
+               "  \"trimmed\": 1,\n"
+               "  \"total\": 1234,\n"
+               "  \"wasted\": 921,\n"
+               "  \"points\": [\n"
+               "    [11,2,11],\n"
+               "    [300,4,900]\n"
+               "  ],\n"
+               "  \"unfiltered\": [\n"
+               "    [10,2,10],\n"
+               "    [11,2,11],\n"
+               "    [300,4,900]\n"
+               "  ]\n"
+               "}\n",
+               write (make_report (true), results::format::json));
+}
+
+TEST (Results, JsonEmpty) {
+    comdat_scanner::report r = make_report (false);
+    r.comdats = r.multiple = 0;
+    r.points.clear ();
+    r.totals = {0, 0};
+    std::string const actual = write (r, results::format::json);
+    EXPECT_THAT (actual, ::testing::HasSubstr ("\"points\": []\n}"));
+    EXPECT_THAT (actual, ::testing::Not (::testing::HasSubstr ("unfiltered")));
+}
+
+TEST (Results, Csv) {
+    EXPECT_EQ ("md5,comdats,filtered,trimmed,total,wasted\n" + digest_hex +
+                   ",5,2,1,1234,921\n"
+                   "\n"
+                   "size,instances,wasted\n"
+                   "11,2,11\n"
+                   "300,4,900\n",
+               write (make_report (false), results::format::csv));
+}
+
+TEST (Results, Sample) {
+    sampling::estimate const e{2U, 10U, {5000.4, 120.6}, {900.0, 80.2}};
+    std::string const text = write (make_report (false), results::format::text, &e);
+    EXPECT_THAT (text, ::testing::HasSubstr ("# Sampled 2 of 10 input files\n"
+                                             "#> Estimated total:5000\n"
+                                             "#> Estimated total CI95:121\n"
+                                             "#> Estimated wasted:900\n"
+                                             "#> Estimated wasted CI95:80\n"
+                                             "Size"));
+    EXPECT_THAT (write (make_report (false), results::format::json, &e),
+                 ::testing::HasSubstr ("\"sample\": {\"sampled\": 2, \"population\": 10, "
+                                       "\"total\": 5000, \"total_ci95\": 121, "
+                                       "\"wasted\": 900, \"wasted_ci95\": 80}"));
+    EXPECT_THAT (write (make_report (false), results::format::csv, &e),
+                 ::testing::HasSubstr ("\nsampled,population,total,total_ci95,wasted,wasted_ci95\n"
+                                       "2,10,5000,121,900,80\n"));
+}
+
+TEST (Results, Binary) {
+    std::string const actual = write (make_report (true), results::format::binary);
+    ASSERT_EQ (sizeof (results::header) + 5U * sizeof (results::point), actual.size ());
+
+    results::header h;
+    std::memcpy (&h, actual.data (), sizeof (h));
+    EXPECT_EQ (0, std::memcmp (h.magic, results::binary_magic, sizeof (h.magic)));
+    EXPECT_EQ (1U, h.version);
+    EXPECT_EQ (results::byte_order_marker, h.byte_order);
+    EXPECT_EQ (5U, h.comdats);
+    EXPECT_EQ (2U, h.filtered);
+    EXPECT_EQ (1U, h.trimmed);
+    EXPECT_EQ (1234U, h.total_size);
+    EXPECT_EQ (921U, h.total_waste);
+    EXPECT_EQ (2U, h.point_count);
+    EXPECT_EQ (3U, h.unfiltered_count);
+    EXPECT_EQ (0xABU, h.digest[15]);
+    EXPECT_EQ (0U, h.population);
+
+    results::point p;
+    std::memcpy (&p, actual.data () + sizeof (h) + sizeof (p), sizeof (p));
+    EXPECT_EQ (300U, p.largest);
+    EXPECT_EQ (4U, p.instances);
+    EXPECT_EQ (900U, p.wasted);
+}
+// eof unittest/test_results.cpp
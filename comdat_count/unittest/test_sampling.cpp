@@ -0,0 +1,183 @@
+// Copyright (c) 2016 by SN Systems Ltd., Sony Interactive Entertainment Inc.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "sampling.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+#include <gmock/gmock.h>
+
+#include "flags.hpp"
+#include "temp_files.hpp"
+
+namespace {
+    /// Returns paths to 'count' files which don't exist (so are all in the same stratum).
+    std::vector<boost::filesystem::path> names (std::size_t count) {
+        std::vector<boost::filesystem::path> result;
+        for (std::size_t ctr = 0; ctr < count; ++ctr) {
+            result.emplace_back ("f" + std::to_string (ctr));
+        }
+        return result;
+    }
+
+    comdat_scanner::value make_value (std::uint64_t total, std::uint64_t largest,
+                                      std::vector<std::uint32_t> inputs) {
+        return {total, largest, static_cast<unsigned> (inputs.size ()), std::move (inputs)};
+    }
+}
+
+TEST (Sampling, Stratum) {
+    EXPECT_EQ (0U, sampling::stratum (0U));
+    EXPECT_EQ (1U, sampling::stratum (1U));
+    EXPECT_EQ (2U, sampling::stratum (2U));
+    EXPECT_EQ (2U, sampling::stratum (3U));
+    EXPECT_EQ (11U, sampling::stratum (1024U));
+    EXPECT_EQ (64U, sampling::stratum (~std::uint64_t{0}));
+}
+
+TEST (Sampling, IsRepeatable) {
+    auto const files = names (100);
+    sampling::sample const s1 (files, 0.1, 1U);
+    sampling::sample const s2 (files, 0.1, 1U);
+    sampling::sample const s3 (files, 0.1, 2U);
+    EXPECT_EQ (100U, s1.population ());
+    EXPECT_EQ (10U, s1.files ().size ());
+    EXPECT_EQ (s1.files (), s2.files ());
+    EXPECT_NE (s1.files (), s3.files ());
+}
+
+TEST (Sampling, EachStratumIsSampled) {
+    temp_directory_creator dir;
+    std::vector<boost::filesystem::path> files;
+    auto create = [&](std::string const & name, std::size_t size) {
+        boost::filesystem::path const p = dir.path () / name;
+        std::ofstream (p.string ()) << std::string (size, 'x');
+        files.push_back (p);
+    };
+    for (auto ctr = 0; ctr < 20; ++ctr) {
+        create ("small" + std::to_string (ctr), 10U);
+    }
+    create ("big1", 100000U);
+    create ("big2", 100000U);
+    create ("big3", 100000U);
+
+    // 10% of the small files but at least two of the big ones.
+    sampling::sample const s (files, 0.1, 0U);
+    std::vector<std::string> const & chosen = s.files ();
+    EXPECT_EQ (4U, chosen.size ());
+    EXPECT_EQ (2, std::count_if (chosen.begin (), chosen.end (), [](std::string const & n) {
+                   return n.find ("big") != std::string::npos;
+               }));
+}
+
+TEST (Sampling, Extrapolate) {
+    sampling::sample const s (names (4), 0.5, 0U);
+    ASSERT_EQ (2U, s.files ().size ());
+    std::string const & a = s.files ()[0];
+    std::string const & b = s.files ()[1];
+
+    // Input 0 is a member of an archive, input 1 a zip member, input 2 came from elsewhere.
+    std::vector<std::string> const inputs{a + " (x.o)", b + "/dir/y.o", "other.o"};
+    comdat_scanner::comdat_map cm;
+    cm["g1"] = make_value (100, 100, {0});   // a: total 100
+    cm["g2"] = make_value (200, 100, {0, 1}); // a and b: total 100 each
+    cm["g3"] = make_value (200, 200, {1});   // b: total 200
+    cm["g4"] = make_value (999, 999, {2});   // ignored
+
+    sampling::estimate const e = s.extrapolate (cm, inputs);
+    EXPECT_EQ (2U, e.sampled);
+    EXPECT_EQ (4U, e.population);
+    // The file totals are 200 and 300: mean 250, variance 5000.
+    EXPECT_DOUBLE_EQ (1000.0, e.total.value);
+    EXPECT_NEAR (1.96 * std::sqrt (16.0 * 0.5 * 5000.0 / 2.0), e.total.half_width, 1e-9);
+    // Each sampled file stands for two so the groups' totals are doubled: g1 and g3 then waste
+    // half of their new totals and g2 three quarters.
+    EXPECT_DOUBLE_EQ (100.0 + 300.0 + 200.0, e.wasted.value);
+    EXPECT_GT (e.wasted.half_width, 0.0);
+}
+
+TEST (Sampling, WholePopulationHasNoError) {
+    sampling::sample const s (names (3), 1.0, 0U);
+    ASSERT_EQ (3U, s.files ().size ());
+    std::vector<std::string> const inputs{s.files ()[0], s.files ()[1], s.files ()[2]};
+    comdat_scanner::comdat_map cm;
+    cm["g1"] = make_value (30, 10, {0, 1, 2});
+    cm["g2"] = make_value (7, 7, {2});
+
+    sampling::estimate const e = s.extrapolate (cm, inputs);
+    EXPECT_DOUBLE_EQ (37.0, e.total.value);
+    EXPECT_DOUBLE_EQ (0.0, e.total.half_width);
+    EXPECT_DOUBLE_EQ (20.0, e.wasted.value);
+    EXPECT_DOUBLE_EQ (0.0, e.wasted.half_width);
+}
+
+TEST (Sampling, WholePopulationMatchesTheScanner) {
+    // The instances of each group differ in size. When every file is sampled the estimated waste
+    // must be exactly that reported by the scanner.
+    sampling::sample const s (names (4), 1.0, 0U);
+    ASSERT_EQ (4U, s.files ().size ());
+    std::vector<std::string> inputs;
+    for (auto const & f : s.files ()) {
+        inputs.push_back (f);
+    }
+    // An archive member adds a second input to the third file.
+    inputs.push_back (s.files ()[2] + " (m.o)");
+    comdat_scanner::comdat_map cm;
+    cm["g1"] = comdat_scanner::value{160, 100, 2, {0, 1}};        // 100 and 60 bytes
+    cm["g2"] = comdat_scanner::value{37, 20, 3, {1, 2, 3}};       // 20, 10 and 7 bytes
+    cm["g3"] = comdat_scanner::value{1001, 333, 4, {0, 2, 3, 4}}; // 333, 333, 300 and 35 bytes
+    cm["g4"] = comdat_scanner::value{5, 5, 1, {4}};
+
+    output_flags const ofl{};
+    comdat_scanner scanner (ofl);
+    scanner.restore (comdat_scanner::comdat_map (cm), std::vector<std::string> (inputs));
+    comdat_scanner::report const report = scanner.make_report (true);
+    ASSERT_EQ (60U + 17U + 668U, report.totals.waste);
+
+    sampling::estimate const e = s.extrapolate (cm, inputs);
+    EXPECT_EQ (static_cast<double> (report.totals.waste), e.wasted.value);
+    EXPECT_EQ (0.0, e.wasted.half_width);
+}
+
+TEST (Sampling, WasteOfGroupsInEveryFile) {
+    // Every one of 100 files contains a group of 10 bytes: 99 of its instances are waste. A 10%
+    // sample sees only ten of them.
+    sampling::sample const s (names (100), 0.1, 0U);
+    ASSERT_EQ (10U, s.files ().size ());
+    std::vector<std::string> inputs;
+    std::vector<std::uint32_t> indices;
+    for (auto const & f : s.files ()) {
+        indices.push_back (static_cast<std::uint32_t> (inputs.size ()));
+        inputs.push_back (f);
+    }
+    comdat_scanner::comdat_map cm;
+    cm["g"] = make_value (100, 10, indices);
+
+    sampling::estimate const e = s.extrapolate (cm, inputs);
+    EXPECT_DOUBLE_EQ (990.0, e.wasted.value);
+    // Every file is alike so resampling them makes no difference.
+    EXPECT_DOUBLE_EQ (0.0, e.wasted.half_width);
+}
+// eof unittest/test_sampling.cpp
@@ -24,7 +24,9 @@
 #include <array>
 #include <cstring>
 #include <limits>
+#include <string>
 #include <type_traits>
+#include <vector>
 
 // 3rd party includes
 #include <gelf.h>
@@ -83,8 +85,8 @@ TEST (Scanner, Be32NoGroups) {
         mock_callback cb;
         EXPECT_CALL (cb, call (_, _)).Times (0);
 
-        // Unfortunately, Google Mock doesn't allow mocks to be copied (into an instance of
-        // std::function in this case), so we need to bounce through a small lambda to call it.
+        // Unfortunately, Google Mock doesn't allow mocks to be copied (scan() takes its callback
+        // by value), so we need to bounce through a small lambda to call it.
         auto trampoline = [&cb](std::string const & name, std::uint64_t size) { cb (name, size); };
         scanner.scan (trampoline);
     }
@@ -291,6 +293,69 @@ TEST (Scanner, Le64SingleCorruptComdatGroup) {
 }
 
 
+TEST (Scanner, SymbolTableIsCachedUntilTheLinkChanges) {
+    file_ptr file = temporary_file ();
+    int const fd = fileno (file.get ());
+
+    std::array<std::uint32_t, 1> const data{{0x01234567}};
+    std::size_t symtab_a = 0;
+    std::size_t strtab_b = 0;
+
+    {
+        elf::elf_ptr elf = make_le64_elf (fd);
+        strings section_names;
+        Elf_Scn * const text =
+            create_progbits_alloc_section (elf.get (), &data, section_names.append (".data"));
+        std::array<std::uint32_t, 2> const group_data{{
+            static_cast<std::uint32_t> (GRP_COMDAT), static_cast<std::uint32_t> (elf_ndxscn (text)),
+        }};
+
+        // Two symbol tables, each with its own string table. The names in the tables have the
+        // same lengths so the symbols in A name the corresponding strings in B's table.
+        symbol_section symbols_a (elf.get ());
+        symbol_section symbols_b (elf.get ());
+        auto group = [&](char const * identifier, symbol_section * symbols) {
+            create_group_section (elf.get (), identifier, symbols,
+                                  section_names.append (".group"), &group_data);
+        };
+        group ("a1", &symbols_a);
+        group ("a2", &symbols_a);
+        group ("b1", &symbols_b);
+        group ("a3", &symbols_a);
+        symbols_b.add ("b2", text, 0, 0);
+        symbols_b.add ("b3", text, 0, 0);
+
+        symbols_a.commit (&section_names);
+        symbols_b.commit (&section_names);
+        create_section_names_section (elf.get (), &section_names);
+        symtab_a = elf_ndxscn (symbols_a.section ());
+        strtab_b = gelf::getshdr (symbols_b.section ()).sh_link;
+        elf::update (elf.get (), ELF_C_WRITE);
+    }
+    {
+        elf::elf_ptr elf = elf::begin (fd, ELF_C_READ);
+        elf_scanner scanner (elf.get ());
+
+        // Once the first group has been found, point symbol table A at B's string table. The
+        // second group also uses table A so it is resolved with the strings cached for the first.
+        // The third group uses table B, so the cache is reloaded. The fourth uses table A once
+        // more: it is reloaded again and so picks up A's new string table.
+        std::vector<std::string> names;
+        scanner.scan ([&](std::string const & name, std::uint64_t size) {
+            EXPECT_EQ (sizeof (data), size);
+            if (names.empty ()) {
+                Elf_Scn * const scn = elf::getscn (elf.get (), symtab_a);
+                GElf_Shdr shdr = gelf::getshdr (scn);
+                shdr.sh_link = static_cast<decltype (shdr.sh_link)> (strtab_b);
+                gelf::update_shdr (scn, shdr);
+            }
+            names.push_back (name);
+        });
+        EXPECT_THAT (names, ::testing::ElementsAre ("a1", "a2", "b1", "b3"));
+    }
+}
+
+
 #if 0
 // Test disabled: some versions of libelf won't allow the creation of an ELF
 // with invalid group section length
@@ -0,0 +1,141 @@
+// Copyright (c) 2016 by SN Systems Ltd., Sony Interactive Entertainment Inc.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "tar_stream.hpp"
+
+#include <cstring>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+#include <gmock/gmock.h>
+
+#include "tar_builder.hpp"
+#include "temp_files.hpp"
+
+namespace {
+    /// A source which reads from a string.
+    class string_source final : public tar::source {
+    public:
+        explicit string_source (std::string const & s)
+                : s_ (s) {}
+        std::size_t read (void * buffer, std::size_t size) override {
+            std::size_t const n = std::min (size, s_.size () - pos_);
+            std::memcpy (buffer, s_.data () + pos_, n);
+            pos_ += n;
+            return n;
+        }
+
+    private:
+        std::string const & s_;
+        std::size_t pos_ = 0;
+    };
+
+    using entries = std::vector<std::tuple<std::string, std::string>>;
+    entries read_all (tar::source & src) {
+        entries result;
+        tar::reader reader (src);
+        while (reader.next ()) {
+            std::string contents (static_cast<std::size_t> (reader.size ()), '\0');
+            std::size_t pos = 0;
+            while (std::size_t const n = reader.read (&contents[pos], contents.size () - pos)) {
+                pos += n;
+            }
+            result.emplace_back (reader.name (), contents);
+        }
+        return result;
+    }
+}
+
+TEST (TarReader, Entries) {
+    std::string const long_name (150, 'n');
+    std::string const tar = tar_builder ()
+                                .add ("dir/", "", '5')
+                                .add ("dir/a.o", "first")
+                                .add ("b.o", "second", '0', "dir")
+                                .add ("link", "", '2')
+                                .add ("././@LongLink", long_name + '\0', 'L')
+                                .add ("truncated", "third")
+                                .add ("pax", "10 path=c\n", 'x')
+                                .add ("ignored", std::string (513, 'x'))
+                                .build ();
+    string_source src (tar);
+    EXPECT_THAT (read_all (src),
+                 ::testing::ElementsAre (std::make_tuple ("dir/a.o", "first"),
+                                         std::make_tuple ("dir/b.o", "second"),
+                                         std::make_tuple (long_name, "third"),
+                                         std::make_tuple ("c", std::string (513, 'x'))));
+}
+
+TEST (TarReader, SkipUnreadContents) {
+    std::string const tar = tar_builder ()
+                                .add ("a", std::string (1000, 'a'))
+                                .add ("b", "b")
+                                .build ();
+    string_source src (tar);
+    tar::reader reader (src);
+    ASSERT_TRUE (reader.next ());
+    char c;
+    EXPECT_EQ (1U, reader.read (&c, 1U));
+    ASSERT_TRUE (reader.next ());
+    EXPECT_EQ ("b", reader.name ());
+    EXPECT_FALSE (reader.next ());
+}
+
+TEST (TarReader, BadHeader) {
+    std::string tar = tar_builder ().add ("a.o", "contents").build ();
+    tar[0] = 'b'; // Invalidates the checksum.
+    string_source src (tar);
+    tar::reader reader (src);
+    EXPECT_THROW (reader.next (), tar::exception);
+}
+
+TEST (TarReader, Truncated) {
+    std::string tar = tar_builder ().add ("a.o", std::string (1000, 'a')).build ();
+    tar.resize (700);
+    string_source src (tar);
+    EXPECT_THROW (read_all (src), tar::exception);
+}
+
+TEST (TarStream, GzipFile) {
+    temp_directory_creator dir;
+    std::string const tar =
+        tar_builder ().add ("a.o", "first").add ("b.o", std::string (10000, 'b')).build ();
+    // Concatenated gzip members are read as one stream.
+    boost::filesystem::path const path = dir.path () / "x.tar.gz";
+    write_file (path, gzip (tar.substr (0, 1024)) + gzip (tar.substr (1024)));
+
+    EXPECT_TRUE (tar::is_tar (path));
+    std::unique_ptr<tar::source> src = tar::open (path);
+    EXPECT_THAT (read_all (*src),
+                 ::testing::ElementsAre (std::make_tuple ("a.o", "first"),
+                                         std::make_tuple ("b.o", std::string (10000, 'b'))));
+}
+
+TEST (TarStream, NotTar) {
+    temp_directory_creator dir;
+    boost::filesystem::path const path = dir.path () / "x.o";
+    write_file (path, std::string (1024, 'x'));
+    EXPECT_FALSE (tar::is_tar (path));
+}
+
+// eof unittest/test_tar_stream.cpp
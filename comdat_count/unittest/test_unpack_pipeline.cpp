@@ -0,0 +1,287 @@
+// Copyright (c) 2016 by SN Systems Ltd., Sony Interactive Entertainment Inc.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "unpack_pipeline.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+#include <gmock/gmock.h>
+#include <zlib.h>
+
+#include "tar_builder.hpp"
+#include "tar_stream.hpp"
+#include "temp_files.hpp"
+#include "work_queue.hpp"
+
+namespace {
+    /// Builds zip files in memory. Members are either stored or compressed with deflate.
+    class zip_builder {
+    public:
+        zip_builder & add (std::string const & name, std::string const & contents,
+                           bool deflated = true) {
+            std::string const data = deflated ? raw_deflate (contents) : contents;
+            auto const crc = static_cast<std::uint32_t> (
+                ::crc32 (0L, reinterpret_cast<Bytef const *> (contents.data ()),
+                         static_cast<uInt> (contents.size ())));
+            std::uint16_t const method = deflated ? 8U : 0U;
+            auto const offset = static_cast<std::uint32_t> (zip_.size ());
+
+            // The local file header.
+            put32 (zip_, 0x04034b50U);
+            put16 (zip_, 20U); // version needed to extract
+            put16 (zip_, 0U);  // flags
+            put16 (zip_, method);
+            put32 (zip_, 0U); // modification time and date
+            put32 (zip_, crc);
+            put32 (zip_, static_cast<std::uint32_t> (data.size ()));
+            put32 (zip_, static_cast<std::uint32_t> (contents.size ()));
+            put16 (zip_, static_cast<std::uint16_t> (name.size ()));
+            put16 (zip_, 0U); // extra field length
+            zip_ += name + data;
+
+            // The matching central directory entry.
+            put32 (directory_, 0x02014b50U);
+            put16 (directory_, 20U); // version made by
+            put16 (directory_, 20U); // version needed to extract
+            put16 (directory_, 0U);  // flags
+            put16 (directory_, method);
+            put32 (directory_, 0U); // modification time and date
+            put32 (directory_, crc);
+            put32 (directory_, static_cast<std::uint32_t> (data.size ()));
+            put32 (directory_, static_cast<std::uint32_t> (contents.size ()));
+            put16 (directory_, static_cast<std::uint16_t> (name.size ()));
+            put16 (directory_, 0U); // extra field length
+            put16 (directory_, 0U); // comment length
+            put16 (directory_, 0U); // disk number
+            put16 (directory_, 0U); // internal attributes
+            put32 (directory_, 0U); // external attributes
+            put32 (directory_, offset);
+            directory_ += name;
+            ++members_;
+            return *this;
+        }
+
+        std::string build () const {
+            std::string result = zip_ + directory_;
+            // The end of central directory record.
+            put32 (result, 0x06054b50U);
+            put16 (result, 0U); // this disk
+            put16 (result, 0U); // the disk with the central directory
+            put16 (result, members_);
+            put16 (result, members_);
+            put32 (result, static_cast<std::uint32_t> (directory_.size ()));
+            put32 (result, static_cast<std::uint32_t> (zip_.size ()));
+            put16 (result, 0U); // comment length
+            return result;
+        }
+
+    private:
+        static void put16 (std::string & s, std::uint16_t v) {
+            s += static_cast<char> (v & 0xFFU);
+            s += static_cast<char> (v >> 8);
+        }
+        static void put32 (std::string & s, std::uint32_t v) {
+            put16 (s, static_cast<std::uint16_t> (v & 0xFFFFU));
+            put16 (s, static_cast<std::uint16_t> (v >> 16));
+        }
+        static std::string raw_deflate (std::string const & in) {
+            z_stream zs;
+            std::memset (&zs, 0, sizeof (zs));
+            deflateInit2 (&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY);
+            std::string out (deflateBound (&zs, static_cast<uLong> (in.size ())), '\0');
+            zs.next_in = reinterpret_cast<Bytef *> (const_cast<char *> (in.data ()));
+            zs.avail_in = static_cast<uInt> (in.size ());
+            zs.next_out = reinterpret_cast<Bytef *> (&out[0]);
+            zs.avail_out = static_cast<uInt> (out.size ());
+            deflate (&zs, Z_FINISH);
+            out.resize (zs.total_out);
+            deflateEnd (&zs);
+            return out;
+        }
+
+        std::string zip_;
+        std::string directory_;
+        std::uint16_t members_ = 0;
+    };
+
+    /// Returns a job for each member of the zip file at 'path'.
+    std::vector<unpack_pipeline::job> zip_jobs (boost::filesystem::path const & path) {
+        std::vector<unpack_pipeline::job> jobs;
+        zipper::zip_ptr uf = zipper::open (path);
+        for (int err = unzGoToFirstFile (uf.get ()); err == UNZ_OK;
+             err = unzGoToNextFile (uf.get ())) {
+            char name[256];
+            unz_file_info64 info;
+            unzGetCurrentFileInfo64 (uf.get (), &info, name, sizeof (name), nullptr, 0, nullptr,
+                                     0);
+            unz64_file_pos pos;
+            unzGetFilePos64 (uf.get (), &pos);
+            jobs.push_back (
+                unpack_pipeline::job::zip_member (path, name, pos, info.uncompressed_size));
+        }
+        return jobs;
+    }
+
+    /// Runs the pipeline to completion.
+    /// \returns The user path and contents of each entry, sorted by path.
+    std::vector<std::pair<std::string, std::string>> drain (unpack_pipeline & pipeline) {
+        std::vector<std::pair<std::string, std::string>> result;
+        std::unique_ptr<unpack_pipeline::entry> e;
+        while (pipeline.pop (e)) {
+            elf_view::span const contents = e->contents ();
+            result.emplace_back (
+                e->user_path.string (),
+                std::string (reinterpret_cast<char const *> (contents.data), contents.size));
+            pipeline.release (std::move (e));
+        }
+        std::sort (result.begin (), result.end ());
+        return result;
+    }
+
+    std::string const elf_like ("\x7F" "ELF and some more bytes");
+}
+
+TEST (UnpackPipeline, TarBuffersScannableEntries) {
+    temp_directory_creator dir;
+    boost::filesystem::path const p1 = dir.path () / "1.tar";
+    boost::filesystem::path const p2 = dir.path () / "2.tar.gz";
+    write_file (p1, tar_builder ()
+                        .add ("a.o", elf_like)
+                        .add ("readme", "text")
+                        .add ("lib.a", "!<arch>\n")
+                        .build ());
+    write_file (p2, gzip (tar_builder ().add ("b.o", elf_like).build ()));
+
+    // A budget smaller than any entry: each must be released before the next is buffered.
+    unpack_pipeline pipeline (
+        {unpack_pipeline::job::tar (p1), unpack_pipeline::job::tar (p2)}, 2U, 1U, nullptr);
+    std::vector<std::string> actual;
+    std::unique_ptr<unpack_pipeline::entry> e;
+    while (pipeline.pop (e)) {
+        actual.push_back (e->user_path.string ());
+        pipeline.release (std::move (e));
+    }
+    EXPECT_THAT (actual, ::testing::UnorderedElementsAre (p1.string () + " (a.o)",
+                                                          p1.string () + " (lib.a)",
+                                                          p2.string () + " (b.o)"));
+}
+
+TEST (UnpackPipeline, TarError) {
+    temp_directory_creator dir;
+    boost::filesystem::path const path = dir.path () / "bad.tar";
+    std::string tar = tar_builder ().add ("a.o", elf_like).build ();
+    tar[0] = 'b';
+    write_file (path, tar);
+
+    unpack_pipeline pipeline ({unpack_pipeline::job::tar (path)}, 1U, 1024U, nullptr);
+    std::unique_ptr<unpack_pipeline::entry> e;
+    EXPECT_THROW (pipeline.pop (e), tar::exception);
+}
+
+TEST (UnpackPipeline, ZipMembers) {
+    temp_directory_creator dir;
+    boost::filesystem::path const path = dir.path () / "x.zip";
+    std::string const big = elf_like + std::string (100000, 'b');
+    write_file (path, zip_builder ()
+                          .add ("a.o", elf_like)
+                          .add ("b.o", big)
+                          .add ("stored.o", elf_like, false /*deflated*/)
+                          .add ("readme", "text")
+                          .add ("empty", "")
+                          .build ());
+
+    unpack_pipeline pipeline (zip_jobs (path), 3U, 1024U * 1024U, nullptr);
+    EXPECT_THAT (drain (pipeline),
+                 ::testing::ElementsAre (std::make_pair ((path / "a.o").string (), elf_like),
+                                         std::make_pair ((path / "b.o").string (), big),
+                                         std::make_pair ((path / "stored.o").string (), elf_like)));
+}
+
+TEST (UnpackPipeline, ZipMembersWithinBudget) {
+    temp_directory_creator dir;
+    boost::filesystem::path const path = dir.path () / "x.zip";
+    zip_builder zip;
+    for (auto ctr = 0; ctr < 16; ++ctr) {
+        zip.add (std::to_string (ctr) + ".o", elf_like + std::string (10000, 'x'));
+    }
+    write_file (path, zip.build ());
+
+    // Room for just one member at a time.
+    unpack_pipeline pipeline (zip_jobs (path), 4U, 1U, nullptr);
+    EXPECT_EQ (16U, drain (pipeline).size ());
+}
+
+TEST (UnpackPipeline, WakesWorkersWaitingForTheQueue) {
+    // Worker 1 is waiting for the work queue (which is open and has an item in flight). When
+    // the pipeline buffers an entry, the worker must wake and take it rather than keep waiting
+    // for the queue.
+    work_queue<int> queue (2U);
+    {
+        work_queue<int>::producer producer (queue);
+        producer.push (queue.store (1));
+    }
+    int const * member = nullptr;
+    ASSERT_TRUE (queue.pop (0U, member));
+
+    temp_directory_creator dir;
+    boost::filesystem::path const path = dir.path () / "x.tar";
+    write_file (path, tar_builder ().add ("a.o", elf_like).build ());
+    unpack_pipeline pipeline ({unpack_pipeline::job::tar (path)}, 1U, 1024U, nullptr, nullptr,
+                              [&queue]() { queue.wake (); });
+
+    std::unique_ptr<unpack_pipeline::entry> e;
+    std::thread waiter ([&queue, &pipeline, &e]() {
+        int const * m = nullptr;
+        while (!pipeline.try_pop (e)) {
+            EXPECT_FALSE (queue.pop (1U, m, [&pipeline]() { return pipeline.ready (); }));
+            EXPECT_FALSE (queue.finished ());
+        }
+    });
+    waiter.join ();
+    ASSERT_NE (nullptr, e.get ());
+    EXPECT_EQ (path.string () + " (a.o)", e->user_path.string ());
+    pipeline.release (std::move (e));
+
+    queue.close ();
+    EXPECT_FALSE (queue.pop (0U, member));
+    EXPECT_TRUE (queue.finished ());
+}
+
+TEST (UnpackPipeline, ZipSizeMismatch) {
+    temp_directory_creator dir;
+    boost::filesystem::path const path = dir.path () / "x.zip";
+    write_file (path, zip_builder ().add ("a.o", elf_like).build ());
+
+    std::vector<unpack_pipeline::job> jobs = zip_jobs (path);
+    ASSERT_EQ (1U, jobs.size ());
+    jobs.front ().size += 1U;
+    unpack_pipeline pipeline (std::move (jobs), 1U, 1024U, nullptr);
+    std::unique_ptr<unpack_pipeline::entry> e;
+    EXPECT_THROW (pipeline.pop (e), std::runtime_error);
+}
+// eof unittest/test_unpack_pipeline.cpp
@@ -0,0 +1,266 @@
+// Copyright (c) 2016 by SN Systems Ltd., Sony Interactive Entertainment Inc.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "watch.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+#include <gmock/gmock.h>
+
+#include "flags.hpp"
+#include "temp_files.hpp"
+
+namespace {
+    /// Returns the contribution of a file containing the given inputs. 'groups' gives the
+    /// signature, size and input index of each group instance.
+    struct instance {
+        std::string signature;
+        std::uint64_t size;
+        std::uint32_t input;
+    };
+    watch::contribution make_contribution (std::vector<std::string> inputs,
+                                           std::vector<instance> const & groups,
+                                           unsigned char digest_byte) {
+        watch::contribution c;
+        for (auto const & g : groups) {
+            comdat_scanner::value & v = c.comdats[g.signature];
+            v.total_size += g.size;
+            v.largest = std::max (v.largest, g.size);
+            ++v.instances;
+            if (v.inputs.empty () || v.inputs.back () != g.input) {
+                v.inputs.push_back (g.input);
+            }
+        }
+        c.inputs = std::move (inputs);
+        md5::digest d;
+        std::fill (std::begin (d), std::end (d), digest_byte);
+        c.digests.assign (c.inputs.size (), d);
+        return c;
+    }
+
+    /// Returns the digest that a scanner would produce for the given contributions.
+    md5::digest expected_digest (std::vector<watch::contribution> const & contributions) {
+        digests d;
+        for (auto const & c : contributions) {
+            for (auto const & digest : c.digests) {
+                d.add (digest);
+            }
+        }
+        return d.final ();
+    }
+}
+
+TEST (LiveResults, UpdateAndRemove) {
+    watch::live_results live;
+    live.update ("a.o", make_contribution ({"a.o"}, {{"foo", 10U, 0U}}, 1U));
+    live.update ("b.a", make_contribution ({"b.a (x.o)", "b.a (y.o)"},
+                                           {{"foo", 20U, 0U}, {"bar", 5U, 0U}, {"bar", 5U, 1U}},
+                                           2U));
+    ASSERT_EQ (2U, live.files ());
+    ASSERT_EQ (2U, live.comdats ().size ());
+    {
+        comdat_scanner::value const & foo = live.comdats ().at ("foo");
+        EXPECT_EQ (30U, foo.total_size);
+        EXPECT_EQ (20U, foo.largest);
+        EXPECT_EQ (2U, foo.instances);
+    }
+
+    // Replacing b.a subtracts its old contribution. The largest 'foo' is now in a.o.
+    watch::contribution const b2 = make_contribution ({"b.a (x.o)"}, {{"bar", 7U, 0U}}, 3U);
+    live.update ("b.a", watch::contribution (b2));
+    {
+        comdat_scanner::value const & foo = live.comdats ().at ("foo");
+        EXPECT_EQ (10U, foo.total_size);
+        EXPECT_EQ (10U, foo.largest);
+        EXPECT_EQ (1U, foo.instances);
+        comdat_scanner::value const & bar = live.comdats ().at ("bar");
+        EXPECT_EQ (7U, bar.total_size);
+        EXPECT_EQ (7U, bar.largest);
+        EXPECT_EQ (1U, bar.instances);
+    }
+
+    comdat_scanner::comdat_map cm;
+    std::vector<std::string> inputs;
+    live.snapshot (cm, inputs);
+    EXPECT_THAT (inputs, ::testing::UnorderedElementsAre ("a.o", "b.a (x.o)"));
+    EXPECT_EQ ("a.o", inputs.at (cm.at ("foo").inputs.at (0)));
+    EXPECT_EQ ("b.a (x.o)", inputs.at (cm.at ("bar").inputs.at (0)));
+    EXPECT_EQ (expected_digest ({make_contribution ({"a.o"}, {}, 1U), b2}), live.digest ());
+
+    // Removing the last instance of a group removes the group.
+    EXPECT_EQ (1U, live.remove ("a.o"));
+    EXPECT_EQ (0U, live.comdats ().count ("foo"));
+    EXPECT_EQ (0U, live.remove ("a.o"));
+    EXPECT_EQ (expected_digest ({b2}), live.digest ());
+}
+
+TEST (LiveResults, RemoveDirectory) {
+    watch::live_results live;
+    live.update ("dir/x.o", make_contribution ({"dir/x.o"}, {{"foo", 1U, 0U}}, 1U));
+    live.update ("dir/sub/y.o", make_contribution ({"dir/sub/y.o"}, {{"foo", 2U, 0U}}, 2U));
+    live.update ("dirz.o", make_contribution ({"dirz.o"}, {{"foo", 4U, 0U}}, 3U));
+
+    EXPECT_EQ (2U, live.remove ("dir"));
+    EXPECT_THAT (live.paths (), ::testing::ElementsAre ("dirz.o"));
+    comdat_scanner::value const & foo = live.comdats ().at ("foo");
+    EXPECT_EQ (4U, foo.total_size);
+    EXPECT_EQ (1U, foo.instances);
+}
+
+TEST (LiveResults, MatchesAScanner) {
+    // Results built up by updates and removals are the same as those of a scanner given just
+    // the files that remain.
+    watch::live_results live;
+    live.update ("1.o", make_contribution ({"1.o"}, {{"a", 8U, 0U}, {"b", 3U, 0U}}, 1U));
+    live.update ("2.o", make_contribution ({"2.o"}, {{"a", 9U, 0U}}, 2U));
+    live.update ("3.o", make_contribution ({"3.o"}, {{"a", 8U, 0U}, {"b", 4U, 0U}}, 3U));
+    live.remove ("2.o");
+
+    output_flags const ofl{};
+    comdat_scanner scanner (ofl);
+    scanner.restore ({{"a", comdat_scanner::value{16U, 8U, 2U, {0, 1}}},
+                      {"b", comdat_scanner::value{7U, 4U, 2U, {0, 1}}}},
+                     {"1.o", "3.o"});
+    md5::digest d1, d3;
+    std::fill (std::begin (d1), std::end (d1), 1U);
+    std::fill (std::begin (d3), std::end (d3), 3U);
+    scanner.restore_digests ({d1, d3});
+
+    comdat_scanner::report const expected = scanner.make_report (true);
+    comdat_scanner::report const actual =
+        comdat_scanner::make_report (live.comdats (), live.digest (), true);
+    EXPECT_EQ (expected.comdats, actual.comdats);
+    EXPECT_EQ (expected.unfiltered, actual.unfiltered);
+    EXPECT_EQ (expected.totals, actual.totals);
+    EXPECT_EQ (expected.digest, actual.digest);
+}
+
+TEST (LiveResults, LargestAndInputsFollowChanges) {
+    // Files containing the same group are added and removed in an order which moves entries
+    // around in the group's 'inputs'. The largest instance and the inputs must remain those of
+    // the files that are left.
+    watch::live_results live;
+    for (unsigned ctr = 0; ctr < 6U; ++ctr) {
+        std::string const name = std::to_string (ctr) + ".o";
+        live.update (name, make_contribution ({name}, {{"g", 10U + ctr, 0U}}, 1U));
+    }
+    live.remove ("5.o");
+    live.remove ("1.o");
+    live.update ("3.o", make_contribution ({"3.o"}, {{"g", 2U, 0U}}, 1U));
+    live.remove ("4.o");
+
+    comdat_scanner::value const & g = live.comdats ().at ("g");
+    EXPECT_EQ (12U, g.largest);
+    EXPECT_EQ (3U, g.instances);
+    EXPECT_EQ (10U + 12U + 2U, g.total_size);
+
+    comdat_scanner::comdat_map cm;
+    std::vector<std::string> inputs;
+    live.snapshot (cm, inputs);
+    std::vector<std::string> names;
+    for (std::uint32_t const index : cm.at ("g").inputs) {
+        names.push_back (inputs.at (index));
+    }
+    EXPECT_TRUE (std::is_sorted (cm.at ("g").inputs.begin (), cm.at ("g").inputs.end ()));
+    EXPECT_THAT (names, ::testing::UnorderedElementsAre ("0.o", "2.o", "3.o"));
+
+    live.remove ("2.o");
+    EXPECT_EQ (10U, live.comdats ().at ("g").largest);
+}
+
+#ifdef __linux__
+namespace {
+    void touch (boost::filesystem::path const & p) {
+        std::ofstream os (p.native ());
+        os << "x";
+    }
+}
+
+TEST (Watcher, ReportsChanges) {
+    temp_directory_creator temp;
+    boost::filesystem::path const dir = temp.path ();
+    output_flags const ofl{};
+    watch::watcher watcher ({dir.string ()}, ofl);
+
+    std::chrono::milliseconds const debounce{20};
+    std::chrono::milliseconds const timeout{5000};
+
+    touch (dir / "a.o");
+    touch (dir / ".hidden");
+    watch::watcher::changes c = watcher.wait (debounce, timeout);
+    EXPECT_THAT (c.modified, ::testing::ElementsAre ((dir / "a.o").string ()));
+    EXPECT_TRUE (c.removed.empty ());
+
+    // A new directory is watched as soon as it's seen.
+    boost::filesystem::create_directory (dir / "sub");
+    touch (dir / "sub" / "b.o");
+    c = watcher.wait (debounce, timeout);
+    EXPECT_EQ (1U, c.modified.count ((dir / "sub" / "b.o").string ()));
+    touch (dir / "sub" / "c.o");
+    c = watcher.wait (debounce, timeout);
+    EXPECT_THAT (c.modified, ::testing::ElementsAre ((dir / "sub" / "c.o").string ()));
+
+    boost::filesystem::remove (dir / "a.o");
+    c = watcher.wait (debounce, timeout);
+    EXPECT_TRUE (c.modified.empty ());
+    EXPECT_THAT (c.removed, ::testing::ElementsAre ((dir / "a.o").string ()));
+
+    // Nothing more has changed.
+    c = watcher.wait (debounce, std::chrono::milliseconds{50});
+    EXPECT_TRUE (c.empty ());
+}
+
+TEST (Watcher, DirectoryMovedAway) {
+    temp_directory_creator temp;
+    temp_directory_creator elsewhere;
+    boost::filesystem::path const dir = temp.path ();
+    boost::filesystem::create_directories (dir / "sub" / "inner");
+    output_flags const ofl{};
+    watch::watcher watcher ({dir.string ()}, ofl);
+
+    std::chrono::milliseconds const debounce{20};
+    std::chrono::milliseconds const timeout{5000};
+
+    // A directory moved within the tree is watched under its new name.
+    boost::filesystem::rename (dir / "sub", dir / "moved");
+    watch::watcher::changes c = watcher.wait (debounce, timeout);
+    EXPECT_THAT (c.removed, ::testing::ElementsAre ((dir / "sub").string ()));
+    touch (dir / "moved" / "inner" / "a.o");
+    c = watcher.wait (debounce, timeout);
+    EXPECT_THAT (c.modified, ::testing::ElementsAre ((dir / "moved" / "inner" / "a.o").string ()));
+
+    // Once moved out of the tree, its changes are no longer reported.
+    boost::filesystem::path const away = elsewhere.path () / "away";
+    boost::filesystem::rename (dir / "moved", away);
+    c = watcher.wait (debounce, timeout);
+    EXPECT_THAT (c.removed, ::testing::ElementsAre ((dir / "moved").string ()));
+    touch (away / "b.o");
+    touch (away / "inner" / "c.o");
+    c = watcher.wait (debounce, std::chrono::milliseconds{50});
+    EXPECT_TRUE (c.empty ());
+}
+#endif // __linux__
+
+// eof test_watch.cpp
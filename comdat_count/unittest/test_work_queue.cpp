@@ -0,0 +1,242 @@
+// Copyright (c) 2016 by SN Systems Ltd., Sony Interactive Entertainment Inc.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "work_queue.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <numeric>
+#include <thread>
+#include <vector>
+
+#include <gmock/gmock.h>
+
+#include "append_arena.hpp"
+
+TEST (AppendArena, PointersAreStable) {
+    append_arena<int, 4> arena;
+    std::vector<int *> pointers;
+    for (int ctr = 0; ctr < 100; ++ctr) {
+        pointers.push_back (arena.append (int{ctr}));
+    }
+    EXPECT_EQ (100U, arena.size ());
+    for (int ctr = 0; ctr < 100; ++ctr) {
+        EXPECT_EQ (ctr, *pointers[ctr]);
+    }
+}
+
+TEST (AppendArena, Full) {
+    append_arena<int, 2, 2> arena;
+    for (int ctr = 0; ctr < 4; ++ctr) {
+        arena.append (int{ctr});
+    }
+    EXPECT_THROW (arena.append (5), std::length_error);
+}
+
+TEST (WorkQueue, Empty) {
+    work_queue<int> queue (2);
+    queue.close ();
+    int const * member = nullptr;
+    EXPECT_FALSE (queue.pop (0, member));
+    EXPECT_FALSE (queue.pop (1, member));
+}
+
+TEST (WorkQueue, SingleWorkerStealsEverything) {
+    // Batches are dealt out to both workers but worker 0 takes them all.
+    work_queue<int> queue (2);
+    {
+        work_queue<int>::producer producer (queue);
+        for (int ctr = 0; ctr < 100; ++ctr) {
+            producer.push (queue.store (int{ctr}));
+        }
+    }
+    queue.close ();
+
+    std::vector<int> actual;
+    int const * member = nullptr;
+    while (queue.pop (0, member)) {
+        actual.push_back (*member);
+    }
+    std::sort (std::begin (actual), std::end (actual));
+    ASSERT_EQ (100U, actual.size ());
+    for (int ctr = 0; ctr < 100; ++ctr) {
+        EXPECT_EQ (ctr, actual[ctr]);
+    }
+}
+
+TEST (WorkQueue, Cancel) {
+    work_queue<int> queue (1);
+    {
+        work_queue<int>::producer producer (queue);
+        producer.push (queue.store (1));
+    }
+    queue.cancel ();
+    int const * member = nullptr;
+    EXPECT_FALSE (queue.pop (0, member));
+}
+
+TEST (WorkQueue, WorkersPushMoreWork) {
+    // Each item with a value greater than zero causes a worker to push an item with the next
+    // lower value. The queue must not report that it is empty until all of these are done.
+    unsigned const num_workers = 4;
+    int const initial = 10;
+    work_queue<int> queue (num_workers);
+    {
+        work_queue<int>::producer producer (queue);
+        for (int ctr = 0; ctr < initial; ++ctr) {
+            producer.push (queue.store (int{initial}));
+        }
+    }
+    queue.close ();
+
+    std::atomic<int> processed (0);
+    std::vector<std::thread> threads;
+    for (unsigned worker = 0; worker < num_workers; ++worker) {
+        threads.emplace_back ([&queue, &processed, worker]() {
+            int const * member = nullptr;
+            while (queue.pop (worker, member)) {
+                ++processed;
+                if (*member > 0) {
+                    work_queue<int>::producer producer (queue, worker);
+                    producer.push (queue.store (*member - 1));
+                }
+            }
+        });
+    }
+    for (auto & t : threads) {
+        t.join ();
+    }
+    EXPECT_EQ (initial * (initial + 1), processed.load ());
+}
+
+TEST (WorkQueue, EveryWorkerGetsWork) {
+    // There are few enough items that they fit in a small number of batches. Idle workers must
+    // take items from batches that other workers are processing rather than leave them with
+    // all of the work.
+    unsigned const num_workers = 8;
+    int const items = static_cast<int> (num_workers) * 4;
+    work_queue<int> queue (num_workers);
+
+    std::vector<int> counts (num_workers, 0);
+    std::vector<std::thread> threads;
+    for (unsigned worker = 0; worker < num_workers; ++worker) {
+        threads.emplace_back ([&queue, &counts, worker]() {
+            int const * member = nullptr;
+            while (queue.pop (worker, member)) {
+                ++counts[worker];
+                std::this_thread::sleep_for (std::chrono::milliseconds (5));
+            }
+        });
+    }
+    {
+        work_queue<int>::producer producer (queue);
+        for (int ctr = 0; ctr < items; ++ctr) {
+            producer.push (queue.store (int{ctr}));
+        }
+    }
+    queue.close ();
+    for (auto & t : threads) {
+        t.join ();
+    }
+
+    EXPECT_EQ (items, std::accumulate (std::begin (counts), std::end (counts), 0));
+    for (unsigned worker = 0; worker < num_workers; ++worker) {
+        EXPECT_GT (counts[worker], 0) << "worker " << worker << " did no work";
+    }
+}
+
+TEST (WorkQueue, IdleWorkerWaitsForWork) {
+    // Worker 1 has nothing to do so it blocks in pop() until worker 0 pushes an item.
+    work_queue<int> queue (2);
+    std::atomic<int> popped (-1);
+    std::thread idle ([&queue, &popped]() {
+        int const * member = nullptr;
+        while (queue.pop (1, member)) {
+            popped = *member;
+        }
+    });
+    std::this_thread::sleep_for (std::chrono::milliseconds (20));
+    EXPECT_EQ (-1, popped.load ());
+    {
+        work_queue<int>::producer producer (queue, 1U);
+        producer.push (queue.store (7));
+    }
+    queue.close ();
+    idle.join ();
+    EXPECT_EQ (7, popped.load ());
+}
+
+TEST (WorkQueue, IdleWorkerWaitsForItemInFlight) {
+    // The queue is closed but worker 0 is still busy with an item. Worker 1 must not finish
+    // until that item is done since worker 0 may push more work.
+    work_queue<int> queue (2);
+    {
+        work_queue<int>::producer producer (queue);
+        producer.push (queue.store (1));
+    }
+    queue.close ();
+    int const * member = nullptr;
+    ASSERT_TRUE (queue.pop (0, member));
+
+    std::atomic<bool> done (false);
+    std::atomic<int> popped (-1);
+    std::thread idle ([&queue, &done, &popped]() {
+        int const * m = nullptr;
+        while (queue.pop (1, m)) {
+            popped = *m;
+        }
+        done = true;
+    });
+    std::this_thread::sleep_for (std::chrono::milliseconds (20));
+    EXPECT_FALSE (done.load ());
+    {
+        work_queue<int>::producer producer (queue, 1U);
+        producer.push (queue.store (2));
+    }
+    // Finishing with the first item lets worker 0 exit (unless it steals the second) and, once
+    // the second is finished, worker 1 too.
+    while (queue.pop (0, member)) {
+        popped = *member;
+    }
+    idle.join ();
+    EXPECT_TRUE (done.load ());
+    EXPECT_EQ (2, popped.load ());
+}
+
+TEST (WorkQueue, ReleaseLetsIdleWorkersFinish) {
+    // Worker 0 finishes with its item but doesn't call pop() again. Worker 1 must still see
+    // that the queue is finished.
+    work_queue<int> queue (2);
+    {
+        work_queue<int>::producer producer (queue);
+        producer.push (queue.store (1));
+    }
+    queue.close ();
+    int const * member = nullptr;
+    ASSERT_TRUE (queue.pop (0, member));
+    queue.release (0);
+    EXPECT_FALSE (queue.pop (1, member));
+    // Releasing again (or popping) is harmless.
+    queue.release (0);
+    EXPECT_FALSE (queue.pop (0, member));
+}
+
+// eof test_work_queue.cpp
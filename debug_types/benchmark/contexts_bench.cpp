@@ -0,0 +1,234 @@
+// Copyright (c) 2016 by SN Systems Ltd., Sony Interactive Entertainment Inc.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+// A benchmark of phase 1 (the discovery of type DIEs and their contexts) with increasing numbers
+// of threads. Each run builds the contexts of the whole file and the time taken to merge the
+// per-thread results is reported separately so that the cost of the merge can be seen as the
+// thread count grows. Finally, the way in which phase 2 would divide the types found between the
+// threads is described.
+
+// Standard library includes
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+// 3rd party includes
+#include <boost/iostreams/device/mapped_file.hpp>
+#include <boost/program_options.hpp>
+#include <boost/thread.hpp>
+
+// typeslib includes
+#include "build_contexts.hpp"
+#include "dwarf_exception.hpp"
+#include "progress.hpp"
+#include "work_queue.hpp"
+#include "worker_error.hpp"
+
+
+namespace {
+
+    struct timing {
+        double seconds;
+        double merge_seconds;
+        std::size_t types;
+        std::size_t contexts;
+        unsigned dies;
+    };
+
+    /// Builds the contexts of the DIEs in 'map_file' using 'num_threads' threads.
+    timing run (boost::iostreams::mapped_file const & map_file, unsigned num_threads) {
+        context_queue queue (1000);
+        context_queue_producer (map_file, &queue);
+
+        build_contexts builder;
+        silent_updater progress;
+        std::atomic<bool> error{false};
+
+        auto const start = std::chrono::steady_clock::now ();
+        {
+            boost::thread_group threads;
+            for (auto ctr = 0U; ctr < num_threads; ++ctr) {
+                auto entry_point =
+                    std::bind (&build_contexts::consumer_thread, &builder, std::cref (map_file),
+                               std::ref (queue), std::ref (progress), std::ref (error));
+                std::unique_ptr<boost::thread> t (new boost::thread (entry_point));
+                threads.add_thread (t.get ());
+                t.release ();
+            }
+            threads.join_all ();
+        }
+        if (error) {
+            throw worker_error ();
+        }
+        auto const merge_start = std::chrono::steady_clock::now ();
+        die_context_map const contexts = builder.release_contexts ();
+        auto const end = std::chrono::steady_clock::now ();
+
+        std::chrono::duration<double> const elapsed = end - start;
+        std::chrono::duration<double> const merge = end - merge_start;
+        return {elapsed.count (), merge.count (), contexts.size (), contexts.contexts (),
+                builder.die_count ()};
+    }
+
+    /// Returns the number of batch boundaries which fall inside a compilation unit. The types of
+    /// such a unit may be scanned by more than one thread, each of which must read its
+    /// abbreviations.
+    std::size_t unit_splits (die_context_map const & contexts,
+                             std::vector<work_batch> & batches) {
+        std::vector<Dwarf_Off> const & units = contexts.units ();
+        auto const unit_of = [&units](Dwarf_Off offset) {
+            return std::upper_bound (std::begin (units), std::end (units), offset);
+        };
+        std::size_t splits = 0;
+        for (std::size_t ctr = 1; ctr < batches.size (); ++ctr) {
+            if (unit_of (std::prev (batches[ctr - 1U].end ())->offset) ==
+                unit_of (batches[ctr].begin ()->offset)) {
+                ++splits;
+            }
+        }
+        return splits;
+    }
+
+    /// Shows how phase 2 divides the types between 'num_threads' threads: first as fixed
+    /// slices of 100 types and then as the batches used by scan_type_dies().
+    void report_batches (die_context_map const & contexts, unsigned num_threads) {
+        std::vector<work_batch> slices;
+        for (auto first = std::begin (contexts); first != std::end (contexts);) {
+            auto const size = std::min (std::distance (first, std::end (contexts)),
+                                        die_context_map::const_iterator::difference_type{100});
+            auto const last = std::next (first, size);
+            slices.emplace_back (first, last);
+            first = last;
+        }
+        std::size_t const bytes = work_batch_bytes (contexts, num_threads);
+        std::vector<work_batch> batches = make_work_batches (contexts, bytes);
+
+        std::cout << "Phase 2 work for " << num_threads << " threads ("
+                  << contexts.units ().size () << " units):\n"
+                  << "  100-type slices: " << slices.size () << " batches, "
+                  << unit_splits (contexts, slices) << " unit splits\n"
+                  << "  " << bytes << "-byte batches: " << batches.size () << " batches, "
+                  << unit_splits (contexts, batches) << " unit splits\n";
+    }
+
+
+    /// Runs the benchmark 'repeat' times and returns the fastest.
+    timing best_of (unsigned repeat, boost::iostreams::mapped_file const & map_file,
+                    unsigned num_threads) {
+        timing best = run (map_file, num_threads);
+        for (auto ctr = 1U; ctr < repeat; ++ctr) {
+            timing const t = run (map_file, num_threads);
+            if (t.seconds < best.seconds) {
+                best = t;
+            }
+        }
+        return best;
+    }
+}
+
+
+int main (int argc, char * argv[]) {
+    namespace po = boost::program_options;
+
+    try {
+        po::options_description options ("Options");
+        options.add_options () ("help", "produce help message") (
+            "threads,t",
+            po::value<unsigned> ()->default_value (
+                std::max (std::thread::hardware_concurrency (), 1U)),
+            "the largest number of threads to measure") (
+            "repeat", po::value<unsigned> ()->default_value (3U),
+            "the number of runs of each configuration (the fastest is reported)");
+        po::options_description hidden;
+        hidden.add_options () ("input-file", po::value<std::string> (), "input file");
+        po::options_description all;
+        all.add (options).add (hidden);
+        po::positional_options_description positional;
+        positional.add ("input-file", 1);
+
+        po::variables_map vm;
+        store (po::command_line_parser (argc, argv).options (all).positional (positional).run (),
+               vm);
+        notify (vm);
+        if (vm.count ("help") || !vm.count ("input-file")) {
+            std::cout << "Usage: " << argv[0] << " [options] file\n" << options << '\n';
+            return vm.count ("help") ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+
+        unsigned const max_threads = std::max (vm["threads"].as<unsigned> (), 1U);
+        unsigned const repeat = std::max (vm["repeat"].as<unsigned> (), 1U);
+        boost::iostreams::mapped_file const map_file (vm["input-file"].as<std::string> (),
+                                                      std::ios::in);
+
+        std::cout << std::setw (8) << "threads" << std::setw (12) << "seconds" << std::setw (12)
+                  << "merge" << std::setw (14) << "DIEs/s" << std::setw (10) << "speedup"
+                  << '\n';
+        timing first{};
+        for (auto threads = 1U;; threads = std::min (threads * 2U, max_threads)) {
+            timing const t = best_of (repeat, map_file, threads);
+            if (threads == 1U) {
+                first = t;
+            } else if (t.types != first.types || t.contexts != first.contexts ||
+                       t.dies != first.dies) {
+                std::cerr << "Results differ with " << threads << " threads\n";
+                return EXIT_FAILURE;
+            }
+            std::cout << std::setw (8) << threads << std::fixed << std::setprecision (3)
+                      << std::setw (12) << t.seconds << std::setw (12) << t.merge_seconds
+                      << std::setprecision (0) << std::setw (14)
+                      << static_cast<double> (t.dies) / t.seconds << std::setprecision (2)
+                      << std::setw (9) << first.seconds / t.seconds << "x\n";
+            if (threads == max_threads) {
+                break;
+            }
+        }
+        std::cout << first.dies << " DIEs, " << first.types << " types, " << first.contexts
+                  << " contexts\n";
+
+        {
+            context_queue queue (1000);
+            context_queue_producer (map_file, &queue);
+            build_contexts builder;
+            silent_updater progress;
+            std::atomic<bool> error{false};
+            builder.consumer (map_file, queue, progress, error);
+            report_batches (builder.release_contexts (), max_threads);
+        }
+    } catch (worker_error const &) {
+        // The worker thread will have reported the error.
+        return EXIT_FAILURE;
+    } catch (dwarf_exception const & dex) {
+        std::cerr << "DWARF error: " << dex << '\n';
+        return EXIT_FAILURE;
+    } catch (std::exception const & ex) {
+        std::cerr << "Error: " << ex.what () << '\n';
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+// eof benchmark/contexts_bench.cpp
@@ -24,7 +24,6 @@
 #include <algorithm>
 #include <iterator>
 #include <string>
-#include <tuple>
 
 #include "build_contexts.hpp"
 #include "dwarf_helpers.hpp"
@@ -32,9 +31,18 @@
 #include <dwarf.h>
 #include <libdwarf.h>
 
+/// Copies a range of bytes to the sequence. This is called unqualified so that an output
+/// iterator which can accept a contiguous block in one go (such as md5::output_iterator) may
+/// provide a more specialized overload to be found by argument-dependent lookup.
+template <typename InputIterator, typename SequenceOutputIterator>
+SequenceOutputIterator copy_bytes (InputIterator first, InputIterator last,
+                                   SequenceOutputIterator S) {
+    return std::copy (first, last, S);
+}
+
 template <typename SequenceOutputIterator>
 SequenceOutputIterator append_string (std::string const & str, SequenceOutputIterator S) {
-    S = std::copy (std::begin (str), std::end (str), S);
+    S = copy_bytes (str.data (), str.data () + str.size (), S);
     *(S++) = '\0';
     return S;
 }
@@ -45,7 +53,7 @@ SequenceOutputIterator append (Dwarf_Half const tag, Dwarf_Half const form, Valu
     *(S++) = 'A';
     S = encode_uleb128 (tag, S);
     S = encode_uleb128 (form, S);
-    S = std::copy (std::begin (value), std::end (value), S);
+    S = copy_bytes (std::begin (value), std::end (value), S);
     return S;
 }
 
@@ -61,14 +69,25 @@ SequenceOutputIterator append (Dwarf_Half const tag, Dwarf_Half const form, std:
 
 
 
+/// Appends the fragments which make up the context 'id', starting with the outermost.
+template <typename SequenceIterator>
+SequenceIterator append_context (die_context_map const & contexts,
+                                 die_context_map::context_id id, SequenceIterator S) {
+    if (id != die_context_map::root_context) {
+        S = append_context (contexts, contexts.parent (id), S);
+        auto const fragment = contexts.fragment (id);
+        S = copy_bytes (fragment.first, fragment.second, S);
+    }
+    return S;
+}
+
 template <typename SequenceIterator>
 SequenceIterator append_type_die_context (dwarf::debug * const debug, Dwarf_Die die,
                                           SequenceIterator S, die_context_map const & contexts) {
-    // The contexts container holds a map of DIE offset to its corresponding
-    // context string, so we can simply append that here.
+    // The contexts container maps the DIE's offset to its context, so we can simply append that
+    // here.
     auto it = contexts.find (debug->die_to_offset (die));
-    std::string const & s = (it != std::end (contexts)) ? std::get<0> (it->second) : std::string ();
-    return std::copy (std::begin (s), std::end (s), S);
+    return (it != std::end (contexts)) ? append_context (contexts, it->context, S) : S;
 }
 
 
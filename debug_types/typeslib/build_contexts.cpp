@@ -21,38 +21,19 @@
 #include "build_contexts.hpp"
 
 #include <cassert>
+#include <string>
 
 #include <dwarf.h>
 
-#include "append.hpp"
 #include "cu_iterator.hpp"
 #include "dwarf_exception.hpp"
 #include "dwarf_helpers.hpp"
 #include "elf_helpers.hpp"
-#include "leb128.hpp"
 #include "print.hpp"
 #include "progress.hpp"
 #include "worker_error.hpp"
 
 
-// ***********************************************************
-// * operator<< (std::ostream & os, die_context_map const &) *
-// ***********************************************************
-std::ostream & operator<< (std::ostream & os, die_context_map const & contexts) {
-    char const * indent = "    ";
-    char const * sep = "[\n";
-    for (auto c : contexts) {
-        auto const & offset = c.first;
-        auto const & context = std::get<0> (c.second);
-        auto const & producer = std::get<1> (c.second);
-        os << sep << indent << "{ \"offset\": " << offset << ", \"context\": \"" << context
-           << ", \"producer\": \"" << *producer << "\" }";
-        sep = ",\n";
-    }
-    return os << "\n]\n";
-}
-
-
 // **************************
 // * context_queue_producer *
 // **************************
@@ -85,18 +66,22 @@ build_contexts::build_contexts ()
 // cu_at_producer
 // ~~~~~~~~~~~~~~
 // Returns the producer name from a CU DIE.
-std::shared_ptr<std::string> build_contexts::cu_at_producer (dwarf::debug * const debug,
-                                                             dwarf::die_ptr const & cu_die) {
+die_context_map::producer_id build_contexts::cu_at_producer (dwarf::debug * const debug,
+                                                             dwarf::die_ptr const & cu_die,
+                                                             die_context_map & contexts) {
     if (dwarf::owned_attribute att = debug->attribute_from_tag (cu_die.get (), DW_AT_producer)) {
-        return std::make_shared<std::string> (att.get ().string ());
+        return contexts.add_producer (att.get ().string ());
     }
-    return std::make_shared<std::string> ("unknown");
+    return contexts.add_producer ("unknown");
 }
 
 // consumer
 // ~~~~~~~~
 void build_contexts::consumer (dwarf::debug * const debug, context_queue & queue,
                                updater_intf & progress, std::atomic<bool> & error) {
+    die_context_map contexts;
+    frame_stack stack;
+    auto dies = 0U;
     auto cu = Dwarf_Off{0};
     while (queue.pop (cu)) {
         if (error) {
@@ -104,11 +89,20 @@ void build_contexts::consumer (dwarf::debug * const debug, context_queue & queue
             break;
         }
         // print_cout ("Building contexts for CU @", cu);
+        contexts.add_unit (cu);
         auto cu_die = debug->offset_to_die (cu);
-        record_die_context (debug, cu_die.get (), cu_at_producer (debug, cu_die), std::string{});
+        auto const producer = cu_at_producer (debug, cu_die, contexts);
+        record_die_context (debug, cu_die, producer, contexts, stack, dies);
 
         progress.completed_incr ();
     }
+
+    // Sorting here means that each thread sorts its own entries and release_contexts() need
+    // only merge them.
+    contexts.sort_entries ();
+    die_count_ += dies;
+    std::lock_guard<std::mutex> guard (partials_mut_);
+    partials_.push_back (std::move (contexts));
 }
 
 void build_contexts::consumer (boost::iostreams::mapped_file const & map_file,
@@ -121,6 +115,29 @@ void build_contexts::consumer (boost::iostreams::mapped_file const & map_file,
 }
 
 
+// release_contexts
+// ~~~~~~~~~~~~~~~~
+die_context_map && build_contexts::release_contexts () {
+    std::lock_guard<std::mutex> guard (partials_mut_);
+    // Merge the maps in pairs so that each entry is moved O(log n) times for n maps.
+    while (partials_.size () > 1U) {
+        std::size_t const size = partials_.size ();
+        for (auto ctr = std::size_t{0}; ctr + 1U < size; ctr += 2U) {
+            partials_[ctr].merge (std::move (partials_[ctr + 1U]));
+        }
+        for (auto ctr = std::size_t{2}; ctr < size; ctr += 2U) {
+            partials_[ctr / 2U] = std::move (partials_[ctr]);
+        }
+        partials_.resize ((size + 1U) / 2U);
+    }
+    if (!partials_.empty ()) {
+        contexts_ = std::move (partials_.front ());
+        partials_.clear ();
+    }
+    contexts_.sort ();
+    return std::move (contexts_);
+}
+
 // consumer_thread
 // ~~~~~~~~~~~~~~~
 void build_contexts::consumer_thread (boost::iostreams::mapped_file const & map_file,
@@ -142,9 +159,10 @@ void build_contexts::consumer_thread (boost::iostreams::mapped_file const & map_
 
 // record_die_context
 // ~~~~~~~~~~~~~~~~~~
-void build_contexts::record_die_context (dwarf::debug * const debug, Dwarf_Die die,
-                                         std::shared_ptr<std::string> const & producer,
-                                         std::string ctx) {
+void build_contexts::record_die_context (dwarf::debug * const debug, dwarf::die_ptr const & die,
+                                         die_context_map::producer_id producer,
+                                         die_context_map & contexts, frame_stack & stack,
+                                         unsigned & dies) {
 
     // 2. If the debugging information entry represents a type that is
     //    nested inside another type or a namespace, append to S the type's
@@ -154,26 +172,40 @@ void build_contexts::record_die_context (dwarf::debug * const debug, Dwarf_Die d
     //    DW_AT_name attribute) of the type or namespace (including its
     //    trailing null byte).
 
-    auto const tag = debug->tag (die);
-    bool const is_type = debug->is_type_die (tag);
-    ++die_count_;
+    // Records a DIE and, if it has children, pushes the first of them onto the stack.
+    auto visit = [&](dwarf::die_ptr const & d, die_context_map::context_id ctx) {
+        auto const tag = debug->tag (d.get ());
+        bool const is_type = debug->is_type_die (tag);
+        ++dies;
 
-    if (is_type) {
-        auto const offset = debug->die_to_offset (die);
-        std::lock_guard<std::mutex> guard (contexts_mut_);
-        assert (contexts_.find (offset) == contexts_.end ());
-        contexts_.emplace (offset, std::make_tuple (ctx, producer));
-    }
-
-    if (tag == DW_TAG_namespace || is_type) {
-        auto inserter = std::back_inserter (ctx);
-        *(inserter++) = 'C';
-        inserter = encode_uleb128 (debug->tag (die), inserter);
-        inserter = append_string (debug->name (die), inserter);
-    }
-
-    for (auto & child_die : dwarf::die_children (debug, die)) {
-        record_die_context (debug, child_die.get (), producer, ctx);
+        if (is_type) {
+            contexts.add (debug->die_to_offset (d.get ()), ctx, producer);
+        }
+        if (auto child = debug->child (d.get ())) {
+            // The context of the children is created only if there are children to use it.
+            if (tag == DW_TAG_namespace || is_type) {
+                ctx = contexts.add_context (ctx, tag, debug->name (d.get ()));
+            }
+            stack.push_back (frame{std::move (child), ctx});
+        }
+    };
+
+    // The tree is walked depth-first using an explicit stack rather than by recursion. The top
+    // of the stack is the next DIE to be visited; the entries beneath it are the next siblings
+    // of its ancestors.
+    assert (stack.empty ());
+    visit (die, die_context_map::root_context);
+    while (!stack.empty ()) {
+        // Take the DIE from the top of the stack and replace it with its next sibling (if any).
+        frame & top = stack.back ();
+        dwarf::die_ptr const current = std::move (top.die);
+        auto const ctx = top.ctx;
+        if (auto sibling = debug->siblingof (current.get ())) {
+            top.die = std::move (sibling);
+        } else {
+            stack.pop_back ();
+        }
+        visit (current, ctx);
     }
 }
 // eof build_contexts.cpp
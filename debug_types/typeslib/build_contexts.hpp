@@ -22,23 +22,16 @@
 #define BUILD_CONTEXTS_HPP
 
 #include <atomic>
-#include <iosfwd>
-#include <memory>
 #include <mutex>
-#include <string>
-#include <tuple>
-#include <unordered_map>
+#include <vector>
 
 #include <boost/iostreams/device/mapped_file.hpp>
 #include <boost/lockfree/queue.hpp>
 
+#include "die_context_map.hpp"
 #include "dwarf_helpers.hpp"
 #include <libdwarf.h>
 
-using die_context_value = std::tuple<std::string, std::shared_ptr<std::string>>;
-using die_context_map = std::unordered_map<Dwarf_Off, die_context_value>;
-std::ostream & operator<< (std::ostream & os, die_context_map const & contexts);
-
 namespace dwarf {
     class debug;
 }
@@ -89,20 +82,34 @@ public:
     void consumer (boost::iostreams::mapped_file const & map_file, context_queue & queue,
                    updater_intf & progress, std::atomic<bool> & error);
 
-    die_context_map && release_contexts () {
-        return std::move (contexts_);
-    }
+    /// Merges the contexts recorded by each of the consumers and returns the result.
+    die_context_map && release_contexts ();
     unsigned die_count () const {
         return die_count_;
     }
 
 private:
-    void record_die_context (dwarf::debug * const debug, Dwarf_Die die,
-                             std::shared_ptr<std::string> const & producer, std::string ctx);
-    std::shared_ptr<std::string> cu_at_producer (dwarf::debug * const debug,
-                                                 dwarf::die_ptr const & cu_die);
-
-    std::mutex contexts_mut_;
+    /// A DIE waiting to be visited by record_die_context() and the context in which it lies.
+    struct frame {
+        dwarf::die_ptr die;
+        die_context_map::context_id ctx;
+    };
+    using frame_stack = std::vector<frame>;
+
+    /// Records the type DIEs in the tree rooted at 'die'. 'stack' is working storage which
+    /// is reused from one call to the next.
+    static void record_die_context (dwarf::debug * const debug, dwarf::die_ptr const & die,
+                                    die_context_map::producer_id producer,
+                                    die_context_map & contexts, frame_stack & stack,
+                                    unsigned & dies);
+    static die_context_map::producer_id cu_at_producer (dwarf::debug * const debug,
+                                                        dwarf::die_ptr const & cu_die,
+                                                        die_context_map & contexts);
+
+    /// Each consumer records the contexts of the CUs that it scans in a map of its own so that
+    /// the threads don't contend for a lock. The maps are merged by release_contexts().
+    std::mutex partials_mut_;
+    std::vector<die_context_map> partials_;
     die_context_map contexts_;
 
     std::atomic<unsigned> die_count_;
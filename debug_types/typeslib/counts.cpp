@@ -52,6 +52,29 @@ bool counts::is_unique (std::uint64_t signature, std::string const & producer) {
     return signatures_.emplace (signature).second;
 }
 
+// merge
+// ~~~~~
+void counts::merge (counts && other) {
+    assert (&other != this);
+    std::lock (mut_, other.mut_);
+    std::lock_guard<std::mutex> lock (mut_, std::adopt_lock);
+    std::lock_guard<std::mutex> other_lock (other.mut_, std::adopt_lock);
+
+    // Signatures seen by both are counted as unique only once.
+    for (std::uint64_t const signature : other.signatures_) {
+        if (signatures_.insert (signature).second) {
+            ++unique_;
+        }
+    }
+    producers_.insert (std::begin (other.producers_), std::end (other.producers_));
+    types_ += other.types_;
+
+    other.signatures_.clear ();
+    other.producers_.clear ();
+    other.types_ = 0U;
+    other.unique_ = 0U;
+}
+
 // simplified_producer_name
 // ~~~~~~~~~~~~~~~~~~~~~~~~
 std::string counts::simplified_producer_name (std::string::const_iterator first,
@@ -40,6 +40,10 @@ public:
         ++types_;
     }
 
+    /// Adds the types recorded by 'other' (for example, by the threads running on another NUMA
+    /// node) to these counts.
+    void merge (counts && other);
+
     std::ostream & write (std::ostream & os) const;
 
     unsigned total () const {
@@ -23,7 +23,7 @@
 cu_iterator::cu_iterator (dwarf::debug * const debug, Dwarf_Die die)
         : debug_ (debug)
         , next_cu_ ()
-        , die_ (die) {}
+        , die_ (debug->as_die_ptr (die)) {}
 
 cu_iterator::cu_iterator (dwarf::debug * const debug)
         : debug_ (debug)
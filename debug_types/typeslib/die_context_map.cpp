@@ -0,0 +1,197 @@
+// Copyright (c) 2016 by SN Systems Ltd., Sony Interactive Entertainment Inc.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "die_context_map.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <iterator>
+#include <ostream>
+
+#include "leb128.hpp"
+
+constexpr die_context_map::context_id die_context_map::root_context;
+
+// (ctor)
+// ~~~~~~
+die_context_map::die_context_map () {
+    nodes_.push_back (node{root_context, 0U, 0U});
+}
+
+// add_context
+// ~~~~~~~~~~~
+auto die_context_map::add_context (context_id parent, Dwarf_Half tag, std::string const & name)
+    -> context_id {
+    this->start_key (parent);
+    auto inserter = std::back_inserter (key_);
+    *(inserter++) = 'C';
+    encode_uleb128 (tag, inserter);
+    key_ += name;
+    key_ += '\0';
+    return this->intern_key (parent);
+}
+
+// intern
+// ~~~~~~
+auto die_context_map::intern (context_id parent, char const * first, char const * last)
+    -> context_id {
+    this->start_key (parent);
+    key_.append (first, last);
+    return this->intern_key (parent);
+}
+
+// start_key
+// ~~~~~~~~~
+void die_context_map::start_key (context_id parent) {
+    assert (parent < nodes_.size ());
+    key_.assign (reinterpret_cast<char const *> (&parent), sizeof (parent));
+}
+
+// intern_key
+// ~~~~~~~~~~
+auto die_context_map::intern_key (context_id parent) -> context_id {
+    // Most contexts have been seen before: the lookup reuses key_'s storage so that only a new
+    // context costs an allocation.
+    auto const pos = node_index_.find (key_);
+    if (pos != std::end (node_index_)) {
+        return pos->second;
+    }
+    auto const id = static_cast<context_id> (nodes_.size ());
+    auto const start = static_cast<std::uint32_t> (fragments_.size ());
+    auto const size = static_cast<std::uint32_t> (key_.size () - sizeof (parent));
+    fragments_.append (key_, sizeof (parent), std::string::npos);
+    nodes_.push_back (node{parent, start, size});
+    node_index_.emplace (key_, id);
+    return id;
+}
+
+// add_producer
+// ~~~~~~~~~~~~
+auto die_context_map::add_producer (std::string const & name) -> producer_id {
+    auto const id = static_cast<producer_id> (producers_.size ());
+    auto const result = producer_index_.emplace (name, id);
+    if (result.second) {
+        producers_.push_back (name);
+    }
+    return result.first->second;
+}
+
+// merge
+// ~~~~~
+void die_context_map::merge (die_context_map && other) {
+    assert (&other != this);
+    // A node's parent is always created before it, so the contexts can be translated in order.
+    std::vector<context_id> context_map (other.nodes_.size ());
+    context_map[root_context] = root_context;
+    for (auto id = context_id{1}; id < other.nodes_.size (); ++id) {
+        auto const f = other.fragment (id);
+        context_map[id] = this->intern (context_map[other.nodes_[id].parent], f.first, f.second);
+    }
+    std::vector<producer_id> producer_map;
+    producer_map.reserve (other.producers_.size ());
+    for (std::string const & producer : other.producers_) {
+        producer_map.push_back (this->add_producer (producer));
+    }
+
+    auto const middle = entries_.size ();
+    entries_.reserve (middle + other.entries_.size ());
+    for (value_type const & entry : other.entries_) {
+        entries_.push_back (
+            value_type{entry.offset, context_map[entry.context], producer_map[entry.producer]});
+    }
+    auto const middle_unit = units_.size ();
+    units_.insert (std::end (units_), std::begin (other.units_), std::end (other.units_));
+    if (sorted_ && other.sorted_) {
+        std::inplace_merge (std::begin (entries_),
+                            std::begin (entries_) + static_cast<std::ptrdiff_t> (middle),
+                            std::end (entries_), offset_less);
+        std::inplace_merge (std::begin (units_),
+                            std::begin (units_) + static_cast<std::ptrdiff_t> (middle_unit),
+                            std::end (units_));
+    } else {
+        sorted_ = false;
+    }
+    other = die_context_map ();
+}
+
+// sort_entries
+// ~~~~~~~~~~~~
+void die_context_map::sort_entries () {
+    if (!sorted_) {
+        std::sort (std::begin (entries_), std::end (entries_), offset_less);
+        std::sort (std::begin (units_), std::end (units_));
+        sorted_ = true;
+    }
+    assert (std::adjacent_find (std::begin (entries_), std::end (entries_),
+                                [](value_type const & a, value_type const & b) {
+                                    return a.offset == b.offset;
+                                }) == std::end (entries_));
+}
+
+// sort
+// ~~~~
+void die_context_map::sort () {
+    this->sort_entries ();
+    entries_.shrink_to_fit ();
+    units_.shrink_to_fit ();
+    fragments_.shrink_to_fit ();
+    nodes_.shrink_to_fit ();
+    node_index_.clear ();
+    producer_index_.clear ();
+    key_ = std::string ();
+}
+
+// find
+// ~~~~
+auto die_context_map::find (Dwarf_Off offset) const -> const_iterator {
+    auto const end = std::end (entries_);
+    auto const it = std::lower_bound (
+        std::begin (entries_), end, offset,
+        [](value_type const & entry, Dwarf_Off off) { return entry.offset < off; });
+    return (it != end && it->offset == offset) ? it : end;
+}
+
+// context
+// ~~~~~~~
+std::string die_context_map::context (context_id id) const {
+    std::string result;
+    for (; id != root_context; id = nodes_[id].parent) {
+        auto const f = this->fragment (id);
+        result.insert (0, f.first, static_cast<std::size_t> (f.second - f.first));
+    }
+    return result;
+}
+
+
+// ***********************************************************
+// * operator<< (std::ostream & os, die_context_map const &) *
+// ***********************************************************
+std::ostream & operator<< (std::ostream & os, die_context_map const & contexts) {
+    char const * indent = "    ";
+    char const * sep = "[\n";
+    for (die_context_map::value_type const & c : contexts) {
+        os << sep << indent << "{ \"offset\": " << c.offset << ", \"context\": \""
+           << contexts.context (c.context) << ", \"producer\": \""
+           << contexts.producer (c.producer) << "\" }";
+        sep = ",\n";
+    }
+    return os << "\n]\n";
+}
+// eof die_context_map.cpp
@@ -0,0 +1,164 @@
+// Copyright (c) 2016 by SN Systems Ltd., Sony Interactive Entertainment Inc.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef DIE_CONTEXT_MAP_HPP
+#define DIE_CONTEXT_MAP_HPP
+
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <libdwarf.h>
+
+// *******************
+// * die_context_map *
+// *******************
+/// Records the context (step 2 of the type signature computation) and the producer of each type
+/// DIE.
+///
+/// A context is the sequence of 'C' fragments (the letter 'C', the tag and the name of a
+/// surrounding type or namespace) from the outermost construct inwards. Contexts are held as a
+/// trie: each is identified by a small integer and consists of the identifier of its parent and
+/// its own fragment. Contexts and producer names are interned so that the many DIEs which share a
+/// namespace or producer share a single copy of it, leaving each type DIE with a small fixed-size
+/// entry in an array sorted by offset.
+class die_context_map {
+public:
+    using context_id = std::uint32_t;
+    using producer_id = std::uint32_t;
+    /// The empty context of a type which is not nested within another type or a namespace.
+    static constexpr context_id root_context = 0;
+
+    struct value_type {
+        Dwarf_Off offset;
+        context_id context;
+        producer_id producer;
+    };
+    using container = std::vector<value_type>;
+    using const_iterator = container::const_iterator;
+
+    die_context_map ();
+
+    /// Returns the context formed by appending the fragment for a type or namespace with the
+    /// given tag and name to 'parent'.
+    context_id add_context (context_id parent, Dwarf_Half tag, std::string const & name);
+    /// Returns the identifier of a producer name.
+    producer_id add_producer (std::string const & name);
+    /// Records the context and producer of the type DIE at 'offset'. sort() must be called once
+    /// all of the DIEs have been added and before any are looked up.
+    void add (Dwarf_Off offset, context_id context, producer_id producer) {
+        entries_.push_back (value_type{offset, context, producer});
+        sorted_ = false;
+    }
+    /// Records that the compilation unit at 'offset' has been scanned.
+    void add_unit (Dwarf_Off offset) {
+        units_.push_back (offset);
+        sorted_ = false;
+    }
+    /// Adds the DIEs recorded by 'other', interning its contexts and producers into this map
+    /// (which must not yet have been passed to sort()). If the entries of both maps were sorted
+    /// by sort_entries(), the result is sorted too.
+    void merge (die_context_map && other);
+
+    /// Sorts the entries and units by offset.
+    void sort_entries ();
+    /// Sorts the entries by offset and discards the tables used to intern contexts and
+    /// producers.
+    void sort ();
+
+    std::size_t size () const {
+        return entries_.size ();
+    }
+    bool empty () const {
+        return entries_.empty ();
+    }
+    const_iterator begin () const {
+        return entries_.begin ();
+    }
+    const_iterator end () const {
+        return entries_.end ();
+    }
+    /// Returns the entry for the DIE at 'offset' or end() if there is none.
+    const_iterator find (Dwarf_Off offset) const;
+
+    /// The offsets of the compilation units in which the DIEs were found, in ascending order.
+    std::vector<Dwarf_Off> const & units () const {
+        return units_;
+    }
+
+    /// The number of distinct contexts (including the root).
+    std::size_t contexts () const {
+        return nodes_.size ();
+    }
+    context_id parent (context_id id) const {
+        return nodes_[id].parent;
+    }
+    /// Returns the range of bytes holding the fragment added to the parent context by 'id'.
+    std::pair<char const *, char const *> fragment (context_id id) const {
+        char const * const first = fragments_.data () + nodes_[id].first;
+        return {first, first + nodes_[id].size};
+    }
+    /// Returns the complete sequence of fragments that make up the context 'id'.
+    std::string context (context_id id) const;
+
+    std::string const & producer (producer_id id) const {
+        return producers_[id];
+    }
+
+private:
+    struct node {
+        context_id parent;
+        std::uint32_t first;
+        std::uint32_t size;
+    };
+
+    context_id intern (context_id parent, char const * first, char const * last);
+    /// Starts to build the key of a child of 'parent' in key_. The child's fragment is appended
+    /// to it before it is passed to intern_key().
+    void start_key (context_id parent);
+    context_id intern_key (context_id parent);
+    static bool offset_less (value_type const & a, value_type const & b) {
+        return a.offset < b.offset;
+    }
+
+    container entries_;
+    std::vector<Dwarf_Off> units_;
+    /// True if entries_ and units_ are sorted.
+    bool sorted_ = true;
+
+    std::vector<node> nodes_;
+    /// The fragments of all of the contexts.
+    std::string fragments_;
+    /// Maps the parent's identifier and the fragment (as raw bytes) to a context.
+    std::unordered_map<std::string, context_id> node_index_;
+    /// Scratch space for the key of the context being looked up.
+    std::string key_;
+
+    std::vector<std::string> producers_;
+    std::unordered_map<std::string, producer_id> producer_index_;
+};
+
+std::ostream & operator<< (std::ostream & os, die_context_map const & contexts);
+
+#endif // DIE_CONTEXT_MAP_HPP
+// eof die_context_map.hpp
@@ -206,9 +206,7 @@ namespace dwarf {
         if (::dwarf_formblock (a, &block, &error) != DW_DLV_OK) {
             throw dwarf_exception (debug_, "dwarf_formblock", error);
         }
-
-        auto dealloc = [this](Dwarf_Block * a) { this->dealloc (a, DW_DLA_BLOCK); };
-        return {block, dealloc};
+        return attribute::block_ptr (block, block_deleter (this));
     }
 
     Dwarf_Off debug::attribute_form_ref (Dwarf_Attribute a) {
@@ -356,6 +354,20 @@ namespace dwarf {
     // (ctor)
     // ~~~~~~
     attribute_list::attribute_list (debug * debug, Dwarf_Die die) {
+        this->reset (debug, die);
+    }
+
+    // (dtor)
+    // ~~~~~~
+    attribute_list::~attribute_list () {
+        this->clear ();
+    }
+
+    // reset
+    // ~~~~~
+    void attribute_list::reset (debug * debug, Dwarf_Die die) {
+        this->clear ();
+
         Dwarf_Attribute * attributes{nullptr};
         Dwarf_Signed const size = debug->attrlist (die, &attributes);
 
@@ -368,12 +380,13 @@ namespace dwarf {
         }
     }
 
-    // (dtor)
-    // ~~~~~~
-    attribute_list::~attribute_list () {
+    // clear
+    // ~~~~~
+    void attribute_list::clear () {
         for (auto & a : array_) {
             a.get_debug ()->dealloc (a.get_attribute (), DW_DLA_ATTR);
         }
+        array_.clear ();
     }
 }
 
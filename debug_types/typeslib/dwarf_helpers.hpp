@@ -42,15 +42,46 @@ namespace dwarf {
     }
 
 
-    using die_ptr =
-        std::unique_ptr<std::remove_pointer<Dwarf_Die>::type, std::function<void(Dwarf_Die)>>;
+    class debug;
+
+    // ***************
+    // * die_deleter *
+    // ***************
+    /// Returns a DIE to the debug object which created it. Unlike a std::function, the deleter is
+    /// a single pointer which costs nothing to create or to move.
+    class die_deleter {
+    public:
+        die_deleter () noexcept = default;
+        explicit die_deleter (debug * const d) noexcept
+                : debug_ (d) {}
+        void operator() (Dwarf_Die die) const;
+
+    private:
+        debug * debug_ = nullptr;
+    };
+
+    using die_ptr = std::unique_ptr<std::remove_pointer<Dwarf_Die>::type, die_deleter>;
+
+    // *****************
+    // * block_deleter *
+    // *****************
+    /// Returns a block to the debug object which created it.
+    class block_deleter {
+    public:
+        block_deleter () noexcept = default;
+        explicit block_deleter (debug * const d) noexcept
+                : debug_ (d) {}
+        void operator() (Dwarf_Block * block) const;
+
+    private:
+        debug * debug_ = nullptr;
+    };
 
     bool is_type_reference_die (Dwarf_Half tag);
 }
 
 
 namespace dwarf {
-    class debug;
     // *************
     // * attribute *
     // *************
@@ -81,7 +112,7 @@ namespace dwarf {
         bool flag () const;
         Dwarf_Off ref () const;
         std::string string () const;
-        using block_ptr = std::unique_ptr<Dwarf_Block, std::function<void(Dwarf_Block *)>>;
+        using block_ptr = std::unique_ptr<Dwarf_Block, block_deleter>;
         block_ptr block () const;
         Dwarf_Signed signed_constant () const;
         Dwarf_Unsigned unsigned_constant () const;
@@ -139,8 +170,8 @@ namespace dwarf {
         virtual void dealloc (Dwarf_Ptr space, Dwarf_Unsigned alloc_type) {
             ::dwarf_dealloc (debug_, space, alloc_type);
         }
-        virtual die_ptr as_die_ptr (Dwarf_Die die) {
-            return {die, [this](Dwarf_Die d) { this->dealloc (d, DW_DLA_DIE); }};
+        die_ptr as_die_ptr (Dwarf_Die die) {
+            return die_ptr (die, die_deleter (this));
         }
 
         // Related DIEs
@@ -178,6 +209,13 @@ namespace dwarf {
         Dwarf_Debug debug_;
     };
 
+    inline void die_deleter::operator() (Dwarf_Die die) const {
+        debug_->dealloc (die, DW_DLA_DIE);
+    }
+    inline void block_deleter::operator() (Dwarf_Block * block) const {
+        debug_->dealloc (block, DW_DLA_BLOCK);
+    }
+
 
     // ****************
     // * die_children *
@@ -246,6 +284,7 @@ namespace dwarf {
         using value_type = container_type::value_type;
         using iterator = container_type::iterator;
 
+        attribute_list () = default;
         attribute_list (debug * debug, Dwarf_Die die);
         explicit attribute_list (container_type && c)
                 : array_ (std::move (c)) {}
@@ -265,6 +304,12 @@ namespace dwarf {
             return array_.size ();
         }
 
+        /// Replaces the contents of the list with the attributes of 'die'. The storage of the
+        /// existing list is reused.
+        void reset (debug * debug, Dwarf_Die die);
+        /// Releases the attributes held by the list but keeps its storage.
+        void clear ();
+
     private:
         container_type array_;
     };
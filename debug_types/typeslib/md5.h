@@ -58,7 +58,9 @@ extern "C"
     #include <algorithm>
     #include <array>
     #include <cstdint>
+    #include <cstring>
     #include <iosfwd>
+    #include <iterator>
     #include <ostream>
     #include <string>
 
@@ -102,6 +104,109 @@ extern "C"
                 this->append (str.begin (), str.end ());
             }
 
+
+        /// A hasher for data which arrives a few bytes at a time. Bytes are collected in a
+        /// block-sized buffer and md5_append() is called only with whole 64-byte blocks (which
+        /// it passes straight to the compression function) so that appending a single byte is
+        /// just a store.
+        class buffered_hasher {
+        public:
+            static constexpr std::size_t block_size = 64;
+
+            buffered_hasher () {
+                ::md5_init (&state_);
+            }
+
+            void append (std::uint8_t b) {
+                buffer_ [used_++] = b;
+                if (used_ == block_size) {
+                    this->flush ();
+                }
+            }
+
+            void append (void const * ptr, std::size_t size) {
+                auto p = static_cast <std::uint8_t const *> (ptr);
+                if (used_ > 0) {
+                    std::size_t const part = std::min (size, block_size - used_);
+                    std::memcpy (&buffer_ [used_], p, part);
+                    used_ += part;
+                    p += part;
+                    size -= part;
+                    if (used_ < block_size) {
+                        return;
+                    }
+                    this->flush ();
+                }
+                // Whole blocks are hashed directly from the source.
+                std::size_t const whole = size & ~(block_size - 1);
+                if (whole > 0) {
+                    ::md5_append (&state_, p, whole);
+                    p += whole;
+                    size -= whole;
+                }
+                if (size > 0) {
+                    std::memcpy (buffer_.data (), p, size);
+                    used_ = size;
+                }
+            }
+
+            digest finish () {
+                ::md5_append (&state_, buffer_.data (), used_);
+                used_ = 0;
+                digest result;
+                ::md5_finish (&state_, result.data ());
+                return result;
+            }
+
+        private:
+            void flush () {
+                ::md5_append (&state_, buffer_.data (), block_size);
+                used_ = 0;
+            }
+
+            md5_state state_;
+            std::array <std::uint8_t, block_size> buffer_;
+            std::size_t used_ = 0;
+        };
+
+
+        /// An output iterator which appends the bytes written through it to a buffered_hasher.
+        class output_iterator {
+        public:
+            typedef std::output_iterator_tag iterator_category;
+            typedef void value_type;
+            typedef void difference_type;
+            typedef void pointer;
+            typedef void reference;
+
+            explicit output_iterator (buffered_hasher * const hasher)
+                    : hasher_ (hasher) {}
+
+            template <typename T>
+                output_iterator & operator= (T const & value) {
+                    hasher_->append (static_cast <std::uint8_t> (value));
+                    return *this;
+                }
+
+            output_iterator & operator* () { return *this; }
+            output_iterator & operator++ () { return *this; }
+            output_iterator & operator++ (int) { return *this; }
+
+            buffered_hasher * hasher () const { return hasher_; }
+
+        private:
+            buffered_hasher * hasher_;
+        };
+
+        /// The bulk path for copy_bytes() (see append.hpp): a contiguous range is passed to the
+        /// hasher in one call rather than a byte at a time.
+        template <typename T>
+            output_iterator copy_bytes (T const * first, T const * last, output_iterator out) {
+                static_assert (sizeof (T) == 1, "copy_bytes() requires a sequence of bytes");
+                out.hasher ()->append (first, static_cast <std::size_t> (last - first));
+                return out;
+            }
+
         inline std::ostream & operator<< (std::ostream & os, digest const & digest) {
             auto hex_char = [] (std::uint8_t v) -> char {
                 return static_cast <char> (v + (v < 10 ? '0' : 'A' - 10));
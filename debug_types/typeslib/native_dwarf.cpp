@@ -0,0 +1,1108 @@
+// Copyright (c) 2016 by SN Systems Ltd., Sony Interactive Entertainment Inc.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "native_dwarf.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <sstream>
+#include <unordered_map>
+
+#include <dwarf.h>
+
+#include "elf_helpers.hpp"
+
+namespace {
+    // DWARF 5 and GNU values which older copies of dwarf.h don't define.
+    constexpr Dwarf_Half form_strx = 0x1a;
+    constexpr Dwarf_Half form_addrx = 0x1b;
+    constexpr Dwarf_Half form_ref_sup4 = 0x1c;
+    constexpr Dwarf_Half form_strp_sup = 0x1d;
+    constexpr Dwarf_Half form_data16 = 0x1e;
+    constexpr Dwarf_Half form_line_strp = 0x1f;
+    constexpr Dwarf_Half form_implicit_const = 0x21;
+    constexpr Dwarf_Half form_loclistx = 0x22;
+    constexpr Dwarf_Half form_rnglistx = 0x23;
+    constexpr Dwarf_Half form_ref_sup8 = 0x24;
+    constexpr Dwarf_Half form_strx1 = 0x25;
+    constexpr Dwarf_Half form_strx2 = 0x26;
+    constexpr Dwarf_Half form_strx3 = 0x27;
+    constexpr Dwarf_Half form_strx4 = 0x28;
+    constexpr Dwarf_Half form_addrx1 = 0x29;
+    constexpr Dwarf_Half form_addrx2 = 0x2a;
+    constexpr Dwarf_Half form_addrx3 = 0x2b;
+    constexpr Dwarf_Half form_addrx4 = 0x2c;
+    constexpr Dwarf_Half form_gnu_addr_index = 0x1f01;
+    constexpr Dwarf_Half form_gnu_str_index = 0x1f02;
+    constexpr Dwarf_Half form_gnu_ref_alt = 0x1f20;
+    constexpr Dwarf_Half form_gnu_strp_alt = 0x1f21;
+
+    constexpr Dwarf_Half at_str_offsets_base = 0x72;
+
+    constexpr std::uint8_t ut_compile = 0x01;
+    constexpr std::uint8_t ut_type = 0x02;
+    constexpr std::uint8_t ut_partial = 0x03;
+    constexpr std::uint8_t ut_skeleton = 0x04;
+    constexpr std::uint8_t ut_split_compile = 0x05;
+    constexpr std::uint8_t ut_split_type = 0x06;
+
+    /// The ELF section flag for a compressed section.
+    constexpr std::uint64_t shf_compressed = 0x800;
+
+    template <typename T>
+    std::string message (char const * what, T value) {
+        std::ostringstream str;
+        str << what << " (0x" << std::hex << value << ')';
+        return str.str ();
+    }
+
+    Dwarf_Die to_handle (Dwarf_Off offset) {
+        // One is added so that the DIE at offset 0 isn't mistaken for nullptr.
+        return reinterpret_cast<Dwarf_Die> (static_cast<std::uintptr_t> (offset) + 1U);
+    }
+
+
+    // **********
+    // * reader *
+    // **********
+    /// Reads the values of a section, checking that they lie within its bounds.
+    class reader {
+    public:
+        reader (std::uint8_t const * pos, std::uint8_t const * last, bool big_endian)
+                : pos_ (pos)
+                , last_ (last)
+                , big_endian_ (big_endian) {}
+
+        std::uint8_t const * pos () const {
+            return pos_;
+        }
+        bool at_end () const {
+            return pos_ >= last_;
+        }
+
+        std::uint64_t fixed (unsigned size) {
+            this->check (size);
+            auto value = std::uint64_t{0};
+            if (big_endian_) {
+                for (auto it = pos_, end = pos_ + size; it != end; ++it) {
+                    value = (value << 8) | *it;
+                }
+            } else {
+                for (auto it = pos_ + size; it != pos_; --it) {
+                    value = (value << 8) | *(it - 1);
+                }
+            }
+            pos_ += size;
+            return value;
+        }
+        std::uint64_t uleb () {
+            auto value = std::uint64_t{0};
+            auto shift = 0U;
+            std::uint8_t byte;
+            do {
+                this->check (1U);
+                byte = *(pos_++);
+                if (shift < 64U) {
+                    value |= static_cast<std::uint64_t> (byte & 0x7f) << shift;
+                }
+                shift += 7U;
+            } while (byte & 0x80);
+            return value;
+        }
+        std::int64_t sleb () {
+            auto value = std::uint64_t{0};
+            auto shift = 0U;
+            std::uint8_t byte;
+            do {
+                this->check (1U);
+                byte = *(pos_++);
+                if (shift < 64U) {
+                    value |= static_cast<std::uint64_t> (byte & 0x7f) << shift;
+                }
+                shift += 7U;
+            } while (byte & 0x80);
+            if (shift < 64U && (byte & 0x40)) {
+                value |= ~std::uint64_t{0} << shift; // sign extend
+            }
+            return static_cast<std::int64_t> (value);
+        }
+        void skip (std::uint64_t size) {
+            this->check (size);
+            pos_ += size;
+        }
+        /// Skips a null-terminated string.
+        void skip_string () {
+            auto const end = std::find (pos_, last_, std::uint8_t{0});
+            if (end == last_) {
+                throw dwarf::native_error ("unterminated DWARF string");
+            }
+            pos_ = end + 1;
+        }
+
+    private:
+        void check (std::uint64_t size) const {
+            if (size > static_cast<std::uint64_t> (last_ - pos_)) {
+                throw dwarf::native_error ("truncated DWARF data");
+            }
+        }
+
+        std::uint8_t const * pos_;
+        std::uint8_t const * last_;
+        bool big_endian_;
+    };
+
+    Dwarf_Signed sign_extend (std::uint64_t value, unsigned size) {
+        auto const shift = 64U - size * 8U;
+        return static_cast<Dwarf_Signed> (value << shift) >> shift;
+    }
+
+    bool is_local_ref (Dwarf_Half form) {
+        switch (form) {
+        case DW_FORM_ref1:
+        case DW_FORM_ref2:
+        case DW_FORM_ref4:
+        case DW_FORM_ref8:
+        case DW_FORM_ref_udata:
+            return true;
+        }
+        return false;
+    }
+
+    bool is_strx (Dwarf_Half form) {
+        switch (form) {
+        case form_strx:
+        case form_strx1:
+        case form_strx2:
+        case form_strx3:
+        case form_strx4:
+            return true;
+        }
+        return false;
+    }
+
+    /// Returns the size of a value of one of the fixed-size forms or 0 if the size of its value
+    /// varies.
+    unsigned fixed_size (Dwarf_Half form, dwarf::native_index::unit const & u) {
+        switch (form) {
+        case DW_FORM_flag_present:
+        case form_implicit_const:
+            return 0U;
+        case DW_FORM_data1:
+        case DW_FORM_ref1:
+        case DW_FORM_flag:
+        case form_strx1:
+        case form_addrx1:
+            return 1U;
+        case DW_FORM_data2:
+        case DW_FORM_ref2:
+        case form_strx2:
+        case form_addrx2:
+            return 2U;
+        case form_strx3:
+        case form_addrx3:
+            return 3U;
+        case DW_FORM_data4:
+        case DW_FORM_ref4:
+        case form_ref_sup4:
+        case form_strx4:
+        case form_addrx4:
+            return 4U;
+        case DW_FORM_data8:
+        case DW_FORM_ref8:
+        case DW_FORM_ref_sig8:
+        case form_ref_sup8:
+            return 8U;
+        case form_data16:
+            return 16U;
+        case DW_FORM_addr:
+            return u.address_size;
+        case DW_FORM_ref_addr:
+            return u.version == 2 ? u.address_size : u.offset_size;
+        case DW_FORM_strp:
+        case DW_FORM_sec_offset:
+        case form_line_strp:
+        case form_strp_sup:
+        case form_gnu_ref_alt:
+        case form_gnu_strp_alt:
+            return u.offset_size;
+        }
+        return 0U;
+    }
+
+    /// Skips the value of an attribute. 'form' must not be DW_FORM_indirect.
+    void skip_value (reader & r, Dwarf_Half form, dwarf::native_index::unit const & u) {
+        switch (form) {
+        case DW_FORM_flag_present:
+        case form_implicit_const:
+            break;
+        case DW_FORM_string:
+            r.skip_string ();
+            break;
+        case DW_FORM_sdata:
+        case DW_FORM_udata:
+        case DW_FORM_ref_udata:
+        case form_strx:
+        case form_addrx:
+        case form_loclistx:
+        case form_rnglistx:
+        case form_gnu_addr_index:
+        case form_gnu_str_index:
+            r.uleb ();
+            break;
+        case DW_FORM_block1:
+            r.skip (r.fixed (1U));
+            break;
+        case DW_FORM_block2:
+            r.skip (r.fixed (2U));
+            break;
+        case DW_FORM_block4:
+            r.skip (r.fixed (4U));
+            break;
+        case DW_FORM_block:
+        case DW_FORM_exprloc:
+            r.skip (r.uleb ());
+            break;
+        default:
+            if (auto const size = fixed_size (form, u)) {
+                r.skip (size);
+                break;
+            }
+            throw dwarf::native_error (message ("unknown DWARF form", form));
+        }
+    }
+
+    /// Returns the form of an attribute whose value is at the reader's position, first reading
+    /// the actual form if it is DW_FORM_indirect.
+    Dwarf_Half direct_form (reader & r, Dwarf_Half form) {
+        while (form == DW_FORM_indirect) {
+            form = static_cast<Dwarf_Half> (r.uleb ());
+        }
+        return form;
+    }
+
+    /// Skips the attribute values of an entry whose abbreviation is 'a'. If the entry has a
+    /// DW_AT_sibling reference, its (section) offset is stored in 'sibling'.
+    void skip_values (reader & r, dwarf::native_index const & index,
+                      dwarf::native_index::abbreviation const & a,
+                      dwarf::native_index::unit const & u, Dwarf_Off * sibling) {
+        auto const * spec = index.specs (a);
+        for (auto const * end = spec + a.num_specs; spec != end; ++spec) {
+            auto const form = direct_form (r, spec->form);
+            if (spec->attr == DW_AT_sibling && is_local_ref (form)) {
+                *sibling = u.offset + (form == DW_FORM_ref_udata ? r.uleb ()
+                                                                 : r.fixed (fixed_size (form, u)));
+            } else {
+                skip_value (r, form, u);
+            }
+        }
+    }
+} // end anonymous namespace
+
+
+namespace dwarf {
+    // ****************
+    // * native_error *
+    // ****************
+    native_error::native_error (std::string const & message)
+            : std::runtime_error (message) {}
+
+
+    // ****************
+    // * native_index *
+    // ****************
+    constexpr Dwarf_Unsigned native_index::no_str_offsets_base;
+
+    // (ctor)
+    // ~~~~~~
+    native_index::native_index (native_sections const & sections)
+            : sections_ (sections) {
+
+        std::unordered_map<Dwarf_Off, std::uint32_t> tables;
+        auto const first = sections_.info.first;
+        auto const size = sections_.info.size ();
+        auto offset = Dwarf_Off{0};
+        while (offset < size) {
+            reader r (first + offset, sections_.info.last, sections_.big_endian);
+            unit u{};
+            u.offset = offset;
+            u.offset_size = 4U;
+            u.length = r.fixed (4U);
+            if (u.length == 0xffffffff) {
+                u.offset_size = 8U;
+                u.length = r.fixed (8U);
+            } else if (u.length >= 0xfffffff0) {
+                throw native_error (message ("bad unit length", u.length));
+            }
+            auto const header = static_cast<Dwarf_Off> (r.pos () - first);
+            if (u.length > size - header) {
+                throw native_error (message ("unit extends beyond .debug_info", offset));
+            }
+            u.end = header + u.length;
+
+            u.version = static_cast<Dwarf_Half> (r.fixed (2U));
+            if (u.version < 2 || u.version > 5) {
+                throw native_error (message ("unsupported DWARF version", u.version));
+            }
+            if (u.version >= 5) {
+                auto const type = static_cast<std::uint8_t> (r.fixed (1U));
+                u.address_size = static_cast<std::uint8_t> (r.fixed (1U));
+                u.abbrev_offset = r.fixed (u.offset_size);
+                switch (type) {
+                case ut_compile:
+                case ut_partial:
+                    break;
+                case ut_skeleton:
+                case ut_split_compile:
+                    r.skip (8U); // dwo_id
+                    break;
+                case ut_type:
+                case ut_split_type:
+                    r.skip (8U + u.offset_size); // type_signature and type_offset
+                    break;
+                default:
+                    throw native_error (message ("unknown unit type", unsigned{type}));
+                }
+            } else {
+                u.abbrev_offset = r.fixed (u.offset_size);
+                u.address_size = static_cast<std::uint8_t> (r.fixed (1U));
+            }
+            u.die_offset = static_cast<Dwarf_Off> (r.pos () - first);
+            if (u.die_offset > u.end) {
+                throw native_error (message ("bad unit header", offset));
+            }
+
+            auto const pos = tables.find (u.abbrev_offset);
+            if (pos != std::end (tables)) {
+                u.table = pos->second;
+            } else {
+                u.table = this->read_table (u.abbrev_offset);
+                tables.emplace (u.abbrev_offset, u.table);
+            }
+
+            // The unit DIE may give the base of the unit's string offsets. There's no default:
+            // a unit which uses DW_FORM_strx* without one is left to libdwarf.
+            u.str_offsets_base = no_str_offsets_base;
+            reader die (first + u.die_offset, first + u.end, sections_.big_endian);
+            if (!die.at_end ()) {
+                if (auto const code = die.uleb ()) {
+                    abbreviation const & a = this->find_abbreviation (u, code);
+                    auto const * spec = this->specs (a);
+                    for (auto const * end = spec + a.num_specs; spec != end; ++spec) {
+                        auto const form = direct_form (die, spec->form);
+                        if (spec->attr == at_str_offsets_base && form == DW_FORM_sec_offset) {
+                            u.str_offsets_base = die.fixed (u.offset_size);
+                            break;
+                        }
+                        skip_value (die, form, u);
+                    }
+                }
+            }
+            if (u.str_offsets_base == no_str_offsets_base && this->uses_strx (u.table)) {
+                throw native_error (
+                    message ("DW_FORM_strx used without DW_AT_str_offsets_base in unit", offset));
+            }
+
+            units_.push_back (u);
+            offset = u.end;
+        }
+    }
+
+    // read_table
+    // ~~~~~~~~~~
+    std::uint32_t native_index::read_table (Dwarf_Off offset) {
+        if (offset >= sections_.abbrev.size ()) {
+            throw native_error (message ("bad abbreviation table offset", offset));
+        }
+        reader r (sections_.abbrev.first + offset, sections_.abbrev.last, sections_.big_endian);
+        auto const first = static_cast<std::uint32_t> (abbreviations_.size ());
+        while (!r.at_end ()) {
+            auto const code = r.uleb ();
+            if (code == 0) {
+                break;
+            }
+            abbreviation a;
+            a.code = code;
+            a.tag = static_cast<Dwarf_Half> (r.uleb ());
+            a.children = r.fixed (1U) != 0;
+            a.first_spec = static_cast<std::uint32_t> (specs_.size ());
+            for (;;) {
+                auto const attr = static_cast<Dwarf_Half> (r.uleb ());
+                auto const form = static_cast<Dwarf_Half> (r.uleb ());
+                if (attr == 0 && form == 0) {
+                    break;
+                }
+                specs_.push_back (
+                    attribute_spec{attr, form, form == form_implicit_const ? r.sleb () : 0});
+            }
+            a.num_specs = static_cast<std::uint32_t> (specs_.size ()) - a.first_spec;
+            abbreviations_.push_back (a);
+        }
+
+        auto const begin = std::begin (abbreviations_) + first;
+        auto const end = std::end (abbreviations_);
+        std::sort (begin, end, [](abbreviation const & a, abbreviation const & b) {
+            return a.code < b.code;
+        });
+        table t;
+        t.first = first;
+        t.size = static_cast<std::uint32_t> (abbreviations_.size ()) - first;
+        t.dense = true;
+        for (auto index = std::uint32_t{0}; index < t.size && t.dense; ++index) {
+            t.dense = abbreviations_[first + index].code == index + 1U;
+        }
+        tables_.push_back (t);
+        return static_cast<std::uint32_t> (tables_.size () - 1U);
+    }
+
+    // uses_strx
+    // ~~~~~~~~~
+    bool native_index::uses_strx (std::uint32_t table_index) const {
+        table const & t = tables_[table_index];
+        auto const first = std::begin (abbreviations_) + t.first;
+        return std::any_of (first, first + t.size, [this](abbreviation const & a) {
+            auto const * const spec = this->specs (a);
+            return std::any_of (spec, spec + a.num_specs,
+                                [](attribute_spec const & as) { return is_strx (as.form); });
+        });
+    }
+
+    // find_unit
+    // ~~~~~~~~~
+    auto native_index::find_unit (Dwarf_Off offset) const -> unit const * {
+        auto it = std::upper_bound (
+            std::begin (units_), std::end (units_), offset,
+            [](Dwarf_Off off, unit const & u) { return off < u.offset; });
+        if (it == std::begin (units_)) {
+            return nullptr;
+        }
+        --it;
+        return (offset >= it->die_offset && offset < it->end) ? &*it : nullptr;
+    }
+
+    // find_abbreviation
+    // ~~~~~~~~~~~~~~~~~
+    auto native_index::find_abbreviation (unit const & u, Dwarf_Unsigned code) const
+        -> abbreviation const & {
+        table const & t = tables_[u.table];
+        if (t.dense) {
+            if (code >= 1U && code <= t.size) {
+                return abbreviations_[t.first + code - 1U];
+            }
+        } else {
+            auto const begin = std::begin (abbreviations_) + t.first;
+            auto const end = begin + t.size;
+            auto const it =
+                std::lower_bound (begin, end, code, [](abbreviation const & a, Dwarf_Unsigned c) {
+                    return a.code < c;
+                });
+            if (it != end && it->code == code) {
+                return *it;
+            }
+        }
+        throw native_error (message ("unknown abbreviation code", code));
+    }
+
+
+    // *********************
+    // * make_native_index *
+    // *********************
+    std::unique_ptr<native_index> make_native_index (void const * image, std::size_t size) {
+        auto elf = elf::make_elf (image, size);
+        char const * const ident = ::elf_getident (elf.get (), nullptr);
+        if (ident == nullptr) {
+            return nullptr;
+        }
+        bool const is64 = ident[EI_CLASS] == ELFCLASS64;
+
+        native_sections sections;
+        sections.big_endian = ident[EI_DATA] == ELFDATA2MSB;
+        if (is64) {
+            auto const ehdr = ::elf64_getehdr (elf.get ());
+            if (ehdr == nullptr || ehdr->e_type == ET_REL) {
+                return nullptr;
+            }
+        } else {
+            auto const ehdr = ::elf32_getehdr (elf.get ());
+            if (ehdr == nullptr || ehdr->e_type == ET_REL) {
+                return nullptr;
+            }
+        }
+
+        auto shstrndx = std::size_t{0};
+        if (::elf_getshdrstrndx (elf.get (), &shstrndx) != 0) {
+            return nullptr;
+        }
+        auto const bytes = static_cast<std::uint8_t const *> (image);
+        for (Elf_Scn * scn = ::elf_nextscn (elf.get (), nullptr); scn != nullptr;
+             scn = ::elf_nextscn (elf.get (), scn)) {
+            std::uint64_t name, type, flags, offset, length;
+            if (is64) {
+                auto const shdr = ::elf64_getshdr (scn);
+                if (shdr == nullptr) {
+                    return nullptr;
+                }
+                name = shdr->sh_name, type = shdr->sh_type, flags = shdr->sh_flags;
+                offset = shdr->sh_offset, length = shdr->sh_size;
+            } else {
+                auto const shdr = ::elf32_getshdr (scn);
+                if (shdr == nullptr) {
+                    return nullptr;
+                }
+                name = shdr->sh_name, type = shdr->sh_type, flags = shdr->sh_flags;
+                offset = shdr->sh_offset, length = shdr->sh_size;
+            }
+
+            char const * const section_name = ::elf_strptr (elf.get (), shstrndx, name);
+            if (section_name == nullptr) {
+                continue;
+            }
+            if (std::strncmp (section_name, ".zdebug", 7) == 0) {
+                return nullptr;
+            }
+            native_sections::range * range = nullptr;
+            if (std::strcmp (section_name, ".debug_info") == 0) {
+                range = &sections.info;
+            } else if (std::strcmp (section_name, ".debug_abbrev") == 0) {
+                range = &sections.abbrev;
+            } else if (std::strcmp (section_name, ".debug_str") == 0) {
+                range = &sections.str;
+            } else if (std::strcmp (section_name, ".debug_line_str") == 0) {
+                range = &sections.line_str;
+            } else if (std::strcmp (section_name, ".debug_str_offsets") == 0) {
+                range = &sections.str_offsets;
+            }
+            if (range == nullptr || type == SHT_NOBITS) {
+                continue;
+            }
+            if ((flags & shf_compressed) != 0 || offset > size || length > size - offset) {
+                return nullptr;
+            }
+            range->first = bytes + offset;
+            range->last = range->first + length;
+        }
+        try {
+            return std::unique_ptr<native_index> (new native_index (sections));
+        } catch (native_error const &) {
+            // Leave the file to libdwarf.
+            return nullptr;
+        }
+    }
+
+
+    // ****************
+    // * native_debug *
+    // ****************
+    // (ctor)
+    // ~~~~~~
+    native_debug::native_debug (native_index const & index)
+            : debug (Dwarf_Debug{nullptr})
+            , index_ (index)
+            , last_die_ () {}
+
+    // (dtor)
+    // ~~~~~~
+    native_debug::~native_debug () {
+        for (Dwarf_Attribute * list : free_lists_) {
+            delete[] list;
+        }
+    }
+
+    // next_cu_header
+    // ~~~~~~~~~~~~~~
+    bool native_debug::next_cu_header (Dwarf_Unsigned * cu_header_length,
+                                       Dwarf_Half * version_stamp, Dwarf_Off * abbrev_offset,
+                                       Dwarf_Half * address_size,
+                                       Dwarf_Unsigned * next_cu_header_offset) {
+        auto const & units = index_.units ();
+        if (next_unit_ >= units.size ()) {
+            // Like libdwarf, start again from the first unit on the next call.
+            next_unit_ = 0;
+            current_unit_ = nullptr;
+            return false;
+        }
+        current_unit_ = &units[next_unit_++];
+        *cu_header_length = current_unit_->length;
+        *version_stamp = current_unit_->version;
+        *abbrev_offset = current_unit_->abbrev_offset;
+        *address_size = current_unit_->address_size;
+        *next_cu_header_offset = current_unit_->end;
+        return true;
+    }
+
+    // die_to_offset
+    // ~~~~~~~~~~~~~
+    Dwarf_Off native_debug::die_to_offset (Dwarf_Die die) {
+        assert (die != nullptr);
+        return static_cast<Dwarf_Off> (reinterpret_cast<std::uintptr_t> (die) - 1U);
+    }
+
+    // offset_to_die
+    // ~~~~~~~~~~~~~
+    die_ptr native_debug::offset_to_die (Dwarf_Off offset) {
+        this->decode (offset); // Check that there's a DIE at 'offset'.
+        return this->as_die_ptr (to_handle (offset));
+    }
+
+    // dealloc
+    // ~~~~~~~
+    void native_debug::dealloc (Dwarf_Ptr space, Dwarf_Unsigned alloc_type) {
+        if (space == nullptr) {
+            return;
+        }
+        switch (alloc_type) {
+        case DW_DLA_ATTR:
+            free_records_.push_back (static_cast<attribute_record *> (space));
+            break;
+        case DW_DLA_LIST:
+            free_lists_.push_back (static_cast<Dwarf_Attribute *> (space) - 1);
+            break;
+        case DW_DLA_BLOCK:
+            delete static_cast<Dwarf_Block *> (space);
+            break;
+        default:
+            // DIEs are offsets: there's nothing to free.
+            break;
+        }
+    }
+
+    // decode
+    // ~~~~~~
+    auto native_debug::decode (Dwarf_Die die) -> die_info {
+        return this->decode (this->die_to_offset (die));
+    }
+
+    auto native_debug::decode (Dwarf_Off offset) -> die_info {
+        if (last_die_.abbrev != nullptr && last_die_.offset == offset) {
+            return last_die_;
+        }
+        native_index::unit const * u = last_die_.unit;
+        if (u == nullptr || offset < u->die_offset || offset >= u->end) {
+            u = index_.find_unit (offset);
+            if (u == nullptr) {
+                throw native_error (message ("no DIE at offset", offset));
+            }
+        }
+        auto const & info = index_.sections ().info;
+        reader r (info.first + offset, info.first + u->end, index_.sections ().big_endian);
+        auto const code = r.uleb ();
+        if (code == 0) {
+            throw native_error (message ("no DIE at offset", offset));
+        }
+        last_die_.offset = offset;
+        last_die_.unit = u;
+        last_die_.abbrev = &index_.find_abbreviation (*u, code);
+        last_die_.values = r.pos ();
+        return last_die_;
+    }
+
+    // skip_children
+    // ~~~~~~~~~~~~~
+    std::uint8_t const * native_debug::skip_children (native_index::unit const & u,
+                                                      std::uint8_t const * pos) const {
+        auto const & sections = index_.sections ();
+        auto const first = sections.info.first;
+        reader r (pos, first + u.end, sections.big_endian);
+        for (auto depth = 1U; depth > 0U && !r.at_end ();) {
+            auto const entry = static_cast<Dwarf_Off> (r.pos () - first);
+            auto const code = r.uleb ();
+            if (code == 0) {
+                --depth;
+                continue;
+            }
+            native_index::abbreviation const & a = index_.find_abbreviation (u, code);
+            auto sibling = Dwarf_Off{0};
+            skip_values (r, index_, a, u, &sibling);
+            if (a.children) {
+                // Where the producer has provided a DW_AT_sibling reference, use it to jump
+                // over the entry's children.
+                if (sibling > entry && sibling < u.end) {
+                    r = reader (first + sibling, first + u.end, sections.big_endian);
+                } else {
+                    ++depth;
+                }
+            }
+        }
+        return r.pos ();
+    }
+
+    // die_at
+    // ~~~~~~
+    die_ptr native_debug::die_at (native_index::unit const & u, std::uint8_t const * pos) {
+        auto const & sections = index_.sections ();
+        reader r (pos, sections.info.first + u.end, sections.big_endian);
+        if (r.at_end () || r.uleb () == 0) {
+            return this->as_die_ptr (nullptr);
+        }
+        return this->as_die_ptr (to_handle (static_cast<Dwarf_Off> (pos - sections.info.first)));
+    }
+
+    // siblingof
+    // ~~~~~~~~~
+    die_ptr native_debug::siblingof (Dwarf_Die die) {
+        auto const first = index_.sections ().info.first;
+        if (die == nullptr) {
+            // The first DIE of the unit most recently returned by next_cu_header().
+            if (current_unit_ == nullptr) {
+                throw native_error ("siblingof: there is no current unit");
+            }
+            return this->die_at (*current_unit_, first + current_unit_->die_offset);
+        }
+
+        die_info const info = this->decode (die);
+        native_index::unit const & u = *info.unit;
+        if (info.offset == u.die_offset) {
+            // A unit DIE has no siblings.
+            return this->as_die_ptr (nullptr);
+        }
+        reader r (info.values, first + u.end, index_.sections ().big_endian);
+        auto sibling = Dwarf_Off{0};
+        skip_values (r, index_, *info.abbrev, u, &sibling);
+        auto pos = r.pos ();
+        if (info.abbrev->children) {
+            pos = (sibling > info.offset && sibling < u.end) ? first + sibling
+                                                             : this->skip_children (u, pos);
+        }
+        return this->die_at (u, pos);
+    }
+
+    // child
+    // ~~~~~
+    die_ptr native_debug::child (Dwarf_Die die) {
+        die_info const info = this->decode (die);
+        if (!info.abbrev->children) {
+            return this->as_die_ptr (nullptr);
+        }
+        auto const & sections = index_.sections ();
+        reader r (info.values, sections.info.first + info.unit->end, sections.big_endian);
+        auto sibling = Dwarf_Off{0};
+        skip_values (r, index_, *info.abbrev, *info.unit, &sibling);
+        return this->die_at (*info.unit, r.pos ());
+    }
+
+    // tag
+    // ~~~
+    Dwarf_Half native_debug::tag (Dwarf_Die die) {
+        return this->decode (die).abbrev->tag;
+    }
+
+    // find_attribute
+    // ~~~~~~~~~~~~~~
+    bool native_debug::find_attribute (die_info const & info, Dwarf_Half attr,
+                                       native_index::attribute_spec const ** spec,
+                                       Dwarf_Half * form, std::uint8_t const ** value) const {
+        auto const & sections = index_.sections ();
+        reader r (info.values, sections.info.first + info.unit->end, sections.big_endian);
+        auto const * s = index_.specs (*info.abbrev);
+        for (auto const * end = s + info.abbrev->num_specs; s != end; ++s) {
+            auto const f = direct_form (r, s->form);
+            if (s->attr == attr) {
+                *spec = s;
+                *form = f;
+                *value = r.pos ();
+                return true;
+            }
+            skip_value (r, f, *info.unit);
+        }
+        return false;
+    }
+
+    // name
+    // ~~~~
+    std::string native_debug::name (Dwarf_Die die) {
+        die_info const info = this->decode (die);
+        native_index::attribute_spec const * spec = nullptr;
+        auto form = Dwarf_Half{0};
+        std::uint8_t const * value = nullptr;
+        if (!this->find_attribute (info, DW_AT_name, &spec, &form, &value)) {
+            return {};
+        }
+        attribute_record const r{spec->attr, form, spec->implicit_const, value, info.unit};
+        return this->attribute_form_string (
+            reinterpret_cast<Dwarf_Attribute> (const_cast<attribute_record *> (&r)));
+    }
+
+    // attrlist
+    // ~~~~~~~~
+    Dwarf_Signed native_debug::attrlist (Dwarf_Die die, Dwarf_Attribute ** array) {
+        die_info const info = this->decode (die);
+        auto const size = info.abbrev->num_specs;
+        if (size == 0U) {
+            *array = nullptr;
+            return 0;
+        }
+
+        Dwarf_Attribute * const list = this->new_list (size);
+        auto const & sections = index_.sections ();
+        reader r (info.values, sections.info.first + info.unit->end, sections.big_endian);
+        auto const * spec = index_.specs (*info.abbrev);
+        for (auto index = 0U; index < size; ++index, ++spec) {
+            auto const form = direct_form (r, spec->form);
+            list[index] = this->new_attribute (*info.unit, *spec, form, r.pos ());
+            skip_value (r, form, *info.unit);
+        }
+        *array = list;
+        return static_cast<Dwarf_Signed> (size);
+    }
+
+    // attribute_from_tag
+    // ~~~~~~~~~~~~~~~~~~
+    dwarf::owned_attribute native_debug::attribute_from_tag (Dwarf_Die die, Dwarf_Half tag) {
+        die_info const info = this->decode (die);
+        native_index::attribute_spec const * spec = nullptr;
+        auto form = Dwarf_Half{0};
+        std::uint8_t const * value = nullptr;
+        if (!this->find_attribute (info, tag, &spec, &form, &value)) {
+            return {this, nullptr};
+        }
+        return {this, this->new_attribute (*info.unit, *spec, form, value)};
+    }
+
+    // new_attribute
+    // ~~~~~~~~~~~~~
+    Dwarf_Attribute native_debug::new_attribute (native_index::unit const & u,
+                                                 native_index::attribute_spec const & spec,
+                                                 Dwarf_Half form, std::uint8_t const * value) {
+        attribute_record * r;
+        if (free_records_.empty ()) {
+            records_.emplace_back (new attribute_record);
+            r = records_.back ().get ();
+        } else {
+            r = free_records_.back ();
+            free_records_.pop_back ();
+        }
+        *r = attribute_record{spec.attr, form, spec.implicit_const, value, &u};
+        return reinterpret_cast<Dwarf_Attribute> (r);
+    }
+
+    // new_list
+    // ~~~~~~~~
+    Dwarf_Attribute * native_debug::new_list (std::size_t size) {
+        // Each list is preceded by a slot which holds its capacity so that it can be reused for
+        // any list which is no larger.
+        auto const capacity = [](Dwarf_Attribute * list) {
+            return static_cast<std::size_t> (reinterpret_cast<std::uintptr_t> (list[0]));
+        };
+        auto it = std::find_if (std::begin (free_lists_), std::end (free_lists_),
+                                [&](Dwarf_Attribute * list) { return capacity (list) >= size; });
+        if (it != std::end (free_lists_)) {
+            Dwarf_Attribute * const list = *it;
+            *it = free_lists_.back ();
+            free_lists_.pop_back ();
+            return list + 1;
+        }
+        auto const list = new Dwarf_Attribute[size + 1U];
+        list[0] = reinterpret_cast<Dwarf_Attribute> (static_cast<std::uintptr_t> (size));
+        return list + 1;
+    }
+
+    // attribute_what_attr
+    // ~~~~~~~~~~~~~~~~~~~
+    Dwarf_Half native_debug::attribute_what_attr (Dwarf_Attribute a) const {
+        return record (a).attr;
+    }
+
+    // attribute_what_form
+    // ~~~~~~~~~~~~~~~~~~~
+    Dwarf_Half native_debug::attribute_what_form (Dwarf_Attribute a) const {
+        return record (a).form;
+    }
+
+    // fixed_value
+    // ~~~~~~~~~~~
+    Dwarf_Unsigned native_debug::fixed_value (attribute_record const & r, unsigned size) const {
+        auto const & sections = index_.sections ();
+        reader rd (r.value, sections.info.first + r.unit->end, sections.big_endian);
+        return size == 0U ? rd.uleb () : rd.fixed (size);
+    }
+
+    // string_at
+    // ~~~~~~~~~
+    std::string native_debug::string_at (native_sections::range const & section,
+                                         Dwarf_Unsigned offset, char const * form_name) const {
+        if (offset >= section.size ()) {
+            throw native_error (message (form_name, offset));
+        }
+        auto const first = section.first + offset;
+        auto const last = std::find (first, section.last, std::uint8_t{0});
+        if (last == section.last) {
+            throw native_error ("unterminated DWARF string");
+        }
+        return {reinterpret_cast<char const *> (first), reinterpret_cast<char const *> (last)};
+    }
+
+    // attribute_form_string
+    // ~~~~~~~~~~~~~~~~~~~~~
+    std::string native_debug::attribute_form_string (Dwarf_Attribute a) const {
+        attribute_record const & r = record (a);
+        auto const & sections = index_.sections ();
+        switch (r.form) {
+        case DW_FORM_string:
+            return this->string_at (sections.info,
+                                    static_cast<Dwarf_Unsigned> (r.value - sections.info.first),
+                                    "bad DW_FORM_string");
+        case DW_FORM_strp:
+            return this->string_at (sections.str, this->fixed_value (r, r.unit->offset_size),
+                                    "bad DW_FORM_strp offset");
+        case form_line_strp:
+            return this->string_at (sections.line_str,
+                                    this->fixed_value (r, r.unit->offset_size),
+                                    "bad DW_FORM_line_strp offset");
+        case form_strx:
+        case form_strx1:
+        case form_strx2:
+        case form_strx3:
+        case form_strx4: {
+            auto const index = this->fixed_value (r, fixed_size (r.form, *r.unit));
+            auto const size = r.unit->offset_size;
+            auto const base = r.unit->str_offsets_base;
+            if (base == native_index::no_str_offsets_base) {
+                // Reached through DW_FORM_indirect in a unit without DW_AT_str_offsets_base.
+                throw native_error (message ("DW_FORM_strx without a string offsets base", index));
+            }
+            auto const entry = base + index * size;
+            if (entry >= sections.str_offsets.size ()) {
+                throw native_error (message ("bad DW_FORM_strx index", index));
+            }
+            reader rd (sections.str_offsets.first + entry, sections.str_offsets.last,
+                       sections.big_endian);
+            return this->string_at (sections.str, rd.fixed (size), "bad DW_FORM_strx offset");
+        }
+        }
+        throw native_error (message ("attribute_form_string: unsupported form", r.form));
+    }
+
+    // attribute_form_flag
+    // ~~~~~~~~~~~~~~~~~~~
+    bool native_debug::attribute_form_flag (Dwarf_Attribute a) const {
+        attribute_record const & r = record (a);
+        switch (r.form) {
+        case DW_FORM_flag:
+            return this->fixed_value (r, 1U) != 0;
+        case DW_FORM_flag_present:
+            return true;
+        }
+        throw native_error (message ("attribute_form_flag: unsupported form", r.form));
+    }
+
+    // attribute_form_signed_constant
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    Dwarf_Signed native_debug::attribute_form_signed_constant (Dwarf_Attribute a) const {
+        attribute_record const & r = record (a);
+        switch (r.form) {
+        case DW_FORM_data1:
+        case DW_FORM_data2:
+        case DW_FORM_data4:
+        case DW_FORM_data8: {
+            auto const size = fixed_size (r.form, *r.unit);
+            return sign_extend (this->fixed_value (r, size), size);
+        }
+        case DW_FORM_sdata: {
+            auto const & sections = index_.sections ();
+            reader rd (r.value, sections.info.first + r.unit->end, sections.big_endian);
+            return rd.sleb ();
+        }
+        case DW_FORM_udata:
+            return static_cast<Dwarf_Signed> (this->fixed_value (r, 0U));
+        case form_implicit_const:
+            return r.implicit_const;
+        }
+        throw native_error (message ("attribute_form_signed_constant: unsupported form", r.form));
+    }
+
+    // attribute_form_unsigned_constant
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    Dwarf_Unsigned native_debug::attribute_form_unsigned_constant (Dwarf_Attribute a) const {
+        attribute_record const & r = record (a);
+        switch (r.form) {
+        case DW_FORM_data1:
+        case DW_FORM_data2:
+        case DW_FORM_data4:
+        case DW_FORM_data8:
+            return this->fixed_value (r, fixed_size (r.form, *r.unit));
+        case DW_FORM_udata:
+            return this->fixed_value (r, 0U);
+        case DW_FORM_sdata:
+        case form_implicit_const: {
+            auto const value = this->attribute_form_signed_constant (a);
+            if (value < 0) {
+                throw native_error (message ("negative unsigned constant", value));
+            }
+            return static_cast<Dwarf_Unsigned> (value);
+        }
+        }
+        throw native_error (
+            message ("attribute_form_unsigned_constant: unsupported form", r.form));
+    }
+
+    // attribute_form_block
+    // ~~~~~~~~~~~~~~~~~~~~
+    attribute::block_ptr native_debug::attribute_form_block (Dwarf_Attribute a) {
+        attribute_record const & r = record (a);
+        auto const & sections = index_.sections ();
+        reader rd (r.value, sections.info.first + r.unit->end, sections.big_endian);
+        auto length = Dwarf_Unsigned{0};
+        switch (r.form) {
+        case DW_FORM_block1:
+            length = rd.fixed (1U);
+            break;
+        case DW_FORM_block2:
+            length = rd.fixed (2U);
+            break;
+        case DW_FORM_block4:
+            length = rd.fixed (4U);
+            break;
+        case DW_FORM_block:
+            length = rd.uleb ();
+            break;
+        default:
+            throw native_error (message ("attribute_form_block: unsupported form", r.form));
+        }
+        auto const data = rd.pos ();
+        rd.skip (length);
+
+        auto block = new Dwarf_Block ();
+        block->bl_len = length;
+        block->bl_data = const_cast<std::uint8_t *> (data);
+        block->bl_from_loclist = 0;
+        block->bl_section_offset = static_cast<Dwarf_Unsigned> (data - sections.info.first);
+        return attribute::block_ptr (block, block_deleter (this));
+    }
+
+    // attribute_form_ref
+    // ~~~~~~~~~~~~~~~~~~
+    Dwarf_Off native_debug::attribute_form_ref (Dwarf_Attribute a) {
+        attribute_record const & r = record (a);
+        switch (r.form) {
+        case DW_FORM_ref1:
+        case DW_FORM_ref2:
+        case DW_FORM_ref4:
+        case DW_FORM_ref8:
+            return r.unit->offset + this->fixed_value (r, fixed_size (r.form, *r.unit));
+        case DW_FORM_ref_udata:
+            return r.unit->offset + this->fixed_value (r, 0U);
+        case DW_FORM_ref_addr:
+            return this->fixed_value (r, fixed_size (r.form, *r.unit));
+        }
+        throw native_error (message ("attribute_form_ref: unsupported form", r.form));
+    }
+} // namespace dwarf
+
+// eof native_dwarf.cpp
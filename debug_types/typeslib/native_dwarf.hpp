@@ -0,0 +1,275 @@
+// Copyright (c) 2016 by SN Systems Ltd., Sony Interactive Entertainment Inc.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef NATIVE_DWARF_HPP
+#define NATIVE_DWARF_HPP
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <libdwarf.h>
+
+#include "dwarf_helpers.hpp"
+
+namespace dwarf {
+    // ****************
+    // * native_error *
+    // ****************
+    /// Raised by the built-in DWARF reader when it meets data that it can't decode.
+    class native_error : public std::runtime_error {
+    public:
+        explicit native_error (std::string const & message);
+    };
+
+
+    // *******************
+    // * native_sections *
+    // *******************
+    /// The DWARF sections read by the built-in reader. Each is a range of bytes within the mapped
+    /// file: nothing is copied.
+    struct native_sections {
+        struct range {
+            std::uint8_t const * first = nullptr;
+            std::uint8_t const * last = nullptr;
+
+            std::size_t size () const {
+                return static_cast<std::size_t> (last - first);
+            }
+        };
+
+        range info;
+        range abbrev;
+        range str;
+        range line_str;
+        range str_offsets;
+        bool big_endian = false;
+    };
+
+
+    // ****************
+    // * native_index *
+    // ****************
+    /// The units of the .debug_info section and their abbreviation tables, decoded once into
+    /// flat arrays. The index is read-only once built so that a single instance can be shared by
+    /// the native_debug objects of all of the worker threads.
+    class native_index {
+    public:
+        struct attribute_spec {
+            Dwarf_Half attr;
+            Dwarf_Half form;
+            /// The value of a DW_FORM_implicit_const attribute.
+            Dwarf_Signed implicit_const;
+        };
+        struct abbreviation {
+            Dwarf_Unsigned code;
+            Dwarf_Half tag;
+            bool children;
+            /// The index of the first of this abbreviation's entries in the array of specs.
+            std::uint32_t first_spec;
+            std::uint32_t num_specs;
+        };
+        struct unit {
+            /// The offset of the unit header.
+            Dwarf_Off offset;
+            /// The offset of the unit's first DIE.
+            Dwarf_Off die_offset;
+            /// The offset of the next unit.
+            Dwarf_Off end;
+            Dwarf_Unsigned length;
+            Dwarf_Off abbrev_offset;
+            /// The value of the unit DIE's DW_AT_str_offsets_base or no_str_offsets_base.
+            Dwarf_Unsigned str_offsets_base;
+            std::uint32_t table;
+            Dwarf_Half version;
+            std::uint8_t address_size;
+            std::uint8_t offset_size;
+        };
+
+        static constexpr Dwarf_Unsigned no_str_offsets_base = ~Dwarf_Unsigned{0};
+
+        /// \throws native_error if a unit can't be decoded or if it uses DW_FORM_strx* without
+        /// giving DW_AT_str_offsets_base.
+        explicit native_index (native_sections const & sections);
+
+        // No copying or assignment allowed.
+        native_index (native_index const &) = delete;
+        native_index & operator= (native_index const &) = delete;
+
+        native_sections const & sections () const {
+            return sections_;
+        }
+        std::vector<unit> const & units () const {
+            return units_;
+        }
+        /// Returns the unit whose DIEs include 'offset' or nullptr if there is none.
+        unit const * find_unit (Dwarf_Off offset) const;
+        /// Returns the abbreviation with the given code from a unit's table.
+        /// \throws native_error if the table has no such abbreviation.
+        abbreviation const & find_abbreviation (unit const & u, Dwarf_Unsigned code) const;
+        attribute_spec const * specs (abbreviation const & a) const {
+            return specs_.data () + a.first_spec;
+        }
+
+    private:
+        /// A run of abbreviations_ sorted by code.
+        struct table {
+            std::uint32_t first;
+            std::uint32_t size;
+            /// True if the codes are 1, 2, 3, ... so that a code can be used as an index.
+            bool dense;
+        };
+
+        std::uint32_t read_table (Dwarf_Off offset);
+        /// Returns true if any of the abbreviations in table number 'table_index' use one of
+        /// the DW_FORM_strx* forms.
+        bool uses_strx (std::uint32_t table_index) const;
+
+        native_sections sections_;
+        std::vector<unit> units_;
+        std::vector<table> tables_;
+        std::vector<abbreviation> abbreviations_;
+        std::vector<attribute_spec> specs_;
+    };
+
+    /// Finds the DWARF sections of the ELF file mapped at 'image' and indexes them.
+    /// \returns nullptr if the file needs something that the built-in reader doesn't do: it
+    /// doesn't apply relocations or decompress sections. nullptr is also returned if a unit
+    /// can't be indexed (see the native_index constructor).
+    std::unique_ptr<native_index> make_native_index (void const * image, std::size_t size);
+
+
+    // ****************
+    // * native_debug *
+    // ****************
+    /// A dwarf::debug which reads the sections directly rather than through libdwarf. A DIE
+    /// handle is simply its offset: DIEs are decoded (from the unit's abbreviation table) each
+    /// time that they are used and their attributes are decoded only when they are asked for, so
+    /// that walking the tree allocates nothing. An instance must be used by one thread at a time;
+    /// the index that it reads can be shared.
+    ///
+    /// test_readers.cpp checks that the type signatures match those produced through libdwarf.
+    /// The project's libdwarf (dwarf-20160613) can't read DWARF 5, so the DWARF 5 path
+    /// (DW_FORM_strx*, DW_FORM_line_strp, DW_FORM_implicit_const and DW_AT_str_offsets_base) is
+    /// checked only against the hand-written expectations in test_native_dwarf.cpp.
+    class native_debug final : public debug {
+    public:
+        explicit native_debug (native_index const & index);
+        ~native_debug () override;
+
+        // No copying or assignment allowed.
+        native_debug (native_debug const &) = delete;
+        native_debug & operator= (native_debug const &) = delete;
+
+        bool next_cu_header (Dwarf_Unsigned * cu_header_length, Dwarf_Half * version_stamp,
+                             Dwarf_Off * abbrev_offset, Dwarf_Half * address_size,
+                             Dwarf_Unsigned * next_cu_header_offset) override;
+
+        Dwarf_Off die_to_offset (Dwarf_Die die) override;
+        die_ptr offset_to_die (Dwarf_Off offset) override;
+        void dealloc (Dwarf_Ptr space, Dwarf_Unsigned alloc_type) override;
+
+        die_ptr siblingof (Dwarf_Die die) override;
+        die_ptr child (Dwarf_Die die) override;
+
+        Dwarf_Half tag (Dwarf_Die die) override;
+        std::string name (Dwarf_Die die) override;
+        Dwarf_Signed attrlist (Dwarf_Die die, Dwarf_Attribute ** array) override;
+
+        dwarf::owned_attribute attribute_from_tag (Dwarf_Die die, Dwarf_Half tag) override;
+
+        Dwarf_Half attribute_what_attr (Dwarf_Attribute a) const override;
+        Dwarf_Half attribute_what_form (Dwarf_Attribute a) const override;
+
+        std::string attribute_form_string (Dwarf_Attribute a) const override;
+        bool attribute_form_flag (Dwarf_Attribute a) const override;
+        Dwarf_Signed attribute_form_signed_constant (Dwarf_Attribute a) const override;
+        Dwarf_Unsigned attribute_form_unsigned_constant (Dwarf_Attribute a) const override;
+        attribute::block_ptr attribute_form_block (Dwarf_Attribute a) override;
+        Dwarf_Off attribute_form_ref (Dwarf_Attribute a) override;
+
+    private:
+        /// A decoded attribute. A Dwarf_Attribute handed out by this class points to one of
+        /// these.
+        struct attribute_record {
+            Dwarf_Half attr;
+            /// The form with DW_FORM_indirect resolved.
+            Dwarf_Half form;
+            Dwarf_Signed implicit_const;
+            std::uint8_t const * value;
+            native_index::unit const * unit;
+        };
+        /// A DIE's unit, abbreviation and the position of its first attribute value.
+        struct die_info {
+            Dwarf_Off offset;
+            native_index::unit const * unit;
+            native_index::abbreviation const * abbrev;
+            std::uint8_t const * values;
+        };
+
+        die_info decode (Dwarf_Die die);
+        die_info decode (Dwarf_Off offset);
+        /// Returns the position which follows the children of the DIE whose attribute values
+        /// end at 'pos'.
+        std::uint8_t const * skip_children (native_index::unit const & u,
+                                            std::uint8_t const * pos) const;
+        /// Returns the DIE which starts at 'pos' or nullptr if there is a null entry (or the
+        /// end of the unit) there.
+        die_ptr die_at (native_index::unit const & u, std::uint8_t const * pos);
+        /// Finds the attribute 'attr' of a DIE. On success, the attribute's form and the
+        /// position of its value are returned through 'form' and 'value'.
+        bool find_attribute (die_info const & info, Dwarf_Half attr,
+                             native_index::attribute_spec const ** spec, Dwarf_Half * form,
+                             std::uint8_t const ** value) const;
+
+        Dwarf_Attribute new_attribute (native_index::unit const & u,
+                                       native_index::attribute_spec const & spec,
+                                       Dwarf_Half form, std::uint8_t const * value);
+        Dwarf_Attribute * new_list (std::size_t size);
+        static attribute_record const & record (Dwarf_Attribute a) {
+            assert (a != nullptr);
+            return *reinterpret_cast<attribute_record const *> (a);
+        }
+        /// Reads a value of one of the fixed-size forms (or a LEB128 form) from an attribute.
+        Dwarf_Unsigned fixed_value (attribute_record const & r, unsigned size) const;
+        std::string string_at (native_sections::range const & section, Dwarf_Unsigned offset,
+                               char const * form_name) const;
+
+        native_index const & index_;
+        /// The position of next_cu_header() in the list of units.
+        std::size_t next_unit_ = 0;
+        native_index::unit const * current_unit_ = nullptr;
+        /// The most recently decoded DIE: most are used several times in a row.
+        die_info last_die_;
+
+        /// Attribute records and lists are recycled by dealloc() so that, once a few have been
+        /// allocated, reading attributes allocates nothing.
+        std::vector<std::unique_ptr<attribute_record>> records_;
+        std::vector<attribute_record *> free_records_;
+        std::vector<Dwarf_Attribute *> free_lists_;
+    };
+} // namespace dwarf
+
+#endif // NATIVE_DWARF_HPP
+// eof native_dwarf.hpp
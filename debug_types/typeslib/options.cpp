@@ -126,6 +126,9 @@ options program_options (int argc, char const * argv[], std::ostream & help_stre
         ("help", "produce a help message")
         ("no-progress", po::bool_switch (), "disable the progress thermometer")
         ("threads,t", po::value<unsigned> (&result.threads)->default_value (result.threads), "the number of worker threads")
+        ("pin-threads", po::bool_switch (&result.pin_threads), "pin the worker threads to the CPUs of each NUMA node and gather counts per node")
+        ("numa-nodes", po::value<unsigned> (&result.numa_nodes)->default_value (result.numa_nodes), "with --pin-threads, the number of simulated NUMA nodes (0 uses the host's topology)")
+        ("native-dwarf", po::bool_switch (&result.native_dwarf), "read the DWARF with the built-in reader rather than libdwarf")
         ("count", po::value<std::string> (&count_output_path), "Count output JSON file ('-' for stdout)")
         ("contexts", po::value<std::string> (&contexts_output_path), "Contexts output JSON file ('-' for stdout)")
         ;
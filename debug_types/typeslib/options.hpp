@@ -41,6 +41,12 @@ struct options {
 
     bool progress_enabled = true;
     unsigned threads;
+    /// Pin the worker threads to the CPUs of each NUMA node.
+    bool pin_threads = false;
+    /// With pin_threads, the number of simulated NUMA nodes (0 uses the host's topology).
+    unsigned numa_nodes = 0U;
+    /// Read the DWARF with the built-in reader rather than libdwarf.
+    bool native_dwarf = false;
     std::string input_path;
     boost::optional<std::string> count_output_path;
     boost::optional<std::string> contexts_output_path;
@@ -20,6 +20,13 @@
 
 #include "process_file.hpp"
 
+#include <algorithm>
+#include <exception>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <vector>
+
 #include <boost/thread.hpp>
 
 #include <dwarf.h>
@@ -29,12 +36,15 @@
 #include "counts.hpp"
 #include "dwarf_exception.hpp"
 #include "dwarf_helpers.hpp"
-#include "function_output_iterator.hpp"
 #include "md5.h"
+#include "native_dwarf.hpp"
+#include "numa.hpp"
 #include "options.hpp"
 #include "print.hpp"
 #include "progress.hpp"
 #include "scan_type.hpp"
+#include "subtree_cache.hpp"
+#include "work_queue.hpp"
 #include "worker_error.hpp"
 
 namespace {
@@ -55,8 +65,7 @@ namespace {
     }
 
 
-    std::uint64_t get_sequence_digest (md5::hasher & md5) {
-        auto digest = md5.finish ();
+    std::uint64_t get_sequence_digest (md5::digest const & digest) {
         return (static_cast<std::uint64_t> (digest[15]) << 0) |
                (static_cast<std::uint64_t> (digest[14]) << 8) |
                (static_cast<std::uint64_t> (digest[13]) << 16) |
@@ -71,13 +80,14 @@ namespace {
     std::uint64_t get_sequence_digest (InputIterator first, InputIterator last) {
         md5::hasher md5;
         md5.append (first, last);
-        return get_sequence_digest (md5);
+        return get_sequence_digest (md5.finish ());
     }
 
 
 
     std::uint64_t scan_type (dwarf::debug * const debug, Dwarf_Die die,
-                             die_context_map const & contexts) {
+                             die_context_map const & contexts, subtree_recorder & recorder,
+                             scan_type_stack & stack) {
 #if CAPTURE_SEQUENCE
         // 1. Start with an empty sequence S and a list V of visited types, where V is initialized
         // to a list
@@ -86,18 +96,19 @@ namespace {
         std::vector<std::uint8_t> S;
         auto sequence = std::back_inserter (S);
 #else
-        md5::hasher S;
-        std::function<void(std::uint8_t)> hash_appender = [&S](std::uint8_t x) { S.append (x); };
-        auto sequence = make_function_output_iterator (hash_appender);
+        // Bytes are collected into whole blocks before being hashed and strings and blocks are
+        // appended in bulk (see copy_bytes()).
+        md5::buffered_hasher S;
+        md5::output_iterator sequence (&S);
 #endif
 
-        scan_type (debug, die, contexts, sequence);
+        scan_type (debug, die, contexts, recorder, stack, sequence);
 
 #if CAPTURE_SEQUENCE
         dump_container (std::cout, S);
         return get_sequence_digest (std::begin (S), std::end (S));
 #else
-        return get_sequence_digest (S);
+        return get_sequence_digest (S.finish ());
 #endif
     }
 }
@@ -105,66 +116,24 @@ namespace {
 
 namespace {
 
-    using context_map_range_queue =
-        boost::lockfree::queue<iter_pair<die_context_map::const_iterator> *,
-                               boost::lockfree::fixed_sized<true>>;
-
-    // ********************
-    // * scan_dies_thread *
-    // ********************
-    void scan_dies_thread (boost::iostreams::mapped_file const & map_file,
-                           context_map_range_queue & work_queue, die_context_map const & contexts,
-                           counts & c, updater_intf & progress, std::atomic<bool> & error) {
-        try {
-            ::elf_errno (); // reset the ELF error code for this thread
-
-            auto elf = elf::make_elf (map_file.const_data (), map_file.size ());
-            assert (elf::is_elf (elf) && elf::kind (elf) != ELF_K_AR);
-            auto debug_ptr = dwarf::make_dwarf (elf);
-            dwarf::debug debug (debug_ptr.get ());
-
-            auto range = context_map_range_queue::value_type{nullptr};
-            while (work_queue.pop (range)) {
-                if (error) {
-                    // Stop if another thread threw an error.
-                    break;
-                }
-
-                for (auto const & offset_info : *range) {
-                    Dwarf_Off const offset = offset_info.first;
-                    die_context_value const & value = offset_info.second;
-
-                    auto die = debug.offset_to_die (offset);
-                    assert (debug.is_type_die (die));
-
-                    auto const signature = scan_type (&debug, die.get (), contexts);
-                    c.add_type (signature, *std::get<1> (value));
-
-                    progress.completed_incr ();
-                }
-            }
-        } catch (dwarf_exception const & dex) {
-            print_cerr ("DWARF error: ", dex);
-            error = true;
-        } catch (std::exception const & ex) {
-            print_cerr ("Error: ", ex.what ());
-            error = true;
-        } catch (...) {
-            print_cerr ("Unknown exception");
-            error = true;
-        }
-    }
-
+    /// The limit on the memory used to hold the sequences of type subtrees during phase 2.
+    constexpr std::size_t subtree_cache_bytes = std::size_t{256} * 1024U * 1024U;
 
     // *****************
     // * create_thread *
     // *****************
+    /// Starts a worker thread. If 'placement' is not null, the thread (worker number 'worker')
+    /// is bound to the CPUs of its NUMA node before 'function' is called.
     template <typename Function>
-    void create_thread (boost::thread_group & threads, Function function) {
-        boost::thread_attributes attrs;
-        attrs.set_stack_size (std::size_t{8} * 1024 * 1024);
-
-        auto t = std::unique_ptr<boost::thread> (new boost::thread (attrs, function));
+    void create_thread (boost::thread_group & threads, numa::placement const * const placement,
+                        unsigned worker, Function function) {
+        auto entry_point = [placement, worker, function]() {
+            if (placement != nullptr) {
+                placement->bind (worker);
+            }
+            function ();
+        };
+        auto t = std::unique_ptr<boost::thread> (new boost::thread (entry_point));
         threads.add_thread (t.get ());
         t.release ();
     }
@@ -189,88 +158,185 @@ namespace {
     };
 
 
-    // **********************
-    // * build_die_contexts *
-    // **********************
-    auto build_die_contexts (boost::iostreams::mapped_file const & map_file,
-                             unsigned const num_threads, updater_factory const & uf)
-        -> std::pair<die_context_map, unsigned> {
+    // *************
+    // * scan_dies *
+    // *************
+    /// The state of phase 2. It is created once the contexts are known and shared by the threads
+    /// which scan the type DIEs.
+    struct scan_state {
+        scan_state (die_context_map const & c, unsigned total, unsigned num_threads,
+                    numa::placement const * const p, updater_factory const & uf);
+
+        /// The counts to which the types found by thread number 'worker' are added. The first
+        /// thread on each NUMA node to call this creates the node's counts so that their memory
+        /// is allocated (and first touched) by a thread pinned to that node.
+        counts & counts_for (unsigned worker);
+        /// Merges the counts recorded by each of the threads.
+        counts result ();
+
+        die_context_map const & contexts;
+        std::unique_ptr<updater_intf> progress;
+        /// Each thread works through the types in a region of the file, in offset order, so that
+        /// the compilation units that it reads stay in libdwarf's caches.
+        work_queue queue;
+        /// The sequences of the types referenced by many others are shared by all of the threads.
+        subtree_cache cache;
+        numa::placement const * const placement;
+        unsigned const total_dies;
+        /// The threads on each NUMA node share a set of counts. These are merged once the
+        /// threads have finished. A node's entry remains null if none of its threads scan.
+        std::vector<std::unique_ptr<counts>> partials;
+        std::vector<std::once_flag> partials_created;
+    };
 
-        context_queue queue (1000); // a lock-free queue primed for 1000 CUs.
-        auto const num_cus = context_queue_producer (map_file, &queue);
+    scan_state::scan_state (die_context_map const & c, unsigned total, unsigned num_threads,
+                            numa::placement const * const p, updater_factory const & uf)
+            : contexts (c)
+            , progress (uf.create ("Phase 2/2: Scanning type DIEs"))
+            , queue (make_work_batches (c, work_batch_bytes (c, num_threads)), num_threads)
+            , cache (subtree_cache_bytes)
+            , placement (p)
+            , total_dies (total)
+            , partials (placement != nullptr ? placement->nodes () : std::size_t{1})
+            , partials_created (partials.size ()) {
+        progress->total (contexts.size ());
+        progress->run ();
+    }
 
-        build_contexts builder;
-        {
-            auto progress = uf.create ("Phase 1/2: Discovering type DIEs");
-            progress->total (num_cus);
-            progress->run ();
-
-            std::atomic<bool> error{false};
-            boost::thread_group threads;
-            for (auto thread_count = 0U; thread_count < num_threads; ++thread_count) {
-                auto entry_point =
-                    std::bind (&build_contexts::consumer_thread, &builder, std::cref (map_file),
-                               std::ref (queue), std::ref (*progress), std::ref (error));
-                create_thread (threads, entry_point);
+    counts & scan_state::counts_for (unsigned worker) {
+        auto const node = placement != nullptr ? placement->node (worker) : 0U;
+        std::call_once (partials_created[node],
+                        [this, node]() { partials[node].reset (new counts (total_dies)); });
+        return *partials[node];
+    }
+
+    counts scan_state::result () {
+        auto first = std::find_if (std::begin (partials), std::end (partials),
+                                   [](std::unique_ptr<counts> const & c) { return c != nullptr; });
+        if (first == std::end (partials)) {
+            return counts (total_dies);
+        }
+        counts total = std::move (**first);
+        for (auto it = std::next (first); it != std::end (partials); ++it) {
+            if (*it != nullptr) {
+                total.merge (std::move (**it));
             }
-            threads.join_all ();
+        }
+        return total;
+    }
+
+    /// Scans the type DIEs from the batches taken by thread number 'worker'.
+    void scan_dies (dwarf::debug & debug, scan_state & state, unsigned worker,
+                    std::atomic<bool> & error) {
+        subtree_recorder recorder (state.cache);
+        scan_type_stack stack;
+        counts & c = state.counts_for (worker);
+
+        work_batch batch;
+        while (state.queue.pop (worker, batch)) {
             if (error) {
-                throw worker_error ();
+                // Stop if another thread threw an error.
+                break;
+            }
+
+            for (die_context_map::value_type const & entry : batch) {
+                auto die = debug.offset_to_die (entry.offset);
+                assert (debug.is_type_die (die));
+
+                auto const signature =
+                    scan_type (&debug, die.get (), state.contexts, recorder, stack);
+                c.add_type (signature, state.contexts.producer (entry.producer));
+
+                state.progress->completed_incr ();
             }
         }
-        return std::make_pair (builder.release_contexts (), builder.die_count ());
     }
 
 
-    // ******************
-    // * scan_type_dies *
-    // ******************
-    counts scan_type_dies (boost::iostreams::mapped_file const & map_file,
-                           die_context_map const & contexts, unsigned total_dies,
-                           unsigned num_threads, updater_factory const & uf) {
-        auto progress = uf.create ("Phase 2/2: Scanning type DIEs");
-        progress->total (contexts.size ());
-        progress->run ();
+    // ****************
+    // * shared_state *
+    // ****************
+    /// The state shared by the worker threads and the thread which coordinates them.
+    struct shared_state {
+        shared_state (boost::iostreams::mapped_file const & m, unsigned num_threads)
+                : map_file (m)
+                , barrier (num_threads + 1U)
+                , queue (1000) {} // a lock-free queue primed for 1000 CUs.
+
+        boost::iostreams::mapped_file const & map_file;
+        /// The index used by the built-in DWARF reader or nullptr if libdwarf is being used.
+        std::unique_ptr<dwarf::native_index> index;
+        /// Separates the phases. The workers and the coordinating thread meet here once phase 1
+        /// is complete and again once phase 2 has been set up.
+        boost::barrier barrier;
+        std::atomic<bool> error{false};
+
+        // Phase 1.
+        context_queue queue;
+        build_contexts builder;
+        std::unique_ptr<updater_intf> contexts_progress;
 
-        constexpr auto types_per_work_packet = std::size_t{100};
-        std::size_t const queue_members = contexts.size () / types_per_work_packet + 1U;
-        context_map_range_queue queue (queue_members);
-        std::vector<std::remove_pointer<context_map_range_queue::value_type>::type> queue_storage;
-        queue_storage.reserve (queue_members);
-        {
-            auto first = std::begin (contexts);
-            auto last = first;
-            auto elements = contexts.size ();
-            while (elements > 0) {
-                auto slice = std::min (elements, types_per_work_packet);
-                std::advance (last, slice);
-                queue_storage.emplace_back (first, last);
-                bool ok = queue.push (&queue_storage.back ());
-                assert (ok);
-                first = last;
-
-                elements -= slice;
-            }
-            assert (first == std::end (contexts));
+        // Phase 2. Created between the phases (unless phase 1 failed).
+        std::unique_ptr<scan_state> scan;
+    };
+
+
+    // **************
+    // * run_phases *
+    // **************
+    /// Runs both phases on one thread using 'debug' to read the file. 'waits' counts the
+    /// thread's visits to the barrier.
+    void run_phases (dwarf::debug & debug, shared_state & shared, unsigned worker,
+                     unsigned & waits) {
+        shared.builder.consumer (&debug, shared.queue, *shared.contexts_progress, shared.error);
+        for (; waits < 2U; ++waits) {
+            shared.barrier.wait ();
+        }
+        if (!shared.error) {
+            assert (shared.scan != nullptr);
+            scan_dies (debug, *shared.scan, worker, shared.error);
         }
+    }
 
-        counts result (total_dies);
-        {
-            std::atomic<bool> error{false};
-            boost::thread_group threads;
-            for (auto thread_count = 0U; thread_count < num_threads; ++thread_count) {
-                auto entry_point =
-                    std::bind (scan_dies_thread, map_file, std::ref (queue), std::cref (contexts),
-                               std::ref (result), std::ref (*progress), std::ref (error));
-                create_thread (threads, entry_point);
-            }
-            // Wait for the worker threads to finish.
-            threads.join_all ();
-            if (error) {
-                throw worker_error ();
+
+    // *****************
+    // * worker_thread *
+    // *****************
+    /// Runs both phases. The file is opened once by each thread and the handle used for both
+    /// phases: a libdwarf handle can't be shared between threads, but the cost of creating one
+    /// (loading the sections and reading the abbreviations as they are needed) is paid once per
+    /// thread rather than once per thread per phase. The built-in reader shares a single index
+    /// of the file between the threads.
+    void worker_thread (shared_state & shared, unsigned worker) {
+        // The barrier must be reached twice however the thread's work ends.
+        auto waits = 0U;
+        try {
+            if (shared.index != nullptr) {
+                dwarf::native_debug debug (*shared.index);
+                run_phases (debug, shared, worker, waits);
+            } else {
+                ::elf_errno (); // reset the ELF error code for this thread
+
+                auto elf =
+                    elf::make_elf (shared.map_file.const_data (), shared.map_file.size ());
+                assert (elf::is_elf (elf) && elf::kind (elf) != ELF_K_AR);
+                auto debug_ptr = dwarf::make_dwarf (elf);
+                dwarf::debug debug (debug_ptr.get ());
+                run_phases (debug, shared, worker, waits);
             }
+        } catch (dwarf_exception const & dex) {
+            print_cerr ("DWARF error: ", dex);
+            shared.error = true;
+        } catch (std::exception const & ex) {
+            print_cerr ("Error: ", ex.what ());
+            shared.error = true;
+        } catch (...) {
+            print_cerr ("Unknown exception");
+            shared.error = true;
+        }
+        for (; waits < 2U; ++waits) {
+            shared.barrier.wait ();
         }
-        return result;
     }
 }
 
@@ -283,15 +349,71 @@ void process_file (options const & options) {
     boost::iostreams::mapped_file map_file (options.input_path, std::ios::in);
     updater_factory updater (options.progress_enabled);
 
+    std::unique_ptr<numa::placement> placement;
+    if (options.pin_threads) {
+        placement.reset (new numa::placement (options.numa_nodes == 0U
+                                                  ? numa::topology::detect ()
+                                                  : numa::topology::simulate (options.numa_nodes),
+                                              true /*pin*/));
+    }
+
+    unsigned const num_threads = std::max (options.threads, 1U);
     die_context_map contexts;
-    unsigned total_dies;
-    std::tie (contexts, total_dies) = build_die_contexts (map_file, options.threads, updater);
+    shared_state shared (map_file, num_threads);
+    if (options.native_dwarf) {
+        shared.index = dwarf::make_native_index (map_file.const_data (), map_file.size ());
+        if (shared.index == nullptr) {
+            print_cerr ("The built-in DWARF reader can't read this file: using libdwarf");
+        }
+    }
+    unsigned num_cus;
+    if (shared.index != nullptr) {
+        dwarf::native_debug debug (*shared.index);
+        num_cus = context_queue_producer (&debug, &shared.queue);
+    } else {
+        num_cus = context_queue_producer (map_file, &shared.queue);
+    }
+    shared.contexts_progress = updater.create ("Phase 1/2: Discovering type DIEs");
+    shared.contexts_progress->total (num_cus);
+    shared.contexts_progress->run ();
+
+    boost::thread_group threads;
+    for (auto thread_count = 0U; thread_count < num_threads; ++thread_count) {
+        create_thread (threads, placement.get (), thread_count,
+                       std::bind (worker_thread, std::ref (shared), thread_count));
+    }
 
-    if (options::output_file_opener contexts_file = options.contexts_file ()) {
-        *contexts_file << contexts;
+    // Wait for phase 1 to finish and then prepare phase 2.
+    shared.barrier.wait ();
+    shared.contexts_progress.reset ();
+    std::exception_ptr failure;
+    if (!shared.error) {
+        try {
+            contexts = shared.builder.release_contexts ();
+            if (options::output_file_opener contexts_file = options.contexts_file ()) {
+                *contexts_file << contexts;
+            }
+            shared.scan.reset (new scan_state (contexts, shared.builder.die_count (),
+                                               num_threads, placement.get (), updater));
+        } catch (...) {
+            // Let the workers go before reporting the error.
+            shared.error = true;
+            failure = std::current_exception ();
+        }
+    }
+    shared.barrier.wait ();
+
+    // Wait for the worker threads to finish.
+    threads.join_all ();
+    if (failure) {
+        std::rethrow_exception (failure);
+    }
+    if (shared.error) {
+        throw worker_error ();
     }
 
-    counts const c = scan_type_dies (map_file, contexts, total_dies, options.threads, updater);
+    counts const c = shared.scan->result ();
+    shared.scan.reset ();
     if (options::output_file_opener ofo = options.count_output_file ()) {
         *ofo << c;
     }
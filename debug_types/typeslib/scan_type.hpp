@@ -21,6 +21,9 @@
 #ifndef SCAN_TYPE_HPP
 #define SCAN_TYPE_HPP
 
+#include <memory>
+#include <vector>
+
 #include <dwarf.h>
 #include <libdwarf.h>
 
@@ -30,6 +33,7 @@
 #include "iter_pair.hpp"
 #include "leb128.hpp"
 #include "sort_attributes.hpp"
+#include "subtree_cache.hpp"
 #include "visited_types.hpp"
 
 dwarf::die_ptr die_referenced_by_attribute (dwarf::attribute const & attribute);
@@ -38,10 +42,255 @@ dwarf::die_ptr type_die_referenced_by_attribute (dwarf::attribute const & attrib
 
 
 namespace details {
+
+    // **************
+    // * scan_frame *
+    // **************
+    /// An entry on the explicit stack used by scan_type(): a DIE whose part of the sequence is
+    /// being produced and how far through steps 3 to 7 it has got.
+    struct scan_frame {
+        enum class state { attributes, type_reference, first_child, next_child, end };
+
+        Dwarf_Die die = nullptr;
+        /// Owns 'die' unless it is owned by the frame beneath (or by the caller).
+        dwarf::die_ptr owner;
+        Dwarf_Half tag = 0;
+        state next = state::attributes;
+        /// True if the frame is for a type entry (that is, the root or a type reached through a
+        /// 'T' reference) rather than for a child DIE.
+        bool is_type = false;
+        /// The offset of the type and the state of the subtree_recorder when its scan began.
+        Dwarf_Off offset = 0;
+        subtree_recorder::mark mark{};
+
+        /// The DIE's attributes and the next to be appended.
+        std::unique_ptr<dwarf::attribute_list> attributes;
+        dwarf::attribute_list::iterator attribute;
+        dwarf::attribute_list::iterator last_attribute;
+        /// The child being visited.
+        dwarf::die_ptr child;
+    };
+
+    // ****************
+    // * walk_storage *
+    // ****************
+    /// The working storage of a type_walker.
+    struct walk_storage {
+        std::vector<scan_frame> frames;
+        /// Attribute lists not in use by any frame. A new frame takes one of these, if there is
+        /// one, so that the list's storage is reused rather than allocated afresh for each DIE.
+        std::vector<std::unique_ptr<dwarf::attribute_list>> spare_attributes;
+    };
+
+    // The hooks by which a walk that writes to a subtree_recorder reuses and records the
+    // sequences of the types that it visits. Other walks have nothing to do.
+    template <typename SequenceIterator>
+    bool start_type (dwarf::debug * const, SequenceIterator, visited_types &, scan_frame &) {
+        return false;
+    }
+    inline bool start_type (dwarf::debug * const debug, subtree_recorder::iterator S,
+                            visited_types & V, scan_frame & f) {
+        f.offset = debug->die_to_offset (f.die);
+        return S.recorder ()->start (f.offset, V, f.mark);
+    }
     template <typename SequenceIterator>
-    SequenceIterator scan_type_body (dwarf::debug * const debug, Dwarf_Die die, SequenceIterator S,
-                                     visited_types & V, die_context_map const & contexts);
+    void finish_type (SequenceIterator, visited_types const &, scan_frame const &) {}
+    inline void finish_type (subtree_recorder::iterator S, visited_types const & V,
+                             scan_frame const & f) {
+        S.recorder ()->finish (f.offset, f.mark, V);
+    }
+
+    /// Appends the index of the type referenced by an 'R' attribute.
+    template <typename SequenceIterator>
+    SequenceIterator append_type_index (unsigned index, SequenceIterator S) {
+        return encode_uleb128 (index, S);
+    }
+    // A subtree_recorder must know where the indices are so that they can be adjusted when a
+    // fragment is reused.
+    inline subtree_recorder::iterator append_type_index (unsigned index,
+                                                         subtree_recorder::iterator S) {
+        S.recorder ()->append_index (index);
+        return S;
+    }
+
+
+    // ***************
+    // * type_walker *
+    // ***************
+    /// Produces the sequence for a type. The DIEs are visited depth-first using an explicit stack
+    /// of scan_frame rather than by recursion so that the depth of a type is limited only by
+    /// the memory available.
+    template <typename SequenceIterator>
+    class type_walker {
+    public:
+        type_walker (dwarf::debug * const debug, SequenceIterator S, visited_types & V,
+                     die_context_map const & contexts, walk_storage & storage)
+                : debug_ (debug)
+                , S_ (S)
+                , V_ (V)
+                , contexts_ (contexts)
+                , stack_ (storage.frames)
+                , spare_attributes_ (storage.spare_attributes) {}
+
+        /// Appends the sequence for the type 'die', which is the most recent addition to V.
+        SequenceIterator run (Dwarf_Die die);
+
+    private:
+        void push_type (Dwarf_Die die, dwarf::die_ptr && owner);
+        void push_die (scan_frame && f);
+        /// Takes the next step of the frame on the top of the stack.
+        void step ();
+
+        void process_attribute_reference_to_type (dwarf::die_ptr && ref_die, Dwarf_Half attr);
+        void process_type_reference (Dwarf_Die die, Dwarf_Half die_tag);
+        void process_child (Dwarf_Die child);
+
+        dwarf::debug * const debug_;
+        SequenceIterator S_;
+        visited_types & V_;
+        die_context_map const & contexts_;
+        std::vector<scan_frame> & stack_;
+        std::vector<std::unique_ptr<dwarf::attribute_list>> & spare_attributes_;
+    };
+
+    // run
+    // ~~~
+    template <typename SequenceIterator>
+    SequenceIterator type_walker<SequenceIterator>::run (Dwarf_Die die) {
+        // The stack may hold the remains of a walk abandoned by an exception.
+        stack_.clear ();
+        this->push_type (die, dwarf::die_ptr ());
+        while (!stack_.empty ()) {
+            this->step ();
+        }
+        return S_;
+    }
+
+    // push_type
+    // ~~~~~~~~~
+    template <typename SequenceIterator>
+    void type_walker<SequenceIterator>::push_type (Dwarf_Die die, dwarf::die_ptr && owner) {
+        scan_frame f;
+        f.die = die;
+        f.owner = std::move (owner);
+        f.is_type = true;
+        if (start_type (debug_, S_, V_, f)) {
+            // The type's sequence came from the cache.
+            return;
+        }
+
+        // 2. If the debugging information entry represents a type that is
+        //    nested inside another type or a namespace, append to S the type's
+        //    context...
+
+        S_ = append_type_die_context (debug_, die, S_, contexts_);
+        this->push_die (std::move (f));
+    }
+
+    // push_die
+    // ~~~~~~~~
+    template <typename SequenceIterator>
+    void type_walker<SequenceIterator>::push_die (scan_frame && f) {
+        // 3. Append to S the letter 'D', followed by the DWARF tag of the
+        //     debugging information entry...
+
+        f.tag = debug_->tag (f.die);
+        *(S_++) = 'D';
+        S_ = encode_uleb128 (f.tag, S_);
+
+        if (spare_attributes_.empty ()) {
+            f.attributes.reset (new dwarf::attribute_list);
+        } else {
+            f.attributes = std::move (spare_attributes_.back ());
+            spare_attributes_.pop_back ();
+        }
+        f.attributes->reset (debug_, f.die);
+        f.attribute = std::begin (*f.attributes);
+        f.last_attribute = sort_attributes (f.attribute, std::end (*f.attributes));
+        f.next = scan_frame::state::attributes;
+        stack_.push_back (std::move (f));
+    }
+
+    // step
+    // ~~~~
+    template <typename SequenceIterator>
+    void type_walker<SequenceIterator>::step () {
+        // Note that 'f' is invalidated by anything which pushes onto the stack.
+        scan_frame & f = stack_.back ();
+        switch (f.next) {
+        case scan_frame::state::attributes:
+            // 4. For each of the attributes that are present in the DIE, in the
+            // order given by ordered_attributes[], append to S a marker letter
+            // (see below), the DWARF attribute code, and the attribute value.
+            //
+            // An attribute that refers to another type entry T is processed as
+            // follows:
+            //
+            // (a) If T is in the list V at some V[x], use the letter 'R' as the
+            //     marker and use the unsigned LEB128 encoding of x as the attribute
+            //     value; otherwise,
+            // (b) use the letter 'T' as the marker, process the type T recursively
+            //     by performing Steps 2 through 7, and use the result as the
+            //     attribute value.
+            //
+            // Other attribute values use the letter 'A' as the marker, and the
+            // value consists of the form code (encoded as an unsigned LEB128 value)
+            // followed by the encoding of the value according to the form code. To
+            // ensure reproducibility of the signature, the set of forms used in the
+            // signature computation is limited to the following: DW_FORM_sdata,
+            // DW_FORM_flag, DW_FORM_string, and DW_FORM_block.
+            if (f.attribute == f.last_attribute) {
+                // Release the attributes now but keep the list for the next DIE.
+                f.attributes->clear ();
+                spare_attributes_.push_back (std::move (f.attributes));
+                f.next = scan_frame::state::type_reference;
+            } else {
+                dwarf::attribute const & attribute = *(f.attribute++);
+                if (dwarf::die_ptr ref_die = type_die_referenced_by_attribute (attribute)) {
+                    this->process_attribute_reference_to_type (std::move (ref_die),
+                                                               attribute.what_attr ());
+                } else {
+                    S_ = append_attribute (attribute, S_);
+                }
+            }
+            break;
+
+        case scan_frame::state::type_reference:
+            f.next = scan_frame::state::first_child;
+            this->process_type_reference (f.die, f.tag);
+            break;
+
+        case scan_frame::state::first_child:
+        case scan_frame::state::next_child:
+            // 7. Visit each child C of the debugging information entry as follows:
+            //    If C is a nested type entry or a member function entry, and has a
+            //    DW_AT_name attribute, append to S the letter'S", the tag of C,
+            //    and its name; otherwise, process C recursively by performing Steps
+            //    3 through 7, appending the result to S. Following the last child
+            //    (or if there are no children), append a zero byte.
+            f.child = f.next == scan_frame::state::first_child
+                          ? debug_->child (f.die)
+                          : debug_->siblingof (f.child.get ());
+            if (f.child) {
+                f.next = scan_frame::state::next_child;
+                this->process_child (f.child.get ());
+            } else {
+                f.next = scan_frame::state::end;
+            }
+            break;
 
+        case scan_frame::state::end:
+            *(S_++) = '\0';
+            if (f.is_type) {
+                finish_type (S_, V_, f);
+            }
+            stack_.pop_back ();
+            break;
+        }
+    }
+
+    // process_attribute_reference_to_type
+    // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
     // Implements the part of step 4 for an attribute that refers to another type entry. That is...
     //
     // An attribute that refers to another type entry T is processed as
@@ -53,88 +302,37 @@ namespace details {
     // (b) use the letter 'T' as the marker, process the type T recursively
     //     by performing Steps 2 through 7, and use the result as the
     //     attribute value.
-
     template <typename SequenceIterator>
-    SequenceIterator
-    process_attribute_reference_to_type (dwarf::debug * const debug, Dwarf_Die ref_die,
-                                         dwarf::attribute const & attribute, SequenceIterator S,
-                                         visited_types & V, die_context_map const & contexts) {
-        auto const tag = attribute.what_attr ();
-
-        visited_types::const_iterator ref_die_it = V.find (ref_die);
-        if (ref_die_it != V.end ()) {
+    void type_walker<SequenceIterator>::process_attribute_reference_to_type (
+        dwarf::die_ptr && ref_die, Dwarf_Half attr) {
+
+        visited_types::const_iterator ref_die_it = V_.find (ref_die.get ());
+        if (ref_die_it != V_.end ()) {
             // "If T is in the list V at some V[x], use the letter 'R' as
             // the marker and use the unsigned LEB128 encoding of x as the
             // attribute value.
 
-            *(S++) = 'R';
-            S = encode_uleb128 (tag, S);
-            S = encode_uleb128 (ref_die_it->second, S);
+            *(S_++) = 'R';
+            S_ = encode_uleb128 (attr, S_);
+            S_ = append_type_index (ref_die_it->second, S_);
         } else {
-            *(S++) = 'T';
-            S = encode_uleb128 (tag, S);
+            *(S_++) = 'T';
+            S_ = encode_uleb128 (attr, S_);
 
             // ref_die is a reference to a separate type, so it (or rather
             // its offset) gets recorded in the set of visited types.
-            V.add (ref_die);
+            V_.add (ref_die.get ());
 
-            S = scan_type_body (debug, ref_die, S, V, contexts);
+            Dwarf_Die const die = ref_die.get ();
+            this->push_type (die, std::move (ref_die));
         }
-        return S;
     }
 
-
-    template <typename SequenceIterator, typename AttributeList = dwarf::attribute_list>
-    SequenceIterator scan_type_body2 (dwarf::debug * const debug, Dwarf_Die die, SequenceIterator S,
-                                      visited_types & V, die_context_map const & contexts) {
-        // print_cout ("scan_type_body2 @", debug->die_to_offset (die), " name:", debug->name
-        // (die));
-
-        // 3. Append to S the letter 'D', followed by the DWARF tag of the
-        //     debugging information entry...
-
-        Dwarf_Half const die_tag = debug->tag (die);
-        {
-            *(S++) = 'D';
-            S = encode_uleb128 (die_tag, S);
-        }
-
-        // 4. For each of the attributes that are present in the DIE, in the
-        // order given by ordered_attributes[], append to S a marker letter
-        // (see below), the DWARF attribute code, and the attribute value.
-        //
-        // An attribute that refers to another type entry T is processed as
-        // follows:
-        //
-        // (a) If T is in the list V at some V[x], use the letter 'R' as the
-        //     marker and use the unsigned LEB128 encoding of x as the attribute
-        //     value; otherwise,
-        // (b) use the letter 'T' as the marker, process the type T recursively
-        //     by performing Steps 2 through 7, and use the result as the
-        //     attribute value.
-        //
-        // Other attribute values use the letter 'A' as the marker, and the
-        // value consists of the form code (encoded as an unsigned LEB128 value)
-        // followed by the encoding of the value according to the form code. To
-        // ensure reproducibility of the signature, the set of forms used in the
-        // signature computation is limited to the following: DW_FORM_sdata,
-        // DW_FORM_flag, DW_FORM_string, and DW_FORM_block.
-
-        {
-            AttributeList attributes (debug, die);
-            auto first = std::begin (attributes);
-            auto last = sort_attributes (first, std::end (attributes));
-            for (auto const & attribute : make_range (first, last)) {
-                if (dwarf::die_ptr ref_die = type_die_referenced_by_attribute (attribute)) {
-                    S = process_attribute_reference_to_type (debug, ref_die.get (), attribute, S, V,
-                                                             contexts);
-                } else {
-                    S = append_attribute (attribute, S);
-                }
-            }
-        }
-
-
+    // process_type_reference
+    // ~~~~~~~~~~~~~~~~~~~~~~
+    template <typename SequenceIterator>
+    void type_walker<SequenceIterator>::process_type_reference (Dwarf_Die die,
+                                                                Dwarf_Half die_tag) {
         // 5. If the tag in Step 3 is one of DW_TAG_pointer_type,
         //    DW_TAG_reference_type, DW_TAG_rvalue_reference_type,
         //    DW_TAG_ptr_to_member_type, or DW_TAG_friend, and the referenced
@@ -160,20 +358,20 @@ namespace details {
                 (die_tag == DW_TAG_friend) ? DW_AT_friend : DW_AT_type;
             // FIXME: friend handling is not properly implemented.
             if (dwarf::owned_attribute reference_attribute =
-                    debug->attribute_from_tag (die, type_reference_tag)) {
+                    debug_->attribute_from_tag (die, type_reference_tag)) {
                 if (dwarf::die_ptr ref_die =
                         die_referenced_by_attribute (reference_attribute.get ())) {
-                    auto const name = debug->name (ref_die.get ());
+                    auto const name = debug_->name (ref_die.get ());
                     if (name.length () > 0) {
-                        *(S++) = 'N';
-                        S = encode_uleb128 (type_reference_tag, S);
-                        S = append_type_die_context (debug, ref_die.get (), S, contexts);
-                        *(S++) = 'E';
-                        S = append_string (name, S);
+                        *(S_++) = 'N';
+                        S_ = encode_uleb128 (type_reference_tag, S_);
+                        S_ = append_type_die_context (debug_, ref_die.get (), S_, contexts_);
+                        *(S_++) = 'E';
+                        S_ = append_string (name, S_);
                     } else {
                         // step 4.
-                        S = process_attribute_reference_to_type (
-                            debug, ref_die.get (), reference_attribute.get (), S, V, contexts);
+                        this->process_attribute_reference_to_type (
+                            std::move (ref_die), reference_attribute.get ().what_attr ());
                     }
                 } else {
                     // GCC sometimes elides DW_AT_TYPE field from a DW_TAG_pointer DIE to represent
@@ -184,59 +382,46 @@ namespace details {
                 }
             }
         } else {
-            if (dwarf::owned_attribute at_type = debug->attribute_from_tag (die, DW_AT_type)) {
+            if (dwarf::owned_attribute at_type = debug_->attribute_from_tag (die, DW_AT_type)) {
                 dwarf::die_ptr ref_die = die_referenced_by_attribute (at_type.get ());
                 assert (ref_die);
                 // step 4
-                S = process_attribute_reference_to_type (debug, ref_die.get (), at_type.get (), S,
-                                                         V, contexts);
+                this->process_attribute_reference_to_type (std::move (ref_die),
+                                                           at_type.get ().what_attr ());
             }
         }
+    }
 
-
-        // 7. Visit each child C of the debugging information entry as follows:
-        //    If C is a nested type entry or a member function entry, and has a
-        //    DW_AT_name attribute, append to S the letter'S", the tag of C,
-        //    and its name; otherwise, process C recursively by performing Steps
-        //    3 through 7, appending the result to S. Following the last child
-        //    (or if there are no children), append a zero byte.
-
-        for (dwarf::die_ptr & C : dwarf::die_children (debug, die)) {
-            auto const child_tag = debug->tag (C.get ());
-            bool handled = false;
-            bool const is_type = debug->is_type_die (child_tag);
-            if (is_type || child_tag == DW_TAG_subprogram) {
-                auto const name = debug->name (C.get ());
-                if (name.length () > 0) {
-                    *(S++) = 'S';
-                    S = encode_uleb128 (child_tag, S);
-                    S = append_string (name, S);
-                    handled = true;
-                }
-            }
-            if (!handled) {
-                // Skip nested types. They'll be picked up by the outer loop.
-                if (!is_type) {
-                    S = scan_type_body2 (debug, C.get (), S, V, contexts);
-                }
+    // process_child
+    // ~~~~~~~~~~~~~
+    template <typename SequenceIterator>
+    void type_walker<SequenceIterator>::process_child (Dwarf_Die child) {
+        auto const child_tag = debug_->tag (child);
+        bool const is_type = debug_->is_type_die (child_tag);
+        if (is_type || child_tag == DW_TAG_subprogram) {
+            auto const name = debug_->name (child);
+            if (name.length () > 0) {
+                *(S_++) = 'S';
+                S_ = encode_uleb128 (child_tag, S_);
+                S_ = append_string (name, S_);
+                return;
             }
         }
-
-        *(S++) = '\0';
-        return S;
+        // Skip nested types. They'll be picked up by the outer loop.
+        if (!is_type) {
+            // The child is owned by its parent's frame which remains beneath it on the stack.
+            scan_frame f;
+            f.die = child;
+            f.is_type = false;
+            this->push_die (std::move (f));
+        }
     }
+}
 
-    template <typename SequenceIterator>
-    SequenceIterator scan_type_body (dwarf::debug * const debug, Dwarf_Die die, SequenceIterator S,
-                                     visited_types & V, die_context_map const & contexts) {
-        // 2. If the debugging information entry represents a type that is
-        //    nested inside another type or a namespace, append to S the type's
-        //    context...
 
-        S = append_type_die_context (debug, die, S, contexts);
-        return scan_type_body2 (debug, die, S, V, contexts);
-    }
-}
+/// The working storage used by scan_type(). A caller which scans many types can reuse one of
+/// these to avoid allocating a new stack and new attribute lists for each.
+using scan_type_stack = details::walk_storage;
 
 template <typename OutputIterator>
 OutputIterator scan_type (dwarf::debug * const debug, Dwarf_Die die,
@@ -250,7 +435,33 @@ OutputIterator scan_type (dwarf::debug * const debug, Dwarf_Die die,
     //    indexed from 1, so that V[1] is T0.
     visited_types V (debug);
     V.add (die);
-    return details::scan_type_body (debug, die, S, V, contexts);
+    scan_type_stack stack;
+    return details::type_walker<OutputIterator> (debug, S, V, contexts, stack).run (die);
+}
+
+/// Produces the same sequence as scan_type() above but reuses the sequences recorded for the types
+/// that it references (and records new ones) in the cache belonging to 'recorder'. 'stack' is
+/// working storage.
+template <typename OutputIterator>
+OutputIterator scan_type (dwarf::debug * const debug, Dwarf_Die die,
+                          die_context_map const & contexts, subtree_recorder & recorder,
+                          scan_type_stack & stack, OutputIterator S) {
+    assert (debug->is_type_die (die));
+    visited_types V (debug);
+    V.add (die);
+    details::type_walker<subtree_recorder::iterator> (debug, recorder.begin_sequence (), V,
+                                                      contexts, stack)
+        .run (die);
+    std::vector<std::uint8_t> const & sequence = recorder.sequence ();
+    return copy_bytes (sequence.data (), sequence.data () + sequence.size (), S);
+}
+
+template <typename OutputIterator>
+OutputIterator scan_type (dwarf::debug * const debug, Dwarf_Die die,
+                          die_context_map const & contexts, subtree_recorder & recorder,
+                          OutputIterator S) {
+    scan_type_stack stack;
+    return scan_type (debug, die, contexts, recorder, stack, S);
 }
 
 #endif // SCAN_TYPE_HPP
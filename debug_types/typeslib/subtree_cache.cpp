@@ -0,0 +1,172 @@
+// Copyright (c) 2016 by SN Systems Ltd., Sony Interactive Entertainment Inc.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "subtree_cache.hpp"
+
+#include <algorithm>
+#include <cassert>
+
+#include "leb128.hpp"
+#include "visited_types.hpp"
+
+// size_bytes
+// ~~~~~~~~~~
+std::size_t subtree_cache::fragment::size_bytes () const {
+    return sizeof (*this) + bytes.size () + references.size () * sizeof (reference) +
+           visited.size () * sizeof (Dwarf_Off);
+}
+
+
+// (ctor)
+// ~~~~~~
+subtree_cache::subtree_cache (std::size_t max_bytes)
+        : max_bytes_ (max_bytes)
+        , bytes_ (0) {}
+
+// find
+// ~~~~
+auto subtree_cache::find (Dwarf_Off offset) const -> fragment_ptr {
+    shard const & s = this->shard_for (offset);
+    std::lock_guard<std::mutex> lock (s.mut);
+    auto it = s.fragments.find (offset);
+    return it != std::end (s.fragments) ? it->second : fragment_ptr ();
+}
+
+// insert
+// ~~~~~~
+void subtree_cache::insert (Dwarf_Off offset, fragment_ptr f) {
+    assert (f != nullptr);
+    if (!this->accepting ()) {
+        return;
+    }
+    std::size_t const size = f->size_bytes ();
+    shard & s = this->shard_for (offset);
+    std::lock_guard<std::mutex> lock (s.mut);
+    if (s.fragments.emplace (offset, std::move (f)).second) {
+        bytes_ += size;
+    }
+}
+
+// size
+// ~~~~
+std::size_t subtree_cache::size () const {
+    std::size_t result = 0;
+    for (shard const & s : shards_) {
+        std::lock_guard<std::mutex> lock (s.mut);
+        result += s.fragments.size ();
+    }
+    return result;
+}
+
+
+// begin_sequence
+// ~~~~~~~~~~~~~~
+auto subtree_recorder::begin_sequence () -> iterator {
+    buffer_.clear ();
+    references_.clear ();
+    return iterator (this);
+}
+
+// append_index
+// ~~~~~~~~~~~~
+void subtree_recorder::append_index (unsigned index) {
+    std::size_t const position = buffer_.size ();
+    encode_uleb128 (index, std::back_inserter (buffer_));
+    references_.push_back (logged_reference{position, buffer_.size () - position, index});
+}
+
+// start
+// ~~~~~
+bool subtree_recorder::start (Dwarf_Off offset, visited_types & V, mark & m) {
+    unsigned const root_index = V.size ();
+    m.position = buffer_.size ();
+    m.reference = references_.size ();
+    m.root_index = root_index;
+    m.record = true;
+
+    if (subtree_cache::fragment_ptr const f = cache_.find (offset)) {
+        // The fragment can be used only if the walk would have added each of the types that it
+        // visited to V (rather than producing an 'R' reference to it).
+        auto const in_v = [&V](Dwarf_Off o) { return V.contains (o); };
+        if (std::none_of (std::begin (f->visited), std::end (f->visited), in_v)) {
+            this->replay (*f, root_index);
+            for (Dwarf_Off const o : f->visited) {
+                V.add (o);
+            }
+            return true;
+        }
+        // There's already a fragment for this type so there's no need to record another.
+        m.record = false;
+    } else {
+        m.record = cache_.accepting ();
+    }
+    return false;
+}
+
+// replay
+// ~~~~~~
+void subtree_recorder::replay (subtree_cache::fragment const & f, unsigned root_index) {
+    std::uint8_t const * const bytes = f.bytes.data ();
+    std::size_t pos = 0;
+    for (subtree_cache::fragment::reference const & r : f.references) {
+        this->append (bytes + pos, bytes + r.position);
+        this->append_index (root_index + r.relative_index);
+        pos = r.position;
+    }
+    this->append (bytes + pos, bytes + f.bytes.size ());
+}
+
+// finish
+// ~~~~~~
+void subtree_recorder::finish (Dwarf_Off offset, mark const & m, visited_types const & V) {
+    // The cache may have filled while the type was being scanned.
+    if (!m.record || !cache_.accepting ()) {
+        return;
+    }
+    auto const first = std::begin (references_) + static_cast<std::ptrdiff_t> (m.reference);
+    auto const last = std::end (references_);
+    bool const back_reference = std::any_of (
+        first, last, [&m](logged_reference const & r) { return r.index < m.root_index; });
+    if (back_reference) {
+        return;
+    }
+
+    auto f = std::make_shared<subtree_cache::fragment> ();
+    f->bytes.reserve (buffer_.size () - m.position);
+    f->references.reserve (static_cast<std::size_t> (last - first));
+    std::uint8_t const * const bytes = buffer_.data ();
+    std::size_t pos = m.position;
+    for (auto it = first; it != last; ++it) {
+        f->bytes.insert (std::end (f->bytes), bytes + pos, bytes + it->position);
+        f->references.push_back (
+            subtree_cache::fragment::reference{f->bytes.size (), it->index - m.root_index});
+        pos = it->position + it->length;
+    }
+    f->bytes.insert (std::end (f->bytes), bytes + pos, bytes + buffer_.size ());
+
+    // V[root_index] is offsets()[root_index - 1] so the types visited after the root start at
+    // offsets()[root_index].
+    std::vector<Dwarf_Off> const & offsets = V.offsets ();
+    assert (m.root_index >= 1U && m.root_index <= offsets.size ());
+    f->visited.assign (std::begin (offsets) + m.root_index, std::end (offsets));
+
+    cache_.insert (offset, std::move (f));
+}
+// eof subtree_cache.cpp
@@ -0,0 +1,222 @@
+// Copyright (c) 2016 by SN Systems Ltd., Sony Interactive Entertainment Inc.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef SUBTREE_CACHE_HPP
+#define SUBTREE_CACHE_HPP
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include <libdwarf.h>
+
+class visited_types;
+
+// *****************
+// * subtree_cache *
+// *****************
+/// Holds the sequences produced by scan_type() for the type entries of a file so that a type
+/// which is referenced by many others is walked only once.
+///
+/// The sequence for a type T depends on the list of visited types V only through the 'R'
+/// references that it contains. A fragment is recorded only if every 'R' reference refers to a
+/// type visited while T was being scanned (T itself or one of the types added to V after it): the
+/// index of such a type is relative to that of T and can be adjusted when the fragment is reused.
+/// A reference to a type visited by the enclosing walk ties the sequence to that walk, so it is
+/// not recorded.
+///
+/// The cache is shared by all of the threads scanning a file.
+class subtree_cache {
+public:
+    struct fragment {
+        /// An 'R' reference within the fragment.
+        struct reference {
+            /// The position in 'bytes' at which the encoded index is inserted.
+            std::size_t position;
+            /// The index of the referenced type relative to the index of the fragment's root.
+            unsigned relative_index;
+        };
+
+        /// The sequence with the indices of the 'R' references removed.
+        std::vector<std::uint8_t> bytes;
+        std::vector<reference> references;
+        /// The types that the walk added to V (excluding the root) in the order that they were
+        /// added.
+        std::vector<Dwarf_Off> visited;
+
+        std::size_t size_bytes () const;
+    };
+    using fragment_ptr = std::shared_ptr<fragment const>;
+
+    /// \param max_bytes  The approximate limit on the memory used by the cached fragments. Once it
+    ///   is reached no more fragments are recorded.
+    explicit subtree_cache (std::size_t max_bytes);
+
+    // No copying or assignment.
+    subtree_cache (subtree_cache const &) = delete;
+    subtree_cache & operator= (subtree_cache const &) = delete;
+
+    /// Returns the fragment for the type at 'offset' or null if there is none.
+    fragment_ptr find (Dwarf_Off offset) const;
+    /// Records the fragment for the type at 'offset'. Does nothing if a fragment has already
+    /// been recorded for that type or if the cache is full.
+    void insert (Dwarf_Off offset, fragment_ptr f);
+    /// Returns true if there is room for more fragments.
+    bool accepting () const {
+        return bytes_ < max_bytes_;
+    }
+
+    /// The number of fragments in the cache.
+    std::size_t size () const;
+    /// The approximate memory used by the cached fragments.
+    std::size_t bytes () const {
+        return bytes_;
+    }
+
+private:
+    static constexpr std::size_t num_shards = 16;
+    struct shard {
+        mutable std::mutex mut;
+        std::unordered_map<Dwarf_Off, fragment_ptr> fragments;
+    };
+    shard & shard_for (Dwarf_Off offset) {
+        return shards_[offset % num_shards];
+    }
+    shard const & shard_for (Dwarf_Off offset) const {
+        return shards_[offset % num_shards];
+    }
+
+    std::size_t const max_bytes_;
+    std::atomic<std::size_t> bytes_;
+    std::array<shard, num_shards> shards_;
+};
+
+
+// ********************
+// * subtree_recorder *
+// ********************
+/// The sequence output used by scan_type() when it is given a cache. Each thread has its own
+/// recorder. The sequence is collected in a buffer from which the fragments for the types that it
+/// contains are cut and given to the cache.
+class subtree_recorder {
+public:
+    /// An output iterator which appends to the recorder's buffer.
+    class iterator {
+    public:
+        using iterator_category = std::output_iterator_tag;
+        using value_type = void;
+        using difference_type = void;
+        using pointer = void;
+        using reference = void;
+
+        explicit iterator (subtree_recorder * const recorder)
+                : recorder_ (recorder) {}
+
+        template <typename T>
+        iterator & operator= (T const & value) {
+            recorder_->buffer_.push_back (static_cast<std::uint8_t> (value));
+            return *this;
+        }
+
+        iterator & operator* () {
+            return *this;
+        }
+        iterator & operator++ () {
+            return *this;
+        }
+        iterator & operator++ (int) {
+            return *this;
+        }
+
+        subtree_recorder * recorder () const {
+            return recorder_;
+        }
+
+    private:
+        subtree_recorder * recorder_;
+    };
+
+    /// The state of the recorder at the start of the scan of a type.
+    struct mark {
+        std::size_t position;
+        std::size_t reference;
+        /// The index in V of the type being scanned.
+        unsigned root_index;
+        bool record;
+    };
+
+    explicit subtree_recorder (subtree_cache & cache)
+            : cache_ (cache) {}
+
+    /// Discards the previous sequence and returns an iterator which appends to a new one.
+    iterator begin_sequence ();
+    /// The sequence recorded since the last call to begin_sequence().
+    std::vector<std::uint8_t> const & sequence () const {
+        return buffer_;
+    }
+
+    void append (std::uint8_t const * first, std::uint8_t const * last) {
+        buffer_.insert (std::end (buffer_), first, last);
+    }
+    /// Appends the encoded index of an 'R' reference.
+    void append_index (unsigned index);
+
+    /// Called at the start of the scan of the type at 'offset', which is the type most recently
+    /// added to V. If the cache holds a fragment for this type which doesn't refer to any of the
+    /// types already in V, the fragment is appended, the types that it visited are added to V and
+    /// true is returned. Otherwise returns false and 'm' is set ready to be passed to finish()
+    /// once the type has been scanned.
+    bool start (Dwarf_Off offset, visited_types & V, mark & m);
+    /// Called once the type at 'offset' has been scanned. Records the fragment unless it refers
+    /// to a type visited before the scan began.
+    void finish (Dwarf_Off offset, mark const & m, visited_types const & V);
+
+private:
+    struct logged_reference {
+        std::size_t position;
+        std::size_t length;
+        unsigned index;
+    };
+
+    void replay (subtree_cache::fragment const & f, unsigned root_index);
+
+    subtree_cache & cache_;
+    std::vector<std::uint8_t> buffer_;
+    /// The 'R' references in buffer_ in the order they were written.
+    std::vector<logged_reference> references_;
+};
+
+/// The bulk path for copy_bytes() (see append.hpp).
+template <typename T>
+subtree_recorder::iterator copy_bytes (T const * first, T const * last,
+                                       subtree_recorder::iterator out) {
+    static_assert (sizeof (T) == 1, "copy_bytes() requires a sequence of bytes");
+    out.recorder ()->append (reinterpret_cast<std::uint8_t const *> (first),
+                             reinterpret_cast<std::uint8_t const *> (last));
+    return out;
+}
+
+#endif // SUBTREE_CACHE_HPP
+// eof subtree_cache.hpp
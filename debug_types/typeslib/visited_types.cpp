@@ -37,10 +37,14 @@ visited_types::const_iterator visited_types::find (Dwarf_Die die) const {
 // add
 // ~~~
 unsigned visited_types::add (Dwarf_Die die) {
-    auto it = this->find (die);
+    return this->add (debug_->die_to_offset (die));
+}
+
+unsigned visited_types::add (Dwarf_Off offset) {
+    auto it = v_.find (offset);
     if (it == std::end (v_)) {
-        auto const offset = debug_->die_to_offset (die);
         v_[offset] = ++index_;
+        order_.push_back (offset);
         return index_;
     } else {
         return it->second;
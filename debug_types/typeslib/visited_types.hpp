@@ -23,6 +23,7 @@
 
 #include <libdwarf.h>
 #include <unordered_map>
+#include <vector>
 
 namespace dwarf {
     class debug;
@@ -44,12 +45,27 @@ public:
     }
 
     const_iterator find (Dwarf_Die die) const;
+    bool contains (Dwarf_Off offset) const {
+        return v_.find (offset) != v_.end ();
+    }
     unsigned add (Dwarf_Die die);
+    unsigned add (Dwarf_Off offset);
+
+    /// The number of types in the list. This is also the index of the type most recently added.
+    unsigned size () const {
+        return index_;
+    }
+    /// The offsets of the types in the order in which they were added: offsets ()[x - 1] is
+    /// V[x].
+    std::vector<Dwarf_Off> const & offsets () const {
+        return order_;
+    }
 
 private:
     dwarf::debug * const debug_;
     unsigned index_ = 0;
     container v_;
+    std::vector<Dwarf_Off> order_;
 };
 
 #endif // VISITED_TYPES_HPP
@@ -0,0 +1,151 @@
+// Copyright (c) 2016 by SN Systems Ltd., Sony Interactive Entertainment Inc.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "work_queue.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <iterator>
+
+namespace {
+    /// The bounds on the size of a batch (in bytes of .debug_info).
+    constexpr std::size_t min_batch_bytes = std::size_t{16} * 1024U;
+    constexpr std::size_t max_batch_bytes = std::size_t{1024} * 1024U;
+    constexpr std::size_t batches_per_worker = 32U;
+}
+
+// work_batch_bytes
+// ~~~~~~~~~~~~~~~~
+std::size_t work_batch_bytes (die_context_map const & contexts, unsigned workers) {
+    if (contexts.empty ()) {
+        return min_batch_bytes;
+    }
+    Dwarf_Off const span = std::prev (std::end (contexts))->offset - std::begin (contexts)->offset;
+    auto const bytes =
+        static_cast<std::size_t> (span / (std::max (workers, 1U) * batches_per_worker));
+    return std::min (std::max (bytes, min_batch_bytes), max_batch_bytes);
+}
+
+// make_work_batches
+// ~~~~~~~~~~~~~~~~~
+std::vector<work_batch> make_work_batches (die_context_map const & contexts,
+                                           std::size_t batch_bytes) {
+    assert (batch_bytes > 0U);
+    std::vector<Dwarf_Off> const & units = contexts.units ();
+    std::vector<work_batch> batches;
+
+    auto const last = std::end (contexts);
+    auto first = std::begin (contexts);
+    while (first != last) {
+        Dwarf_Off const limit = first->offset + batch_bytes;
+        // Run on to the start of the next unit unless that is more than another batch away.
+        auto const unit = std::lower_bound (std::begin (units), std::end (units), limit);
+        Dwarf_Off const end =
+            (unit != std::end (units) && *unit - limit < batch_bytes) ? *unit : limit;
+
+        auto const next = std::lower_bound (
+            std::next (first), last, end,
+            [](die_context_map::value_type const & entry, Dwarf_Off off) {
+                return entry.offset < off;
+            });
+        batches.emplace_back (first, next);
+        first = next;
+    }
+    return batches;
+}
+
+
+// **************
+// * work_queue *
+// **************
+// (ctor)
+// ~~~~~~
+work_queue::work_queue (std::vector<work_batch> && batches, unsigned workers)
+        : batches_ (std::move (batches))
+        , shares_ (std::max (workers, 1U))
+        , steals_ (0) {
+    // Give each worker an equal run of batches.
+    std::size_t const num_shares = shares_.size ();
+    for (std::size_t ctr = 0; ctr < num_shares; ++ctr) {
+        shares_[ctr].next = batches_.size () * ctr / num_shares;
+        shares_[ctr].end = batches_.size () * (ctr + 1U) / num_shares;
+    }
+}
+
+// pop
+// ~~~
+bool work_queue::pop (unsigned worker, work_batch & batch) {
+    assert (worker < shares_.size ());
+    share & own = shares_[worker];
+    do {
+        std::lock_guard<std::mutex> lock (own.mut);
+        if (own.next < own.end) {
+            batch = batches_[own.next++];
+            return true;
+        }
+    } while (this->steal (worker));
+    return false;
+}
+
+// steal
+// ~~~~~
+bool work_queue::steal (unsigned worker) {
+    std::size_t const num_shares = shares_.size ();
+    for (;;) {
+        // Find the share with the most batches remaining.
+        std::size_t victim = num_shares;
+        std::size_t most = 0;
+        for (std::size_t ctr = 0; ctr < num_shares; ++ctr) {
+            if (ctr != worker) {
+                std::lock_guard<std::mutex> lock (shares_[ctr].mut);
+                std::size_t const remaining = shares_[ctr].end - shares_[ctr].next;
+                if (remaining > most) {
+                    most = remaining;
+                    victim = ctr;
+                }
+            }
+        }
+        if (victim == num_shares) {
+            return false;
+        }
+
+        std::size_t first;
+        std::size_t last;
+        {
+            share & s = shares_[victim];
+            std::lock_guard<std::mutex> lock (s.mut);
+            if (s.next == s.end) {
+                // Another worker got there first. Look again.
+                continue;
+            }
+            first = s.next + (s.end - s.next) / 2U;
+            last = s.end;
+            s.end = first;
+        }
+        ++steals_;
+
+        share & own = shares_[worker];
+        std::lock_guard<std::mutex> lock (own.mut);
+        own.next = first;
+        own.end = last;
+        return true;
+    }
+}
+// eof work_queue.cpp
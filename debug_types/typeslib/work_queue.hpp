@@ -0,0 +1,92 @@
+// Copyright (c) 2016 by SN Systems Ltd., Sony Interactive Entertainment Inc.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef WORK_QUEUE_HPP
+#define WORK_QUEUE_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+#include "die_context_map.hpp"
+#include "iter_pair.hpp"
+
+/// A run of type DIEs which lie next to each other in the file and are scanned by one thread.
+using work_batch = iter_pair<die_context_map::const_iterator>;
+
+/// Divides the entries of 'contexts' (which must have been sorted) into batches which each cover
+/// roughly 'batch_bytes' of the .debug_info section. Where it can, a batch ends at the start of a
+/// compilation unit so that the types of a unit are scanned together; only a unit which is much
+/// larger than 'batch_bytes' is split.
+std::vector<work_batch> make_work_batches (die_context_map const & contexts,
+                                           std::size_t batch_bytes);
+/// Returns a batch size which gives each of 'workers' threads a few dozen batches of the types in
+/// 'contexts'.
+std::size_t work_batch_bytes (die_context_map const & contexts, unsigned workers);
+
+
+// **************
+// * work_queue *
+// **************
+/// Hands out the batches to the phase 2 threads. Each worker is given a contiguous share of the
+/// batches (and so a region of the file) which it works through in order. A worker which has
+/// finished its share steals the second half of the largest share that remains so that the
+/// threads finish together.
+class work_queue {
+public:
+    work_queue (std::vector<work_batch> && batches, unsigned workers);
+
+    // No copying or assignment.
+    work_queue (work_queue const &) = delete;
+    work_queue & operator= (work_queue const &) = delete;
+
+    /// Takes the next batch for worker number 'worker'.
+    /// \returns False once all of the batches have been taken.
+    bool pop (unsigned worker, work_batch & batch);
+
+    /// The number of batches.
+    std::size_t size () const {
+        return batches_.size ();
+    }
+    /// The number of times that a worker took work from another's share.
+    std::size_t steals () const {
+        return steals_;
+    }
+
+private:
+    /// The batches [next, end) which remain in a worker's share.
+    struct share {
+        std::mutex mut;
+        std::size_t next = 0;
+        std::size_t end = 0;
+    };
+
+    /// Moves half of the largest remaining share to that of 'worker'.
+    /// \returns False if there was nothing left to steal.
+    bool steal (unsigned worker);
+
+    std::vector<work_batch> batches_;
+    std::vector<share> shares_;
+    std::atomic<std::size_t> steals_;
+};
+
+#endif // WORK_QUEUE_HPP
+// eof work_queue.hpp
@@ -0,0 +1,109 @@
+// Copyright (c) 2016 by SN Systems Ltd., Sony Interactive Entertainment Inc.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+// The source of the DWARF fixtures used by test_readers.cpp. They are built with:
+//
+//     g++ -g -gdwarf-4 -O0 -o types_dwarf4.elf types.cpp
+//     g++ -g -gdwarf-5 -O0 -o types_dwarf5.elf types.cpp
+//
+// The types cover the DWARF constructs that a type signature depends on: namespaces, nested
+// and template types, enumerations, typedefs, bit fields, arrays, references, pointers to
+// members, member functions and recursive types.
+
+#include <cstdint>
+
+namespace outer {
+    namespace inner {
+        enum class colour : std::uint8_t { red = 1, green = 2, blue = 250 };
+        enum plain { a = -1, b = 0, c = 1 };
+
+        struct node {
+            int value;
+            node * next;
+            node const * prev;
+        };
+    }
+
+    template <typename T, int N>
+    struct array_holder {
+        T values[N];
+        T const & get (int index) const { return values[index]; }
+    };
+
+    class shape {
+    public:
+        virtual ~shape () = default;
+        virtual double area () const { return 0.0; }
+
+        struct bounds {
+            double x0, y0, x1, y1;
+        };
+        bounds box;
+
+    protected:
+        unsigned flags : 3;
+        unsigned kind : 5;
+    };
+
+    class circle final : public shape {
+    public:
+        explicit circle (double r)
+                : radius (r) {}
+        double area () const override { return 3.0 * radius * radius; }
+
+    private:
+        double radius;
+    };
+
+    using node_alias = inner::node;
+    typedef int (*callback) (node_alias &, long);
+}
+
+namespace {
+    struct hidden {
+        char name[16];
+        outer::inner::colour c;
+    };
+}
+
+union value {
+    std::int64_t i;
+    double d;
+    char bytes[8];
+};
+
+int outer_function (outer::node_alias & n, long) { return n.value; }
+
+int main () {
+    outer::inner::node n{1, nullptr, nullptr};
+    outer::array_holder<outer::inner::plain, 3> h{
+        {outer::inner::a, outer::inner::b, outer::inner::c}};
+    outer::circle ci (2.0);
+    outer::shape & s = ci;
+    hidden hid{"x", outer::inner::colour::blue};
+    value v;
+    v.i = 3;
+    outer::callback cb = &outer_function;
+    int outer::inner::node::*pm = &outer::inner::node::value;
+    return cb (n, 0) + h.get (1) + static_cast<int> (s.area ()) + (n.*pm) +
+           static_cast<int> (hid.c) + static_cast<int> (v.bytes[0]);
+}
+
+// eof unit_test/fixtures/types.cpp
@@ -178,15 +178,25 @@ public:
         get_attribute_form_block,
         Dwarf_Block *(Dwarf_Attribute a)); // a mockable wrapper for attribute_form_block()
     dwarf::attribute::block_ptr attribute_form_block (Dwarf_Attribute a) {
-        Dwarf_Block * block = this->get_attribute_form_block (a);
-        return {block, [](Dwarf_Block * bl) { delete bl; }};
+        return dwarf::attribute::block_ptr (this->get_attribute_form_block (a),
+                                            dwarf::block_deleter (this));
     }
 
+    /// DIEs and blocks handed out by the mock are allocated with new and freed here. Attributes
+    /// belong to the Dwarf_Die_s from which they came.
+    void dealloc (Dwarf_Ptr space, Dwarf_Unsigned alloc_type) final {
+        switch (alloc_type) {
+        case DW_DLA_DIE:
+            delete static_cast<Dwarf_Die> (space);
+            break;
+        case DW_DLA_BLOCK:
+            delete static_cast<Dwarf_Block *> (space);
+            break;
+        }
+    }
 
-    MOCK_METHOD2 (dealloc, void(Dwarf_Ptr space, Dwarf_Unsigned alloc_type));
-
-    static dwarf::die_ptr new_die () {
-        return {new Dwarf_Die_s, [](Dwarf_Die d) { delete d; }};
+    dwarf::die_ptr new_die () {
+        return this->as_die_ptr (new Dwarf_Die_s);
     }
 };
 
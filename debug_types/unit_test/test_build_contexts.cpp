@@ -21,6 +21,9 @@
 #include "build_contexts.hpp"
 
 #include <array>
+#include <map>
+#include <string>
+#include <utility>
 #include <vector>
 
 #include "die_tree.hpp"
@@ -112,10 +115,18 @@ TEST_F (ContextQueueConsumer, NoTypes) {
 }
 
 
-MATCHER_P (ContextMatches, n, "") {
-    *result_listener << "where the context was \"" << std::get<0> (arg) << "\" and producer was \""
-                     << *std::get<1> (arg) << "\"";
-    return std::get<0> (arg) == std::get<0> (n) && *std::get<1> (arg) == std::get<1> (n);
+namespace {
+    using context_and_producer = std::pair<std::string, std::string>;
+
+    /// Returns the context string and producer name of each of the DIEs in 'contexts'.
+    std::map<Dwarf_Off, context_and_producer> materialize (die_context_map const & contexts) {
+        std::map<Dwarf_Off, context_and_producer> result;
+        for (die_context_map::value_type const & entry : contexts) {
+            result.emplace (entry.offset, context_and_producer{contexts.context (entry.context),
+                                                               contexts.producer (entry.producer)});
+        }
+        return result;
+    }
 }
 
 
@@ -123,7 +134,7 @@ TEST_F (ContextQueueConsumer, BaseType) {
     // +10 DW_TAG_compile_unit
     //   +20 DW_TAG_base_type "int"
     // +30 DW_TAG_compile_unit
-    using ::testing::UnorderedElementsAre;
+    using ::testing::ElementsAre;
     using ::testing::Pair;
 
     std::array<Dwarf_Die_s, 3> dies;
@@ -147,8 +158,8 @@ TEST_F (ContextQueueConsumer, BaseType) {
 
     die_context_map const contexts = builder.release_contexts ();
 
-    EXPECT_THAT (contexts, UnorderedElementsAre (
-                               Pair (20, ContextMatches (std::make_tuple ("", "producer")))));
+    EXPECT_THAT (materialize (contexts),
+                 ElementsAre (Pair (20, context_and_producer{"", "producer"})));
     EXPECT_EQ (dies.size (), builder.die_count ());
     EXPECT_EQ (std::atomic<bool>{false}, error);
 }
@@ -158,7 +169,7 @@ TEST_F (ContextQueueConsumer, NestedStructsInNamespace) {
     //   +20 DW_TAG_namespace "ns"
     //     +30 DW_TAG_structure_type "foo"
     //       +40 DW_TAG_structure_type "bar"
-    using ::testing::UnorderedElementsAre;
+    using ::testing::ElementsAre;
     using ::testing::Pair;
 
     std::array<Dwarf_Die_s, 4> dies;
@@ -193,11 +204,9 @@ TEST_F (ContextQueueConsumer, NestedStructsInNamespace) {
     auto const ns_context = std::string{"C9ns"} + '\0';
     auto const foo_context =
         ns_context + 'C' + uleb128 (DW_TAG_structure_type) + std::string{"foo"} + '\0';
-    EXPECT_THAT (
-        contexts,
-        UnorderedElementsAre (
-            Pair (Dwarf_Off{30}, ContextMatches (std::make_tuple (ns_context, "unknown"))),
-            Pair (Dwarf_Off{40}, ContextMatches (std::make_tuple (foo_context, "unknown")))));
+    EXPECT_THAT (materialize (contexts),
+                 ElementsAre (Pair (Dwarf_Off{30}, context_and_producer{ns_context, "unknown"}),
+                              Pair (Dwarf_Off{40}, context_and_producer{foo_context, "unknown"})));
     EXPECT_EQ (dies.size (), builder.die_count ());
     EXPECT_EQ (std::atomic<bool>{false}, error);
 }
@@ -209,7 +218,7 @@ TEST_F (ContextQueueConsumer, OneStructInEachOfTwoNamespaces) {
     //   +40 DW_TAG_namespace "ns2"
     //     +50 DW_TAG_structure_type "bar"
 
-    using ::testing::UnorderedElementsAre;
+    using ::testing::ElementsAre;
     using ::testing::Pair;
 
     std::array<Dwarf_Die_s, 5> dies;
@@ -254,10 +263,104 @@ TEST_F (ContextQueueConsumer, OneStructInEachOfTwoNamespaces) {
     auto const ns2_context = std::string{"C9ns2"} + '\0';
 
     EXPECT_THAT (
-        contexts,
-        UnorderedElementsAre (
-            Pair (Dwarf_Off{30}, ContextMatches (std::make_tuple (ns1_context, "producer"))),
-            Pair (Dwarf_Off{50}, ContextMatches (std::make_tuple (ns2_context, "producer")))));
+        materialize (contexts),
+        ElementsAre (Pair (Dwarf_Off{30}, context_and_producer{ns1_context, "producer"}),
+                     Pair (Dwarf_Off{50}, context_and_producer{ns2_context, "producer"})));
+    EXPECT_EQ (dies.size (), builder.die_count ());
+    EXPECT_EQ (std::atomic<bool>{false}, error);
+}
+
+TEST_F (ContextQueueConsumer, ConsumersAreMerged) {
+    // +10 DW_TAG_compile_unit
+    //   +20 DW_TAG_namespace "ns"
+    //     +30 DW_TAG_structure_type "foo"
+    // +40 DW_TAG_compile_unit
+    //   +50 DW_TAG_namespace "ns"
+    //     +60 DW_TAG_structure_type "bar"
+    using ::testing::ElementsAre;
+    using ::testing::Pair;
+
+    std::array<Dwarf_Die_s, 6> dies;
+    dies.at (0) = {Dwarf_Off{10},
+                   DW_TAG_compile_unit,
+                   &dies.at (3) /*sibling*/,
+                   &dies.at (1) /*child*/,
+                   {{DW_AT_producer, "one"}}};
+    dies.at (1) = {Dwarf_Off{20}, DW_TAG_namespace, nullptr, &dies.at (2), {{DW_AT_name, "ns"}}};
+    dies.at (2) = {Dwarf_Off{30}, DW_TAG_structure_type, nullptr, nullptr, {{DW_AT_name, "foo"}}};
+    dies.at (3) = {Dwarf_Off{40},
+                   DW_TAG_compile_unit,
+                   nullptr /*sibling*/,
+                   &dies.at (4) /*child*/,
+                   {{DW_AT_producer, "two"}}};
+    dies.at (4) = {Dwarf_Off{50}, DW_TAG_namespace, nullptr, &dies.at (5), {{DW_AT_name, "ns"}}};
+    dies.at (5) = {Dwarf_Off{60}, DW_TAG_structure_type, nullptr, nullptr, {{DW_AT_name, "bar"}}};
+    this->setup (std::begin (dies), std::end (dies));
+
+    // Each consumer (as if it were running on a separate thread) takes one of the CUs.
+    build_contexts builder;
+    silent_updater updater;
+    std::atomic<bool> error{false};
+    for (Dwarf_Off const cu : {dies.at (3).offset (), dies.at (0).offset ()}) {
+        context_queue queue (1);
+        queue.push (cu);
+        builder.consumer (&debug, queue, updater, error);
+    }
+
+    die_context_map const contexts = builder.release_contexts ();
+
+    auto const ns_context = std::string{"C9ns"} + '\0';
+    EXPECT_THAT (materialize (contexts),
+                 ElementsAre (Pair (Dwarf_Off{30}, context_and_producer{ns_context, "one"}),
+                              Pair (Dwarf_Off{60}, context_and_producer{ns_context, "two"})));
+    // The two CUs share the context for "ns".
+    EXPECT_EQ (2U, contexts.contexts ());
+    EXPECT_EQ (dies.size (), builder.die_count ());
+    EXPECT_EQ (std::atomic<bool>{false}, error);
+}
+
+
+TEST_F (ContextQueueConsumer, DeeplyNestedDies) {
+    // +10 DW_TAG_compile_unit
+    //   +20 DW_TAG_namespace "ns"
+    //     +30 DW_TAG_lexical_block
+    //       +40 DW_TAG_lexical_block
+    //         ...
+    //           +n DW_TAG_base_type "int"
+    //     +n+10 DW_TAG_base_type "char"
+    // The DIEs are nested far more deeply than a recursive walk could manage.
+    using ::testing::ElementsAre;
+    using ::testing::Pair;
+
+    constexpr auto blocks = std::size_t{100000};
+    std::vector<Dwarf_Die_s> dies (blocks + 4U);
+    dies.front () = {Dwarf_Off{10}, DW_TAG_compile_unit, nullptr, &dies.at (1)};
+    dies.at (1) = {Dwarf_Off{20}, DW_TAG_namespace, nullptr, &dies.at (2), {{DW_AT_name, "ns"}}};
+    for (auto ctr = std::size_t{2}; ctr < blocks + 2U; ++ctr) {
+        dies.at (ctr) = {Dwarf_Off{(ctr + 1U) * 10U}, DW_TAG_lexical_block, nullptr,
+                         &dies.at (ctr + 1U)};
+    }
+    auto const int_off = Dwarf_Off{(blocks + 3U) * 10U};
+    auto const char_off = int_off + 10U;
+    dies.at (blocks + 2U) = {int_off, DW_TAG_base_type, {{DW_AT_name, "int"}}};
+    dies.at (blocks + 3U) = {char_off, DW_TAG_base_type, {{DW_AT_name, "char"}}};
+    dies.at (2).sibling (&dies.at (blocks + 3U));
+    this->setup (std::begin (dies), std::end (dies));
+
+    context_queue queue (1);
+    queue.push (dies.front ().offset ());
+
+    build_contexts builder;
+    silent_updater progress;
+    std::atomic<bool> error{false};
+    builder.consumer (&debug, queue, progress, error);
+
+    die_context_map const contexts = builder.release_contexts ();
+
+    auto const ns_context = std::string{"C9ns"} + '\0';
+    EXPECT_THAT (materialize (contexts),
+                 ElementsAre (Pair (int_off, context_and_producer{ns_context, "unknown"}),
+                              Pair (char_off, context_and_producer{ns_context, "unknown"})));
     EXPECT_EQ (dies.size (), builder.die_count ());
     EXPECT_EQ (std::atomic<bool>{false}, error);
 }
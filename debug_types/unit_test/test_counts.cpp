@@ -82,4 +82,20 @@ TEST (Counts, OneTypeProducerWithVersion) {
     EXPECT_EQ ("clang v 3.9.0 (trunk 269902)", c.producer ());
 }
 
+TEST (Counts, Merge) {
+    counts a (4U);
+    a.add_type (std::uint64_t{1}, "first");
+    a.add_type (std::uint64_t{2}, "first");
+    counts b (4U);
+    b.add_type (std::uint64_t{2}, "second");
+    b.add_type (std::uint64_t{3}, "second");
+
+    a.merge (std::move (b));
+    EXPECT_EQ (4U, a.total ());
+    EXPECT_EQ (4U, a.types ());
+    EXPECT_EQ (3U, a.unique ());
+    EXPECT_EQ ("first/second", a.producer ());
+    EXPECT_EQ (0U, b.types ());
+}
+
 // eof test_counts.cpp
@@ -0,0 +1,115 @@
+// Copyright (c) 2016 by SN Systems Ltd., Sony Interactive Entertainment Inc.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "die_context_map.hpp"
+
+#include <string>
+#include <vector>
+
+#include <dwarf.h>
+#include <gmock/gmock.h>
+
+TEST (DieContextMap, Empty) {
+    die_context_map contexts;
+    contexts.sort ();
+    EXPECT_TRUE (contexts.empty ());
+    EXPECT_EQ (std::end (contexts), contexts.find (Dwarf_Off{10}));
+    EXPECT_EQ (1U, contexts.contexts ());
+    EXPECT_EQ ("", contexts.context (die_context_map::root_context));
+}
+
+TEST (DieContextMap, ContextsAreInterned) {
+    die_context_map contexts;
+    auto const ns = contexts.add_context (die_context_map::root_context, DW_TAG_namespace, "ns");
+    auto const foo = contexts.add_context (ns, DW_TAG_structure_type, "foo");
+    EXPECT_EQ (ns, contexts.add_context (die_context_map::root_context, DW_TAG_namespace, "ns"));
+    EXPECT_EQ (foo, contexts.add_context (ns, DW_TAG_structure_type, "foo"));
+    // The same name with a different tag or parent is a different context.
+    EXPECT_NE (foo, contexts.add_context (ns, DW_TAG_class_type, "foo"));
+    EXPECT_NE (foo, contexts.add_context (die_context_map::root_context, DW_TAG_structure_type,
+                                          "foo"));
+    EXPECT_EQ (5U, contexts.contexts ());
+
+    EXPECT_EQ (ns, contexts.parent (foo));
+    auto const ns_context = std::string{"C9ns"} + '\0';
+    EXPECT_EQ (ns_context, contexts.context (ns));
+    EXPECT_EQ (ns_context + "C\x13" + "foo" + '\0', contexts.context (foo));
+}
+
+TEST (DieContextMap, FindAfterSort) {
+    die_context_map contexts;
+    auto const ns = contexts.add_context (die_context_map::root_context, DW_TAG_namespace, "ns");
+    auto const p1 = contexts.add_producer ("one");
+    auto const p2 = contexts.add_producer ("two");
+    EXPECT_EQ (p1, contexts.add_producer ("one"));
+
+    contexts.add (Dwarf_Off{30}, ns, p2);
+    contexts.add (Dwarf_Off{10}, die_context_map::root_context, p1);
+    contexts.add (Dwarf_Off{20}, ns, p1);
+    contexts.sort ();
+
+    ASSERT_EQ (3U, contexts.size ());
+    EXPECT_EQ (Dwarf_Off{10}, contexts.begin ()->offset);
+    auto const it = contexts.find (Dwarf_Off{30});
+    ASSERT_NE (std::end (contexts), it);
+    EXPECT_EQ (ns, it->context);
+    EXPECT_EQ ("two", contexts.producer (it->producer));
+    EXPECT_EQ (std::end (contexts), contexts.find (Dwarf_Off{25}));
+}
+TEST (DieContextMap, Merge) {
+    die_context_map a;
+    auto const a_ns = a.add_context (die_context_map::root_context, DW_TAG_namespace, "ns");
+    a.add (Dwarf_Off{40}, a_ns, a.add_producer ("one"));
+    a.add (Dwarf_Off{10}, die_context_map::root_context, a.add_producer ("two"));
+    a.add_unit (Dwarf_Off{35});
+    a.add_unit (Dwarf_Off{0});
+    a.sort_entries ();
+
+    die_context_map b;
+    auto const b_other = b.add_context (die_context_map::root_context, DW_TAG_namespace, "x");
+    auto const b_ns = b.add_context (die_context_map::root_context, DW_TAG_namespace, "ns");
+    auto const b_foo = b.add_context (b_ns, DW_TAG_structure_type, "foo");
+    auto const b_two = b.add_producer ("two");
+    b.add (Dwarf_Off{30}, b_foo, b_two);
+    b.add (Dwarf_Off{20}, b_other, b_two);
+    b.add_unit (Dwarf_Off{15});
+    b.sort_entries ();
+
+    a.merge (std::move (b));
+    EXPECT_TRUE (b.empty ());
+    // The root, "ns", "x" and "ns::foo".
+    EXPECT_EQ (4U, a.contexts ());
+    a.sort ();
+
+    std::vector<Dwarf_Off> offsets;
+    for (die_context_map::value_type const & entry : a) {
+        offsets.push_back (entry.offset);
+    }
+    EXPECT_THAT (offsets, ::testing::ElementsAre (10U, 20U, 30U, 40U));
+    EXPECT_THAT (a.units (), ::testing::ElementsAre (0U, 15U, 35U));
+
+    auto const it = a.find (Dwarf_Off{30});
+    ASSERT_NE (std::end (a), it);
+    EXPECT_EQ (a_ns, a.parent (it->context));
+    EXPECT_EQ (std::string{"C9ns"} + '\0' + "C\x13" + "foo" + '\0', a.context (it->context));
+    EXPECT_EQ ("two", a.producer (it->producer));
+    EXPECT_EQ ("two", a.producer (a.find (Dwarf_Off{10})->producer));
+}
+// eof test_die_context_map.cpp
@@ -19,7 +19,9 @@
 // THE SOFTWARE.
 
 #include "md5.h"
+#include <cstdint>
 #include <sstream>
+#include <vector>
 
 #include <gtest/gtest.h>
 
@@ -74,4 +76,51 @@ TEST (Md5, NsrlMillionAs) {
     EXPECT_EQ (expected, actual);
 }
 
+namespace {
+    std::vector<std::uint8_t> make_message (std::size_t size) {
+        std::vector<std::uint8_t> result (size);
+        for (std::size_t ctr = 0; ctr < size; ++ctr) {
+            result[ctr] = static_cast<std::uint8_t> (ctr * 7 + 3);
+        }
+        return result;
+    }
+}
+
+// The buffered hasher produces the same digest as the plain hasher regardless of how the data is
+// divided between calls to append() relative to the block boundaries.
+TEST (Md5, BufferedMatchesHasher) {
+    std::vector<std::uint8_t> const message = make_message (1000);
+    for (std::size_t chunk : {1U, 3U, 63U, 64U, 65U, 130U, 1000U}) {
+        md5::hasher expected;
+        md5::buffered_hasher actual;
+        for (std::size_t pos = 0; pos < message.size (); pos += chunk) {
+            std::size_t const size = std::min (chunk, message.size () - pos);
+            expected.append (&message[pos], size);
+            if (size == 1) {
+                actual.append (message[pos]);
+            } else {
+                actual.append (&message[pos], size);
+            }
+        }
+        EXPECT_EQ (expected.finish (), actual.finish ()) << "chunk size " << chunk;
+    }
+}
+
+// Mixing single bytes with bulk copies through the output iterator.
+TEST (Md5, OutputIterator) {
+    std::vector<std::uint8_t> const message = make_message (300);
+    md5::buffered_hasher h;
+    md5::output_iterator out (&h);
+    *(out++) = message[0];
+    out = copy_bytes (&message[1], &message[70], out);
+    for (std::size_t ctr = 70; ctr < 72; ++ctr) {
+        *(out++) = message[ctr];
+    }
+    out = copy_bytes (&message[72], &message[300], out);
+
+    md5::hasher expected;
+    expected.append (message.data (), message.size ());
+    EXPECT_EQ (expected.finish (), h.finish ());
+}
+
 // eof test_md5.cpp
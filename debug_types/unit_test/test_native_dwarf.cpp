@@ -0,0 +1,400 @@
+// Copyright (c) 2016 by SN Systems Ltd., Sony Interactive Entertainment Inc.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "native_dwarf.hpp"
+
+#include <cstdint>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include <dwarf.h>
+#include <gmock/gmock.h>
+
+#include "die_context_map.hpp"
+#include "leb128.hpp"
+#include "scan_type.hpp"
+
+namespace {
+    /// Builds the contents of a (little-endian) DWARF section.
+    class section {
+    public:
+        section & u8 (std::uint64_t v) {
+            return this->fixed (v, 1U);
+        }
+        section & u16 (std::uint64_t v) {
+            return this->fixed (v, 2U);
+        }
+        section & u32 (std::uint64_t v) {
+            return this->fixed (v, 4U);
+        }
+        section & uleb (std::uint64_t v) {
+            encode_uleb128 (v, std::back_inserter (bytes_));
+            return *this;
+        }
+        section & sleb (std::int64_t v) {
+            encode_sleb128 (v, std::back_inserter (bytes_));
+            return *this;
+        }
+        section & str (std::string const & s) {
+            bytes_.insert (std::end (bytes_), std::begin (s), std::end (s));
+            return this->u8 (0U);
+        }
+        /// Reserves space for a 4-byte value which is set by patch32().
+        std::size_t hole32 () {
+            auto const result = this->size ();
+            this->u32 (0U);
+            return result;
+        }
+        void patch32 (std::size_t pos, std::uint64_t v) {
+            for (auto ctr = 0U; ctr < 4U; ++ctr, v >>= 8) {
+                bytes_[pos + ctr] = static_cast<std::uint8_t> (v);
+            }
+        }
+
+        std::size_t size () const {
+            return bytes_.size ();
+        }
+        dwarf::native_sections::range range () const {
+            dwarf::native_sections::range r;
+            r.first = bytes_.data ();
+            r.last = r.first + bytes_.size ();
+            return r;
+        }
+
+    private:
+        section & fixed (std::uint64_t v, unsigned size) {
+            for (auto ctr = 0U; ctr < size; ++ctr, v >>= 8) {
+                bytes_.push_back (static_cast<std::uint8_t> (v));
+            }
+            return *this;
+        }
+
+        std::vector<std::uint8_t> bytes_;
+    };
+
+    class NativeDwarf : public ::testing::Test {
+    protected:
+        dwarf::native_sections sections () const {
+            dwarf::native_sections result;
+            result.info = info.range ();
+            result.abbrev = abbrev.range ();
+            result.str = str.range ();
+            result.str_offsets = str_offsets.range ();
+            return result;
+        }
+
+        /// Ends a unit whose length field is at 'length_pos'.
+        void end_unit (std::size_t length_pos) {
+            info.patch32 (length_pos, info.size () - length_pos - 4U);
+        }
+
+        static std::vector<std::uint8_t> append (std::vector<std::uint8_t> a,
+                                                 std::vector<std::uint8_t> const & b) {
+            a.insert (std::end (a), std::begin (b), std::end (b));
+            return a;
+        }
+
+        section info;
+        section abbrev;
+        section str;
+        section str_offsets;
+    };
+}
+
+
+// The structure from example E.2.1 of the DWARF 4 specification encoded as a producer might:
+// strings in .debug_str, constants with the smallest data forms and a DW_AT_sibling reference.
+TEST_F (NativeDwarf, ExampleE_2_1_structC) {
+    // clang-format off
+    abbrev.uleb (1).uleb (DW_TAG_compile_unit).u8 (DW_CHILDREN_yes)
+        .uleb (DW_AT_producer).uleb (DW_FORM_strp)
+        .uleb (DW_AT_language).uleb (DW_FORM_data1)
+        .uleb (0).uleb (0);
+    abbrev.uleb (2).uleb (DW_TAG_namespace).u8 (DW_CHILDREN_yes)
+        .uleb (DW_AT_name).uleb (DW_FORM_string)
+        .uleb (0).uleb (0);
+    abbrev.uleb (3).uleb (DW_TAG_structure_type).u8 (DW_CHILDREN_yes)
+        .uleb (DW_AT_name).uleb (DW_FORM_string)
+        .uleb (DW_AT_byte_size).uleb (DW_FORM_data1)
+        .uleb (DW_AT_decl_file).uleb (DW_FORM_data1)
+        .uleb (DW_AT_decl_line).uleb (DW_FORM_data1)
+        .uleb (DW_AT_sibling).uleb (DW_FORM_ref4)
+        .uleb (0).uleb (0);
+    abbrev.uleb (4).uleb (DW_TAG_member).u8 (DW_CHILDREN_no)
+        .uleb (DW_AT_name).uleb (DW_FORM_strp)
+        .uleb (DW_AT_decl_file).uleb (DW_FORM_data1)
+        .uleb (DW_AT_decl_line).uleb (DW_FORM_data1)
+        .uleb (DW_AT_data_member_location).uleb (DW_FORM_data1)
+        .uleb (DW_AT_type).uleb (DW_FORM_ref4)
+        .uleb (0).uleb (0);
+    abbrev.uleb (5).uleb (DW_TAG_base_type).u8 (DW_CHILDREN_no)
+        .uleb (DW_AT_byte_size).uleb (DW_FORM_data1)
+        .uleb (DW_AT_encoding).uleb (DW_FORM_data1)
+        .uleb (DW_AT_name).uleb (DW_FORM_string)
+        .uleb (0).uleb (0);
+    abbrev.uleb (0);
+
+    str.str ("producer");
+    auto const str_x = str.size ();
+    str.str ("x");
+    auto const str_y = str.size ();
+    str.str ("y");
+
+    auto const length = info.hole32 ();
+    info.u16 (4).u32 (0).u8 (8); // version, abbreviation table, address size
+    auto const cu = info.size ();
+    info.uleb (1).u32 (0).u8 (DW_LANG_C_plus_plus);
+        auto const namespace_N = info.size ();
+        info.uleb (2).str ("N");
+            auto const struct_C = info.size ();
+            info.uleb (3).str ("C").u8 (8).u8 (1).u8 (5);
+            auto const struct_C_sibling = info.hole32 ();
+                info.uleb (4).u32 (str_x).u8 (1).u8 (6).u8 (0);
+                auto const x_type = info.hole32 ();
+                info.uleb (4).u32 (str_y).u8 (1).u8 (7).u8 (4);
+                auto const y_type = info.hole32 ();
+                info.uleb (0);
+            info.patch32 (struct_C_sibling, info.size ());
+            info.uleb (0);
+        auto const base_type_int = info.size ();
+        info.uleb (5).u8 (4).u8 (DW_ATE_signed).str ("int");
+        info.uleb (0);
+    info.patch32 (x_type, base_type_int);
+    info.patch32 (y_type, base_type_int);
+    end_unit (length);
+    // clang-format on
+
+    dwarf::native_index index (this->sections ());
+    dwarf::native_debug debug (index);
+
+    // Find the unit and walk its DIEs.
+    auto cu_length = Dwarf_Unsigned{0};
+    auto version = Dwarf_Half{0};
+    auto abbrev_offset = Dwarf_Off{0};
+    auto address_size = Dwarf_Half{0};
+    auto next = Dwarf_Unsigned{0};
+    ASSERT_TRUE (debug.next_cu_header (&cu_length, &version, &abbrev_offset, &address_size, &next));
+    EXPECT_EQ (info.size () - 4U, cu_length);
+    EXPECT_EQ (4U, version);
+    EXPECT_EQ (8U, address_size);
+    EXPECT_EQ (info.size (), next);
+
+    dwarf::die_ptr const cu_die = debug.siblingof (nullptr);
+    ASSERT_NE (nullptr, cu_die);
+    EXPECT_EQ (cu, debug.die_to_offset (cu_die.get ()));
+    EXPECT_EQ (DW_TAG_compile_unit, debug.tag (cu_die.get ()));
+    EXPECT_EQ (nullptr, debug.siblingof (cu_die.get ()));
+    {
+        dwarf::owned_attribute producer =
+            debug.attribute_from_tag (cu_die.get (), DW_AT_producer);
+        ASSERT_TRUE (producer);
+        EXPECT_EQ ("producer", producer.get ().string ());
+    }
+
+    dwarf::die_ptr const ns = debug.child (cu_die.get ());
+    ASSERT_NE (nullptr, ns);
+    EXPECT_EQ (namespace_N, debug.die_to_offset (ns.get ()));
+    EXPECT_EQ ("N", debug.name (ns.get ()));
+
+    dwarf::die_ptr const c = debug.child (ns.get ());
+    ASSERT_NE (nullptr, c);
+    EXPECT_EQ (struct_C, debug.die_to_offset (c.get ()));
+    EXPECT_EQ (nullptr, debug.siblingof (c.get ()));
+
+    dwarf::die_ptr const i = debug.siblingof (ns.get ());
+    ASSERT_NE (nullptr, i);
+    EXPECT_EQ (base_type_int, debug.die_to_offset (i.get ()));
+    EXPECT_EQ ("int", debug.name (i.get ()));
+    EXPECT_EQ (nullptr, debug.siblingof (i.get ()));
+    EXPECT_FALSE (
+        debug.next_cu_header (&cu_length, &version, &abbrev_offset, &address_size, &next));
+
+    // The signature's sequence must be the same as the one given by the specification.
+    die_context_map contexts;
+    auto const producer = contexts.add_producer ("producer");
+    contexts.add (struct_C,
+                  contexts.add_context (die_context_map::root_context, DW_TAG_namespace, "N"),
+                  producer);
+    contexts.add (base_type_int, die_context_map::root_context, producer);
+    contexts.sort ();
+
+    // clang-format off
+    std::vector<std::uint8_t> expected;
+    expected = append (expected, {0x43, 0x39, 0x4e, 0x00}); // 'C' DW_TAG_namespace "N"
+    expected = append (expected, {0x44, 0x13}); // 'D' DW_TAG_structure_type
+    expected = append (expected, {0x41, 0x03, 0x08, 0x43, 0x00}); // DW_AT_name "C"
+    expected = append (expected, {0x41, 0x0b, 0x0d, 0x08}); // DW_AT_byte_size 8
+        expected = append (expected, {0x44, 0x0d}); // 'D' DW_TAG_member
+        expected = append (expected, {0x41, 0x03, 0x08, 0x78, 0x00}); // DW_AT_name "x"
+        expected = append (expected, {0x41, 0x38, 0x0d, 0x00}); // DW_AT_data_member_location 0
+        expected = append (expected, {0x54, 0x49}); // 'T' DW_AT_type
+            expected = append (expected, {0x44, 0x24}); // 'D' DW_TAG_base_type
+            expected = append (expected, {0x41, 0x03, 0x08, 0x69, 0x6e, 0x74, 0x00}); // "int"
+            expected = append (expected, {0x41, 0x0b, 0x0d, 0x04}); // DW_AT_byte_size 4
+            expected = append (expected, {0x41, 0x3e, 0x0d, 0x05}); // DW_AT_encoding
+            expected = append (expected, {0x00});
+        expected = append (expected, {0x00});
+        expected = append (expected, {0x44, 0x0d}); // 'D' DW_TAG_member
+        expected = append (expected, {0x41, 0x03, 0x08, 0x79, 0x00}); // DW_AT_name "y"
+        expected = append (expected, {0x41, 0x38, 0x0d, 0x04}); // DW_AT_data_member_location 4
+        expected = append (expected, {0x52, 0x49, 0x02}); // 'R' DW_AT_type #2
+        expected = append (expected, {0x00});
+    expected = append (expected, {0x00});
+    // clang-format on
+
+    std::vector<std::uint8_t> S;
+    scan_type (&debug, debug.offset_to_die (struct_C).get (), contexts, std::back_inserter (S));
+    EXPECT_THAT (S, ::testing::ContainerEq (expected));
+}
+
+
+// The forms added by DWARF 5 and those that the first test doesn't use.
+TEST_F (NativeDwarf, Dwarf5Forms) {
+    constexpr Dwarf_Half form_strx1 = 0x25;
+    constexpr Dwarf_Half form_implicit_const = 0x21;
+    constexpr Dwarf_Half at_str_offsets_base = 0x72;
+
+    // clang-format off
+    abbrev.uleb (1).uleb (DW_TAG_compile_unit).u8 (DW_CHILDREN_yes)
+        .uleb (DW_AT_name).uleb (form_strx1)
+        .uleb (at_str_offsets_base).uleb (DW_FORM_sec_offset)
+        .uleb (0).uleb (0);
+    abbrev.uleb (2).uleb (DW_TAG_base_type).u8 (DW_CHILDREN_no)
+        .uleb (DW_AT_name).uleb (form_strx1)
+        .uleb (DW_AT_byte_size).uleb (form_implicit_const).sleb (4)
+        .uleb (DW_AT_external).uleb (DW_FORM_flag_present)
+        .uleb (DW_AT_const_value).uleb (DW_FORM_sdata)
+        .uleb (DW_AT_location).uleb (DW_FORM_block1)
+        .uleb (DW_AT_upper_bound).uleb (DW_FORM_data2)
+        .uleb (DW_AT_decl_line).uleb (DW_FORM_indirect)
+        .uleb (0).uleb (0);
+    abbrev.uleb (3).uleb (DW_TAG_pointer_type).u8 (DW_CHILDREN_no)
+        .uleb (DW_AT_type).uleb (DW_FORM_ref_udata)
+        .uleb (0).uleb (0);
+    abbrev.uleb (0);
+
+    auto const str_unit = str.size ();
+    str.str ("unit");
+    auto const str_int = str.size ();
+    str.str ("int");
+    // The .debug_str_offsets header is followed by the offsets of the strings.
+    str_offsets.u32 (12).u16 (5).u16 (0).u32 (str_unit).u32 (str_int);
+
+    auto const length = info.hole32 ();
+    info.u16 (5).u8 (0x01 /*DW_UT_compile*/).u8 (8).u32 (0);
+    auto const cu = info.size ();
+    info.uleb (1).u8 (0).u32 (8);
+        auto const base_type = info.size ();
+        info.uleb (2).u8 (1).sleb (-3).u8 (2).u8 (0xaa).u8 (0xbb).u16 (0xfffe)
+            .uleb (DW_FORM_udata).uleb (300);
+        auto const pointer = info.size ();
+        info.uleb (3).uleb (base_type);
+        info.uleb (0);
+    end_unit (length);
+    // clang-format on
+
+    dwarf::native_index index (this->sections ());
+    ASSERT_EQ (1U, index.units ().size ());
+    dwarf::native_debug debug (index);
+
+    dwarf::die_ptr const cu_die = debug.offset_to_die (cu);
+    EXPECT_EQ ("unit", debug.name (cu_die.get ()));
+    dwarf::die_ptr const b = debug.child (cu_die.get ());
+    ASSERT_NE (nullptr, b);
+    EXPECT_EQ (base_type, debug.die_to_offset (b.get ()));
+    EXPECT_EQ ("int", debug.name (b.get ()));
+
+    {
+        dwarf::attribute_list attributes (&debug, b.get ());
+        ASSERT_EQ (7U, attributes.size ());
+        auto it = std::begin (attributes);
+        EXPECT_EQ (DW_AT_name, it->what_attr ());
+        EXPECT_EQ ("int", it->string ());
+        ++it;
+        EXPECT_EQ (form_implicit_const, it->what_form ());
+        EXPECT_EQ (4, it->signed_constant ());
+        EXPECT_EQ (4U, it->unsigned_constant ());
+        ++it;
+        EXPECT_TRUE (it->flag ());
+        ++it;
+        EXPECT_EQ (-3, it->signed_constant ());
+        ++it;
+        dwarf::attribute::block_ptr block = it->block ();
+        ASSERT_EQ (2U, block->bl_len);
+        EXPECT_EQ (0xaa, static_cast<std::uint8_t const *> (block->bl_data)[0]);
+        EXPECT_EQ (0xbb, static_cast<std::uint8_t const *> (block->bl_data)[1]);
+        ++it;
+        EXPECT_EQ (-2, it->signed_constant ());
+        EXPECT_EQ (0xfffeU, it->unsigned_constant ());
+        ++it;
+        EXPECT_EQ (DW_AT_decl_line, it->what_attr ());
+        EXPECT_EQ (DW_FORM_udata, it->what_form ());
+        EXPECT_EQ (300U, it->unsigned_constant ());
+    }
+
+    dwarf::die_ptr const p = debug.siblingof (b.get ());
+    ASSERT_NE (nullptr, p);
+    EXPECT_EQ (pointer, debug.die_to_offset (p.get ()));
+    EXPECT_EQ (DW_TAG_pointer_type, debug.tag (p.get ()));
+    {
+        dwarf::owned_attribute type = debug.attribute_from_tag (p.get (), DW_AT_type);
+        ASSERT_TRUE (type);
+        EXPECT_EQ (base_type, type.get ().ref ());
+    }
+    EXPECT_FALSE (debug.attribute_from_tag (p.get (), DW_AT_name));
+    {
+        // A list can be refilled in place with the attributes of another DIE.
+        dwarf::attribute_list attributes (&debug, b.get ());
+        attributes.reset (&debug, p.get ());
+        ASSERT_EQ (1U, attributes.size ());
+        EXPECT_EQ (DW_AT_type, std::begin (attributes)->what_attr ());
+        EXPECT_EQ (base_type, std::begin (attributes)->ref ());
+        attributes.clear ();
+        EXPECT_EQ (0U, attributes.size ());
+    }
+    EXPECT_EQ (nullptr, debug.siblingof (p.get ()));
+    EXPECT_THROW (debug.offset_to_die (info.size () + 10U), dwarf::native_error);
+}
+
+// A unit which uses DW_FORM_strx* must give DW_AT_str_offsets_base: there is no default so the
+// file is rejected and left to libdwarf.
+TEST_F (NativeDwarf, StrxWithoutStrOffsetsBase) {
+    constexpr Dwarf_Half form_strx1 = 0x25;
+
+    // clang-format off
+    abbrev.uleb (1).uleb (DW_TAG_compile_unit).u8 (DW_CHILDREN_no)
+        .uleb (DW_AT_name).uleb (form_strx1)
+        .uleb (0).uleb (0);
+    abbrev.uleb (0);
+
+    str.str ("unit");
+    str_offsets.u32 (8).u16 (5).u16 (0).u32 (0);
+
+    auto const length = info.hole32 ();
+    info.u16 (5).u8 (0x01 /*DW_UT_compile*/).u8 (8).u32 (0);
+    info.uleb (1).u8 (0);
+    end_unit (length);
+    // clang-format on
+
+    EXPECT_THROW (dwarf::native_index index (this->sections ()), dwarf::native_error);
+}
+
+// eof test_native_dwarf.cpp
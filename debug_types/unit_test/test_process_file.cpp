@@ -26,6 +26,7 @@
 #include "append.hpp"
 #include "build_contexts.hpp"
 #include "mock_debug.hpp"
+#include <dwarf.h>
 #include <gmock/gmock.h>
 
 namespace {
@@ -40,14 +41,17 @@ namespace {
         ::testing::NiceMock<mock_debug> debug;
         dwarf::die_ptr die = debug.new_die ();
         Dwarf_Off const offset = 100;
-        std::string const context = "C9ns";
+        std::string const context = std::string{"C9ns"} + '\0';
     };
 }
 
 TEST_F (AppendContext, HasContext) {
     std::string S;
-    die_context_map contexts{
-        {offset, std::make_tuple (context, std::make_shared<std::string> ("producer"))}};
+    die_context_map contexts;
+    contexts.add (offset,
+                  contexts.add_context (die_context_map::root_context, DW_TAG_namespace, "ns"),
+                  contexts.add_producer ("producer"));
+    contexts.sort ();
     append_type_die_context (&debug, die.get (), std::back_inserter (S), contexts);
     EXPECT_EQ (context, S);
 }
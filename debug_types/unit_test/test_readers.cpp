@@ -0,0 +1,135 @@
+// Copyright (c) 2016 by SN Systems Ltd., Sony Interactive Entertainment Inc.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "native_dwarf.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <iterator>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <boost/iostreams/device/mapped_file.hpp>
+#include <gmock/gmock.h>
+
+#include "build_contexts.hpp"
+#include "dt_config.h"
+#include "dwarf_helpers.hpp"
+#include "elf_helpers.hpp"
+#include "progress.hpp"
+#include "scan_type.hpp"
+
+// Runs the built-in DWARF reader and libdwarf over the linked executables in the fixtures
+// directory (see fixtures/types.cpp) and checks that they produce the same sequence, and hence
+// the same signature, for every type.
+//
+// The DWARF 5 fixture uses DW_FORM_line_strp and DW_FORM_implicit_const. A libdwarf which
+// can't read those (LIBDWARF_READS_DWARF5 is set by typeslib/CMakeLists.txt) has nothing to
+// compare with, so that comparison is disabled and only the built-in reader's half is run.
+
+namespace {
+    using sequences = std::map<Dwarf_Off, std::vector<std::uint8_t>>;
+
+    /// Returns the sequence of each of the type DIEs read by 'debug' keyed by its offset.
+    sequences type_sequences (dwarf::debug & debug) {
+        context_queue queue (1000);
+        context_queue_producer (&debug, &queue);
+        build_contexts builder;
+        silent_updater progress;
+        std::atomic<bool> error{false};
+        builder.consumer (&debug, queue, progress, error);
+        EXPECT_FALSE (error);
+        die_context_map const contexts = builder.release_contexts ();
+
+        sequences result;
+        for (die_context_map::value_type const & entry : contexts) {
+            dwarf::die_ptr const die = debug.offset_to_die (entry.offset);
+            std::vector<std::uint8_t> S;
+            scan_type (&debug, die.get (), contexts, std::back_inserter (S));
+            result.emplace (entry.offset, std::move (S));
+        }
+        return result;
+    }
+
+    boost::iostreams::mapped_file_source open_fixture (char const * fixture) {
+        return boost::iostreams::mapped_file_source (std::string (DEBUG_TYPES_FIXTURES) + '/' +
+                                                     fixture);
+    }
+
+    /// Sets 'result' to the type sequences read from 'map_file' by the built-in reader.
+    void native_sequences (boost::iostreams::mapped_file_source const & map_file,
+                           sequences * const result) {
+        // The built-in reader must be able to read the file rather than leave it to libdwarf.
+        std::unique_ptr<dwarf::native_index> const index =
+            dwarf::make_native_index (map_file.data (), map_file.size ());
+        ASSERT_NE (nullptr, index);
+        dwarf::native_debug native (*index);
+        *result = type_sequences (native);
+    }
+
+    void compare_readers (char const * fixture) {
+        boost::iostreams::mapped_file_source const map_file = open_fixture (fixture);
+
+        auto elf = elf::make_elf (map_file.data (), map_file.size ());
+        auto debug_ptr = dwarf::make_dwarf (elf);
+        dwarf::debug libdwarf (debug_ptr.get ());
+        sequences const expected = type_sequences (libdwarf);
+
+        sequences actual;
+        native_sequences (map_file, &actual);
+        if (::testing::Test::HasFatalFailure ()) {
+            return;
+        }
+
+        EXPECT_GT (expected.size (), 20U);
+        ASSERT_EQ (expected.size (), actual.size ());
+        for (auto const & kvp : expected) {
+            auto const pos = actual.find (kvp.first);
+            ASSERT_NE (actual.end (), pos) << "offset " << kvp.first;
+            EXPECT_THAT (pos->second, ::testing::ContainerEq (kvp.second))
+                << "offset " << kvp.first;
+        }
+    }
+}
+
+TEST (DwarfReaders, Dwarf4) {
+    compare_readers ("types_dwarf4.elf");
+}
+
+#if LIBDWARF_READS_DWARF5
+TEST (DwarfReaders, Dwarf5) {
+    compare_readers ("types_dwarf5.elf");
+}
+#else
+// Skipped: this libdwarf can't read the fixture.
+TEST (DwarfReaders, DISABLED_Dwarf5) {
+    compare_readers ("types_dwarf5.elf");
+}
+#endif // LIBDWARF_READS_DWARF5
+
+TEST (DwarfReaders, Dwarf5Native) {
+    // Whatever libdwarf can read, the built-in reader must read the DWARF 5 fixture.
+    sequences actual;
+    native_sequences (open_fixture ("types_dwarf5.elf"), &actual);
+    EXPECT_GT (actual.size (), 20U);
+}
+
+// eof test_readers.cpp
@@ -50,6 +50,7 @@ namespace {
 
         void setup () {
             DieTree::setup (std::begin (dies_), std::end (dies_));
+            contexts_.sort ();
         }
 
         auto build_ExampleE_2_1_structC (Dwarf_Die_s * base_type_int = nullptr)
@@ -112,9 +113,13 @@ namespace {
             // base_type_int?
         // clang-format on
 
-        auto const producer = std::make_shared<std::string> ("producer");
-        contexts_[struct_C->offset ()] = std::make_tuple (std::string{"C9N"} + '\0', producer);
-        contexts_[base_type_int->offset ()] = std::make_tuple (std::string{}, producer);
+        auto const producer = contexts_.add_producer ("producer");
+        auto const namespace_N_context =
+            contexts_.add_context (die_context_map::root_context, DW_TAG_namespace, "N");
+        contexts_.add (struct_C->offset (), namespace_N_context, producer);
+        if (int_in_this_cu) {
+            contexts_.add (base_type_int->offset (), die_context_map::root_context, producer);
+        }
         return std::make_tuple (cu, struct_C);
     }
 
@@ -214,12 +219,14 @@ namespace {
             //base_type_int
         // clang-format on
 
-        auto producer = std::make_shared<std::string> ("producer");
-        contexts_[class_A->offset ()] = std::make_tuple (std::string{"C9N"} + '\0', producer);
-        contexts_[base_type_int->offset ()] = std::make_tuple (std::string{}, producer);
-        contexts_[ptr_class_A->offset ()] = std::make_tuple (std::string{}, producer);
-        contexts_[ptr_struct_B->offset ()] = std::make_tuple (std::string{}, producer);
-        contexts_[struct_B->offset ()] = std::make_tuple (std::string{"C9N"} + '\0', producer);
+        auto const producer = contexts_.add_producer ("producer");
+        auto const namespace_N_context =
+            contexts_.add_context (die_context_map::root_context, DW_TAG_namespace, "N");
+        contexts_.add (class_A->offset (), namespace_N_context, producer);
+        contexts_.add (base_type_int->offset (), die_context_map::root_context, producer);
+        contexts_.add (ptr_class_A->offset (), die_context_map::root_context, producer);
+        contexts_.add (ptr_struct_B->offset (), die_context_map::root_context, producer);
+        contexts_.add (struct_B->offset (), namespace_N_context, producer);
         return std::make_tuple (cu, class_A);
     }
 }
@@ -459,4 +466,109 @@ TEST_F (ScanType, ExampleE_2_1_classA) {
     EXPECT_THAT (S, ::testing::ContainerEq (expected));
     EXPECT_EQ (reserve, S.size ());
 }
+
+namespace {
+    std::vector<std::uint8_t> scan_type_uncached (dwarf::debug * const debug, Dwarf_Die die,
+                                                  die_context_map const & contexts) {
+        std::vector<std::uint8_t> S;
+        scan_type (debug, die, contexts, std::back_inserter (S));
+        return S;
+    }
+    std::vector<std::uint8_t> scan_type_cached (dwarf::debug * const debug, Dwarf_Die die,
+                                                die_context_map const & contexts,
+                                                subtree_recorder & recorder) {
+        std::vector<std::uint8_t> S;
+        scan_type (debug, die, contexts, recorder, std::back_inserter (S));
+        return S;
+    }
+}
+
+TEST_F (ScanType, SubtreeCacheMatchesUncached) {
+    dies_.reserve (23);
+    this->build_ExampleE_2_1_classA ();
+    this->setup ();
+
+    std::vector<Dwarf_Die> types;
+    for (Dwarf_Die_s & d : dies_) {
+        if (contexts_.find (d.offset ()) != std::end (contexts_)) {
+            types.push_back (&d);
+        }
+    }
+    ASSERT_EQ (6U, types.size ());
+
+    // Scan the types in both directions so that each is seen both before and after the types
+    // that it references have been recorded.
+    for (bool const forward : {true, false}) {
+        subtree_cache cache (std::size_t{1} << 20);
+        subtree_recorder recorder (cache);
+        for (int pass = 0; pass < 2; ++pass) {
+            for (std::size_t ctr = 0; ctr < types.size (); ++ctr) {
+                Dwarf_Die const die = types[forward ? ctr : types.size () - ctr - 1];
+                EXPECT_EQ (scan_type_uncached (&debug, die, contexts_),
+                           scan_type_cached (&debug, die, contexts_, recorder))
+                    << "offset " << die->offset ();
+            }
+        }
+        EXPECT_GT (cache.size (), 0U);
+    }
+}
+
+TEST_F (ScanType, SubtreeCacheRelocatesReferences) {
+    dies_.reserve (8);
+    Dwarf_Die struct_C = std::get<1> (this->build_ExampleE_2_1_structC ());
+    // struct W { N::C c; } in which C's two references to 'int' have different indices to those
+    // produced when C is scanned alone.
+    auto struct_W = add_die (DW_TAG_structure_type, {{DW_AT_byte_size, 8}});
+    auto struct_W_c = add_die (DW_TAG_member, {{DW_AT_data_member_location, Dwarf_Signed{0}}});
+    struct_W_c->add_attribute (DW_AT_type, struct_C);
+    struct_W->child (struct_W_c);
+    this->setup ();
+
+    subtree_cache cache (std::size_t{1} << 20);
+    subtree_recorder recorder (cache);
+    EXPECT_EQ (scan_type_uncached (&debug, struct_C, contexts_),
+               scan_type_cached (&debug, struct_C, contexts_, recorder));
+
+    // The fragment for C refers to 'int' relative to C itself.
+    subtree_cache::fragment_ptr const f = cache.find (struct_C->offset ());
+    ASSERT_NE (nullptr, f);
+    ASSERT_EQ (1U, f->references.size ());
+    EXPECT_EQ (1U, f->references.front ().relative_index);
+    ASSERT_EQ (1U, f->visited.size ());
+
+    std::vector<std::uint8_t> const expected = scan_type_uncached (&debug, struct_W, contexts_);
+    EXPECT_EQ (expected, scan_type_cached (&debug, struct_W, contexts_, recorder));
+}
+TEST_F (ScanType, DeeplyNestedTypes) {
+    // int * * ... *, where only the innermost pointer refers to a named type. The types are
+    // nested far more deeply than a recursive walk could manage.
+    constexpr auto depth = std::size_t{100000};
+    dies_.reserve (depth + 1U);
+    Dwarf_Die_s * referenced = add_die (
+        DW_TAG_base_type,
+        {{DW_AT_byte_size, 4}, {DW_AT_encoding, DW_ATE_signed}, {DW_AT_name, "int"}});
+    for (auto ctr = std::size_t{0}; ctr < depth; ++ctr) {
+        auto pointer = add_die (DW_TAG_pointer_type);
+        pointer->add_attribute (DW_AT_type, referenced);
+        referenced = pointer;
+    }
+    contexts_.add (referenced->offset (), die_context_map::root_context,
+                   contexts_.add_producer ("producer"));
+    this->setup ();
+
+    // Each pointer is 'D' DW_TAG_pointer_type followed by its referenced type and a terminating
+    // zero. The innermost names 'int'; the others use 'T' to include the next pointer.
+    std::vector<std::uint8_t> expected;
+    for (auto ctr = std::size_t{1}; ctr < depth; ++ctr) {
+        append (expected, {'D', DW_TAG_pointer_type, 'T', DW_AT_type});
+    }
+    append (expected, {'D', DW_TAG_pointer_type, 'N', DW_AT_type, 'E', 'i', 'n', 't', '\0'});
+    expected.insert (std::end (expected), depth, std::uint8_t{0});
+
+    EXPECT_EQ (expected, scan_type_uncached (&debug, referenced, contexts_));
+
+    subtree_cache cache (std::size_t{1} << 20);
+    subtree_recorder recorder (cache);
+    EXPECT_EQ (expected, scan_type_cached (&debug, referenced, contexts_, recorder));
+}
 // eof test_scan_type.cpp
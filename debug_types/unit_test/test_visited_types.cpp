@@ -81,4 +81,16 @@ TEST (VisitedTypes, TwoDies) {
     unsigned index2 = v.add (d2p);
     EXPECT_EQ (2U, index2);
 }
+
+TEST (VisitedTypes, Offsets) {
+    mock_debug debug;
+    visited_types v (&debug);
+    EXPECT_EQ (1U, v.add (Dwarf_Off{93}));
+    EXPECT_EQ (2U, v.add (Dwarf_Off{27}));
+    EXPECT_EQ (1U, v.add (Dwarf_Off{93}));
+    EXPECT_EQ (2U, v.size ());
+    EXPECT_TRUE (v.contains (27));
+    EXPECT_FALSE (v.contains (28));
+    EXPECT_THAT (v.offsets (), ::testing::ElementsAre (Dwarf_Off{93}, Dwarf_Off{27}));
+}
 // eof test_visited_types.cpp
@@ -0,0 +1,112 @@
+// Copyright (c) 2016 by SN Systems Ltd., Sony Interactive Entertainment Inc.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "work_queue.hpp"
+
+#include <initializer_list>
+#include <set>
+#include <utility>
+#include <vector>
+
+#include <gmock/gmock.h>
+
+namespace {
+    /// Returns a sorted map holding a type DIE at each of 'offsets' and compilation units
+    /// starting at each of 'units'.
+    die_context_map make_contexts (std::initializer_list<Dwarf_Off> offsets,
+                                   std::initializer_list<Dwarf_Off> units) {
+        die_context_map contexts;
+        auto const producer = contexts.add_producer ("producer");
+        for (Dwarf_Off const offset : offsets) {
+            contexts.add (offset, die_context_map::root_context, producer);
+        }
+        for (Dwarf_Off const unit : units) {
+            contexts.add_unit (unit);
+        }
+        contexts.sort ();
+        return contexts;
+    }
+
+    /// Returns the offsets of the first and last DIEs in each batch.
+    std::vector<std::pair<Dwarf_Off, Dwarf_Off>> bounds (std::vector<work_batch> batches) {
+        std::vector<std::pair<Dwarf_Off, Dwarf_Off>> result;
+        for (work_batch & batch : batches) {
+            result.emplace_back (batch.begin ()->offset, std::prev (batch.end ())->offset);
+        }
+        return result;
+    }
+}
+
+TEST (WorkBatches, Empty) {
+    die_context_map const contexts = make_contexts ({}, {});
+    EXPECT_TRUE (make_work_batches (contexts, 100U).empty ());
+}
+
+TEST (WorkBatches, EndAtUnits) {
+    // Three units starting at 0, 100 and 1000.
+    die_context_map const contexts = make_contexts ({10, 20, 110, 120, 1010}, {0, 100, 1000});
+    using ::testing::ElementsAre;
+    using ::testing::Pair;
+    // The first batch runs on to the start of the second unit. The second unit's remaining bytes
+    // are more than another batch so the batch stops at the limit.
+    EXPECT_THAT (bounds (make_work_batches (contexts, 50U)),
+                 ElementsAre (Pair (10U, 20U), Pair (110U, 120U), Pair (1010U, 1010U)));
+}
+
+TEST (WorkBatches, LargeUnitIsSplit) {
+    die_context_map const contexts =
+        make_contexts ({0, 10, 20, 30, 40, 50, 60, 70, 80, 90, 100}, {0});
+    using ::testing::ElementsAre;
+    using ::testing::Pair;
+    EXPECT_THAT (bounds (make_work_batches (contexts, 40U)),
+                 ElementsAre (Pair (0U, 30U), Pair (40U, 70U), Pair (80U, 100U)));
+}
+
+TEST (WorkQueue, WorkersTakeTheirOwnShares) {
+    die_context_map const contexts = make_contexts ({0, 10, 20, 30, 40, 50, 60, 70}, {0});
+    work_queue queue (make_work_batches (contexts, 10U), 2U);
+    ASSERT_EQ (8U, queue.size ());
+
+    std::vector<Dwarf_Off> taken;
+    work_batch batch;
+    for (auto ctr = 0U; ctr < 4U; ++ctr) {
+        ASSERT_TRUE (queue.pop (1U, batch));
+        taken.push_back (batch.begin ()->offset);
+    }
+    EXPECT_THAT (taken, ::testing::ElementsAre (40U, 50U, 60U, 70U));
+    EXPECT_EQ (0U, queue.steals ());
+}
+
+TEST (WorkQueue, IdleWorkerSteals) {
+    die_context_map const contexts = make_contexts ({0, 10, 20, 30, 40, 50, 60, 70}, {0});
+    work_queue queue (make_work_batches (contexts, 10U), 2U);
+
+    // Worker 0 finishes its share and then takes the second half of what remains of worker 1's,
+    // each time in offset order.
+    std::vector<Dwarf_Off> taken;
+    work_batch batch;
+    while (queue.pop (0U, batch)) {
+        taken.push_back (batch.begin ()->offset);
+    }
+    EXPECT_THAT (taken, ::testing::ElementsAre (0U, 10U, 20U, 30U, 60U, 70U, 50U, 40U));
+    EXPECT_EQ (3U, queue.steals ());
+    EXPECT_FALSE (queue.pop (1U, batch));
+}
+// eof test_work_queue.cpp
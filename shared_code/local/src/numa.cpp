@@ -0,0 +1,198 @@
+// Copyright (c) 2016 by Sony Interactive Entertainment, Inc.
+// This file is subject to the terms and conditions defined in file
+// 'LICENSE.txt', which is part of this source code package.
+
+#include "numa.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace {
+
+    /// Returns the CPUs 0 to n-1 where n is the number reported by the standard library.
+    numa::topology::cpu_list all_cpus () {
+        numa::topology::cpu_list result (std::max (std::thread::hardware_concurrency (), 1U));
+        for (auto ctr = 0U; ctr < result.size (); ++ctr) {
+            result[ctr] = ctr;
+        }
+        return result;
+    }
+
+    /// Reads the first line of the file at 'path'. Returns false if it could not be read.
+    bool read_line (std::string const & path, std::string * const line) {
+        std::ifstream file (path);
+        return static_cast<bool> (std::getline (file, *line));
+    }
+
+} // end anonymous namespace
+
+namespace numa {
+
+    // ************
+    // * topology *
+    // ************
+    // (ctor)
+    // ~~~~~~
+    topology::topology (std::vector<cpu_list> nodes)
+            : nodes_ (std::move (nodes)) {
+        // Memory-only nodes have no CPUs on which to run a worker.
+        nodes_.erase (std::remove_if (std::begin (nodes_), std::end (nodes_),
+                                      [](cpu_list const & l) { return l.empty (); }),
+                      std::end (nodes_));
+        if (nodes_.empty ()) {
+            nodes_.push_back (all_cpus ());
+        }
+    }
+
+    // detect [static]
+    // ~~~~~~
+    topology topology::detect () {
+        std::vector<cpu_list> nodes;
+#ifdef __linux__
+        static char const root[] = "/sys/devices/system/node/";
+        std::string line;
+        if (read_line (std::string (root) + "online", &line)) {
+            try {
+                for (unsigned const node : parse_cpu_list (line)) {
+                    std::ostringstream path;
+                    path << root << "node" << node << "/cpulist";
+                    if (read_line (path.str (), &line)) {
+                        nodes.push_back (parse_cpu_list (line));
+                    }
+                }
+            } catch (std::runtime_error const &) {
+                // A kernel that we don't understand. Behave as if there's a single node.
+                nodes.clear ();
+            }
+        }
+#endif
+        return topology{std::move (nodes)};
+    }
+
+    // simulate [static]
+    // ~~~~~~~~
+    topology topology::simulate (unsigned nodes) {
+        // Flatten the real topology so that the simulated nodes name CPUs which exist.
+        cpu_list cpus;
+        topology const real = detect ();
+        for (auto const & node : real.nodes_) {
+            cpus.insert (std::end (cpus), std::begin (node), std::end (node));
+        }
+
+        nodes = std::max (nodes, 1U);
+        std::vector<cpu_list> result (nodes);
+        if (nodes <= cpus.size ()) {
+            for (std::size_t ctr = 0; ctr < cpus.size (); ++ctr) {
+                result[ctr * nodes / cpus.size ()].push_back (cpus[ctr]);
+            }
+        } else {
+            // More nodes than CPUs: the nodes must share.
+            for (std::size_t ctr = 0; ctr < nodes; ++ctr) {
+                result[ctr].push_back (cpus[ctr % cpus.size ()]);
+            }
+        }
+        return topology{std::move (result)};
+    }
+
+    // parse cpu list [static]
+    // ~~~~~~~~~~~~~~
+    auto topology::parse_cpu_list (std::string const & str) -> cpu_list {
+        auto fail = [&str]() {
+            std::ostringstream message;
+            message << "Malformed CPU list \"" << str << '"';
+            throw std::runtime_error (message.str ());
+        };
+        auto number = [&fail](char const *& p) {
+            char * end = nullptr;
+            unsigned long const v = std::strtoul (p, &end, 10);
+            if (end == p) {
+                fail ();
+            }
+            p = end;
+            return static_cast<unsigned> (v);
+        };
+
+        cpu_list result;
+        char const * p = str.c_str ();
+        while (*p != '\0' && *p != '\n') {
+            unsigned const first = number (p);
+            unsigned last = first;
+            if (*p == '-') {
+                ++p;
+                last = number (p);
+                if (last < first) {
+                    fail ();
+                }
+            }
+            for (auto cpu = first; cpu <= last; ++cpu) {
+                result.push_back (cpu);
+            }
+            if (*p == ',') {
+                ++p;
+            } else if (*p != '\0' && *p != '\n') {
+                fail ();
+            }
+        }
+        return result;
+    }
+
+
+    // *************
+    // * placement *
+    // *************
+    // (ctor)
+    // ~~~~~~
+    placement::placement (topology topo, bool pin)
+            : topo_ (std::move (topo))
+            , pin_ (pin) {}
+
+    // node
+    // ~~~~
+    unsigned placement::node (unsigned worker) const {
+        return static_cast<unsigned> (worker % topo_.size ());
+    }
+
+    // bind
+    // ~~~~
+    unsigned placement::bind (unsigned worker) const {
+        unsigned const n = this->node (worker);
+        if (pin_) {
+            // Failure is not fatal: the worker simply runs wherever the scheduler puts it.
+            (void) pin_current_thread (topo_[n]);
+        }
+        return n;
+    }
+
+
+    // pin current thread
+    // ~~~~~~~~~~~~~~~~~~
+    bool pin_current_thread (topology::cpu_list const & cpus) {
+#ifdef __linux__
+        cpu_set_t set;
+        CPU_ZERO (&set);
+        for (unsigned const cpu : cpus) {
+            if (cpu < CPU_SETSIZE) {
+                CPU_SET (cpu, &set);
+            }
+        }
+        return CPU_COUNT (&set) > 0 &&
+               ::pthread_setaffinity_np (::pthread_self (), sizeof (set), &set) == 0;
+#else
+        (void) cpus;
+        return false;
+#endif
+    }
+
+} // end namespace numa
+
+// eof numa.cpp
@@ -0,0 +1,77 @@
+// Copyright (c) 2016 by Sony Interactive Entertainment, Inc.
+// This file is subject to the terms and conditions defined in file
+// 'LICENSE.txt', which is part of this source code package.
+
+#ifndef SCANLIB_NUMA_HPP
+#define SCANLIB_NUMA_HPP
+
+#include <string>
+#include <vector>
+
+namespace numa {
+
+    // ************
+    // * topology *
+    // ************
+    /// The CPUs belonging to each of the host's NUMA nodes.
+    class topology {
+    public:
+        using cpu_list = std::vector<unsigned>;
+
+        explicit topology (std::vector<cpu_list> nodes);
+
+        /// Reads the host's topology. On Linux this comes from /sys/devices/system/node; if that
+        /// is unavailable (or on other systems), all of the CPUs are placed in a single node.
+        static topology detect ();
+
+        /// Returns a topology in which the host's CPUs are divided evenly between 'nodes'
+        /// nodes (or shared between them if there are more nodes than CPUs). Used to exercise
+        /// the node-local code paths on a machine with a single node.
+        static topology simulate (unsigned nodes);
+
+        /// Parses a Linux CPU list such as "0-3,8,10-11". Throws std::runtime_error if the
+        /// string is malformed.
+        static cpu_list parse_cpu_list (std::string const & str);
+
+        std::size_t size () const { return nodes_.size (); }
+        cpu_list const & operator[] (std::size_t node) const { return nodes_[node]; }
+
+    private:
+        std::vector<cpu_list> nodes_;
+    };
+
+
+    // *************
+    // * placement *
+    // *************
+    /// Assigns worker threads to the nodes of a topology. Workers are dealt round-robin so that
+    /// a pool smaller than the machine still spreads across all of its memory controllers.
+    class placement {
+    public:
+        /// \param topo  The topology over which workers are spread.
+        /// \param pin  If false, node() still shards the workers but bind() doesn't restrict
+        ///   the CPUs on which they run.
+        placement (topology topo, bool pin);
+
+        std::size_t nodes () const { return topo_.size (); }
+        /// Returns the node to which worker number 'worker' is assigned.
+        unsigned node (unsigned worker) const;
+
+        /// Restricts the calling thread (worker number 'worker') to the CPUs of its node.
+        /// \returns The worker's node.
+        unsigned bind (unsigned worker) const;
+
+    private:
+        topology topo_;
+        bool pin_;
+    };
+
+
+    /// Restricts the calling thread to the given CPUs. Returns false if thread affinity is not
+    /// supported on this system or the request was refused.
+    bool pin_current_thread (topology::cpu_list const & cpus);
+
+} // end namespace numa
+
+#endif // SCANLIB_NUMA_HPP
+// eof numa.hpp
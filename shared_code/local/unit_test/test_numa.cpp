@@ -0,0 +1,51 @@
+#include "numa.hpp"
+
+#include <stdexcept>
+
+#include <gmock/gmock.h>
+
+TEST (NumaTopology, ParseCpuList) {
+    using ::testing::ElementsAre;
+    EXPECT_THAT (numa::topology::parse_cpu_list ("0"), ElementsAre (0U));
+    EXPECT_THAT (numa::topology::parse_cpu_list ("0-3,8,10-11\n"),
+                 ElementsAre (0U, 1U, 2U, 3U, 8U, 10U, 11U));
+    EXPECT_TRUE (numa::topology::parse_cpu_list ("").empty ());
+}
+
+TEST (NumaTopology, ParseMalformedCpuList) {
+    EXPECT_THROW (numa::topology::parse_cpu_list ("a"), std::runtime_error);
+    EXPECT_THROW (numa::topology::parse_cpu_list ("3-1"), std::runtime_error);
+    EXPECT_THROW (numa::topology::parse_cpu_list ("1;2"), std::runtime_error);
+}
+
+TEST (NumaTopology, EmptyNodesAreDropped) {
+    numa::topology const topo ({{}, {4, 5}, {}});
+    ASSERT_EQ (1U, topo.size ());
+    EXPECT_THAT (topo[0], ::testing::ElementsAre (4U, 5U));
+}
+
+TEST (NumaTopology, Simulate) {
+    numa::topology const real = numa::topology::detect ();
+    std::size_t cpus = 0;
+    for (std::size_t node = 0; node < real.size (); ++node) {
+        cpus += real[node].size ();
+    }
+
+    numa::topology const sim = numa::topology::simulate (2);
+    ASSERT_EQ (2U, sim.size ());
+    EXPECT_FALSE (sim[0].empty ());
+    EXPECT_FALSE (sim[1].empty ());
+    // The CPUs are divided between the nodes unless there are too few to go round.
+    EXPECT_EQ (std::max (cpus, std::size_t{2}), sim[0].size () + sim[1].size ());
+}
+
+TEST (NumaPlacement, RoundRobin) {
+    numa::placement const p (numa::topology ({{0, 1}, {2, 3}, {4, 5}}), false);
+    EXPECT_EQ (3U, p.nodes ());
+    EXPECT_EQ (0U, p.node (0));
+    EXPECT_EQ (1U, p.node (1));
+    EXPECT_EQ (2U, p.node (2));
+    EXPECT_EQ (0U, p.node (3));
+    // Without pinning, bind() just reports the node.
+    EXPECT_EQ (1U, p.bind (4));
+}